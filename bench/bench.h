@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Lienzo {
+namespace Bench {
+
+// Extra named values attached to a result (memory, sizes, ...)
+using Counters = std::vector<std::pair<std::string, double>>;
+
+struct Result {
+    std::string name;
+    size_t ops;
+    double seconds;
+    Counters counters;
+};
+
+class Context {
+public:
+    explicit Context(double scale) : scale(scale) {}
+    
+    // Scale a problem size by the --scale factor (never below 1)
+    size_t size(size_t n) const {
+        size_t scaled = static_cast<size_t>(static_cast<double>(n) * scale);
+        return scaled > 0 ? scaled : 1;
+    }
+    
+    // Run body once and return elapsed seconds
+    template<typename F>
+    static double time(F&& body) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double>(end - start).count();
+    }
+    
+    // Print one result line: name, operation count, elapsed time, throughput
+    void report(const std::string& name, size_t ops, double seconds,
+                const Counters& counters = Counters());
+    
+    // Everything reported so far, in order
+    const std::vector<Result>& getResults() const { return results; }
+    
+private:
+    double scale;
+    std::vector<Result> results;
+};
+
+using BenchFunction = std::function<void(Context&)>;
+
+bool registerBenchmark(const char* name, BenchFunction function);
+
+} // namespace Bench
+} // namespace Lienzo
+
+// Defines and registers a benchmark function
+#define LIENZO_BENCHMARK(name) \
+    static void name(Lienzo::Bench::Context& ctx); \
+    static bool name##_registered = Lienzo::Bench::registerBenchmark(#name, name); \
+    static void name(Lienzo::Bench::Context& ctx)
@@ -0,0 +1,168 @@
+#include "bench.h"
+#include "chat.h"
+#include "crdt.h"
+#include "generation_cache.h"
+#include "model_stream.h"
+#include <chrono>
+#include <string>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kElements = 2000;
+const size_t kTokenSize = 4;    // Characters per token, roughly what models emit
+
+// A large generated illustration: prose, then rects, paths and circles in groups
+std::string makeResponse(size_t elements) {
+    std::string svg = "Sure! Here is the illustration you asked for:\n```svg\n"
+                      "<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"0 0 2000 2000\">\n";
+    for (size_t i = 0; i < elements; i++) {
+        if (i % 50 == 0) {
+            svg += i == 0 ? "<g id=\"layer0\">\n" : "</g>\n<g id=\"layer" + std::to_string(i / 50) + "\">\n";
+        }
+        std::string x = std::to_string(i % 40 * 50);
+        std::string y = std::to_string(i / 40 * 40);
+        switch (i % 3) {
+            case 0:
+                svg += "  <rect x=\"" + x + "\" y=\"" + y + "\" width=\"40\" height=\"30\" fill=\"#3A86FF\"/>\n";
+                break;
+            case 1:
+                svg += "  <path d=\"M" + x + " " + y + " c10 -20 30 -20 40 0 s-10 30 -20 30 z\" "
+                       "fill=\"none\" stroke=\"#FB5607\" stroke-width=\"2\"/>\n";
+                break;
+            default:
+                svg += "  <circle cx=\"" + x + "\" cy=\"" + y + "\" r=\"15\" fill=\"#8338EC\"/>\n";
+                break;
+        }
+    }
+    svg += "</g>\n</svg>\n```\nEach layer groups fifty shapes.";
+    return svg;
+}
+
+} // namespace
+
+// Time until the first shape is in the frame and total ingest throughput,
+// streaming versus parsing the buffered response once it is complete
+LIENZO_BENCHMARK(ai_stream_ingest) {
+    size_t elements = ctx.size(kElements);
+    std::string response = makeResponse(elements);
+    auto model = std::make_shared<MockModelServer>();
+    model->setDefaultResponse(response);
+    model->setTokenSize(kTokenSize);
+
+    CRDTDocument doc("alice");
+    CRDTId frame = doc.createNode("frame");
+    doc.addChild(doc.getRootId(), frame);
+    size_t batches = 0;
+    doc.addBatchListener([&] { batches++; });
+
+    ChatInterface chat;
+    chat.setModel(model);
+    chat.setTargetFrame(doc, frame);
+    auto start = std::chrono::steady_clock::now();
+    double firstShape = -1.0;
+    size_t tokensBeforeFirst = 0;
+    chat.setShapeCreatedCallback([&](const CRDTId&) {
+        if (firstShape < 0.0) {
+            firstShape = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            tokensBeforeFirst = model->getTokensSent();
+        }
+    });
+    double seconds = ctx.time([&] { chat.sendMessage("draw an illustration"); });
+    size_t created = doc.getChildren(frame).size();
+    size_t tokens = model->getTokensSent();
+
+    // Buffered: collect the whole response, then parse it in one go
+    CRDTDocument bufferedDoc("bob");
+    CRDTId bufferedFrame = bufferedDoc.createNode("frame");
+    bufferedDoc.addChild(bufferedDoc.getRootId(), bufferedFrame);
+    std::string collected;
+    double bufferedFirst = ctx.time([&] {
+        model->generate("draw", [&](std::string_view token) {
+            collected.append(token.data(), token.size());
+            return true;
+        });
+        ChatInterface bufferedChat;
+        bufferedChat.setTargetFrame(bufferedDoc, bufferedFrame);
+        bufferedChat.beginVectorStream();
+        bufferedChat.receiveVectorTokens(collected);
+        bufferedChat.endVectorStream();
+    });
+
+    ctx.report("ai_stream_ingest", elements, seconds, Counters{
+        {"first_shape_us", firstShape * 1e6},
+        {"first_shape_tokens", static_cast<double>(tokensBeforeFirst)},
+        {"tokens", static_cast<double>(tokens)},
+        {"buffered_first_shape_us", bufferedFirst * 1e6},
+        {"mb_per_sec", static_cast<double>(response.size()) / seconds / 1e6},
+        {"top_level_nodes", static_cast<double>(created)},
+        {"batches", static_cast<double>(batches)},
+    });
+}
+
+// Repeated and reworded prompts against a result cache: a hit rebuilds
+// the shapes from the cached batch instead of streaming and parsing again
+LIENZO_BENCHMARK(ai_generation_cache) {
+    const size_t kPrompts = 20;
+    const size_t kRequests = ctx.size(400);
+    auto model = std::make_shared<MockModelServer>();
+    model->setTokenSize(kTokenSize);
+    for (size_t p = 0; p < kPrompts; p++) {
+        model->addResponse("icon " + std::to_string(p) + " ", makeResponse(100 + p * 10));
+    }
+
+    CRDTDocument doc("alice");
+    CRDTId frame = doc.createNode("frame");
+    doc.setNodeProperty(frame, "width", "800");
+    doc.setNodeProperty(frame, "height", "600");
+    doc.addChild(doc.getRootId(), frame);
+
+    auto cache = std::make_shared<GenerationCache>();
+    ChatInterface chat;
+    chat.setModel(model);
+    chat.setTargetFrame(doc, frame);
+    chat.setCache(cache);
+
+    // Same prompts with different case, spacing and punctuation
+    auto prompt = [](size_t request) {
+        size_t p = request * 7 % kPrompts;
+        switch (request % 3) {
+            case 0: return "Draw icon " + std::to_string(p) + " please.";
+            case 1: return "draw  icon " + std::to_string(p) + " please";
+            default: return "DRAW ICON " + std::to_string(p) + " PLEASE!";
+        }
+    };
+
+    double missSeconds = 0.0, hitSeconds = 0.0;
+    size_t nodes = 0;
+    for (size_t request = 0; request < kRequests; request++) {
+        uint64_t hitsBefore = cache->getStats().hits;
+        double seconds = ctx.time([&] { chat.sendMessage(prompt(request)); });
+        (cache->getStats().hits > hitsBefore ? hitSeconds : missSeconds) += seconds;
+        // Keep the frame small so every request costs the same
+        for (const auto& id : doc.getChildren(frame)) {
+            nodes++;
+            doc.removeChild(frame, id);
+        }
+    }
+    GenerationCache::Stats stats = cache->getStats();
+
+    // A cap of a quarter of the working set forces evictions
+    auto small = std::make_shared<GenerationCache>(stats.bytes / 4);
+    chat.setCache(small);
+    for (size_t request = 0; request < kRequests; request++) {
+        chat.sendMessage(prompt(request));
+    }
+
+    ctx.report("ai_generation_cache", kRequests, missSeconds + hitSeconds, Counters{
+        {"miss_us", stats.misses ? missSeconds * 1e6 / static_cast<double>(stats.misses) : 0.0},
+        {"hit_us", stats.hits ? hitSeconds * 1e6 / static_cast<double>(stats.hits) : 0.0},
+        {"hit_rate_pct", 100.0 * static_cast<double>(stats.hits) / static_cast<double>(kRequests)},
+        {"cache_kb", static_cast<double>(stats.bytes) / 1024.0},
+        {"top_level_nodes", static_cast<double>(nodes)},
+        {"capped_kb", static_cast<double>(small->getStats().bytes) / 1024.0},
+        {"capped_evictions", static_cast<double>(small->getStats().evictions)},
+    });
+}
@@ -0,0 +1,131 @@
+#include "bench.h"
+#include "../src/wasm/crdt_bindings.h"
+#include <string>
+#include <vector>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+// Exported by crdt_bindings.cpp
+extern "C" {
+    void* crdt_manager_create(const char* siteId);
+    const char* crdt_create_rectangle(const char* frameIdStr, double x, double y, double width, double height);
+    double crdt_rectangle_get_x(const char* rectIdStr);
+    void crdt_rectangle_set_position(const char* rectIdStr, double x, double y);
+    const char* crdt_create_frame(double x, double y, double width, double height);
+    double crdt_frame_get_x(const char* frameIdStr);
+    void crdt_free_string(char* str);
+    int crdt_get_metrics(void* out, int size);
+    char* crdt_get_site_clocks();
+}
+
+namespace {
+
+const size_t kCalls = 200000;
+
+} // namespace
+
+// Node IDs cross the JS boundary as "site:clock" strings in both directions
+LIENZO_BENCHMARK(bindings_id_strings) {
+    size_t count = ctx.size(kCalls);
+    std::vector<std::string> strings;
+    strings.reserve(count);
+    double format = ctx.time([&] {
+        for (size_t i = 0; i < count; i++) {
+            strings.push_back(crdtIdToString(CRDTId("site-7f3a", 1000000 + i)));
+        }
+    });
+    size_t valid = 0;
+    double parse = ctx.time([&] {
+        for (const auto& str : strings) {
+            valid += stringToCRDTId(str.c_str()).logicalClock != 0 ? 1 : 0;
+        }
+    });
+    bool roundTrip = stringToCRDTId("a:b:42") == CRDTId("a:b", 42) &&
+                     stringToCRDTId("site:") == CRDTId() && stringToCRDTId("site:12x") == CRDTId();
+    ctx.report("bindings_id_strings", 2 * count, format + parse, Counters{
+        {"format_ns", format * 1e9 / static_cast<double>(count)},
+        {"parse_ns", parse * 1e9 / static_cast<double>(count)},
+        {"valid", static_cast<double>(valid)},
+        {"round_trip_ok", roundTrip ? 1.0 : 0.0},
+    });
+}
+
+// Exported calls as the JS side makes them: ID string in, property parsed out
+LIENZO_BENCHMARK(bindings_calls) {
+    size_t count = ctx.size(kCalls);
+    crdt_manager_create("bench");
+    const char* frame = crdt_create_frame(0, 0, 1000, 1000);
+    std::vector<const char*> rects;
+    const size_t kRects = 1000;
+    for (size_t i = 0; i < kRects; i++) {
+        rects.push_back(crdt_create_rectangle(frame, static_cast<double>(i), 0, 10, 10));
+    }
+
+    double sum = 0.0;
+    double getFrame = ctx.time([&] {
+        for (size_t i = 0; i < count; i++) {
+            sum += crdt_frame_get_x(frame);
+        }
+    });
+    double getRect = ctx.time([&] {
+        for (size_t i = 0; i < count; i++) {
+            sum += crdt_rectangle_get_x(rects[i % kRects]);
+        }
+    });
+    double setRect = ctx.time([&] {
+        for (size_t i = 0; i < count; i++) {
+            crdt_rectangle_set_position(rects[i % kRects], static_cast<double>(i), 5.0);
+        }
+    });
+
+    for (const char* rect : rects) {
+        crdt_free_string(const_cast<char*>(rect));
+    }
+    crdt_free_string(const_cast<char*>(frame));
+    ctx.report("bindings_calls", 3 * count, getFrame + getRect + setRect, Counters{
+        {"frame_get_x_ns", getFrame * 1e9 / static_cast<double>(count)},
+        {"rectangle_get_x_ns", getRect * 1e9 / static_cast<double>(count)},
+        {"rectangle_set_position_ns", setRect * 1e9 / static_cast<double>(count)},
+        {"checksum", sum > 0.0 ? 1.0 : 0.0},
+    });
+}
+
+// Dashboard polling: one crdt_get_metrics call on a document of frames of
+// rectangles, and whether its node and operation counts add up
+LIENZO_BENCHMARK(bindings_metrics) {
+    size_t frames = ctx.size(200);
+    const size_t kRectsPerFrame = 50;
+    crdt_manager_create("bench");
+    for (size_t f = 0; f < frames; f++) {
+        char* frame = const_cast<char*>(crdt_create_frame(static_cast<double>(f) * 1200.0, 0, 1000, 1000));
+        for (size_t i = 0; i < kRectsPerFrame; i++) {
+            crdt_free_string(const_cast<char*>(crdt_create_rectangle(frame, static_cast<double>(i), 0, 10, 10)));
+        }
+        crdt_free_string(frame);
+    }
+
+    const size_t kPolls = 20;
+    CRDTMetrics metrics;
+    int written = 0;
+    double seconds = ctx.time([&] {
+        for (size_t i = 0; i < kPolls; i++) {
+            written = crdt_get_metrics(&metrics, sizeof(metrics));
+        }
+    });
+    bool counts = written == static_cast<int>(sizeof(metrics)) &&
+                  metrics.liveFrames == static_cast<double>(frames) &&
+                  metrics.liveRectangles == static_cast<double>(frames * kRectsPerFrame) &&
+                  metrics.localOperations > metrics.liveNodes;
+    char* clocks = crdt_get_site_clocks();
+    bool clocksOk = std::string(clocks) ==
+                    "[{\"site\":\"bench\",\"clock\":" + std::to_string(static_cast<uint64_t>(metrics.logicalClock)) + "}]";
+    crdt_free_string(clocks);
+    ctx.report("bindings_metrics", kPolls, seconds, Counters{
+        {"poll_us", seconds * 1e6 / static_cast<double>(kPolls)},
+        {"nodes", metrics.residentNodes},
+        {"struct_bytes", static_cast<double>(written)},
+        {"counts_ok", counts ? 1.0 : 0.0},
+        {"site_clocks_ok", clocksOk ? 1.0 : 0.0},
+    });
+}
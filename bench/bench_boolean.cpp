@@ -0,0 +1,189 @@
+#include "bench.h"
+#include "boolean_ops.h"
+#include "svg_export.h"
+#include <cmath>
+#include <string>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kSegments = 12000;
+
+// Closed wavy circle made of many short segments; two with different wave
+// counts cross each other wherever their rims overlap
+VectorPath wavyCircle(double cx, double cy, double radius, size_t segments, double waves) {
+    VectorPath path;
+    for (size_t i = 0; i < segments; i++) {
+        double angle = 2.0 * 3.14159265358979 * static_cast<double>(i) / static_cast<double>(segments);
+        double r = radius * (1.0 + 0.08 * std::sin(waves * angle));
+        path.addPoint(Point(cx + r * std::cos(angle), cy + r * std::sin(angle)));
+    }
+    path.close();
+    return path;
+}
+
+// Net enclosed area; holes run opposite to their outer boundary
+double area(const std::vector<VectorPath>& paths) {
+    double sum = 0.0;
+    for (const auto& path : paths) {
+        const auto& points = path.points;
+        for (size_t i = 0; i < points.size(); i++) {
+            const Point& p = points[i];
+            const Point& q = points[(i + 1) % points.size()];
+            sum += p.x * q.y - q.x * p.y;
+        }
+    }
+    return std::fabs(sum) / 2.0;
+}
+
+bool near(double a, double b, double scale) {
+    return std::fabs(a - b) <= 1e-6 * scale;
+}
+
+} // namespace
+
+// All four operations on two 10k+ segment outlines, checked against the
+// area identities they must satisfy
+LIENZO_BENCHMARK(boolean_ops) {
+    size_t segments = ctx.size(kSegments);
+    std::vector<VectorPath> a{wavyCircle(0.0, 0.0, 1000.0, segments, 37.0)};
+    std::vector<VectorPath> b{wavyCircle(600.0, 100.0, 900.0, segments, 53.0)};
+    double areaA = area(a), areaB = area(b);
+
+    BooleanResult results[4];
+    const BooleanOp ops[4] = {BooleanOp::Union, BooleanOp::Subtract, BooleanOp::Intersect, BooleanOp::Exclude};
+    double seconds[4];
+    for (int i = 0; i < 4; i++) {
+        seconds[i] = ctx.time([&] { results[i] = computeBoolean(a, b, ops[i]); });
+    }
+    double unionArea = area(results[0].paths), subtractArea = area(results[1].paths);
+    double intersectArea = area(results[2].paths), excludeArea = area(results[3].paths);
+    double scale = areaA + areaB;
+    // Every crossing was split before the windings were classified
+    bool resolved = results[0].resolved && results[1].resolved && results[2].resolved && results[3].resolved;
+    bool areasOk = near(unionArea + intersectArea, areaA + areaB, scale) &&
+                   near(subtractArea + intersectArea, areaA, scale) &&
+                   near(excludeArea, unionArea - intersectArea, scale);
+
+    // Orientation stays exact for nearly collinear points
+    Point p(0.5, 0.5), q(12.0, 12.0), r(24.0, 24.0);
+    Point nudged(24.0, std::nextafter(24.0, 25.0));
+    bool predicatesOk = orient2d(p, q, r) == 0 && orient2d(p, q, nudged) == 1 && orient2d(q, p, nudged) == -1;
+
+    double total = seconds[0] + seconds[1] + seconds[2] + seconds[3];
+    ctx.report("boolean_ops", 4, total, Counters{
+        {"input_segments", static_cast<double>(results[0].inputSegments)},
+        {"intersections", static_cast<double>(results[0].intersections)},
+        {"passes", static_cast<double>(results[0].passes)},
+        {"union_ms", seconds[0] * 1e3},
+        {"subtract_ms", seconds[1] * 1e3},
+        {"intersect_ms", seconds[2] * 1e3},
+        {"exclude_ms", seconds[3] * 1e3},
+        {"union_paths", static_cast<double>(results[0].paths.size())},
+        {"exclude_paths", static_cast<double>(results[3].paths.size())},
+        {"resolved", resolved ? 1.0 : 0.0},
+        {"areas_ok", areasOk ? 1.0 : 0.0},
+        {"predicates_ok", predicatesOk ? 1.0 : 0.0},
+    });
+}
+
+// Document shapes: the first computation, cached repeats, a recompute
+// after an operand moves, and writing the result back in one batch
+LIENZO_BENCHMARK(boolean_engine) {
+    size_t segments = ctx.size(kSegments);
+    CRDTDocument doc("alice");
+    CRDTId frame = doc.createNode("frame");
+    doc.addChild(doc.getRootId(), frame);
+    auto addShape = [&](const VectorPath& path) {
+        std::string d;
+        appendPathData(d, path, 4);
+        CRDTId id = doc.createNode("shape");
+        doc.setNodeProperty(id, "kind", "path");
+        doc.setNodeProperty(id, "d", d);
+        doc.setNodeProperty(id, "x", "-2000");
+        doc.setNodeProperty(id, "y", "-2000");
+        doc.setNodeProperty(id, "width", "4000");
+        doc.setNodeProperty(id, "height", "4000");
+        doc.setNodeProperty(id, "fill", "#118AB2");
+        doc.addChild(frame, id);
+        return id;
+    };
+    CRDTId a = addShape(wavyCircle(0.0, 0.0, 1000.0, segments, 37.0));
+    CRDTId b = addShape(wavyCircle(600.0, 100.0, 900.0, segments, 53.0));
+
+    BooleanEngine engine(doc);
+    double first = ctx.time([&] { engine.compute(BooleanOp::Union, a, b); });
+    const size_t kRepeats = 1000;
+    double cached = ctx.time([&] {
+        for (size_t i = 0; i < kRepeats; i++) {
+            engine.compute(BooleanOp::Union, a, b);
+        }
+    });
+    size_t hits = engine.getHits();
+
+    doc.setNodeProperty(b, "d", [&] {
+        std::string d;
+        appendPathData(d, wavyCircle(500.0, 100.0, 900.0, segments, 53.0), 4);
+        return d;
+    }());
+    size_t misses = engine.getMisses();
+    double recompute = ctx.time([&] { engine.compute(BooleanOp::Union, a, b); });
+    bool invalidated = engine.getMisses() == misses + 1;
+
+    size_t batches = 0;
+    doc.addBatchListener([&] { batches++; });
+    CRDTId result;
+    double applied = ctx.time([&] { result = engine.apply(BooleanOp::Subtract, a, b, frame, true); });
+    bool applyOk = !result.siteId.empty() && doc.getNode(a)->isDeleted() && doc.getNode(b)->isDeleted() &&
+                   !doc.getNodeProperty(result, "d").empty() && doc.getNodeProperty(result, "fill") == "#118AB2";
+
+    ctx.report("boolean_engine", kRepeats, cached, Counters{
+        {"first_ms", first * 1e3},
+        {"cached_ns", cached * 1e9 / static_cast<double>(kRepeats)},
+        {"recompute_ms", recompute * 1e3},
+        {"apply_ms", applied * 1e3},
+        {"cache_hits", static_cast<double>(hits)},
+        {"invalidated", invalidated ? 1.0 : 0.0},
+        {"batches", static_cast<double>(batches)},
+        {"apply_ok", applyOk ? 1.0 : 0.0},
+    });
+}
+
+// More distinct operand pairs than the cache holds: the most recently used
+// results stay cached, and only operands of cached results are tracked
+LIENZO_BENCHMARK(boolean_engine_cache) {
+    CRDTDocument doc("alice");
+    std::vector<CRDTId> shapes;
+    for (size_t i = 0; i < 64; i++) {
+        std::string d;
+        appendPathData(d, wavyCircle(static_cast<double>(i) * 10.0, 0.0, 20.0, 16, 3.0), 4);
+        CRDTId id = doc.createNode("shape");
+        doc.setNodeProperty(id, "kind", "path");
+        doc.setNodeProperty(id, "d", d);
+        doc.addChild(doc.getRootId(), id);
+        shapes.push_back(id);
+    }
+    const size_t kPairs = BooleanEngine::kMaxCacheEntries + 64;
+    auto pair = [&](size_t i) { return std::make_pair(shapes[i % 64], shapes[(i / 64 + i + 1) % 64]); };
+
+    BooleanEngine engine(doc);
+    double seconds = ctx.time([&] {
+        for (size_t i = 0; i < kPairs; i++) {
+            engine.compute(BooleanOp::Union, pair(i).first, pair(i).second);
+        }
+    });
+    size_t misses = engine.getMisses();
+    for (size_t i = kPairs - BooleanEngine::kMaxCacheEntries; i < kPairs; i++) {
+        engine.compute(BooleanOp::Union, pair(i).first, pair(i).second);
+    }
+    bool recentHit = engine.getMisses() == misses;
+    engine.compute(BooleanOp::Union, pair(0).first, pair(0).second);
+    bool oldestEvicted = engine.getMisses() == misses + 1;
+
+    ctx.report("boolean_engine_cache", kPairs, seconds, Counters{
+        {"recent_hit", recentHit ? 1.0 : 0.0},
+        {"oldest_evicted", oldestEvicted ? 1.0 : 0.0},
+    });
+}
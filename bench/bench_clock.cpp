@@ -0,0 +1,121 @@
+#include "bench.h"
+#include "crdt.h"
+#include "sync_simulator.h"
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kEditors = 4;
+const size_t kHistory = 10000;      // Edits the first editor made before the session
+const size_t kFrames = 600;         // Ten seconds at 60 fps
+const size_t kTurnFrames = 60;      // Editors take turns dragging for a second each
+const size_t kLatencyFrames = 3;
+
+struct Message {
+    size_t deliverAt;
+    size_t from;
+    CRDTOperation op;
+};
+
+struct DragStats {
+    size_t writes = 0;
+    size_t lostWrites = 0;      // Local writes beaten by a value the writer had already seen
+    bool converged = false;
+};
+
+// Every editor drags the same shape in turn (with overlap at the handoffs)
+// over a link with a few frames of latency. With siteClocks, writes are
+// stamped from a per-site counter, the way merge advanced the clock before
+// Lamport clocks: editors whose counter trails the first editor's history
+// lose every write and keep redrawing, re-sending and losing again.
+DragStats runDrag(bool siteClocks) {
+    std::vector<std::unique_ptr<CRDTDocument>> docs;
+    for (size_t i = 0; i < kEditors; i++) {
+        docs.push_back(std::make_unique<CRDTDocument>("editor" + std::to_string(i)));
+    }
+    CRDTDocument& first = *docs[0];
+    CRDTId shape = first.createNode("rectangle");
+    first.addChild(first.getRootId(), shape);
+    CRDTId scratch = first.createNode("rectangle");
+    for (size_t i = 0; i < kHistory; i++) {
+        first.setNodeProperty(scratch, "x", std::to_string(i));
+    }
+    first.setNodeProperty(shape, "x", "0");
+    for (size_t i = 1; i < kEditors; i++) {
+        docs[i]->merge(first);
+    }
+
+    std::vector<uint64_t> counters(kEditors, 0);
+    counters[0] = first.getLogicalClock();
+    std::deque<Message> inFlight;
+    DragStats stats;
+    for (size_t frame = 0; frame < kFrames + kLatencyFrames; frame++) {
+        while (!inFlight.empty() && inFlight.front().deliverAt <= frame) {
+            const Message& message = inFlight.front();
+            for (size_t i = 0; i < kEditors; i++) {
+                if (i != message.from) {
+                    docs[i]->applyOperation(message.op);
+                }
+            }
+            inFlight.pop_front();
+        }
+        if (frame >= kFrames) {
+            continue;
+        }
+        size_t turn = frame / kTurnFrames;
+        for (size_t editor : {turn % kEditors, (turn + 1) % kEditors}) {
+            // The next editor grabs the shape for the last few frames of a turn
+            if (editor != turn % kEditors && frame % kTurnFrames < kTurnFrames - kLatencyFrames) {
+                continue;
+            }
+            CRDTDocument& doc = *docs[editor];
+            std::string value = std::to_string(frame * 10 + editor);
+            CRDTOperation op;
+            if (siteClocks) {
+                op = CRDTOperation::setProperty(shape, "x", value, CRDTId(doc.getSiteId(), ++counters[editor]));
+                doc.applyOperation(op);
+            } else {
+                size_t handle = doc.addOperationListener([&op](const CRDTOperation& local, bool) { op = local; });
+                doc.setNodeProperty(shape, "x", value);
+                doc.removeOperationListener(handle);
+            }
+            stats.writes++;
+            if (doc.getNodeProperty(shape, "x") != value) {
+                stats.lostWrites++;
+            }
+            inFlight.push_back(Message{frame + kLatencyFrames, editor, op});
+        }
+    }
+
+    std::string state = SyncSimulator::canonicalState(first);
+    stats.converged = true;
+    for (size_t i = 1; i < kEditors; i++) {
+        stats.converged &= SyncSimulator::canonicalState(*docs[i]) == state;
+    }
+    return stats;
+}
+
+void report(Bench::Context& ctx, const std::string& name, bool siteClocks) {
+    DragStats stats;
+    double seconds = ctx.time([&] { stats = runDrag(siteClocks); });
+    ctx.report(name, stats.writes, seconds, Counters{
+        {"lost_writes", static_cast<double>(stats.lostWrites)},
+        {"lost_pct", 100.0 * static_cast<double>(stats.lostWrites) / static_cast<double>(stats.writes)},
+        {"converged", stats.converged ? 1.0 : 0.0},
+    });
+}
+
+} // namespace
+
+// Concurrent dragging after one editor has a long history: per-site clocks
+// against the document's Lamport clock
+LIENZO_BENCHMARK(clock_drag) {
+    report(ctx, "clock_drag_site_clocks", true);
+    report(ctx, "clock_drag_lamport", false);
+}
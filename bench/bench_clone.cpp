@@ -0,0 +1,129 @@
+#include "bench.h"
+#include "crdt.h"
+#include "crdt_codec.h"
+#include "sync_simulator.h"
+#include <string>
+#include <vector>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kShapes = 5000;
+
+CRDTId populate(CRDTDocument& doc, size_t shapes) {
+    CRDTId frame = doc.createNode("frame");
+    doc.setNodeProperty(frame, "x", "0");
+    doc.setNodeProperty(frame, "y", "0");
+    doc.addChild(doc.getRootId(), frame);
+    for (size_t i = 0; i < shapes; i++) {
+        CRDTId id = doc.createNode("rectangle");
+        doc.setNodeProperty(id, "x", std::to_string(i % 100 * 12));
+        doc.setNodeProperty(id, "y", std::to_string(i / 100 * 12));
+        doc.setNodeProperty(id, "width", "10");
+        doc.setNodeProperty(id, "height", "10");
+        doc.setNodeProperty(id, "fill", "#3366FF");
+        doc.addChild(frame, id);
+    }
+    return frame;
+}
+
+// Duplicate the way callers had to before cloneSubtree: one createNode,
+// setNodeProperty and addChild per node and property
+CRDTId copyNodeByNode(CRDTDocument& doc, const CRDTId& sourceId, const CRDTId& parentId) {
+    auto source = doc.getNode(sourceId);
+    CRDTId copy = doc.createNode(source->getType());
+    for (const auto& prop : source->getProperties()) {
+        doc.setNodeProperty(copy, prop.first, prop.second.value);
+    }
+    for (const auto& child : source->getChildren()) {
+        copyNodeByNode(doc, child, copy);
+    }
+    doc.addChild(parentId, copy);
+    return copy;
+}
+
+struct Peer {
+    CRDTDocument sender{"alice"};
+    CRDTDocument receiver{"bob"};
+    CRDTId frame;
+    ByteWriter wire;
+    size_t sent = 0;
+
+    explicit Peer(size_t shapes) {
+        frame = populate(sender, shapes);
+        receiver.merge(sender);
+        sender.addOperationListener([this](const CRDTOperation& op, bool local) {
+            if (local && !sender.isExpandingClone()) {
+                CRDTCodec::encodeOperation(wire, op);
+                sent++;
+            }
+        });
+    }
+
+    // Apply everything sent so far; returns the operations the receiver rejected
+    std::vector<CRDTOperation> deliver() {
+        std::vector<CRDTOperation> rejected;
+        ByteReader reader(wire.data().data(), wire.size());
+        CRDTOperation op;
+        while (reader.remaining() > 0 && CRDTCodec::decodeOperation(reader, op)) {
+            if (!receiver.applyOperation(op)) {
+                rejected.push_back(op);
+            }
+        }
+        return rejected;
+    }
+};
+
+void report(Bench::Context& ctx, const std::string& name, Peer& peer, double local, double remote,
+            size_t extraBytes = 0) {
+    bool converged = SyncSimulator::canonicalState(peer.sender) == SyncSimulator::canonicalState(peer.receiver);
+    ctx.report(name, peer.sent, local + remote, Counters{
+        {"local_ms", local * 1e3},
+        {"remote_ms", remote * 1e3},
+        {"wire_bytes", static_cast<double>(peer.wire.size() + extraBytes)},
+        {"converged", converged ? 1.0 : 0.0},
+    });
+}
+
+} // namespace
+
+// Duplicating a 5k-shape frame and replaying it on a peer: individual
+// operations against one CloneSubtree that the peer expands itself
+LIENZO_BENCHMARK(clone_frame) {
+    size_t shapes = ctx.size(kShapes);
+    {
+        Peer peer(shapes);
+        double local = ctx.time([&] { copyNodeByNode(peer.sender, peer.frame, peer.sender.getRootId()); });
+        double remote = ctx.time([&] { peer.deliver(); });
+        report(ctx, "clone_frame_node_by_node", peer, local, remote);
+    }
+    {
+        Peer peer(shapes);
+        double local = ctx.time([&] { peer.sender.cloneSubtree(peer.frame, peer.sender.getRootId()); });
+        double remote = ctx.time([&] { peer.deliver(); });
+        report(ctx, "clone_frame_subtree", peer, local, remote);
+    }
+}
+
+// The receiver moved a shape of the source concurrently, so its digest
+// differs: it rejects the clone and the sender falls back to expandClone
+LIENZO_BENCHMARK(clone_fallback) {
+    size_t shapes = ctx.size(kShapes);
+    Peer peer(shapes);
+    peer.receiver.setNodeProperty(peer.receiver.getChildren(peer.frame)[0], "x", "-50");
+    double local = ctx.time([&] { peer.sender.cloneSubtree(peer.frame, peer.sender.getRootId()); });
+    ByteWriter fallback;
+    double remote = ctx.time([&] {
+        for (const auto& rejected : peer.deliver()) {
+            for (const auto& op : peer.sender.expandClone(rejected)) {
+                CRDTCodec::encodeOperation(fallback, op);
+                peer.receiver.applyOperation(op);
+            }
+        }
+    });
+    // Bring the sender the receiver's concurrent edit too
+    peer.sender.merge(peer.receiver);
+    report(ctx, "clone_fallback", peer, local, remote, fallback.size());
+}
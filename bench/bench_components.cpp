@@ -0,0 +1,170 @@
+#include "bench.h"
+#include "components.h"
+#include "dom_graph.h"
+#include "hit_test.h"
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kCopies = 10000;
+const size_t kColumns = 100;
+const double kSpacing = 60.0;
+const size_t kPicks = 10000;
+
+void setProperties(CRDTDocument& doc, const CRDTId& id,
+                   std::initializer_list<std::pair<const char*, const char*>> properties) {
+    for (const auto& property : properties) {
+        doc.setNodeProperty(id, property.first, property.second);
+    }
+}
+
+CRDTId addPart(CRDTDocument& doc, const CRDTId& parent, const std::string& type,
+               std::initializer_list<std::pair<const char*, const char*>> properties) {
+    CRDTId id = doc.createNode(type);
+    setProperties(doc, id, properties);
+    doc.addChild(parent, id);
+    return id;
+}
+
+// A 50x50 badge: background, ellipse, star, curved blob, stroked line and
+// a small outlined box
+struct Badge {
+    CRDTId component;
+    std::vector<CRDTId> parts;
+};
+
+Badge makeBadge(CRDTDocument& doc, const CRDTId& parent) {
+    Badge badge;
+    badge.component = createComponent(doc, parent, 0, 0, 50, 50);
+    const CRDTId& c = badge.component;
+    badge.parts.push_back(addPart(doc, c, "rectangle", {{"x", "0"}, {"y", "0"}, {"width", "50"},
+                                                        {"height", "50"}, {"rx", "6"}, {"fill", "#F1FAEE"}}));
+    badge.parts.push_back(addPart(doc, c, "shape", {{"kind", "ellipse"}, {"x", "4"}, {"y", "4"},
+                                                    {"width", "16"}, {"height", "16"}, {"fill", "#E63946"}}));
+    badge.parts.push_back(addPart(doc, c, "shape", {{"d", "M35,5 L38,13 L46,13 L40,18 L42,26 L35,21 "
+                                                          "L28,26 L30,18 L24,13 L32,13 Z"},
+                                                    {"fill", "#FFD166"}}));
+    badge.parts.push_back(addPart(doc, c, "shape", {{"d", "M5,30 C20,26 20,42 5,46 S-2,36 5,30 Z"},
+                                                    {"fill", "#06D6A0"}, {"fill-rule", "evenodd"}}));
+    badge.parts.push_back(addPart(doc, c, "shape", {{"d", "M24,30 L44,46"}, {"fill", "none"},
+                                                    {"stroke", "#1D3557"}, {"stroke-width", "2"}}));
+    badge.parts.push_back(addPart(doc, c, "rectangle", {{"x", "30"}, {"y", "40"}, {"width", "12"},
+                                                        {"height", "6"}, {"fill", "none"}, {"stroke", "#457B9D"}}));
+    return badge;
+}
+
+Point placement(size_t i) {
+    return Point(100.0 + static_cast<double>(i % kColumns) * kSpacing,
+                 100.0 + static_cast<double>(i / kColumns) * kSpacing);
+}
+
+enum class Copies { Instances, OverriddenInstances, Clones };
+
+void run(Bench::Context& ctx, const std::string& name, Copies mode) {
+    size_t copies = ctx.size(kCopies);
+    CRDTDocument doc("alice");
+    CRDTId frame = doc.createNode("frame");
+    setProperties(doc, frame, {{"x", "0"}, {"y", "0"}, {"width", "7000"}, {"height", "7000"}});
+    doc.addChild(doc.getRootId(), frame);
+    Badge badge = makeBadge(doc, frame);
+    size_t baseBytes = doc.getMemoryUsage().bytesInUse;
+
+    std::vector<CRDTId> ids;
+    double build = ctx.time([&] {
+        for (size_t i = 0; i < copies; i++) {
+            Point at = placement(i);
+            if (mode == Copies::Clones) {
+                CRDTId copy = doc.cloneSubtree(badge.component, frame);
+                doc.setNodeProperty(copy, "x", std::to_string(static_cast<int>(at.x)));
+                doc.setNodeProperty(copy, "y", std::to_string(static_cast<int>(at.y)));
+                ids.push_back(copy);
+                continue;
+            }
+            CRDTId instance = createInstance(doc, badge.component, frame, at.x, at.y);
+            if (mode == Copies::OverriddenInstances && i % 10 == 0) {
+                setInstanceOverride(doc, instance, badge.parts[1], "fill", "#118AB2");
+            }
+            ids.push_back(instance);
+        }
+    });
+    size_t copyBytes = doc.getMemoryUsage().bytesInUse - baseBytes;
+
+    DOMGraph graph(doc);
+    HitTester tester(graph);
+    std::mt19937 random(7);
+    std::uniform_real_distribution<double> coordinate(100.0, 100.0 + kColumns * kSpacing);
+    std::vector<Point> points;
+    for (size_t i = 0; i < kPicks; i++) {
+        points.emplace_back(coordinate(random), coordinate(random) * static_cast<double>(copies) /
+                                                    static_cast<double>(kCopies));
+    }
+    HitTester::Hit hit;
+    double cold = ctx.time([&] {
+        for (const auto& point : points) {
+            tester.hitTest(point.x, point.y, hit, 1.0);
+        }
+    });
+    double seconds = ctx.time([&] {
+        for (const auto& point : points) {
+            tester.hitTest(point.x, point.y, hit, 1.0);
+        }
+    });
+
+    ctx.report(name, copies, seconds, Counters{
+        {"build_ms", build * 1e3},
+        {"bytes_per_copy", static_cast<double>(copyBytes) / static_cast<double>(copies)},
+        {"doc_kb", static_cast<double>(doc.getMemoryUsage().bytesInUse) / 1024.0},
+        {"geometries", static_cast<double>(tester.getGeometryCache().size())},
+        {"geometry_kb", static_cast<double>(tester.getGeometryCache().getMemoryUsage()) / 1024.0},
+        {"geometry_builds", static_cast<double>(tester.getGeometryBuilds())},
+        {"cold_us_per_pick", cold * 1e6 / static_cast<double>(kPicks)},
+        {"us_per_pick", seconds * 1e6 / static_cast<double>(kPicks)},
+    });
+}
+
+} // namespace
+
+// 10k copies of a six-shape component: instances (plain, and with 10% of
+// them overriding a fill) against full subtree clones
+LIENZO_BENCHMARK(components) {
+    run(ctx, "components_instances", Copies::Instances);
+    run(ctx, "components_instances_overridden", Copies::OverriddenInstances);
+    run(ctx, "components_clones", Copies::Clones);
+}
+
+// Picks on an instance report the instance and the component part, follow
+// overrides and follow edits to the component
+LIENZO_BENCHMARK(components_pick) {
+    CRDTDocument doc("alice");
+    CRDTId frame = doc.createNode("frame");
+    setProperties(doc, frame, {{"x", "0"}, {"y", "0"}, {"width", "1000"}, {"height", "1000"}});
+    doc.addChild(doc.getRootId(), frame);
+    Badge badge = makeBadge(doc, frame);
+    CRDTId plain = createInstance(doc, badge.component, frame, 100, 100);
+    CRDTId hollow = createInstance(doc, badge.component, frame, 200, 100, 2.0);
+    setInstanceOverride(doc, hollow, badge.parts[0], "fill", "none");
+
+    DOMGraph graph(doc);
+    HitTester tester(graph);
+    HitTester::Hit hit;
+    bool ok = true;
+    // Background corner of the plain instance
+    ok &= tester.hitTest(146, 103, hit) && hit.id == plain && hit.part == badge.parts[0];
+    // Star, scaled 2x in the second instance
+    ok &= tester.hitTest(270, 130, hit) && hit.id == hollow && hit.part == badge.parts[2];
+    // Its background is not filled: the pick falls through to the frame
+    ok &= tester.hitTest(296, 104, hit) && hit.id == frame;
+    // The stroked line, on its stroke
+    ok &= tester.hitTest(134, 138, hit, 0.5) && hit.id == plain && hit.part == badge.parts[4] && hit.onStroke;
+    // Editing the component moves every instance's part
+    doc.setNodeProperty(badge.parts[1], "x", "30");
+    ok &= tester.hitTest(142, 112, hit) && hit.id == plain && hit.part == badge.parts[1];
+    ok &= tester.hitTest(284, 124, hit) && hit.id == hollow && hit.part == badge.parts[1];
+
+    ctx.report("components_pick", 1, 0.0, Counters{{"ok", ok ? 1.0 : 0.0}});
+}
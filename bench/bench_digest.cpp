@@ -0,0 +1,143 @@
+#include "bench.h"
+#include "crdt.h"
+#include "document_digest.h"
+#include "sync_simulator.h"
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kNodes = 100000;
+const size_t kShapesPerFrame = 50;
+
+std::vector<CRDTId> populate(CRDTDocument& doc, size_t nodeCount) {
+    std::vector<CRDTId> shapes;
+    CRDTId frame;
+    for (size_t i = 0; i < nodeCount; i++) {
+        bool isFrame = i % (kShapesPerFrame + 1) == 0;
+        CRDTId id = doc.createNode(isFrame ? "frame" : "rectangle");
+        doc.setNodeProperty(id, "x", std::to_string(i % 1000));
+        doc.setNodeProperty(id, "y", std::to_string(i / 1000));
+        doc.setNodeProperty(id, "width", "100");
+        doc.setNodeProperty(id, "height", "50");
+        if (isFrame) {
+            doc.addChild(doc.getRootId(), id);
+            frame = id;
+        } else {
+            doc.addChild(frame, id);
+            shapes.push_back(id);
+        }
+    }
+    return shapes;
+}
+
+// Offline edits: moves, new rectangles, deletions
+void diverge(CRDTDocument& doc, const std::vector<CRDTId>& shapes, size_t edits, uint32_t seed) {
+    std::mt19937 random(seed);
+    for (size_t i = 0; i < edits; i++) {
+        const CRDTId& shape = shapes[random() % shapes.size()];
+        switch (i % 4) {
+            case 0: {
+                CRDTId frame = doc.getChildren(doc.getRootId())[random() % 10];
+                CRDTId id = doc.createNode("rectangle");
+                doc.setNodeProperty(id, "x", "5");
+                doc.addChild(frame, id);
+                break;
+            }
+            case 1:
+                doc.deleteNode(shape);
+                break;
+            default:
+                doc.setNodeProperty(shape, "x", std::to_string(random() % 1000));
+                break;
+        }
+    }
+}
+
+} // namespace
+
+// Two replicas of a document reconnect after k offline edits each and
+// reconcile through digests instead of exchanging full snapshots
+LIENZO_BENCHMARK(digest_reconcile) {
+    size_t nodes = ctx.size(kNodes);
+    for (size_t edits : {10, 1000}) {
+        CRDTDocument alice("alice");
+        std::vector<CRDTId> shapes = populate(alice, nodes);
+        CRDTDocument bob("bob");
+        bob.merge(alice);
+        DocumentDigest aliceDigest(alice);
+        std::unique_ptr<DocumentDigest> bobDigest;
+        double build = ctx.time([&] { bobDigest = std::make_unique<DocumentDigest>(bob); });
+        bool equalBefore = aliceDigest.getRootDigest() == bobDigest->getRootDigest();
+
+        diverge(alice, shapes, edits, 1);
+        diverge(bob, shapes, edits, 2);
+
+        size_t digestBytes = 0, nodeBytes = 0, divergent = 0, roundTrips = 0;
+        double seconds = ctx.time([&] {
+            DigestReconciler reconciler(aliceDigest);
+            std::string request = reconciler.start();
+            while (!request.empty()) {
+                std::string reply = bobDigest->answer(request);
+                digestBytes += request.size() + reply.size();
+                request = reconciler.receive(reply);
+            }
+            std::vector<CRDTId> ids = reconciler.getDivergentNodes();
+            divergent = ids.size();
+            roundTrips = reconciler.getRoundTrips() + 1;
+            std::string toBob = aliceDigest.encodeNodes(ids);
+            std::string toAlice = bobDigest->encodeNodes(ids);
+            nodeBytes = toBob.size() + toAlice.size();
+            bobDigest->mergeNodes(toBob);
+            aliceDigest.mergeNodes(toAlice);
+        });
+        bool digestsMatch = aliceDigest.getRootDigest() == bobDigest->getRootDigest();
+        bool converged = SyncSimulator::canonicalState(alice) == SyncSimulator::canonicalState(bob);
+        size_t snapshotBytes = alice.serialize().size() + bob.serialize().size();
+
+        ctx.report("digest_reconcile_" + std::to_string(edits), divergent, seconds, Counters{
+            {"round_trips", static_cast<double>(roundTrips)},
+            {"digest_bytes", static_cast<double>(digestBytes)},
+            {"node_bytes", static_cast<double>(nodeBytes)},
+            {"snapshot_bytes", static_cast<double>(snapshotBytes)},
+            {"digest_build_ms", build * 1e3},
+            {"equal_before", equalBefore ? 1.0 : 0.0},
+            {"digests_match", digestsMatch ? 1.0 : 0.0},
+            {"converged", converged ? 1.0 : 0.0},
+        });
+    }
+}
+
+// Keeping the digest current during editing: operations only mark nodes
+// dirty, and the root digest is recomputed once per frame
+LIENZO_BENCHMARK(digest_update) {
+    size_t nodes = ctx.size(kNodes);
+    CRDTDocument doc("alice");
+    std::vector<CRDTId> shapes = populate(doc, nodes);
+    DocumentDigest digest(doc);
+    digest.getRootDigest();
+    size_t hashesBefore = digest.getNodeHashes();
+
+    const size_t kFrames = 100, kEditsPerFrame = 20;
+    std::mt19937 random(3);
+    uint64_t root = 0;
+    double seconds = ctx.time([&] {
+        for (size_t f = 0; f < kFrames; f++) {
+            for (size_t i = 0; i < kEditsPerFrame; i++) {
+                doc.setNodeProperty(shapes[random() % shapes.size()], "x", std::to_string(i));
+            }
+            root ^= digest.getRootDigest();
+        }
+    });
+    ctx.report("digest_update", kFrames * kEditsPerFrame, seconds, Counters{
+        {"us_per_frame", seconds * 1e6 / static_cast<double>(kFrames)},
+        {"node_hashes_per_frame", static_cast<double>(digest.getNodeHashes() - hashesBefore) /
+                                  static_cast<double>(kFrames)},
+        {"checksum", root != 0 ? 1.0 : 0.0},
+    });
+}
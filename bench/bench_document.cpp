@@ -0,0 +1,169 @@
+#include "bench.h"
+#include "crdt.h"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kDocumentNodes = 500000;
+const size_t kShapesPerFrame = 50;
+
+// Frames under the root, each holding kShapesPerFrame rectangles
+void populate(CRDTDocument& doc, size_t nodeCount) {
+    doc.reserve(nodeCount + 1);
+    CRDTId frameId;
+    for (size_t i = 0; i < nodeCount; i++) {
+        bool isFrame = i % (kShapesPerFrame + 1) == 0;
+        CRDTId id = doc.createNode(isFrame ? "frame" : "rectangle");
+        doc.setNodeProperty(id, "x", std::to_string(i % 1000));
+        doc.setNodeProperty(id, "y", std::to_string(i / 1000));
+        doc.setNodeProperty(id, "width", "100.000000");
+        doc.setNodeProperty(id, "height", "50.000000");
+        if (isFrame) {
+            doc.addChild(doc.getRootId(), id);
+            frameId = id;
+        } else {
+            doc.addChild(frameId, id);
+        }
+    }
+}
+
+Counters memoryCounters(const CRDTDocument& doc) {
+    DocumentMemoryUsage usage = doc.getMemoryUsage();
+    return {
+        {"nodes", static_cast<double>(usage.nodeCount)},
+        {"bytes_in_use", static_cast<double>(usage.bytesInUse)},
+        {"bytes_reserved", static_cast<double>(usage.bytesReserved)},
+        {"bytes_per_node", static_cast<double>(usage.bytesReserved) /
+                           static_cast<double>(usage.nodeCount)},
+    };
+}
+
+} // namespace
+
+LIENZO_BENCHMARK(document_load) {
+    size_t count = ctx.size(kDocumentNodes);
+    CRDTDocument doc("bench");
+    double seconds = ctx.time([&] { populate(doc, count); });
+    ctx.report("document_load", count, seconds, memoryCounters(doc));
+}
+
+LIENZO_BENCHMARK(document_merge) {
+    size_t count = ctx.size(kDocumentNodes);
+    CRDTDocument source("remote");
+    populate(source, count);
+    
+    // Every node is new to the target: deep copy into the target's arena
+    CRDTDocument target("local");
+    double seconds = ctx.time([&] { target.merge(source); });
+    ctx.report("document_merge_new", count, seconds, memoryCounters(target));
+    
+    // Every node already exists: pure LWW merge
+    seconds = ctx.time([&] { target.merge(source); });
+    ctx.report("document_merge_existing", count, seconds, memoryCounters(target));
+}
+
+// Core operations one at a time, as edits and bindings issue them
+
+LIENZO_BENCHMARK(document_create_node) {
+    size_t count = ctx.size(kDocumentNodes);
+    CRDTDocument doc("bench");
+    double seconds = ctx.time([&] {
+        for (size_t i = 0; i < count; i++) {
+            doc.createNode("rectangle");
+        }
+    });
+    ctx.report("document_create_node", count, seconds, Counters{
+        {"ns_per_op", seconds * 1e9 / static_cast<double>(count)},
+    });
+}
+
+LIENZO_BENCHMARK(document_set_property) {
+    size_t count = ctx.size(kDocumentNodes);
+    CRDTDocument doc("bench");
+    std::vector<CRDTId> ids;
+    ids.reserve(count / 10);
+    for (size_t i = 0; i < count / 10; i++) {
+        ids.push_back(doc.createNode("rectangle"));
+    }
+    // Ten writes per node: the first adds the key, the rest overwrite it
+    double seconds = ctx.time([&] {
+        for (size_t i = 0; i < count; i++) {
+            doc.setNodeProperty(ids[i % ids.size()], "x", "123.500000");
+        }
+    });
+    ctx.report("document_set_property", count, seconds, Counters{
+        {"ns_per_op", seconds * 1e9 / static_cast<double>(count)},
+    });
+}
+
+LIENZO_BENCHMARK(document_get_node) {
+    size_t count = ctx.size(kDocumentNodes);
+    CRDTDocument doc("bench");
+    populate(doc, count);
+    std::vector<CRDTId> ids = doc.getAllNodeIds();
+    std::mt19937 random(1);
+    std::shuffle(ids.begin(), ids.end(), random);
+    size_t found = 0;
+    double seconds = ctx.time([&] {
+        for (const auto& id : ids) {
+            found += doc.getNode(id) ? 1 : 0;
+        }
+    });
+    ctx.report("document_get_node", ids.size(), seconds, Counters{
+        {"ns_per_op", seconds * 1e9 / static_cast<double>(ids.size())},
+        {"found", static_cast<double>(found)},
+    });
+}
+
+LIENZO_BENCHMARK(document_child_add_remove) {
+    size_t count = ctx.size(kDocumentNodes / 50);
+    CRDTDocument doc("bench");
+    CRDTId frame = doc.createNode("frame");
+    doc.addChild(doc.getRootId(), frame);
+    std::vector<CRDTId> ids;
+    ids.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        ids.push_back(doc.createNode("rectangle"));
+    }
+    // Child lists are scanned linearly and keep tombstones, so both grow with the list
+    double added = ctx.time([&] {
+        for (const auto& id : ids) {
+            doc.addChild(frame, id);
+        }
+    });
+    double removed = ctx.time([&] {
+        for (const auto& id : ids) {
+            doc.removeChild(frame, id);
+        }
+    });
+    ctx.report("document_child_add_remove", 2 * count, added + removed, Counters{
+        {"add_ns_per_op", added * 1e9 / static_cast<double>(count)},
+        {"remove_ns_per_op", removed * 1e9 / static_cast<double>(count)},
+        {"children_left", static_cast<double>(doc.getChildren(frame).size())},
+    });
+}
+
+// Merge cost at several document sizes, to see how it scales
+LIENZO_BENCHMARK(document_merge_sizes) {
+    for (size_t base : {1000, 10000, 100000}) {
+        size_t count = ctx.size(base);
+        CRDTDocument source("remote");
+        populate(source, count);
+        CRDTDocument target("local");
+        double fresh = ctx.time([&] { target.merge(source); });
+        double existing = ctx.time([&] { target.merge(source); });
+        std::string suffix = "_" + std::to_string(base);
+        ctx.report("document_merge_new" + suffix, count, fresh, Counters{
+            {"ns_per_node", fresh * 1e9 / static_cast<double>(count)},
+        });
+        ctx.report("document_merge_existing" + suffix, count, existing, Counters{
+            {"ns_per_node", existing * 1e9 / static_cast<double>(count)},
+        });
+    }
+}
@@ -0,0 +1,127 @@
+#include "bench.h"
+#include "crdt.h"
+#include "dom_graph.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kFrames = 500;
+const size_t kGroupsPerFrame = 4;
+const size_t kShapesPerGroup = 50;
+const size_t kWalks = 20;
+const size_t kEdits = 2000;
+
+// Frames under the root, each holding groups of rectangles
+std::vector<CRDTId> populate(CRDTDocument& doc, size_t frames) {
+    std::vector<CRDTId> groups;
+    for (size_t f = 0; f < frames; f++) {
+        CRDTId frameId = doc.createNode("frame");
+        doc.addChild(doc.getRootId(), frameId);
+        for (size_t g = 0; g < kGroupsPerFrame; g++) {
+            CRDTId groupId = doc.createNode("group");
+            doc.addChild(frameId, groupId);
+            groups.push_back(groupId);
+            for (size_t s = 0; s < kShapesPerGroup; s++) {
+                CRDTId shapeId = doc.createNode("rectangle");
+                doc.setNodeProperty(shapeId, "x", std::to_string(s * 10));
+                doc.addChild(groupId, shapeId);
+            }
+        }
+    }
+    return groups;
+}
+
+} // namespace
+
+// Visiting every node: linear scan of the flattened view versus looking
+// children up by ID through the document
+LIENZO_BENCHMARK(dom_graph_walk) {
+    CRDTDocument doc("alice");
+    populate(doc, ctx.size(kFrames));
+
+    DOMGraph* graph = nullptr;
+    double build = ctx.time([&] { graph = new DOMGraph(doc); });
+
+    size_t flatSum = 0;
+    double flat = ctx.time([&] {
+        for (size_t walk = 0; walk < kWalks; walk++) {
+            for (const auto& node : graph->getNodes()) {
+                flatSum += node.node->getProperties().size() + node.depth;
+            }
+        }
+    });
+
+    size_t pointerSum = 0;
+    std::function<void(const CRDTId&, size_t)> visit = [&](const CRDTId& id, size_t depth) {
+        auto node = doc.getNode(id);
+        pointerSum += node->getProperties().size() + depth;
+        for (const auto& child : node->getChildren()) {
+            visit(child, depth + 1);
+        }
+    };
+    double pointer = ctx.time([&] {
+        for (size_t walk = 0; walk < kWalks; walk++) {
+            visit(doc.getRootId(), 0);
+        }
+    });
+
+    double visits = static_cast<double>(graph->size() * kWalks);
+    ctx.report("dom_graph_walk", graph->size() * kWalks, flat, Counters{
+        {"nodes", static_cast<double>(graph->size())},
+        {"build_ms", build * 1000.0},
+        {"flat_ns_per_node", flat * 1e9 / visits},
+        {"pointer_ns_per_node", pointer * 1e9 / visits},
+        {"same_result", flatSum == pointerSum ? 1.0 : 0.0},
+    });
+    delete graph;
+}
+
+// Structural edits patched into the view as they happen
+LIENZO_BENCHMARK(dom_graph_patch) {
+    CRDTDocument doc("alice");
+    std::vector<CRDTId> groups = populate(doc, ctx.size(kFrames));
+    DOMGraph graph(doc);
+    size_t edits = ctx.size(kEdits);
+
+    double seconds = ctx.time([&] {
+        for (size_t i = 0; i < edits; i++) {
+            const CRDTId& group = groups[(i * 7919) % groups.size()];
+            if (i % 2 == 0) {
+                CRDTId shapeId = doc.createNode("rectangle");
+                doc.addChild(group, shapeId);
+            } else {
+                auto children = doc.getChildren(group);
+                doc.removeChild(group, children[i % children.size()]);
+            }
+        }
+    });
+
+    DOMGraph fresh(doc);
+    bool consistent = fresh.size() == graph.size();
+    for (uint32_t i = 0; consistent && i < graph.size(); i++) {
+        consistent = graph.getId(i) == fresh.getId(i) &&
+                     graph[i].subtreeSize == fresh[i].subtreeSize;
+    }
+    size_t nodes = graph.size();
+    size_t rebuilds = graph.getRebuildCount() - 1;
+
+    // A shown group replaced by createNodeWithId: the view drops the old node
+    doc.createNodeWithId(groups.front(), "group");
+    uint32_t replaced = graph.indexOf(groups.front());
+    bool replaceOk = replaced != DOMGraph::kNone &&
+                     graph[replaced].node == doc.getNode(groups.front()).get() &&
+                     graph[replaced].subtreeSize == 1;
+
+    ctx.report("dom_graph_patch", edits, seconds, Counters{
+        {"nodes", static_cast<double>(nodes)},
+        {"us_per_edit", seconds * 1e6 / static_cast<double>(edits)},
+        {"rebuilds", static_cast<double>(rebuilds)},
+        {"consistent", consistent ? 1.0 : 0.0},
+        {"replace_ok", replaceOk ? 1.0 : 0.0},
+    });
+}
@@ -0,0 +1,192 @@
+#include "bench.h"
+#include "dom_graph.h"
+#include "hit_test.h"
+#include "vector_crdt.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kShapes = 20000;
+const double kSceneSize = 10000.0;
+
+// Dense scene: overlapping rectangles, ellipses, concave stars, curved
+// blobs and thin diagonal strokes, so bounding boxes are a poor guide
+std::string makeScene(size_t shapes) {
+    std::mt19937 random(3);
+    std::uniform_real_distribution<double> position(0.0, kSceneSize - 200.0);
+    std::uniform_real_distribution<double> size(20.0, 200.0);
+    std::string svg = "<svg>";
+    for (size_t i = 0; i < shapes; i++) {
+        double x = position(random), y = position(random), s = size(random);
+        std::string sx = std::to_string(x), sy = std::to_string(y), ss = std::to_string(s);
+        switch (i % 5) {
+            case 0:
+                svg += "<rect x=\"" + sx + "\" y=\"" + sy + "\" width=\"" + ss + "\" height=\"" +
+                       std::to_string(s / 2) + "\" rx=\"6\"/>";
+                break;
+            case 1:
+                svg += "<ellipse cx=\"" + sx + "\" cy=\"" + sy + "\" rx=\"" + ss + "\" ry=\"" +
+                       std::to_string(s / 3) + "\"/>";
+                break;
+            case 2: {
+                // Ten-point star: most of its bounding box is empty
+                std::string d = "M";
+                for (int k = 0; k < 10; k++) {
+                    double angle = k * 3.14159265358979 / 5.0;
+                    double radius = k % 2 ? s / 5 : s / 2;
+                    d += std::to_string(x + s / 2 + radius * std::sin(angle)) + "," +
+                         std::to_string(y + s / 2 - radius * std::cos(angle)) + (k < 9 ? " L" : "");
+                }
+                svg += "<path d=\"" + d + "Z\" fill=\"#FFD166\"/>";
+                break;
+            }
+            case 3:
+                svg += "<path d=\"M" + sx + "," + sy + " c" + ss + ",-40 " + ss + ",80 0," + ss +
+                       " s-60,-60 0,-" + ss + "z\" fill=\"#06D6A0\" fill-rule=\"evenodd\"/>";
+                break;
+            default:
+                svg += "<line x1=\"" + sx + "\" y1=\"" + sy + "\" x2=\"" + std::to_string(x + s) +
+                       "\" y2=\"" + std::to_string(y + s) + "\" stroke=\"#000\" stroke-width=\"2\"/>";
+                break;
+        }
+    }
+    svg += "</svg>";
+    return svg;
+}
+
+} // namespace
+
+// Point picks on a dense scene: a bounding-box pass over the DOMGraph,
+// then exact fill/stroke tests on the candidates only
+LIENZO_BENCHMARK(hit_test_pick) {
+    size_t shapes = ctx.size(kShapes);
+    VectorCRDTManager manager("alice");
+    CRDTId frame = manager.createFrame(0, 0, kSceneSize, kSceneSize);
+    manager.importSvg(frame, makeScene(shapes));
+    CRDTDocument& doc = manager.getDocument();
+    DOMGraph graph(doc);
+    HitTester tester(graph);
+
+    const size_t kPicks = 10000;
+    std::mt19937 random(5);
+    std::uniform_real_distribution<double> coordinate(0.0, kSceneSize);
+    std::vector<Point> points;
+    for (size_t i = 0; i < kPicks; i++) {
+        points.emplace_back(coordinate(random), coordinate(random));
+    }
+
+    HitTester::Hit hit;
+    double firstPick = ctx.time([&] { tester.hitTest(points[0].x, points[0].y, hit, 2.0); });
+    // Cold: every candidate's geometry is built on first use
+    double cold = ctx.time([&] {
+        for (const auto& point : points) {
+            tester.hitTest(point.x, point.y, hit, 2.0);
+        }
+    });
+    size_t builds = tester.getGeometryBuilds();
+
+    size_t candidates = tester.getCandidatesTested();
+    size_t shapeHits = 0, boxOnlyWrong = 0;
+    double worst = 0.0;
+    double seconds = ctx.time([&] {
+        for (const auto& point : points) {
+            auto start = std::chrono::steady_clock::now();
+            bool found = tester.hitTest(point.x, point.y, hit, 2.0);
+            worst = std::max(worst, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            if (found && hit.id != frame) {
+                shapeHits++;
+            }
+        }
+    });
+    candidates = tester.getCandidatesTested() - candidates;
+
+    // How often the topmost bounding box is not the shape actually under the point
+    for (const auto& point : points) {
+        uint32_t topmostBox = DOMGraph::kNone;
+        for (uint32_t i = static_cast<uint32_t>(graph.size()); i-- > 1;) {
+            if (graph.getId(i) != frame && tester.getBounds(i).contains(point.x, point.y)) {
+                topmostBox = i;
+                break;
+            }
+        }
+        bool found = tester.hitTest(point.x, point.y, hit, 0.0);
+        uint32_t precise = found && hit.id != frame ? hit.index : DOMGraph::kNone;
+        if (topmostBox != precise) {
+            boxOnlyWrong++;
+        }
+    }
+
+    // A diagonal line is hit on the line, not in the empty corner of its box,
+    // and a star's notch falls through to what is behind it
+    CRDTDocument small("bob");
+    CRDTId smallFrame = small.createNode("frame");
+    small.addChild(small.getRootId(), smallFrame);
+    CRDTId back = small.createNode("rectangle");
+    for (auto property : {std::make_pair("x", "0"), std::make_pair("y", "0"),
+                          std::make_pair("width", "100"), std::make_pair("height", "100")}) {
+        small.setNodeProperty(back, property.first, property.second);
+    }
+    small.addChild(smallFrame, back);
+    CRDTId line = small.createNode("shape");
+    small.setNodeProperty(line, "d", "M0,0 L100,100");
+    small.setNodeProperty(line, "x", "0");
+    small.setNodeProperty(line, "y", "0");
+    small.setNodeProperty(line, "width", "100");
+    small.setNodeProperty(line, "height", "100");
+    small.setNodeProperty(line, "fill", "none");
+    small.setNodeProperty(line, "stroke", "#000");
+    small.addChild(smallFrame, line);
+    DOMGraph smallGraph(small);
+    HitTester smallTester(smallGraph);
+    HitTester::Hit onLine, offLine;
+    bool lineOk = smallTester.hitTest(50.3, 49.8, onLine) && onLine.id == line && onLine.onStroke &&
+                  smallTester.hitTest(90, 10, offLine) && offLine.id == back;
+
+    ctx.report("hit_test_pick", kPicks, seconds, Counters{
+        {"us_per_pick", seconds * 1e6 / static_cast<double>(kPicks)},
+        {"max_pick_us", worst * 1e6},
+        {"first_pick_us", firstPick * 1e6},
+        {"cold_us_per_pick", cold * 1e6 / static_cast<double>(kPicks)},
+        {"candidates_per_pick", static_cast<double>(candidates) / static_cast<double>(kPicks)},
+        {"geometry_builds", static_cast<double>(builds)},
+        {"shape_hit_pct", 100.0 * static_cast<double>(shapeHits) / static_cast<double>(kPicks)},
+        {"bbox_wrong_pct", 100.0 * static_cast<double>(boxOnlyWrong) / static_cast<double>(kPicks)},
+        {"line_ok", lineOk ? 1.0 : 0.0},
+    });
+}
+
+// Editing one shape only rebuilds that shape's geometry
+LIENZO_BENCHMARK(hit_test_after_edit) {
+    size_t shapes = ctx.size(kShapes);
+    VectorCRDTManager manager("alice");
+    CRDTId frame = manager.createFrame(0, 0, kSceneSize, kSceneSize);
+    std::vector<CRDTId> created = manager.importSvg(frame, makeScene(shapes));
+    CRDTDocument& doc = manager.getDocument();
+    DOMGraph graph(doc);
+    HitTester tester(graph);
+    HitTester::Hit hit;
+    tester.hitTest(kSceneSize / 2, kSceneSize / 2, hit);
+
+    const size_t kEdits = 200;
+    std::mt19937 random(9);
+    std::uniform_real_distribution<double> coordinate(0.0, kSceneSize);
+    size_t builds = tester.getGeometryBuilds();
+    double seconds = ctx.time([&] {
+        for (size_t i = 0; i < kEdits; i++) {
+            const CRDTId& id = created[i * 37 % created.size()];
+            doc.setNodeProperty(id, "stroke", i % 2 ? "#F00" : "none");
+            tester.hitTest(coordinate(random), coordinate(random), hit, 2.0);
+        }
+    });
+
+    ctx.report("hit_test_after_edit", kEdits, seconds, Counters{
+        {"us_per_edit_and_pick", seconds * 1e6 / static_cast<double>(kEdits)},
+        {"geometry_builds", static_cast<double>(tester.getGeometryBuilds() - builds)},
+    });
+}
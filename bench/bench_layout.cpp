@@ -0,0 +1,81 @@
+#include "bench.h"
+#include "crdt.h"
+#include "renderer.h"
+#include <string>
+#include <vector>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kTextNodes = 500;
+const size_t kParagraphs = 8;         // Per node
+const size_t kParagraphChars = 240;
+const size_t kFrames = 2000;
+const double kBoxWidth = 320.0;
+
+std::string paragraphText(size_t seed) {
+    static const char* words[] = {"canvas", "frame", "layer", "shape", "text", "vector",
+                                  "merge", "edit", "a", "of", "collaborative", "replica"};
+    std::string text;
+    while (text.size() < kParagraphChars) {
+        text += words[(seed = seed * 1103515245 + 12345) >> 16 & 7 ? (seed >> 8) % 12 : 0];
+        text += ' ';
+    }
+    return text;
+}
+
+} // namespace
+
+// Canvas with many multi-paragraph text boxes, one keystroke per frame into
+// one of them; every frame prepares all text nodes for drawing
+LIENZO_BENCHMARK(text_layout_frames) {
+    size_t nodeCount = ctx.size(kTextNodes);
+    size_t frames = ctx.size(kFrames);
+
+    CRDTDocument doc("alice");
+    std::vector<CRDTId> textIds;
+    for (size_t i = 0; i < nodeCount; i++) {
+        CRDTId id = doc.createNode("text");
+        std::string text;
+        for (size_t p = 0; p < kParagraphs; p++) {
+            text += paragraphText(i * kParagraphs + p);
+            text += p + 1 < kParagraphs ? "\n" : "";
+        }
+        doc.insertText(id, 0, text);
+        textIds.push_back(id);
+    }
+
+    Renderer renderer;
+    FontDescriptor font;
+    auto prepareAll = [&] {
+        size_t lines = 0;
+        for (const auto& id : textIds) {
+            lines += renderer.prepareText(*doc.getNode(id), kBoxWidth, font).lineCount;
+        }
+        return lines;
+    };
+
+    size_t lines = 0;
+    double cold = ctx.time([&] { lines = prepareAll(); });
+    size_t coldParagraphs = renderer.getTextLayout().getParagraphsLaidOut();
+
+    double warm = ctx.time([&] {
+        for (size_t frame = 0; frame < frames; frame++) {
+            const CRDTId& id = textIds[(frame * 7919) % textIds.size()];
+            doc.insertText(id, (frame * 31) % kParagraphChars, "x");
+            prepareAll();
+        }
+    });
+    size_t warmParagraphs = renderer.getTextLayout().getParagraphsLaidOut() - coldParagraphs;
+
+    ctx.report("text_layout_frames", frames, warm, Counters{
+        {"nodes", static_cast<double>(nodeCount)},
+        {"lines", static_cast<double>(lines)},
+        {"cold_us", cold * 1e6},
+        {"frame_us", warm * 1e6 / static_cast<double>(frames)},
+        {"paragraphs_per_frame", static_cast<double>(warmParagraphs) / static_cast<double>(frames)},
+        {"atlas_glyphs", static_cast<double>(renderer.getGlyphAtlas().getGlyphCount())},
+    });
+}
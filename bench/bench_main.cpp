@@ -0,0 +1,136 @@
+#include "bench.h"
+#include "profiler.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace Lienzo {
+namespace Bench {
+
+namespace {
+
+struct Entry {
+    const char* name;
+    BenchFunction function;
+};
+
+std::vector<Entry>& registry() {
+    static std::vector<Entry> entries;
+    return entries;
+}
+
+} // namespace
+
+bool registerBenchmark(const char* name, BenchFunction function) {
+    registry().push_back(Entry{name, std::move(function)});
+    return true;
+}
+
+void Context::report(const std::string& name, size_t ops, double seconds,
+                     const Counters& counters) {
+    double opsPerSecond = seconds > 0.0 ? static_cast<double>(ops) / seconds : 0.0;
+    std::printf("%-40s ops=%-10zu time_ms=%-12.3f ops_per_sec=%.0f",
+                name.c_str(), ops, seconds * 1000.0, opsPerSecond);
+    for (const auto& counter : counters) {
+        std::printf(" %s=%.0f", counter.first.c_str(), counter.second);
+    }
+    std::printf("\n");
+    std::fflush(stdout);
+    results.push_back(Result{name, ops, seconds, counters});
+}
+
+namespace {
+
+void writeJsonString(std::FILE* out, const std::string& value) {
+    std::fputc('"', out);
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            std::fputc('\\', out);
+        }
+        std::fputc(c, out);
+    }
+    std::fputc('"', out);
+}
+
+// One result per line, so runs can be compared with a plain diff
+bool writeJson(const char* path, double scale, const std::vector<Result>& results) {
+    std::FILE* out = std::fopen(path, "w");
+    if (!out) {
+        return false;
+    }
+    std::fprintf(out, "{\"scale\": %g, \"results\": [\n", scale);
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        double opsPerSecond = result.seconds > 0.0 ? static_cast<double>(result.ops) / result.seconds : 0.0;
+        std::fprintf(out, "  {\"name\": ");
+        writeJsonString(out, result.name);
+        std::fprintf(out, ", \"ops\": %zu, \"seconds\": %.9g, \"ops_per_sec\": %.6g, \"counters\": {",
+                     result.ops, result.seconds, opsPerSecond);
+        for (size_t k = 0; k < result.counters.size(); k++) {
+            std::fputs(k ? ", " : "", out);
+            writeJsonString(out, result.counters[k].first);
+            double value = result.counters[k].second;
+            if (std::isfinite(value) && value == std::floor(value) && std::fabs(value) < 1e15) {
+                std::fprintf(out, ": %.0f", value);     // Counts and byte sizes, exactly
+            } else if (std::isfinite(value)) {
+                std::fprintf(out, ": %.6g", value);
+            } else {
+                std::fputs(": null", out);
+            }
+        }
+        std::fprintf(out, "}}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "]}\n");
+    return std::fclose(out) == 0;
+}
+
+} // namespace
+
+} // namespace Bench
+} // namespace Lienzo
+
+// Usage: lienzo_bench [--scale=F] [--json=FILE] [--profile=FILE] [filter...]
+// A filter runs only benchmarks whose name contains it. --json also writes
+// every result, with its counters, to FILE. --profile writes the spans of a
+// LIENZO_ENABLE_PROFILING build as a Chrome trace.
+int main(int argc, char** argv) {
+    double scale = 1.0;
+    const char* jsonPath = nullptr;
+    const char* profilePath = nullptr;
+    std::vector<const char*> filters;
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], "--scale=", 8) == 0) {
+            scale = std::atof(argv[i] + 8);
+        } else if (std::strncmp(argv[i], "--json=", 7) == 0) {
+            jsonPath = argv[i] + 7;
+        } else if (std::strncmp(argv[i], "--profile=", 10) == 0) {
+            profilePath = argv[i] + 10;
+        } else {
+            filters.push_back(argv[i]);
+        }
+    }
+    
+    Lienzo::Bench::Context ctx(scale);
+    for (const auto& entry : Lienzo::Bench::registry()) {
+        bool selected = filters.empty();
+        for (const char* filter : filters) {
+            if (std::strstr(entry.name, filter)) {
+                selected = true;
+            }
+        }
+        if (selected) {
+            LIENZO_PROFILE_SCOPE(entry.name);
+            entry.function(ctx);
+        }
+    }
+    if (jsonPath && !Lienzo::Bench::writeJson(jsonPath, scale, ctx.getResults())) {
+        std::fprintf(stderr, "lienzo_bench: cannot write %s\n", jsonPath);
+        return 1;
+    }
+    if (profilePath && !Lienzo::Profiler::writeChromeTrace(profilePath)) {
+        std::fprintf(stderr, "lienzo_bench: cannot write %s\n", profilePath);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "bench.h"
+#include "crdt.h"
+#include "persistence.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kFrames = 1000;
+const char* kDirectory = "lienzo_bench_persistence";
+
+// Record `edits` drags over a document of kFrames frames, then reopen it
+void recordAndOpen(Bench::Context& ctx, const std::string& name, size_t edits,
+                   size_t thresholdBytes) {
+    std::filesystem::remove_all(kDirectory);
+    PersistenceOptions options;
+    options.checkpointThresholdBytes = thresholdBytes;
+    
+    size_t checkpoints = 0;
+    {
+        CRDTDocument doc("bench");
+        DocumentPersistence persistence(kDirectory, options);
+        persistence.open(doc);
+        std::vector<CRDTId> frames;
+        for (size_t i = 0; i < kFrames; i++) {
+            CRDTId frameId = doc.createNode("frame");
+            doc.setNodeProperty(frameId, "width", "100.000000");
+            doc.setNodeProperty(frameId, "height", "100.000000");
+            doc.addChild(doc.getRootId(), frameId);
+            frames.push_back(frameId);
+        }
+        for (size_t i = 0; i < edits; i++) {
+            const CRDTId& frameId = frames[i % frames.size()];
+            doc.setNodeProperty(frameId, "x", std::to_string(i));
+            doc.setNodeProperty(frameId, "y", std::to_string(i));
+        }
+        checkpoints = persistence.getCheckpointCount();
+    }
+    
+    CRDTDocument reopened("bench");
+    DocumentPersistence persistence(kDirectory, options);
+    double seconds = ctx.time([&] { persistence.open(reopened); });
+    ctx.report(name, edits * 2, seconds, {
+        {"replayed_ops", static_cast<double>(persistence.getReplayedOperationCount())},
+        {"checkpoints", static_cast<double>(checkpoints)},
+        {"nodes", static_cast<double>(reopened.getNodeCount())},
+    });
+    persistence.close();
+    std::filesystem::remove_all(kDirectory);
+}
+
+} // namespace
+
+// Open time against log length: with checkpointing it stays flat, without
+// it grows with the number of edits
+LIENZO_BENCHMARK(persistence_open) {
+    for (size_t edits : {ctx.size(10000), ctx.size(100000), ctx.size(1000000)}) {
+        std::string suffix = "_" + std::to_string(edits * 2);
+        recordAndOpen(ctx, "persistence_open_log_only" + suffix, edits, SIZE_MAX);
+        recordAndOpen(ctx, "persistence_open_checkpointed" + suffix, edits, 1024 * 1024);
+    }
+}
+
+// A snapshot that cannot be written (its temporary path is taken by a
+// directory) fails the checkpoint and keeps the segments; once the path is
+// free again the next checkpoint covers and removes them, and a segment
+// left below the snapshot is removed on open
+LIENZO_BENCHMARK(persistence_failed_snapshot) {
+    const std::string directory = kDirectory;
+    const std::string copy = directory + "_copy";
+    std::filesystem::remove_all(directory);
+    PersistenceOptions options;
+    options.backgroundCheckpoint = false;
+    auto reopens = [&](const std::string& from) {
+        CRDTDocument reopened("bench");
+        DocumentPersistence reader(from, options);
+        return reader.open(reopened) && reopened.getChildren(reopened.getRootId()).size() == kFrames + 1;
+    };
+
+    bool ok = true;
+    {
+        CRDTDocument doc("bench");
+        DocumentPersistence persistence(directory, options);
+        ok &= persistence.open(doc);
+        for (size_t i = 0; i < kFrames; i++) {
+            doc.addChild(doc.getRootId(), doc.createNode("frame"));
+        }
+        std::filesystem::create_directory(directory + "/snapshot.tmp");
+        ok &= !persistence.checkpoint() && persistence.hasFailed() && !persistence.sync();
+        ok &= std::filesystem::exists(directory + "/log.0");
+        doc.addChild(doc.getRootId(), doc.createNode("frame"));
+        // What is on disk now still opens to the whole document
+        std::filesystem::remove_all(copy);
+        std::filesystem::copy(directory, copy);
+        ok &= reopens(copy);
+        std::filesystem::remove_all(copy);
+
+        std::filesystem::remove(directory + "/snapshot.tmp");
+        ok &= persistence.checkpoint() && !persistence.hasFailed() && persistence.sync();
+        ok &= !std::filesystem::exists(directory + "/log.0") && !std::filesystem::exists(directory + "/log.1");
+    }
+    // A crash between the rename and the removals leaves covered segments
+    // behind: opening deletes them instead of replaying them
+    std::ofstream(directory + "/log.0") << "stale";
+    ok &= reopens(directory) && !std::filesystem::exists(directory + "/log.0");
+    std::filesystem::remove_all(directory);
+    ctx.report("persistence_failed_snapshot", 1, 0.0, Counters{{"ok", ok ? 1.0 : 0.0}});
+}
@@ -0,0 +1,148 @@
+#include "bench.h"
+#include "crdt.h"
+#include "plugin.h"
+#include "plugin_sandbox.h"
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kShapes = 10000;
+const size_t kFrames = 200;
+const size_t kEditsPerFrame = 200;
+const float kGrid = 8.0f;
+
+// Snaps moved shapes to a grid through the command buffer
+class SnapModule : public PluginModule {
+public:
+    std::string getName() const override { return "snap"; }
+    std::string getVersion() const override { return "1.0"; }
+
+    void onChanges(const PluginViewReader& view, const std::vector<uint32_t>& changedNodes,
+                   uint32_t, PluginCommandBuffer& commands) override {
+        for (uint32_t index : changedNodes) {
+            const PluginNodeRecord& node = view.getNode(index);
+            if (node.type != PluginNodeType::Rectangle) {
+                continue;
+            }
+            float x = std::round(node.x / kGrid) * kGrid;
+            float y = std::round(node.y / kGrid) * kGrid;
+            if (x != node.x) {
+                commands.setProperty(index, "x", std::to_string(static_cast<int>(x)));
+            }
+            if (y != node.y) {
+                commands.setProperty(index, "y", std::to_string(static_cast<int>(y)));
+            }
+        }
+    }
+};
+
+// Creates under a parent it does not have, then under the handle that
+// failed, then one shape under the root
+class OrphanModule : public PluginModule {
+public:
+    std::string getName() const override { return "orphan"; }
+    std::string getVersion() const override { return "1.0"; }
+
+    void onChanges(const PluginViewReader& view, const std::vector<uint32_t>&,
+                   uint32_t, PluginCommandBuffer& commands) override {
+        uint32_t missing = commands.createNode("rectangle", view.getNodeCount() + 100);
+        uint32_t nested = commands.createNode("rectangle", missing);
+        commands.setProperty(missing, "x", "1");
+        commands.setProperty(nested, "x", "1");
+        commands.createNode("rectangle", 0);
+    }
+};
+
+} // namespace
+
+// A drag moving 200 of 10k shapes per frame with a sandboxed snapping
+// plugin; the plugin reads the shared view, so a frame costs the changed
+// records rather than a copy of the document (copy_ms, for comparison)
+LIENZO_BENCHMARK(plugin_sandbox_snap) {
+    size_t frames = ctx.size(kFrames);
+    CRDTDocument doc("alice");
+    std::vector<CRDTId> shapes;
+    for (size_t i = 0; i < kShapes; i++) {
+        CRDTId id = doc.createNode("rectangle");
+        doc.setNodeProperty(id, "x", std::to_string(i % 100 * 16));
+        doc.setNodeProperty(id, "y", std::to_string(i / 100 * 16));
+        doc.addChild(doc.getRootId(), id);
+        shapes.push_back(id);
+    }
+
+    NativePluginRuntime::registerModule("snap", [] { return std::make_unique<SnapModule>(); });
+    PluginManager manager;
+    manager.attachDocument(doc);
+    bool loaded = manager.loadPlugin("plugins/snap.wasm", kPropertyChanges, 100.0);
+
+    double seconds = ctx.time([&] {
+        for (size_t frame = 0; frame < frames; frame++) {
+            doc.beginBatch();
+            for (size_t i = 0; i < kEditsPerFrame; i++) {
+                const CRDTId& id = shapes[(frame * 53 + i) % shapes.size()];
+                doc.setNodeProperty(id, "x", std::to_string(frame * 3 + i));
+            }
+            doc.endBatch();
+            manager.dispatchEvents(1000.0);
+        }
+    });
+    // What handing the plugin its own copy of the document would cost
+    size_t copies = std::min<size_t>(frames, 10);
+    size_t copyBytes = 0;
+    double copyMs = ctx.time([&] {
+        for (size_t i = 0; i < copies; i++) {
+            copyBytes += doc.serialize().size();
+        }
+    }) * 1000.0 / static_cast<double>(copies);
+
+    // Every moved shape ends up on the grid
+    bool snapped = true;
+    for (const auto& id : shapes) {
+        snapped &= std::stoi(doc.getNodeProperty(id, "x")) % static_cast<int>(kGrid) == 0;
+    }
+    const PluginStats* stats = manager.getStats("snap");
+    ctx.report("plugin_sandbox_snap", frames, seconds, Counters{
+        {"frame_ms", seconds * 1000.0 / static_cast<double>(frames)},
+        {"plugin_ms", stats ? stats->totalMs / static_cast<double>(frames) : 0.0},
+        {"commands", stats ? static_cast<double>(stats->commands) : 0.0},
+        {"rejected", stats ? static_cast<double>(stats->rejectedCommands) : 0.0},
+        {"copy_ms", copyMs},
+        {"copy_kb", static_cast<double>(copyBytes / copies) / 1024.0},
+        {"snapped", loaded && snapped ? 1.0 : 0.0},
+    });
+    manager.unloadPlugin("snap");
+    NativePluginRuntime::unregisterModule("snap");
+}
+
+// Rejected creates leave nothing behind: only the one with a resolvable
+// parent adds a node
+LIENZO_BENCHMARK(plugin_sandbox_rejected) {
+    CRDTDocument doc("alice");
+    CRDTId shape = doc.createNode("rectangle");
+    doc.addChild(doc.getRootId(), shape);
+
+    NativePluginRuntime::registerModule("orphan", [] { return std::make_unique<OrphanModule>(); });
+    PluginManager manager;
+    manager.attachDocument(doc);
+    bool loaded = manager.loadPlugin("plugins/orphan.wasm", kPropertyChanges, 100.0);
+    size_t before = doc.getAllNodeIds().size();
+    doc.setNodeProperty(shape, "x", "10");
+    double seconds = ctx.time([&] { manager.dispatchEvents(1000.0); });
+
+    const PluginStats* stats = manager.getStats("orphan");
+    bool ok = loaded && stats && stats->commands == 1 && stats->rejectedCommands == 4 &&
+              doc.getAllNodeIds().size() == before + 1 && doc.getChildren(doc.getRootId()).size() == 2;
+    ctx.report("plugin_sandbox_rejected", 1, seconds, Counters{
+        {"created", static_cast<double>(doc.getAllNodeIds().size() - before)},
+        {"rejected", stats ? static_cast<double>(stats->rejectedCommands) : 0.0},
+        {"ok", ok ? 1.0 : 0.0},
+    });
+    manager.unloadPlugin("orphan");
+    NativePluginRuntime::unregisterModule("orphan");
+}
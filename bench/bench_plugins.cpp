@@ -0,0 +1,130 @@
+#include "bench.h"
+#include "crdt.h"
+#include "plugin.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kShapes = 2000;
+const size_t kFrames = 300;
+const size_t kEditsPerFrame = 500;    // Property changes, e.g. a multi-select drag
+
+// Plugin whose cost is a fixed amount of work per call plus per change
+class WorkPlugin : public IPlugin {
+public:
+    WorkPlugin(const std::string& name, double msPerCall, double usPerChange)
+        : name(name), msPerCall(msPerCall), usPerChange(usPerChange) {}
+    
+    std::string getName() const override { return name; }
+    std::string getVersion() const override { return "1.0"; }
+    void activate() override {}
+    void deactivate() override {}
+    
+    void onDocumentChanged(const CRDTDocument&, const DocumentChangeSet& changes) override {
+        spin(msPerCall + usPerChange * changes.changedProperties.size() / 1000.0);
+    }
+    
+    // Same work, called once per operation
+    void onOperation() {
+        spin(msPerCall + usPerChange / 1000.0);
+    }
+    
+private:
+    std::string name;
+    double msPerCall;
+    double usPerChange;
+    
+    static void spin(double ms) {
+        auto until = std::chrono::steady_clock::now() + std::chrono::duration<double, std::milli>(ms);
+        while (std::chrono::steady_clock::now() < until) {
+        }
+    }
+};
+
+struct Setup {
+    CRDTDocument doc{"alice"};
+    std::vector<CRDTId> shapes;
+    std::shared_ptr<WorkPlugin> light = std::make_shared<WorkPlugin>("light", 0.0, 0.2);
+    std::shared_ptr<WorkPlugin> medium = std::make_shared<WorkPlugin>("medium", 0.3, 0.5);
+    std::shared_ptr<WorkPlugin> heavy = std::make_shared<WorkPlugin>("heavy", 3.0, 1.0);
+    
+    explicit Setup(size_t shapeCount) {
+        for (size_t i = 0; i < shapeCount; i++) {
+            CRDTId id = doc.createNode("rectangle");
+            doc.addChild(doc.getRootId(), id);
+            shapes.push_back(id);
+        }
+    }
+    
+    // One drag step moving a run of shapes, as one batch
+    void editFrame(size_t frame, size_t edits) {
+        doc.beginBatch();
+        for (size_t i = 0; i < edits; i++) {
+            const CRDTId& id = shapes[(frame * 37 + i) % shapes.size()];
+            doc.setNodeProperty(id, i % 2 ? "y" : "x", std::to_string(frame));
+        }
+        doc.endBatch();
+    }
+};
+
+} // namespace
+
+// Three plugins (one far over budget) watching a drag that changes 500
+// properties per frame; batched bus versus a callback per operation
+LIENZO_BENCHMARK(plugin_event_bus) {
+    size_t frames = ctx.size(kFrames);
+    Setup setup(kShapes);
+    PluginManager manager;
+    for (const auto& plugin : {setup.light, setup.medium, setup.heavy}) {
+        manager.registerPlugin(plugin);
+        manager.subscribe(plugin->getName(), kPropertyChanges);
+    }
+    manager.attachDocument(setup.doc);
+    
+    std::vector<double> frameMs;
+    double seconds = ctx.time([&] {
+        for (size_t frame = 0; frame < frames; frame++) {
+            setup.editFrame(frame, kEditsPerFrame);
+            frameMs.push_back(ctx.time([&] { manager.dispatchEvents(); }) * 1000.0);
+        }
+    });
+    std::sort(frameMs.begin(), frameMs.end());
+    
+    const PluginStats* heavy = manager.getStats("heavy");
+    const PluginStats* light = manager.getStats("light");
+    ctx.report("plugin_event_bus", frames, seconds, Counters{
+        {"dispatch_p50_ms", frameMs[frameMs.size() / 2]},
+        {"dispatch_p99_ms", frameMs[frameMs.size() * 99 / 100]},
+        {"light_calls", static_cast<double>(light->deliveries)},
+        {"heavy_calls", static_cast<double>(heavy->deliveries)},
+        {"heavy_throttled", static_cast<double>(heavy->throttled)},
+        {"heavy_total_ms", heavy->totalMs},
+        {"heavy_batches", static_cast<double>(heavy->batches + heavy->pendingBatches)},
+    });
+}
+
+LIENZO_BENCHMARK(plugin_event_per_operation) {
+    // One frame is enough: every property change calls every plugin
+    size_t frames = 1;
+    Setup setup(kShapes);
+    setup.doc.addOperationListener([&](const CRDTOperation&, bool) {
+        setup.light->onOperation();
+        setup.medium->onOperation();
+        setup.heavy->onOperation();
+    });
+    
+    double seconds = ctx.time([&] {
+        for (size_t frame = 0; frame < frames; frame++) {
+            setup.editFrame(frame, kEditsPerFrame);
+        }
+    });
+    ctx.report("plugin_event_per_operation", frames, seconds, Counters{
+        {"frame_ms", seconds * 1000.0 / static_cast<double>(frames)},
+    });
+}
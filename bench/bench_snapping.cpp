@@ -0,0 +1,114 @@
+#include "bench.h"
+#include "snapping.h"
+#include "vector_crdt.h"
+#include <cmath>
+#include <random>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kFrames = 50000;
+const double kCanvasSize = 200000.0;
+
+// Smallest correction along one axis by comparing with every other frame
+double naiveDelta(const std::vector<Bounds>& others, size_t skip, double min, double max,
+                  bool horizontal, double tolerance, bool& snapped) {
+    double anchors[3] = {min, (min + max) / 2.0, max};
+    double best = 0.0;
+    snapped = false;
+    for (size_t i = 0; i < others.size(); i++) {
+        if (i == skip) {
+            continue;
+        }
+        const Bounds& b = others[i];
+        double lines[3] = {horizontal ? b.minX : b.minY, horizontal ? (b.minX + b.maxX) / 2.0 : (b.minY + b.maxY) / 2.0,
+                           horizontal ? b.maxX : b.maxY};
+        for (double anchor : anchors) {
+            for (double line : lines) {
+                double delta = line - anchor;
+                if (std::fabs(delta) <= tolerance && (!snapped || std::fabs(delta) < std::fabs(best))) {
+                    best = delta;
+                    snapped = true;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+// A frame dragged across many others: every mouse move updates the index
+// through CRDTFrame::setPosition and asks for the nearest guides
+LIENZO_BENCHMARK(snap_drag) {
+    size_t frames = ctx.size(kFrames);
+    VectorCRDTManager manager("alice");
+    std::mt19937 random(11);
+    std::uniform_real_distribution<double> position(0.0, kCanvasSize);
+    std::uniform_real_distribution<double> size(100.0, 2000.0);
+    std::vector<CRDTId> ids;
+    std::vector<Bounds> bounds;
+    for (size_t i = 0; i < frames; i++) {
+        // Whole-number positions, as after earlier snapping, so lines coincide
+        double x = std::floor(position(random)), y = std::floor(position(random));
+        double width = std::floor(size(random)), height = std::floor(size(random));
+        ids.push_back(manager.createFrame(x, y, width, height));
+        Bounds b;
+        b.include(x, y);
+        b.include(x + width, y + height);
+        bounds.push_back(b);
+    }
+    CRDTDocument& doc = manager.getDocument();
+    SnapEngine engine(doc);
+    double build = ctx.time([&] { engine.rebuild(); });
+
+    auto frame = manager.getFrame(ids[0]);
+    const size_t kMoves = 2000;
+    const double kTolerance = 4.0;
+    std::vector<Point> moves;
+    for (size_t i = 0; i < kMoves; i++) {
+        moves.emplace_back(position(random), position(random));
+    }
+
+    size_t snapped = 0, guides = 0;
+    std::vector<SnapResult> results(kMoves);
+    double seconds = ctx.time([&] {
+        for (size_t i = 0; i < kMoves; i++) {
+            Bounds moving;
+            moving.include(moves[i].x, moves[i].y);
+            moving.include(moves[i].x + frame->getWidth(), moves[i].y + frame->getHeight());
+            if (engine.snap(moving, kTolerance, results[i], {ids[0]})) {
+                snapped++;
+                guides += results[i].guides.size();
+            }
+            frame->setPosition(moves[i].x + results[i].dx, moves[i].y + results[i].dy, doc);
+        }
+    });
+
+    // Same corrections as comparing against every frame
+    size_t mismatches = 0;
+    double naive = ctx.time([&] {
+        for (size_t i = 0; i < kMoves; i++) {
+            bool snappedX, snappedY;
+            double dx = naiveDelta(bounds, 0, moves[i].x, moves[i].x + frame->getWidth(), true, kTolerance, snappedX);
+            double dy = naiveDelta(bounds, 0, moves[i].y, moves[i].y + frame->getHeight(), false, kTolerance, snappedY);
+            if (snappedX != results[i].snappedX || snappedY != results[i].snappedY ||
+                std::fabs(std::fabs(dx) - std::fabs(results[i].dx)) > 1e-9 ||
+                std::fabs(std::fabs(dy) - std::fabs(results[i].dy)) > 1e-9) {
+                mismatches++;
+            }
+        }
+    });
+
+    ctx.report("snap_drag", kMoves, seconds, Counters{
+        {"us_per_move", seconds * 1e6 / static_cast<double>(kMoves)},
+        {"naive_us_per_move", naive * 1e6 / static_cast<double>(kMoves)},
+        {"build_ms", build * 1e3},
+        {"lines", static_cast<double>(engine.getLineCount())},
+        {"snapped_pct", 100.0 * static_cast<double>(snapped) / static_cast<double>(kMoves)},
+        {"guides", static_cast<double>(guides)},
+        {"matches_naive", mismatches == 0 ? 1.0 : 0.0},
+    });
+}
@@ -0,0 +1,81 @@
+#include "bench.h"
+#include "crdt.h"
+#include "document_store.h"
+#include <cstdio>
+#include <string>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kStoreNodes = 500000;
+const size_t kShapesPerFrame = 50;
+const char* kStorePath = "lienzo_bench_store.lnz";
+
+void populate(CRDTDocument& doc, size_t nodeCount) {
+    doc.reserve(nodeCount + 1);
+    CRDTId frameId;
+    for (size_t i = 0; i < nodeCount; i++) {
+        bool isFrame = i % (kShapesPerFrame + 1) == 0;
+        CRDTId id = doc.createNode(isFrame ? "frame" : "rectangle");
+        doc.setNodeProperty(id, "x", std::to_string(i % 1000));
+        doc.setNodeProperty(id, "y", std::to_string(i / 1000));
+        if (isFrame) {
+            doc.addChild(doc.getRootId(), id);
+            frameId = id;
+        } else {
+            doc.addChild(frameId, id);
+        }
+    }
+}
+
+} // namespace
+
+LIENZO_BENCHMARK(document_store) {
+    size_t count = ctx.size(kStoreNodes);
+    {
+        CRDTDocument source("bench");
+        populate(source, count);
+        double seconds = ctx.time([&] { MappedDocumentStore::write(kStorePath, source); });
+        ctx.report("document_store_write", count, seconds);
+    }
+    
+    // Open and paint the first frame: only the root, one frame and its
+    // shapes are decoded
+    CRDTDocument doc("bench");
+    std::shared_ptr<MappedDocumentStore> store;
+    size_t shapes = 0;
+    double seconds = ctx.time([&] {
+        store = MappedDocumentStore::open(kStorePath);
+        store->attach(doc);
+        CRDTId frameId = doc.getChildren(doc.getRootId()).front();
+        for (const auto& shapeId : doc.getChildren(frameId)) {
+            shapes += doc.getNodeProperty(shapeId, "x").empty() ? 0 : 1;
+        }
+    });
+    ctx.report("document_store_open_first_frame", shapes, seconds, {
+        {"file_bytes", static_cast<double>(store->getFileSize())},
+        {"loaded_nodes", static_cast<double>(store->getLoadedNodeCount())},
+    });
+    
+    // Appends go to the op log without rewriting the file
+    CRDTId frameId = doc.getChildren(doc.getRootId()).front();
+    const size_t appends = ctx.size(10000);
+    seconds = ctx.time([&] {
+        for (size_t i = 0; i < appends; i++) {
+            doc.setNodeProperty(frameId, "x", std::to_string(i));
+        }
+        store->flush();
+    });
+    ctx.report("document_store_append", appends, seconds);
+    
+    // Faulting in everything, for comparison with the first-frame open
+    seconds = ctx.time([&] { doc.loadAllNodes(); });
+    ctx.report("document_store_load_all", count, seconds, {
+        {"loaded_nodes", static_cast<double>(store->getLoadedNodeCount())},
+    });
+    
+    store.reset();
+    std::remove(kStorePath);
+}
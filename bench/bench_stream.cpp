@@ -0,0 +1,126 @@
+#include "bench.h"
+#include "crdt.h"
+#include "snapshot_stream.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kFrames = 2000;
+const size_t kShapesPerFrame = 100;
+const size_t kChunkSize = 64 * 1024; // Typical fetch stream chunk
+
+std::string buildSnapshot(size_t frames) {
+    CRDTDocument doc("bench");
+    doc.reserve(frames * (kShapesPerFrame + 1) + 1);
+    for (size_t f = 0; f < frames; f++) {
+        CRDTId frameId = doc.createNode("frame");
+        doc.setNodeProperty(frameId, "x", std::to_string(f * 120));
+        doc.addChild(doc.getRootId(), frameId);
+        for (size_t i = 0; i < kShapesPerFrame; i++) {
+            CRDTId id = doc.createNode("rectangle");
+            doc.setNodeProperty(id, "x", std::to_string(i));
+            doc.setNodeProperty(id, "width", "100.000000");
+            doc.addChild(frameId, id);
+        }
+    }
+    return doc.serialize();
+}
+
+} // namespace
+
+// Time until the root and the first frame are paintable vs. the whole load
+LIENZO_BENCHMARK(snapshot_stream) {
+    size_t frames = ctx.size(kFrames);
+    std::string data = buildSnapshot(frames);
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start, rootReady, firstFrame;
+    bool sawRoot = false, sawFrame = false;
+    size_t readyFrames = 0;
+
+    CRDTDocument doc("client");
+    SnapshotStreamDecoder decoder(doc);
+    decoder.setFrameReadyCallback([&](const CRDTId&) {
+        if (!sawFrame) {
+            firstFrame = Clock::now();
+            sawFrame = true;
+        }
+        readyFrames++;
+    });
+
+    double seconds = ctx.time([&] {
+        start = Clock::now();
+        for (size_t offset = 0; offset < data.size(); offset += kChunkSize) {
+            decoder.push(data.data() + offset, std::min(kChunkSize, data.size() - offset));
+            if (!sawRoot && decoder.isRootReady()) {
+                rootReady = Clock::now();
+                sawRoot = true;
+            }
+        }
+        decoder.finish();
+    });
+
+    auto ms = [&](Clock::time_point t) {
+        return std::chrono::duration<double, std::milli>(t - start).count();
+    };
+    ctx.report("snapshot_stream", decoder.getDecodedNodeCount(), seconds, Counters{
+        {"bytes", static_cast<double>(data.size())},
+        {"frames_ready", static_cast<double>(readyFrames)},
+        {"root_ready_ms", sawRoot ? ms(rootReady) : -1.0},
+        {"first_frame_ms", sawFrame ? ms(firstFrame) : -1.0},
+    });
+}
+
+// Frames sharing a group: each is reported only once every node under it
+// has been decoded, including the shared ones
+LIENZO_BENCHMARK(snapshot_stream_shared) {
+    CRDTDocument source("bench");
+    std::vector<CRDTId> frames;
+    CRDTId shared = source.createNode("group");
+    for (size_t i = 0; i < kShapesPerFrame; i++) {
+        CRDTId id = source.createNode("rectangle");
+        source.addChild(shared, id);
+    }
+    for (size_t f = 0; f < 4; f++) {
+        CRDTId frameId = source.createNode("frame");
+        source.addChild(source.getRootId(), frameId);
+        source.addChild(frameId, shared);
+        frames.push_back(frameId);
+    }
+    std::string data = source.serialize();
+
+    CRDTDocument doc("client");
+    SnapshotStreamDecoder decoder(doc);
+    size_t readyFrames = 0;
+    bool complete = true;
+    decoder.setFrameReadyCallback([&](const CRDTId& frameId) {
+        readyFrames++;
+        std::vector<CRDTId> stack = {frameId};
+        while (!stack.empty()) {
+            auto node = doc.getNode(stack.back());
+            stack.pop_back();
+            if (!node) {
+                complete = false;
+                continue;
+            }
+            for (const auto& child : node->getChildren()) {
+                stack.push_back(child);
+            }
+        }
+    });
+    double seconds = ctx.time([&] {
+        decoder.push(data.data(), data.size());
+        decoder.finish();
+    });
+
+    ctx.report("snapshot_stream_shared", decoder.getDecodedNodeCount(), seconds, Counters{
+        {"frames_ready", static_cast<double>(readyFrames)},
+        {"ok", complete && readyFrames == frames.size() ? 1.0 : 0.0},
+    });
+}
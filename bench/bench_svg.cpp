@@ -0,0 +1,200 @@
+#include "bench.h"
+#include "numbers.h"
+#include "svg_export.h"
+#include "svg_parser.h"
+#include "vector_crdt.h"
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kRegions = 5000;
+const size_t kCommandsPerRegion = 24;
+
+// A map-like illustration: many irregular regions with mixed commands and
+// full-precision coordinates, plus labels and markers
+std::string makeMap(size_t regions, size_t& commands) {
+    std::mt19937 random(7);
+    std::uniform_real_distribution<double> step(-40.0, 40.0);
+    std::string svg = "<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"0 0 20000 20000\">\n";
+    commands = 0;
+    for (size_t r = 0; r < regions; r++) {
+        if (r % 100 == 0) {
+            svg += r == 0 ? "<g id=\"province0\">\n" : "</g>\n<g id=\"province" + std::to_string(r / 100) + "\">\n";
+        }
+        svg += "<path id=\"region" + std::to_string(r) + "\" fill=\"#C8D6A0\" stroke=\"#444\" stroke-width=\"0.5\" d=\"M";
+        appendNumber(svg, static_cast<double>(r % 100) * 200.0 + 17.123456, 6);
+        svg += ' ';
+        appendNumber(svg, static_cast<double>(r / 100) * 200.0 + 3.654321, 6);
+        for (size_t c = 1; c < kCommandsPerRegion; c++) {
+            switch (c % 4) {
+                case 0: svg += " c"; break;
+                case 1: svg += " l"; break;
+                case 2: svg += " q"; break;
+                default: svg += " t"; break;
+            }
+            size_t pairs = c % 4 == 0 ? 3 : (c % 4 == 2 ? 2 : 1);
+            for (size_t k = 0; k < pairs; k++) {
+                appendNumber(svg, step(random), 6);
+                svg += ',';
+                appendNumber(svg, step(random), 6);
+                svg += ' ';
+            }
+        }
+        svg += "z\"/>\n";
+        commands += kCommandsPerRegion + 1;
+        if (r % 10 == 0) {
+            svg += "<circle cx=\"" + std::to_string(r % 100 * 200 + 100) + "\" cy=\"" +
+                   std::to_string(r / 100 * 200 + 100) + "\" r=\"4\" fill=\"#222\"/>\n";
+            svg += "<text x=\"" + std::to_string(r % 100 * 200 + 110) + "\" y=\"" +
+                   std::to_string(r / 100 * 200 + 100) + "\">Town &amp; " + std::to_string(r) + "</text>\n";
+        }
+    }
+    svg += "</g>\n</svg>\n";
+    return svg;
+}
+
+} // namespace
+
+// Tokenize-only and full import (tokenize, parse numbers, bounds, insert
+// as one batch) of a large map with 100k+ path commands
+LIENZO_BENCHMARK(svg_import) {
+    size_t regions = ctx.size(kRegions);
+    size_t commands = 0;
+    std::string svg = makeMap(regions, commands);
+    double megabytes = static_cast<double>(svg.size()) / 1e6;
+
+    size_t elements = 0;
+    double parseSeconds = ctx.time([&] {
+        SvgStreamParser parser([&](const SvgElement&) { elements++; });
+        parser.feed(svg);
+        parser.finish();
+    });
+
+    VectorCRDTManager manager("alice");
+    CRDTId frame = manager.createFrame(0, 0, 20000, 20000);
+    size_t batches = 0;
+    manager.getDocument().addBatchListener([&] { batches++; });
+    std::vector<CRDTId> created;
+    double seconds = ctx.time([&] { created = manager.importSvg(frame, svg); });
+
+    ctx.report("svg_import", commands, seconds, Counters{
+        {"mb", megabytes},
+        {"mb_per_sec", megabytes / seconds},
+        {"tokenize_mb_per_sec", megabytes / parseSeconds},
+        {"path_commands", static_cast<double>(commands)},
+        {"elements", static_cast<double>(elements)},
+        {"nodes", static_cast<double>(created.size())},
+        {"batches", static_cast<double>(batches)},
+    });
+}
+
+// Frame to SVG through the streaming writer, and flattened VectorPaths
+// straight to path data; output goes to a sink in 64 KB chunks
+LIENZO_BENCHMARK(svg_export) {
+    size_t regions = ctx.size(kRegions);
+    size_t commands = 0;
+    std::string svg = makeMap(regions, commands);
+    VectorCRDTManager manager("alice");
+    CRDTId frame = manager.createFrame(0, 0, 20000, 20000);
+    size_t nodes = manager.importSvg(frame, svg).size();
+
+    size_t chunks = 0;
+    size_t largestChunk = 0;
+    std::string exported;
+    size_t bytes = 0;
+    double seconds = ctx.time([&] {
+        bytes = manager.exportSvg(frame, [&](std::string_view chunk) {
+            chunks++;
+            largestChunk = std::max(largestChunk, chunk.size());
+            exported.append(chunk.data(), chunk.size());
+        });
+    });
+
+    // The export reads back to the same nodes
+    VectorCRDTManager reimport("bob");
+    CRDTId copy = reimport.createFrame(0, 0, 20000, 20000);
+    size_t reimported = reimport.importSvg(copy, exported).size();
+
+    // Polylines, as produced by flattening or drawing tools
+    std::vector<VectorPath> paths;
+    size_t offset = 0;
+    while ((offset = svg.find(" d=\"", offset)) != std::string::npos) {
+        offset += 4;
+        size_t end = svg.find('"', offset);
+        flattenPath(std::string_view(svg).substr(offset, end - offset), paths);
+        offset = end;
+    }
+    size_t points = 0;
+    for (const auto& path : paths) {
+        points += path.points.size();
+    }
+    size_t pathBytes = 0;
+    double pathSeconds = ctx.time([&] {
+        SvgWriter writer([&](std::string_view chunk) { pathBytes += chunk.size(); });
+        writer.beginDocument(20000, 20000);
+        SvgAttributes style = {{"fill", "none"}, {"stroke", "#000"}};
+        for (const auto& path : paths) {
+            writer.writePath(path, style);
+        }
+        writer.endDocument();
+    });
+
+    ctx.report("svg_export", nodes, seconds, Counters{
+        {"mb_per_sec", static_cast<double>(bytes) / seconds / 1e6},
+        {"kb", static_cast<double>(bytes) / 1024.0},
+        {"chunks", static_cast<double>(chunks)},
+        {"largest_chunk_kb", static_cast<double>(largestChunk) / 1024.0},
+        {"round_trip_ok", reimported == nodes ? 1.0 : 0.0},
+        {"path_points", static_cast<double>(points)},
+        {"path_mb_per_sec", static_cast<double>(pathBytes) / pathSeconds / 1e6},
+    });
+}
+
+// The coordinate parser against strtod on typical path numbers
+LIENZO_BENCHMARK(svg_number_parse) {
+    size_t count = ctx.size(1000000);
+    std::mt19937 random(11);
+    std::uniform_real_distribution<double> coordinate(-5000.0, 5000.0);
+    std::uniform_int_distribution<int> precision(0, 6);
+    std::string text;
+    for (size_t i = 0; i < count; i++) {
+        appendNumber(text, coordinate(random), precision(random));
+        text += ' ';
+    }
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+
+    double sum = 0.0;
+    double seconds = ctx.time([&] {
+        const char* p = begin;
+        double value;
+        while (p < end && parseNumber(p, end, value)) {
+            sum += value;
+            p++;
+        }
+    });
+    double strtodSum = 0.0;
+    double strtodSeconds = ctx.time([&] {
+        const char* p = begin;
+        char* next;
+        while (p < end) {
+            strtodSum += std::strtod(p, &next);
+            p = next + 1;
+        }
+    });
+
+    ctx.report("svg_number_parse", count, seconds, Counters{
+        {"ns_per_number", seconds * 1e9 / static_cast<double>(count)},
+        {"strtod_ns_per_number", strtodSeconds * 1e9 / static_cast<double>(count)},
+        {"mb_per_sec", static_cast<double>(text.size()) / seconds / 1e6},
+        {"strtod_mb_per_sec", static_cast<double>(text.size()) / strtodSeconds / 1e6},
+        {"sums_match", sum == strtodSum ? 1.0 : 0.0},
+    });
+}
@@ -0,0 +1,56 @@
+#include "bench.h"
+#include "sync_simulator.h"
+#include <string>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const double kDurationMs = 5000.0;
+
+void report(Bench::Context& ctx, const std::string& name, const SyncSimulationOptions& options) {
+    SyncSimulator simulator(options);
+    SyncSimulationStats stats;
+    double seconds = ctx.time([&] { stats = simulator.run(); });
+    double replicas = static_cast<double>(options.replicas);
+    ctx.report(name, stats.operations, seconds, Counters{
+        {"messages", static_cast<double>(stats.messages)},
+        {"sent_bytes_per_replica", static_cast<double>(stats.bytesSent) / replicas},
+        {"received_bytes_per_replica", static_cast<double>(stats.bytesReceived) / replicas},
+        {"deferred_ops", static_cast<double>(stats.deferred)},
+        {"convergence_ms", stats.convergenceMs},
+        {"cpu_mean_us", stats.cpuMeanMs * 1e3},
+        {"cpu_max_us", stats.cpuMaxMs * 1e3},
+        {"child_order_mismatches", static_cast<double>(stats.childOrderMismatches)},
+        {"converged", stats.converged ? 1.0 : 0.0},
+    });
+}
+
+} // namespace
+
+// Editors sharing one document through a relay; simulated network time,
+// so results are reproducible and independent of the machine's speed except
+// for the CPU counters
+LIENZO_BENCHMARK(sync_editors) {
+    for (size_t editors : {2, 10, 50, 200}) {
+        SyncSimulationOptions options;
+        options.replicas = editors;
+        options.durationMs = static_cast<double>(ctx.size(static_cast<size_t>(kDurationMs)));
+        report(ctx, "sync_editors_" + std::to_string(editors), options);
+    }
+}
+
+// Reordering links and three of ten editors offline for four seconds
+// while everyone keeps editing
+LIENZO_BENCHMARK(sync_partition) {
+    SyncSimulationOptions options;
+    options.replicas = 10;
+    options.durationMs = static_cast<double>(ctx.size(static_cast<size_t>(kDurationMs)));
+    options.jitterMs = 80.0;
+    options.partitions.push_back(SyncPartition{options.durationMs * 0.2, options.durationMs * 0.6, {1, 4, 7}});
+    report(ctx, "sync_partition", options);
+
+    options.reorder = false;
+    report(ctx, "sync_partition_fifo", options);
+}
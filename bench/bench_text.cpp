@@ -0,0 +1,130 @@
+#include "bench.h"
+#include "crdt.h"
+#include "crdt_codec.h"
+#include "text_sequence.h"
+#include <string>
+#include <vector>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kInitialChars = 100000;
+const size_t kKeystrokes = 20000;     // Per replica
+const size_t kSyncInterval = 50;      // Keystrokes between exchanges
+
+std::string initialText(size_t count) {
+    std::string text;
+    text.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        text += (i % 64 == 63) ? '\n' : static_cast<char>('a' + i % 26);
+    }
+    return text;
+}
+
+// Replica that records its local operations for the other side
+struct Replica {
+    CRDTDocument doc;
+    std::vector<CRDTOperation> outbox;
+    size_t opBytes = 0;
+    size_t opCount = 0;
+
+    explicit Replica(const std::string& site) : doc(site) {
+        doc.addOperationListener([this](const CRDTOperation& op, bool local) {
+            if (local) {
+                ByteWriter writer;
+                CRDTCodec::encodeOperation(writer, op);
+                opBytes += writer.size();
+                opCount++;
+                outbox.push_back(op);
+            }
+        });
+    }
+
+    void deliverTo(Replica& other) {
+        for (const auto& op : outbox) {
+            other.doc.applyOperation(op);
+        }
+        outbox.clear();
+    }
+};
+
+} // namespace
+
+// Two users typing concurrently into one 100k-character textbox: each
+// keystroke is a one-character insert (every eighth a backspace), and the
+// replicas exchange operations every kSyncInterval keystrokes
+LIENZO_BENCHMARK(text_typing) {
+    size_t initial = ctx.size(kInitialChars);
+    size_t keystrokes = ctx.size(kKeystrokes);
+
+    Replica a("alice");
+    Replica b("bob");
+    CRDTId textId = a.doc.createNode("text");
+    a.doc.insertText(textId, 0, initialText(initial));
+    a.deliverTo(b);
+    a.opBytes = a.opCount = 0;
+
+    // a types a third into the text; b two thirds in, tracked from the end
+    // so a's edits ahead of it do not move it
+    TextSequence& textB = b.doc.getNode(textId)->ensureText();
+    size_t cursorA = initial / 3;
+    size_t tailB = initial / 3;
+    double seconds = ctx.time([&] {
+        for (size_t i = 0; i < keystrokes; i++) {
+            if (i % 8 == 7) {
+                a.doc.deleteText(textId, --cursorA, 1);
+                b.doc.deleteText(textId, textB.length() - tailB - 1, 1);
+            } else {
+                std::string key(1, static_cast<char>('A' + i % 26));
+                a.doc.insertText(textId, cursorA++, key);
+                b.doc.insertText(textId, textB.length() - tailB, key);
+            }
+            if (i % kSyncInterval == kSyncInterval - 1) {
+                a.deliverTo(b);
+                b.deliverTo(a);
+            }
+        }
+        a.deliverTo(b);
+        b.deliverTo(a);
+    });
+
+    bool converged = a.doc.getText(textId) == b.doc.getText(textId);
+    size_t ops = a.opCount + b.opCount;
+    ctx.report("text_typing", 2 * keystrokes, seconds, Counters{
+        {"chars", static_cast<double>(a.doc.getNode(textId)->getText()->length())},
+        {"runs", static_cast<double>(a.doc.getNode(textId)->getText()->getRunCount())},
+        {"bytes_per_op", static_cast<double>(a.opBytes + b.opBytes) / static_cast<double>(ops)},
+        {"converged", converged ? 1.0 : 0.0},
+    });
+}
+
+// Same keystrokes on one replica with the old whole-text LWW property, for
+// comparison of per-keystroke cost and delta size
+LIENZO_BENCHMARK(text_typing_lww_property) {
+    size_t initial = ctx.size(kInitialChars);
+    size_t keystrokes = ctx.size(kKeystrokes);
+
+    Replica a("alice");
+    CRDTId textId = a.doc.createNode("text");
+    std::string text = initialText(initial);
+    a.opBytes = a.opCount = 0;
+
+    size_t cursor = initial / 3;
+    double seconds = ctx.time([&] {
+        for (size_t i = 0; i < keystrokes; i++) {
+            if (i % 8 == 7) {
+                text.erase(--cursor, 1);
+            } else {
+                text.insert(cursor++, 1, static_cast<char>('A' + i % 26));
+            }
+            a.doc.setNodeProperty(textId, "text", text);
+            a.outbox.clear();
+        }
+    });
+
+    ctx.report("text_typing_lww_property", keystrokes, seconds, Counters{
+        {"bytes_per_op", static_cast<double>(a.opBytes) / static_cast<double>(a.opCount)},
+    });
+}
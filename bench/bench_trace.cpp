@@ -0,0 +1,132 @@
+#include "bench.h"
+#include "op_trace.h"
+#include "vector_crdt.h"
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kFrames = 200;
+const size_t kShapesPerFrame = 50;
+const size_t kEdits = 100000;
+
+// An editing session: build frames of rectangles, then mostly drags and
+// resizes, some recolours and text edits, with a collaborator's operations
+// arriving every thousand edits
+void runSession(VectorCRDTManager& manager, size_t edits) {
+    CRDTDocument& doc = manager.getDocument();
+    std::mt19937 random(17);
+    std::vector<CRDTId> shapes;
+    for (size_t f = 0; f < kFrames; f++) {
+        CRDTId frame = manager.createFrame(static_cast<double>(f % 20) * 1200.0,
+                                           static_cast<double>(f / 20) * 1200.0, 1000, 1000);
+        for (size_t i = 0; i < kShapesPerFrame; i++) {
+            CRDTId id = doc.createNode("rectangle");
+            doc.setNodeProperty(id, "x", std::to_string(i * 10));
+            doc.setNodeProperty(id, "y", std::to_string(i * 5));
+            doc.setNodeProperty(id, "width", "80");
+            doc.setNodeProperty(id, "height", "40");
+            doc.addChild(frame, id);
+            shapes.push_back(id);
+        }
+    }
+    CRDTId text = doc.createNode("text");
+    doc.addChild(doc.getRootId(), text);
+
+    CRDTDocument remote("bob");
+    remote.merge(doc);
+    std::vector<CRDTOperation> outbox;
+    remote.addOperationListener([&](const CRDTOperation& op, bool local) {
+        if (local) {
+            outbox.push_back(op);
+        }
+    });
+    std::uniform_int_distribution<size_t> pick(0, shapes.size() - 1);
+    for (size_t i = 0; i < edits; i++) {
+        const CRDTId& shape = shapes[pick(random)];
+        switch (i % 10) {
+            case 7:
+                doc.setNodeProperty(shape, "fill", i % 20 ? "#EF476F" : "#118AB2");
+                break;
+            case 8:
+                doc.insertText(text, doc.getText(text).size() / 2, "a");
+                break;
+            case 9:
+                doc.setNodeProperty(shape, "width", std::to_string(40 + i % 100));
+                break;
+            default:
+                doc.setNodeProperty(shape, "x", std::to_string(i % 1000));
+                doc.setNodeProperty(shape, "y", std::to_string(i % 777));
+                break;
+        }
+        if (i % 1000 == 999) {
+            for (int k = 0; k < 20; k++) {
+                remote.setNodeProperty(shapes[pick(random)], "stroke", "#073B4C");
+            }
+            for (const auto& op : outbox) {
+                doc.applyOperation(op);
+            }
+            outbox.clear();
+        }
+    }
+}
+
+} // namespace
+
+// Recording overhead on a realistic session, and the trace's size
+LIENZO_BENCHMARK(trace_record) {
+    size_t edits = ctx.size(kEdits);
+    VectorCRDTManager warmup("alice");
+    runSession(warmup, edits / 10);
+    VectorCRDTManager plain("alice");
+    double untraced = ctx.time([&] { runSession(plain, edits); });
+
+    VectorCRDTManager traced("alice");
+    traced.startTrace();
+    double seconds = ctx.time([&] { runSession(traced, edits); });
+    std::string trace = traced.stopTrace();
+
+    OpTraceReader reader(trace.data(), trace.size());
+    OpTraceRecord record;
+    size_t records = 0, remote = 0;
+    while (reader.next(record)) {
+        records++;
+        remote += record.local ? 0 : 1;
+    }
+    ctx.report("trace_record", records, seconds, Counters{
+        {"overhead_pct", 100.0 * (seconds - untraced) / untraced},
+        {"remote_records", static_cast<double>(remote)},
+        {"trace_bytes", static_cast<double>(trace.size())},
+        {"bytes_per_record", static_cast<double>(trace.size()) / static_cast<double>(records)},
+        {"readable", reader.hasError() ? 0.0 : 1.0},
+    });
+}
+
+// The same session replayed into 1 and 8 replicas at maximum speed
+LIENZO_BENCHMARK(trace_replay) {
+    size_t edits = ctx.size(kEdits);
+    VectorCRDTManager manager("alice");
+    manager.startTrace();
+    runSession(manager, edits);
+    std::string trace = manager.stopTrace();
+
+    for (size_t replicas : {1, 8}) {
+        OpTraceReplayOptions options;
+        options.replicas = replicas;
+        OpTraceReplayStats stats;
+        bool complete = replayOpTrace(trace, options, stats);
+        bool matches = stats.nodes == manager.getDocument().getNodeCount();
+        ctx.report("trace_replay_" + std::to_string(replicas), stats.records * replicas, stats.seconds, Counters{
+            {"p50_ns", stats.latencyP50Micros * 1e3},
+            {"p99_ns", stats.latencyP99Micros * 1e3},
+            {"max_us", stats.latencyMaxMicros},
+            {"peak_bytes_in_use", static_cast<double>(stats.peakBytesInUse)},
+            {"complete", complete ? 1.0 : 0.0},
+            {"node_count_matches", matches ? 1.0 : 0.0},
+        });
+    }
+}
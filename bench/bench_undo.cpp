@@ -0,0 +1,307 @@
+#include "bench.h"
+#include "crdt.h"
+#include "dom_graph.h"
+#include "sync_simulator.h"
+#include "undo_manager.h"
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace Lienzo;
+using Lienzo::Bench::Counters;
+
+namespace {
+
+const size_t kSizes[] = {1000, 10000, 100000};
+const size_t kEdits = 1000;
+const size_t kDragFrames = 600;     // Ten seconds at 60 fps
+const size_t kCappedEdits = 20000;
+const size_t kCap = 64 * 1024;
+
+std::vector<CRDTId> populate(CRDTDocument& doc, CRDTId& frame, size_t shapes) {
+    frame = doc.createNode("frame");
+    doc.setNodeProperty(frame, "x", "0");
+    doc.setNodeProperty(frame, "y", "0");
+    doc.addChild(doc.getRootId(), frame);
+    std::vector<CRDTId> ids;
+    for (size_t i = 0; i < shapes; i++) {
+        CRDTId id = doc.createNode("rectangle");
+        doc.setNodeProperty(id, "x", std::to_string(i % 100 * 12));
+        doc.setNodeProperty(id, "y", std::to_string(i / 100 * 12));
+        doc.setNodeProperty(id, "width", "10");
+        doc.setNodeProperty(id, "height", "10");
+        doc.setNodeProperty(id, "fill", "#3366FF");
+        doc.addChild(frame, id);
+        ids.push_back(id);
+    }
+    return ids;
+}
+
+// Replica that keeps its local operations until delivered, so edits made
+// before a delivery are concurrent with the other side's
+struct Replica {
+    CRDTDocument doc;
+    std::vector<CRDTOperation> outbox;
+
+    explicit Replica(const std::string& site) : doc(site) {
+        doc.addOperationListener([this](const CRDTOperation& op, bool local) {
+            if (local && !doc.isExpandingClone()) {
+                outbox.push_back(op);
+            }
+        });
+    }
+
+    void deliverTo(Replica& other) {
+        for (const auto& op : outbox) {
+            other.doc.applyOperation(op);
+        }
+        outbox.clear();
+    }
+};
+
+void exchange(Replica& a, Replica& b) {
+    a.deliverTo(b);
+    b.deliverTo(a);
+}
+
+bool isChild(const CRDTDocument& doc, const CRDTId& parent, const CRDTId& child) {
+    for (const auto& id : doc.getChildren(parent)) {
+        if (id == child) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+// Undo and redo of a one-shape move on documents of 1k to 100k shapes,
+// against serializing a snapshot per step (what undo by copies would cost)
+LIENZO_BENCHMARK(undo) {
+    for (size_t size : kSizes) {
+        size_t shapes = ctx.size(size);
+        CRDTDocument doc("alice");
+        CRDTId frame;
+        std::vector<CRDTId> ids = populate(doc, frame, shapes);
+        UndoManager undo(doc);
+        undo.setCoalesceWindow(0);
+
+        std::mt19937 random(11);
+        std::uniform_int_distribution<size_t> pick(0, shapes - 1);
+        for (size_t i = 0; i < kEdits; i++) {
+            doc.setNodeProperty(ids[pick(random)], "x", std::to_string(i));
+        }
+        size_t bytesPerStep = undo.getMemoryUsage() / undo.getUndoDepth();
+        double undoSeconds = ctx.time([&] {
+            while (undo.undo()) {
+            }
+        });
+        double redoSeconds = ctx.time([&] {
+            while (undo.redo()) {
+            }
+        });
+        size_t snapshotBytes = 0;
+        double snapshotSeconds = ctx.time([&] { snapshotBytes = doc.serialize().size(); });
+
+        ctx.report("undo_" + std::to_string(shapes), kEdits, undoSeconds + redoSeconds, Counters{
+            {"us_per_undo", undoSeconds * 1e6 / static_cast<double>(kEdits)},
+            {"us_per_redo", redoSeconds * 1e6 / static_cast<double>(kEdits)},
+            {"bytes_per_step", static_cast<double>(bytesPerStep)},
+            {"snapshot_kb", static_cast<double>(snapshotBytes) / 1024.0},
+            {"us_per_snapshot", snapshotSeconds * 1e6},
+        });
+    }
+}
+
+// A 600-frame drag writes x and y once per frame, outside any batch: with
+// coalescing it is one step, and one undo puts the shape back
+LIENZO_BENCHMARK(undo_drag) {
+    for (double window : {UndoManager::kDefaultCoalesceWindow, 0.0}) {
+        CRDTDocument doc("alice");
+        CRDTId frame;
+        CRDTId shape = populate(doc, frame, 1)[0];
+        UndoManager undo(doc);
+        undo.setCoalesceWindow(window);
+
+        double seconds = ctx.time([&] {
+            for (size_t i = 1; i <= kDragFrames; i++) {
+                doc.setNodeProperty(shape, "x", std::to_string(i));
+                doc.setNodeProperty(shape, "y", std::to_string(i / 2));
+            }
+        });
+        undo.breakCoalescing();
+        size_t depth = undo.getUndoDepth();
+        size_t bytes = undo.getMemoryUsage();
+        undo.undo();
+        bool restored = doc.getNode(shape)->getProperty("x") == "0";
+
+        ctx.report(window > 0.0 ? "undo_drag_coalesced" : "undo_drag_uncoalesced", kDragFrames * 2, seconds, Counters{
+            {"undo_depth", static_cast<double>(depth)},
+            {"undo_bytes", static_cast<double>(bytes)},
+            {"coalesced", static_cast<double>(undo.getCoalescedSteps())},
+            {"one_undo_restores", restored ? 1.0 : 0.0},
+        });
+    }
+}
+
+// 20k separate edits against a 64 KB cap: the oldest steps are dropped and
+// memory never goes over
+LIENZO_BENCHMARK(undo_memory) {
+    size_t edits = ctx.size(kCappedEdits);
+    CRDTDocument doc("alice");
+    CRDTId frame;
+    std::vector<CRDTId> ids = populate(doc, frame, 100);
+    UndoManager undo(doc, kCap);
+    size_t peak = 0;
+    double seconds = ctx.time([&] {
+        for (size_t i = 0; i < edits; i++) {
+            doc.setNodeProperty(ids[i % ids.size()], "fill", "#" + std::to_string(100000 + i));
+            undo.breakCoalescing();
+            peak = std::max(peak, undo.getMemoryUsage());
+        }
+    });
+    size_t undone = 0;
+    while (undo.undo()) {
+        undone++;
+    }
+
+    ctx.report("undo_memory", edits, seconds, Counters{
+        {"limit_bytes", static_cast<double>(kCap)},
+        {"peak_bytes", static_cast<double>(peak)},
+        {"within_limit", peak <= kCap ? 1.0 : 0.0},
+        {"undo_depth", static_cast<double>(undone)},
+        {"dropped", static_cast<double>(undo.getDroppedSteps())},
+    });
+}
+
+// Typing sessions that delete and undo the delete: the characters typed
+// again are tracked alongside the steps, counted against the cap and
+// released with the last step that could refer to them
+LIENZO_BENCHMARK(undo_text_memory) {
+    size_t edits = ctx.size(kCappedEdits) / 4;
+    CRDTDocument doc("alice");
+    CRDTId text = doc.createNode("text");
+    doc.addChild(doc.getRootId(), text);
+    UndoManager undo(doc, kCap);
+    size_t peak = 0;
+    double seconds = ctx.time([&] {
+        for (size_t i = 0; i < edits; i++) {
+            doc.insertText(text, 0, "word ");
+            doc.deleteText(text, 0, 5);
+            undo.undo();
+            // Typing after the undo drops the redo step
+            doc.insertText(text, 0, "x");
+            peak = std::max(peak, undo.getMemoryUsage());
+        }
+    });
+    undo.setMemoryLimit(0);
+    bool released = undo.getMemoryUsage() == 0 && !undo.canUndo() && !undo.canRedo();
+
+    ctx.report("undo_text_memory", edits * 4, seconds, Counters{
+        {"limit_bytes", static_cast<double>(kCap)},
+        {"peak_bytes", static_cast<double>(peak)},
+        {"within_limit", peak <= kCap ? 1.0 : 0.0},
+        {"released", released ? 1.0 : 0.0},
+    });
+}
+
+// Undo next to a concurrent peer: only alice's own changes are reverted,
+// bob's edits survive, and both replicas converge
+LIENZO_BENCHMARK(undo_peers) {
+    Replica alice("alice");
+    Replica bob("bob");
+    CRDTId frame;
+    std::vector<CRDTId> ids = populate(alice.doc, frame, 10);
+    CRDTId text = alice.doc.createNode("text");
+    alice.doc.insertText(text, 0, "hello world");
+    alice.doc.addChild(frame, text);
+    exchange(alice, bob);
+    DOMGraph graph(bob.doc);
+    UndoManager undo(alice.doc);
+    bool ok = true;
+
+    // Undoing a move keeps bob's concurrent fill
+    alice.doc.setNodeProperty(ids[0], "x", "500");
+    undo.breakCoalescing();
+    bob.doc.setNodeProperty(ids[0], "fill", "#FF0000");
+    exchange(alice, bob);
+    ok &= undo.undo();
+    exchange(alice, bob);
+    ok &= bob.doc.getNode(ids[0])->getProperty("x") == "0";
+    ok &= bob.doc.getNode(ids[0])->getProperty("fill") == "#FF0000";
+    // Redo moves it again
+    ok &= undo.redo();
+    exchange(alice, bob);
+    ok &= bob.doc.getNode(ids[0])->getProperty("x") == "500";
+
+    // Undoing a delete brings the shape back where it was, with the edit
+    // bob made to it meanwhile
+    alice.doc.deleteNode(ids[1]);
+    bob.doc.setNodeProperty(ids[1], "width", "40");
+    exchange(alice, bob);
+    ok &= graph.indexOf(ids[1]) == DOMGraph::kNone;
+    ok &= undo.undo();
+    exchange(alice, bob);
+    ok &= !bob.doc.getNode(ids[1])->isDeleted() && isChild(bob.doc, frame, ids[1]);
+    ok &= bob.doc.getNode(ids[1])->getProperty("width") == "40";
+    ok &= graph.indexOf(ids[1]) != DOMGraph::kNone;
+
+    // A property bob wrote after alice is not reverted
+    alice.doc.setNodeProperty(ids[2], "y", "300");
+    undo.breakCoalescing();
+    exchange(alice, bob);
+    bob.doc.setNodeProperty(ids[2], "y", "900");
+    exchange(alice, bob);
+    undo.undo();
+    exchange(alice, bob);
+    ok &= alice.doc.getNode(ids[2])->getProperty("y") == "900";
+
+    // Text: an insert and a delete, each undone while bob types at the end
+    alice.doc.insertText(text, 5, ", big");
+    bob.doc.insertText(text, 11, "!");
+    exchange(alice, bob);
+    alice.doc.deleteText(text, 0, 7);
+    exchange(alice, bob);
+    ok &= alice.doc.getText(text) == "big world!";
+    ok &= undo.undo();
+    ok &= alice.doc.getText(text) == "hello, big world!";
+    ok &= undo.undo();
+    exchange(alice, bob);
+    ok &= bob.doc.getText(text) == "hello world!";
+    ok &= undo.redo() && undo.redo();
+    exchange(alice, bob);
+    ok &= bob.doc.getText(text) == "big world!";
+
+    // A new shape, undone in one step
+    alice.doc.beginBatch();
+    CRDTId added = alice.doc.createNode("rectangle");
+    alice.doc.setNodeProperty(added, "x", "1");
+    alice.doc.addChild(frame, added);
+    alice.doc.endBatch();
+    exchange(alice, bob);
+    ok &= undo.undo();
+    exchange(alice, bob);
+    ok &= !isChild(bob.doc, frame, added) && graph.indexOf(added) == DOMGraph::kNone;
+
+    // Child order is not restored: a child whose removal is undone comes
+    // back last, and moving a child to the end is no step at all
+    alice.doc.removeChild(frame, ids[3]);
+    ok &= undo.undo();
+    bool orderAtEnd = alice.doc.getChildren(frame).back() == ids[3];
+    size_t depth = undo.getUndoDepth();
+    alice.doc.addChild(frame, ids[4]);
+    orderAtEnd &= alice.doc.getChildren(frame).back() == ids[4] && undo.getUndoDepth() == depth;
+    exchange(alice, bob);
+
+    bool converged = SyncSimulator::canonicalState(alice.doc) == SyncSimulator::canonicalState(bob.doc);
+    DOMGraph fresh(bob.doc);
+    bool graphMatches = graph.size() == fresh.size();
+    ctx.report("undo_peers", 1, 0.0, Counters{
+        {"ok", ok ? 1.0 : 0.0},
+        {"converged", converged ? 1.0 : 0.0},
+        {"graph_matches", graphMatches ? 1.0 : 0.0},
+        {"order_at_end", orderAtEnd ? 1.0 : 0.0},
+        // Beyond the one at construction: restores are patched in
+        {"graph_rebuilds", static_cast<double>(graph.getRebuildCount() - fresh.getRebuildCount())},
+    });
+}
@@ -1,8 +1,15 @@
 #include "chat.h"
+#include <cstdlib>
 
 namespace Lienzo {
 
-ChatInterface::ChatInterface() {
+ChatInterface::ChatInterface()
+    : document(nullptr), streaming(false) {
+    parser.setCallback([this](const SvgElement& element) {
+        if (importer) {
+            importer->handle(element);
+        }
+    });
 }
 
 void ChatInterface::setFrame(std::shared_ptr<Frame> frame) {
@@ -17,6 +24,27 @@ void ChatInterface::setVectorGeneratedCallback(VectorGeneratedCallback callback)
     onVectorGenerated = callback;
 }
 
+void ChatInterface::setModel(std::shared_ptr<ModelBackend> backend) {
+    model = backend;
+}
+
+void ChatInterface::setTargetFrame(CRDTDocument& target, const CRDTId& frameId) {
+    document = &target;
+    targetFrame = frameId;
+}
+
+void ChatInterface::setCache(std::shared_ptr<GenerationCache> target) {
+    cache = target;
+}
+
+void ChatInterface::setStyleContext(const std::string& style) {
+    styleContext = style;
+}
+
+void ChatInterface::setShapeCreatedCallback(ShapeCreatedCallback callback) {
+    onShapeCreated = callback;
+}
+
 void ChatInterface::processMessage(const std::string& message) {
     // TODO: Parse message and determine intent
     // For now, treat all messages as vector generation requests
@@ -24,12 +52,99 @@ void ChatInterface::processMessage(const std::string& message) {
 }
 
 void ChatInterface::generateVector(const std::string& prompt) {
-    // TODO: Integrate with AI model (local or cloud)
-    // For now, just call the callback with empty data
+    if (!model) {
+        // TODO: Integrate with AI model (local or cloud)
+        if (onVectorGenerated) {
+            onVectorGenerated("");
+        }
+        return;
+    }
+    bool cached = cache && document && targetFrame != CRDTId();
+    GenerationContext context;
+    if (cached) {
+        context = getContext();
+        if (auto batch = cache->find(prompt, context)) {
+            document->beginBatch();
+            batch->instantiate(*document, targetFrame, onShapeCreated);
+            document->endBatch();
+            if (onVectorGenerated) {
+                onVectorGenerated("");
+            }
+            return;
+        }
+    }
+
+    beginVectorStream();
+    std::shared_ptr<ShapeBatch> recording;
+    if (cached) {
+        recording = std::make_shared<ShapeBatch>();
+        importer->setRecorder(recording.get());
+    }
+    bool complete = model->generate(prompt, [this](std::string_view tokens) {
+        receiveVectorTokens(tokens);
+        return true;
+    });
+    endVectorStream();
+    // Only complete responses are worth replaying
+    if (recording && complete && !recording->entries.empty()) {
+        cache->insert(prompt, context, recording);
+    }
     if (onVectorGenerated) {
-        onVectorGenerated("");
+        onVectorGenerated(streamed);
     }
 }
 
-} // namespace Lienzo
+GenerationContext ChatInterface::getContext() const {
+    GenerationContext context;
+    context.style = styleContext;
+    auto frame = document->getNode(targetFrame);
+    if (frame) {
+        context.frameWidth = std::strtod(frame->getProperty("width").c_str(), nullptr);
+        context.frameHeight = std::strtod(frame->getProperty("height").c_str(), nullptr);
+    }
+    return context;
+}
+
+void ChatInterface::beginVectorStream() {
+    if (streaming) {
+        endVectorStream();
+    }
+    streaming = true;
+    streamed.clear();
+    parser.reset();
+    if (document && targetFrame != CRDTId()) {
+        document->beginBatch();
+        importer = std::make_unique<SvgImporter>(*document, targetFrame);
+        importer->setNodeCallback([this](const CRDTId& id) {
+            if (onShapeCreated) {
+                onShapeCreated(id);
+            }
+        });
+    }
+}
 
+void ChatInterface::receiveVectorTokens(std::string_view tokens) {
+    if (!streaming) {
+        return;
+    }
+    streamed.append(tokens.data(), tokens.size());
+    parser.feed(tokens);
+}
+
+size_t ChatInterface::endVectorStream() {
+    if (!streaming) {
+        return 0;
+    }
+    streaming = false;
+    parser.finish();
+    size_t count = 0;
+    if (importer) {
+        importer->finish();
+        count = importer->getCreatedNodes().size();
+        importer.reset();
+        document->endBatch();
+    }
+    return count;
+}
+
+} // namespace Lienzo
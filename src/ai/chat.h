@@ -1,8 +1,15 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <functional>
+#include <memory>
 #include "../core/frame.h"
+#include "../core/svg_import.h"
+#include "../core/svg_parser.h"
+#include "../collaboration/crdt.h"
+#include "generation_cache.h"
+#include "model_stream.h"
 
 namespace Lienzo {
 
@@ -10,21 +17,56 @@ namespace Lienzo {
 class ChatInterface {
 public:
     ChatInterface();
-    
+
     void setFrame(std::shared_ptr<Frame> frame);
     void sendMessage(const std::string& message);
-    
+
     // Callback for when AI generates a vector
     using VectorGeneratedCallback = std::function<void(const std::string& vectorData)>;
     void setVectorGeneratedCallback(VectorGeneratedCallback callback);
-    
+
+    // Streaming generation
+    // With a model and a target frame set, SVG in the model's output is
+    // parsed while it streams in and each complete element becomes a node
+    // in the frame right away. The whole response is one document batch,
+    // so it undoes as a single step.
+    void setModel(std::shared_ptr<ModelBackend> model);
+    void setTargetFrame(CRDTDocument& document, const CRDTId& frameId);
+
+    // Results are cached per prompt, target frame size and style; a hit
+    // recreates the shapes without calling the model or the parser (the
+    // vector callback then receives an empty string)
+    void setCache(std::shared_ptr<GenerationCache> cache);
+    void setStyleContext(const std::string& style);
+
+    using ShapeCreatedCallback = std::function<void(const CRDTId& id)>;
+    void setShapeCreatedCallback(ShapeCreatedCallback callback);
+
+    // For hosts that receive the tokens themselves (e.g. from a fetch stream)
+    void beginVectorStream();
+    void receiveVectorTokens(std::string_view tokens);
+    // Returns the number of nodes created
+    size_t endVectorStream();
+    bool isStreaming() const { return streaming; }
+
 private:
     std::shared_ptr<Frame> associatedFrame;
     VectorGeneratedCallback onVectorGenerated;
-    
+
+    std::shared_ptr<ModelBackend> model;
+    CRDTDocument* document;
+    CRDTId targetFrame;
+    ShapeCreatedCallback onShapeCreated;
+    std::shared_ptr<GenerationCache> cache;
+    std::string styleContext;
+    SvgStreamParser parser;
+    std::unique_ptr<SvgImporter> importer;
+    std::string streamed;     // Raw response so far
+    bool streaming;
+
     void processMessage(const std::string& message);
     void generateVector(const std::string& prompt);
+    GenerationContext getContext() const;
 };
 
 } // namespace Lienzo
-
@@ -0,0 +1,116 @@
+#include "generation_cache.h"
+#include <cctype>
+#include <cstdio>
+
+namespace Lienzo {
+
+const size_t GenerationCache::kDefaultMemoryCap;
+
+GenerationCache::GenerationCache(size_t memoryCap)
+    : memoryCap(memoryCap) {
+}
+
+std::string GenerationCache::normalizePrompt(const std::string& prompt) {
+    std::string normalized;
+    normalized.reserve(prompt.size());
+    bool space = false;
+    for (unsigned char c : prompt) {
+        if (std::isspace(c)) {
+            space = !normalized.empty();
+            continue;
+        }
+        if (space) {
+            normalized += ' ';
+            space = false;
+        }
+        normalized += static_cast<char>(std::tolower(c));
+    }
+    while (!normalized.empty() && std::ispunct(static_cast<unsigned char>(normalized.back()))) {
+        normalized.pop_back();
+    }
+    return normalized;
+}
+
+uint64_t GenerationCache::hashKey(const std::string& key) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string GenerationCache::makeKey(const std::string& prompt, const GenerationContext& context) {
+    char size[64];
+    std::snprintf(size, sizeof(size), "%.3fx%.3f", context.frameWidth, context.frameHeight);
+    std::string key = normalizePrompt(prompt);
+    key += '\0';
+    key += size;
+    key += '\0';
+    key += context.style;
+    return key;
+}
+
+std::shared_ptr<const ShapeBatch> GenerationCache::find(const std::string& prompt,
+                                                        const GenerationContext& context) {
+    std::string key = makeKey(prompt, context);
+    auto it = index.find(hashKey(key));
+    if (it == index.end() || it->second->key != key) {
+        stats.misses++;
+        return nullptr;
+    }
+    entries.splice(entries.begin(), entries, it->second);
+    stats.hits++;
+    return it->second->batch;
+}
+
+void GenerationCache::insert(const std::string& prompt, const GenerationContext& context,
+                             std::shared_ptr<const ShapeBatch> batch) {
+    if (!batch) {
+        return;
+    }
+    std::string key = makeKey(prompt, context);
+    uint64_t hash = hashKey(key);
+    size_t bytes = batch->getMemoryUsage() + key.capacity() + sizeof(Entry);
+    if (bytes > memoryCap) {
+        return;
+    }
+    auto it = index.find(hash);
+    if (it != index.end()) {
+        // Same key, or a colliding one: the newer result wins
+        stats.bytes -= it->second->bytes;
+        entries.erase(it->second);
+        index.erase(it);
+    }
+    entries.push_front(Entry{hash, std::move(key), std::move(batch), bytes});
+    index[hash] = entries.begin();
+    stats.bytes += bytes;
+    evict();
+    stats.entries = entries.size();
+}
+
+void GenerationCache::clear() {
+    entries.clear();
+    index.clear();
+    stats.entries = 0;
+    stats.bytes = 0;
+}
+
+void GenerationCache::setMemoryCap(size_t bytes) {
+    memoryCap = bytes;
+    evict();
+    stats.entries = entries.size();
+}
+
+void GenerationCache::evict() {
+    while (stats.bytes > memoryCap && !entries.empty()) {
+        const Entry& last = entries.back();
+        stats.bytes -= last.bytes;
+        index.erase(last.hash);
+        entries.pop_back();
+        stats.evictions++;
+    }
+}
+
+} // namespace Lienzo
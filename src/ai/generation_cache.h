@@ -0,0 +1,70 @@
+#pragma once
+
+#include "../core/svg_import.h"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace Lienzo {
+
+// What a generation result depends on besides the prompt
+struct GenerationContext {
+    double frameWidth = 0.0;
+    double frameHeight = 0.0;
+    std::string style;        // Style or palette instructions sent with the prompt
+};
+
+// Content-addressed LRU cache of parsed generation results
+//
+// Keys hash the normalized prompt (case, whitespace and trailing
+// punctuation folded) with the context, so "Draw a cat." and "draw a
+// cat" share an entry. Values are ShapeBatches, so a hit instantiates
+// nodes without touching the parser. Least recently used entries are
+// dropped once their estimated memory passes the cap.
+class GenerationCache {
+public:
+    static const size_t kDefaultMemoryCap = 16 * 1024 * 1024;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    explicit GenerationCache(size_t memoryCap = kDefaultMemoryCap);
+
+    static std::string normalizePrompt(const std::string& prompt);
+    static uint64_t hashKey(const std::string& key);
+
+    // nullptr on a miss; a hit becomes the most recently used entry
+    std::shared_ptr<const ShapeBatch> find(const std::string& prompt, const GenerationContext& context);
+    void insert(const std::string& prompt, const GenerationContext& context,
+                std::shared_ptr<const ShapeBatch> batch);
+    void clear();
+
+    void setMemoryCap(size_t bytes);
+    size_t getMemoryCap() const { return memoryCap; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    struct Entry {
+        uint64_t hash;
+        std::string key;      // Full key, to rule out hash collisions
+        std::shared_ptr<const ShapeBatch> batch;
+        size_t bytes;
+    };
+
+    size_t memoryCap;
+    std::list<Entry> entries;   // Most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+    Stats stats;
+
+    static std::string makeKey(const std::string& prompt, const GenerationContext& context);
+    void evict();
+};
+
+} // namespace Lienzo
@@ -0,0 +1,51 @@
+#include "model_stream.h"
+#include <chrono>
+#include <thread>
+
+namespace Lienzo {
+
+// What a model typically answers: prose around a fenced SVG block
+static const char* const kDefaultResponse =
+    "Here is a simple house icon:\n"
+    "```svg\n"
+    "<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"0 0 200 200\">\n"
+    "  <rect x=\"40\" y=\"90\" width=\"120\" height=\"90\" fill=\"#F4D35E\" stroke=\"#333\"/>\n"
+    "  <path d=\"M30 95 L100 30 L170 95 Z\" fill=\"#EE6352\" stroke=\"#333\"/>\n"
+    "  <rect x=\"85\" y=\"130\" width=\"30\" height=\"50\" fill=\"#7A4419\"/>\n"
+    "  <circle cx=\"130\" cy=\"120\" r=\"12\" fill=\"#A9D6E5\" stroke=\"#333\"/>\n"
+    "  <text x=\"100\" y=\"195\" font-size=\"12\" text-anchor=\"middle\">Home</text>\n"
+    "</svg>\n"
+    "```\n"
+    "Let me know if you want changes.";
+
+MockModelServer::MockModelServer()
+    : defaultResponse(kDefaultResponse), tokenSize(4), tokenDelayUs(0.0), tokensSent(0) {
+}
+
+void MockModelServer::addResponse(const std::string& keyword, const std::string& response) {
+    responses.emplace_back(keyword, response);
+}
+
+bool MockModelServer::generate(const std::string& prompt, const TokenCallback& onToken) {
+    const std::string* response = &defaultResponse;
+    for (const auto& candidate : responses) {
+        if (prompt.find(candidate.first) != std::string::npos) {
+            response = &candidate.second;
+            break;
+        }
+    }
+
+    std::string_view text(*response);
+    for (size_t offset = 0; offset < text.size(); offset += tokenSize) {
+        if (tokenDelayUs > 0.0) {
+            std::this_thread::sleep_for(std::chrono::duration<double, std::micro>(tokenDelayUs));
+        }
+        tokensSent++;
+        if (!onToken(text.substr(offset, tokenSize))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace Lienzo
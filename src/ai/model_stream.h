@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Lienzo {
+
+// A text generation model that streams its output
+class ModelBackend {
+public:
+    // Called per token as it arrives; return false to stop generation
+    using TokenCallback = std::function<bool(std::string_view token)>;
+
+    virtual ~ModelBackend() = default;
+
+    // Blocks until the response is complete or cancelled; false on failure
+    virtual bool generate(const std::string& prompt, const TokenCallback& onToken) = 0;
+};
+
+// Local stand-in for a model server, replaying canned responses
+// The first response whose keyword occurs in the prompt is streamed in
+// fixed-size tokens, optionally paced like a real model.
+class MockModelServer : public ModelBackend {
+public:
+    MockModelServer();
+
+    void addResponse(const std::string& keyword, const std::string& response);
+    void setDefaultResponse(const std::string& response) { defaultResponse = response; }
+    // Characters per token (at least 1) and delay before each token
+    void setTokenSize(size_t characters) { tokenSize = characters > 0 ? characters : 1; }
+    void setTokenDelay(double microseconds) { tokenDelayUs = microseconds; }
+
+    bool generate(const std::string& prompt, const TokenCallback& onToken) override;
+
+    size_t getTokensSent() const { return tokensSent; }
+
+private:
+    std::vector<std::pair<std::string, std::string>> responses;
+    std::string defaultResponse;
+    size_t tokenSize;
+    double tokenDelayUs;
+    size_t tokensSent;
+};
+
+} // namespace Lienzo
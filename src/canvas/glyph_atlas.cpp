@@ -0,0 +1,170 @@
+#include "glyph_atlas.h"
+#include <algorithm>
+#include <cmath>
+#include <string_view>
+
+namespace Lienzo {
+
+std::string FontDescriptor::key() const {
+    return family + "/" + std::to_string(weight) + "/" +
+           std::to_string(static_cast<int>(std::lround(size)));
+}
+
+// FallbackGlyphRasterizer implementation
+GlyphMetrics FallbackGlyphRasterizer::getMetrics(const FontDescriptor& font, char32_t codepoint) {
+    // Rough proportional widths of a sans-serif face
+    double size = std::max(1.0, std::round(font.size));
+    double factor = 0.5;
+    if (codepoint == U' ' || codepoint == U'\t') {
+        factor = 0.28;
+    } else if (std::u32string_view(U"iljtfrI.,;:'!|()[]").find(codepoint) != std::u32string_view::npos) {
+        factor = 0.3;
+    } else if (std::u32string_view(U"mwMW@%").find(codepoint) != std::u32string_view::npos) {
+        factor = 0.85;
+    } else if (codepoint >= U'A' && codepoint <= U'Z') {
+        factor = 0.65;
+    } else if (codepoint >= U'0' && codepoint <= U'9') {
+        factor = 0.55;
+    } else if (codepoint >= 0x2E80) {
+        factor = 1.0; // CJK and other full-width scripts
+    }
+    if (font.weight >= 600) {
+        factor *= 1.05;
+    }
+
+    GlyphMetrics metrics;
+    metrics.advance = static_cast<float>(size * factor);
+    if (codepoint == U' ' || codepoint == U'\t' || codepoint == U'\n') {
+        return metrics;
+    }
+    bool tall = (codepoint >= U'A' && codepoint <= U'Z') ||
+                (codepoint >= U'0' && codepoint <= U'9') || codepoint >= 0x2E80 ||
+                std::u32string_view(U"bdfhklt").find(codepoint) != std::u32string_view::npos;
+    metrics.bearingX = static_cast<int>(std::lround(size * 0.05));
+    metrics.width = std::max(1, static_cast<int>(std::lround(metrics.advance - 2 * metrics.bearingX)));
+    metrics.height = std::max(1, static_cast<int>(std::lround(size * (tall ? 0.72 : 0.5))));
+    metrics.bearingY = metrics.height;
+    return metrics;
+}
+
+void FallbackGlyphRasterizer::rasterize(const FontDescriptor& font, char32_t codepoint,
+                                        uint8_t* dst, int stride) {
+    // Placeholder glyph: outlined box
+    GlyphMetrics metrics = getMetrics(font, codepoint);
+    for (int y = 0; y < metrics.height; y++) {
+        for (int x = 0; x < metrics.width; x++) {
+            bool edge = x == 0 || y == 0 || x == metrics.width - 1 || y == metrics.height - 1;
+            dst[y * stride + x] = edge ? 255 : 48;
+        }
+    }
+}
+
+// GlyphAtlas implementation
+GlyphAtlas::GlyphAtlas(GlyphRasterizer& rasterizer, int width, int height)
+    : rasterizer(rasterizer), width(width), height(height),
+      pixels(static_cast<size_t>(width) * height, 0),
+      generation(0), glyphCount(0), rasterizedCount(0) {
+    markUploaded();
+}
+
+const AtlasGlyph* GlyphAtlas::getGlyph(const FontDescriptor& font, char32_t codepoint) {
+    return getGlyph(font.key(), font, codepoint);
+}
+
+const AtlasGlyph* GlyphAtlas::getGlyph(const std::string& fontKey, const FontDescriptor& font,
+                                       char32_t codepoint) {
+    auto& fontGlyphs = glyphs[fontKey];
+    auto it = fontGlyphs.find(codepoint);
+    if (it != fontGlyphs.end()) {
+        return &it->second;
+    }
+
+    AtlasGlyph glyph;
+    glyph.metrics = rasterizer.getMetrics(font, codepoint);
+    if (glyph.metrics.width > 0 && glyph.metrics.height > 0) {
+        if (glyph.metrics.width + 2 * kPadding > width ||
+            glyph.metrics.height + 2 * kPadding > height) {
+            return nullptr;
+        }
+        if (!allocate(glyph.metrics.width, glyph.metrics.height, glyph.x, glyph.y)) {
+            // Full: start over; glyphs still in use get re-rasterized on demand
+            reset();
+            allocate(glyph.metrics.width, glyph.metrics.height, glyph.x, glyph.y);
+        }
+        rasterizer.rasterize(font, codepoint, &pixels[static_cast<size_t>(glyph.y) * width + glyph.x],
+                             width);
+        rasterizedCount++;
+
+        glyph.u0 = static_cast<float>(glyph.x) / width;
+        glyph.v0 = static_cast<float>(glyph.y) / height;
+        glyph.u1 = static_cast<float>(glyph.x + glyph.metrics.width) / width;
+        glyph.v1 = static_cast<float>(glyph.y + glyph.metrics.height) / height;
+
+        dirtyMinX = std::min(dirtyMinX, glyph.x);
+        dirtyMinY = std::min(dirtyMinY, glyph.y);
+        dirtyMaxX = std::max(dirtyMaxX, glyph.x + glyph.metrics.width);
+        dirtyMaxY = std::max(dirtyMaxY, glyph.y + glyph.metrics.height);
+    }
+    glyphCount++;
+    // reset() may have dropped the map this glyph belongs to
+    return &(glyphs[fontKey][codepoint] = glyph);
+}
+
+bool GlyphAtlas::allocate(int w, int h, int& x, int& y) {
+    int paddedW = w + 2 * kPadding;
+    int paddedH = h + 2 * kPadding;
+
+    // Best-fitting shelf that still has room
+    Shelf* best = nullptr;
+    for (auto& shelf : shelves) {
+        if (shelf.height >= paddedH && shelf.cursorX + paddedW <= width &&
+            (!best || shelf.height < best->height)) {
+            best = &shelf;
+        }
+    }
+    if (!best) {
+        int top = shelves.empty() ? 0 : shelves.back().y + shelves.back().height;
+        if (top + paddedH > height) {
+            return false;
+        }
+        shelves.push_back(Shelf{top, paddedH, 0});
+        best = &shelves.back();
+    }
+    x = best->cursorX + kPadding;
+    y = best->y + kPadding;
+    best->cursorX += paddedW;
+    return true;
+}
+
+void GlyphAtlas::reset() {
+    std::fill(pixels.begin(), pixels.end(), 0);
+    shelves.clear();
+    glyphs.clear();
+    glyphCount = 0;
+    generation++;
+    // Everything has to be uploaded again
+    dirtyMinX = 0;
+    dirtyMinY = 0;
+    dirtyMaxX = width;
+    dirtyMaxY = height;
+}
+
+bool GlyphAtlas::getDirtyRect(int& x, int& y, int& w, int& h) const {
+    if (dirtyMaxX <= dirtyMinX || dirtyMaxY <= dirtyMinY) {
+        return false;
+    }
+    x = dirtyMinX;
+    y = dirtyMinY;
+    w = dirtyMaxX - dirtyMinX;
+    h = dirtyMaxY - dirtyMinY;
+    return true;
+}
+
+void GlyphAtlas::markUploaded() {
+    dirtyMinX = width;
+    dirtyMinY = height;
+    dirtyMaxX = 0;
+    dirtyMaxY = 0;
+}
+
+} // namespace Lienzo
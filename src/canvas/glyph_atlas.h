@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Lienzo {
+
+// Font selection for text layout and glyph rasterization
+struct FontDescriptor {
+    std::string family = "sans-serif";
+    double size = 16.0;       // Pixels
+    int weight = 400;
+    double lineHeight = 1.25; // Multiple of size
+
+    // Stable cache key; sizes are bucketed to whole pixels
+    std::string key() const;
+};
+
+// Horizontal metrics and bitmap bounds of one glyph, in pixels
+struct GlyphMetrics {
+    float advance = 0.0f;
+    int width = 0;            // Bitmap size (0 for blank glyphs such as space)
+    int height = 0;
+    int bearingX = 0;         // Bitmap offset from the pen position
+    int bearingY = 0;         // Distance from the baseline up to the bitmap top
+};
+
+// Source of glyph metrics and 8-bit coverage bitmaps
+// The browser build can supply one backed by canvas fillText; the built-in
+// FallbackGlyphRasterizer only approximates metrics and draws box glyphs.
+class GlyphRasterizer {
+public:
+    virtual ~GlyphRasterizer() = default;
+
+    virtual GlyphMetrics getMetrics(const FontDescriptor& font, char32_t codepoint) = 0;
+    // Write metrics.width x metrics.height coverage values starting at dst
+    virtual void rasterize(const FontDescriptor& font, char32_t codepoint,
+                           uint8_t* dst, int stride) = 0;
+};
+
+class FallbackGlyphRasterizer : public GlyphRasterizer {
+public:
+    GlyphMetrics getMetrics(const FontDescriptor& font, char32_t codepoint) override;
+    void rasterize(const FontDescriptor& font, char32_t codepoint,
+                   uint8_t* dst, int stride) override;
+};
+
+// Glyph location in the atlas texture
+struct AtlasGlyph {
+    GlyphMetrics metrics;
+    int x = 0;                // Top-left texel
+    int y = 0;
+    float u0 = 0.0f, v0 = 0.0f, u1 = 0.0f, v1 = 0.0f;
+};
+
+// Single-channel coverage texture shared by every text node
+//
+// Glyphs are rasterized once per (font, codepoint) and packed into shelves
+// (rows as tall as their tallest glyph). When the texture is full it is
+// cleared and refilled on demand; getGeneration() changes when that
+// happens so cached texture coordinates can be dropped. getDirtyRect()
+// covers the texels written since the last markUploaded(), so only that
+// part has to be re-uploaded to the GPU.
+class GlyphAtlas {
+public:
+    GlyphAtlas(GlyphRasterizer& rasterizer, int width = 1024, int height = 1024);
+
+    // Rasterizes and packs the glyph on first use; nullptr if it can never fit.
+    // Returned pointers stay valid until the generation changes.
+    const AtlasGlyph* getGlyph(const FontDescriptor& font, char32_t codepoint);
+    const AtlasGlyph* getGlyph(const std::string& fontKey, const FontDescriptor& font,
+                               char32_t codepoint);
+
+    const std::vector<uint8_t>& getPixels() const { return pixels; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    uint64_t getGeneration() const { return generation; }
+
+    // Texels changed since the last upload; false if there are none
+    bool getDirtyRect(int& x, int& y, int& w, int& h) const;
+    void markUploaded();
+
+    // Statistics
+    size_t getGlyphCount() const { return glyphCount; }
+    size_t getRasterizedCount() const { return rasterizedCount; }
+
+private:
+    struct Shelf {
+        int y;
+        int height;
+        int cursorX;
+    };
+
+    GlyphRasterizer& rasterizer;
+    int width;
+    int height;
+    std::vector<uint8_t> pixels;
+    std::vector<Shelf> shelves;
+    // font key -> codepoint -> glyph
+    std::unordered_map<std::string, std::unordered_map<char32_t, AtlasGlyph>> glyphs;
+    uint64_t generation;
+    size_t glyphCount;
+    size_t rasterizedCount;
+    int dirtyMinX, dirtyMinY, dirtyMaxX, dirtyMaxY;
+
+    static const int kPadding = 1; // Keeps bilinear sampling off neighbours
+
+    bool allocate(int w, int h, int& x, int& y);
+    void reset();
+};
+
+} // namespace Lienzo
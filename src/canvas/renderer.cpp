@@ -1,20 +1,48 @@
 #include "renderer.h"
+#include "../core/profiler.h"
 
 namespace Lienzo {
 
-Renderer::Renderer() {
+Renderer::Renderer() : glyphAtlas(glyphRasterizer), textLayout(glyphRasterizer) {
 }
 
 Renderer::~Renderer() {
 }
 
 void Renderer::renderFrame(const Frame& frame) {
+    LIENZO_PROFILE_SCOPE("Renderer::renderFrame");
     // TODO: Implement rendering
 }
 
 void Renderer::clear() {
+    LIENZO_PROFILE_SCOPE("Renderer::clear");
     // TODO: Implement clear
 }
 
+const TextLayout& Renderer::prepareText(const CRDTNode& node, double width,
+                                        const FontDescriptor& font) {
+    LIENZO_PROFILE_SCOPE("Renderer::prepareText");
+    const TextLayout& layout = textLayout.layout(node, width, font);
+    auto& prepared = preparedText[node.getId().toString()];
+    if (prepared.first == layout.revision && prepared.second == glyphAtlas.getGeneration()) {
+        return layout;
+    }
+    
+    std::string fontKey = font.key();
+    uint64_t generation = glyphAtlas.getGeneration();
+    for (const auto& paragraph : layout.paragraphs) {
+        for (const auto& glyph : paragraph.layout->glyphs) {
+            glyphAtlas.getGlyph(fontKey, font, glyph.codepoint);
+        }
+    }
+    // An atlas reset halfway through dropped the earlier glyphs; redo next time
+    if (glyphAtlas.getGeneration() == generation) {
+        prepared = {layout.revision, generation};
+    } else {
+        prepared = {0, 0};
+    }
+    return layout;
+}
+
 } // namespace Lienzo
 
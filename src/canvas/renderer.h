@@ -1,6 +1,10 @@
 #pragma once
 
 #include "../core/frame.h"
+#include "glyph_atlas.h"
+#include "text_layout.h"
+#include <string>
+#include <unordered_map>
 
 namespace Lienzo {
 
@@ -12,8 +16,20 @@ public:
     void renderFrame(const Frame& frame);
     void clear();
     
+    // Lay out a text node and make sure its glyphs are in the atlas.
+    // Glyphs are only looked up again when the layout or atlas changed.
+    const TextLayout& prepareText(const CRDTNode& node, double width, const FontDescriptor& font);
+    
+    GlyphAtlas& getGlyphAtlas() { return glyphAtlas; }
+    TextLayoutEngine& getTextLayout() { return textLayout; }
+    
 private:
     // Rendering state
+    FallbackGlyphRasterizer glyphRasterizer;
+    GlyphAtlas glyphAtlas;
+    TextLayoutEngine textLayout;
+    // node id -> (layout revision, atlas generation) whose glyphs are packed
+    std::unordered_map<std::string, std::pair<uint64_t, uint64_t>> preparedText;
 };
 
 } // namespace Lienzo
@@ -0,0 +1,202 @@
+#include "text_layout.h"
+#include "../collaboration/text_sequence.h"
+#include <algorithm>
+#include <limits>
+
+namespace Lienzo {
+
+static bool isBreakAfter(char32_t c) {
+    // Spaces, and full-width scripts that wrap between any two characters
+    return c == U' ' || c == U'\t' || c >= 0x2E80;
+}
+
+static bool isSpace(char32_t c) {
+    return c == U' ' || c == U'\t';
+}
+
+TextLayoutEngine::TextLayoutEngine(GlyphRasterizer& rasterizer)
+    : rasterizer(rasterizer), paragraphsLaidOut(0), paragraphsReused(0), layoutHits(0),
+      nextRevision(1) {
+}
+
+const TextLayout& TextLayoutEngine::layout(const CRDTNode& node, double width,
+                                           const FontDescriptor& font) {
+    std::string key = node.getId().toString();
+    const TextSequence* text = node.getText();
+    if (!text) {
+        // Documents from before text editing stored a plain property
+        auto prop = node.getProperties().find("text");
+        if (prop == node.getProperties().end()) {
+            return layout(key, 0, std::string(), width, font);
+        }
+        return layout(key, prop->second.timestamp.logicalClock ^
+                           std::hash<std::string>()(prop->second.timestamp.siteId),
+                      prop->second.value, width, font);
+    }
+
+    Entry& entry = entries[key];
+    if (entry.source == text && entry.version == text->getVersion() &&
+        entry.width == width && entry.fontKey == font.key()) {
+        layoutHits++;
+        return entry.layout;
+    }
+    entry.source = text;
+    entry.version = text->getVersion();
+    rebuild(entry, text->toString(), width, font);
+    return entry.layout;
+}
+
+const TextLayout& TextLayoutEngine::layout(const std::string& key, uint64_t version,
+                                           const std::string& text, double width,
+                                           const FontDescriptor& font) {
+    Entry& entry = entries[key];
+    if (entry.source == nullptr && entry.version == version && entry.layout.revision != 0 &&
+        entry.width == width && entry.fontKey == font.key()) {
+        layoutHits++;
+        return entry.layout;
+    }
+    entry.source = nullptr;
+    entry.version = version;
+    rebuild(entry, text, width, font);
+    return entry.layout;
+}
+
+void TextLayoutEngine::evict(const std::string& key) {
+    entries.erase(key);
+}
+
+void TextLayoutEngine::clear() {
+    entries.clear();
+}
+
+void TextLayoutEngine::rebuild(Entry& entry, const std::string& text, double width,
+                               const FontDescriptor& font) {
+    std::string fontKey = font.key();
+    // Paragraph layouts only carry over while the box and font are the same
+    std::unordered_map<uint64_t, std::shared_ptr<const ParagraphLayout>> previous;
+    if (entry.width == width && entry.fontKey == fontKey) {
+        previous.swap(entry.paragraphs);
+    }
+    entry.paragraphs.clear();
+    entry.width = width;
+    entry.fontKey = fontKey;
+
+    auto& fontAdvances = advances[fontKey];
+    TextLayout& result = entry.layout;
+    result = TextLayout();
+    result.revision = nextRevision++;
+    result.lineHeight = static_cast<float>(font.size * font.lineHeight);
+    result.ascent = static_cast<float>(font.size * 0.8 + (result.lineHeight - font.size) / 2);
+
+    std::u32string chars = TextSequence::decodeUtf8(text);
+    size_t start = 0;
+    float y = 0.0f;
+    while (start <= chars.size()) {
+        size_t end = chars.find(U'\n', start);
+        if (end == std::u32string::npos) {
+            end = chars.size();
+        }
+        uint64_t hash = hashParagraph(chars.data() + start, end - start);
+        auto find = [&](const std::unordered_map<uint64_t, std::shared_ptr<const ParagraphLayout>>& from) {
+            auto it = from.find(hash);
+            if (it != from.end() &&
+                it->second->text.compare(0, std::u32string::npos, chars, start, end - start) == 0) {
+                return it->second;
+            }
+            return std::shared_ptr<const ParagraphLayout>();
+        };
+        // Repeated paragraphs in this text, then paragraphs of the previous text
+        std::shared_ptr<const ParagraphLayout> paragraph = find(entry.paragraphs);
+        if (!paragraph) {
+            paragraph = find(previous);
+        }
+        if (paragraph) {
+            paragraphsReused++;
+        } else {
+            paragraph = breakLines(chars.substr(start, end - start), width, font, fontAdvances);
+            paragraphsLaidOut++;
+        }
+        entry.paragraphs[hash] = paragraph;
+
+        result.paragraphs.push_back(TextLayout::Paragraph{paragraph, y});
+        y += paragraph->height;
+        result.lineCount += paragraph->lines.size();
+        for (const auto& line : paragraph->lines) {
+            result.width = std::max(result.width, line.width);
+        }
+        start = end + 1;
+    }
+    result.height = y;
+}
+
+std::shared_ptr<const ParagraphLayout> TextLayoutEngine::breakLines(
+        std::u32string text, double width, const FontDescriptor& font,
+        std::unordered_map<char32_t, float>& fontAdvances) {
+    auto advanceOf = [&](char32_t c) {
+        auto it = fontAdvances.find(c);
+        if (it != fontAdvances.end()) {
+            return it->second;
+        }
+        float advance = rasterizer.getMetrics(font, c).advance;
+        fontAdvances.emplace(c, advance);
+        return advance;
+    };
+    auto paragraph = std::make_shared<ParagraphLayout>();
+    float maxWidth = width > 0 ? static_cast<float>(width) : std::numeric_limits<float>::infinity();
+    auto& glyphs = paragraph->glyphs;
+    auto& lines = paragraph->lines;
+    glyphs.reserve(text.size());
+
+    auto finishLine = [&](uint32_t start, uint32_t end) {
+        // Trailing spaces hang past the edge and do not count
+        uint32_t visibleEnd = end;
+        while (visibleEnd > start && isSpace(glyphs[visibleEnd - 1].codepoint)) {
+            visibleEnd--;
+        }
+        float lineWidth = visibleEnd > start
+            ? glyphs[visibleEnd - 1].x + advanceOf(glyphs[visibleEnd - 1].codepoint) : 0.0f;
+        lines.push_back(ParagraphLayout::Line{start, end, lineWidth});
+    };
+
+    float x = 0.0f;
+    uint32_t lineStart = 0;
+    uint32_t lastBreak = 0;   // First glyph after the latest break opportunity
+    for (uint32_t i = 0; i < text.size(); i++) {
+        char32_t c = text[i];
+        float advance = advanceOf(c);
+        while (!isSpace(c) && x + advance > maxWidth && i > lineStart) {
+            // Wrap at the last break opportunity, or mid-word if there is none
+            uint32_t breakAt = lastBreak > lineStart ? lastBreak : i;
+            finishLine(lineStart, breakAt);
+            float shift = breakAt < i ? glyphs[breakAt].x : x;
+            for (uint32_t k = breakAt; k < i; k++) {
+                glyphs[k].x -= shift;
+                glyphs[k].line = static_cast<uint32_t>(lines.size());
+            }
+            x -= shift;
+            lineStart = breakAt;
+        }
+        glyphs.push_back(PositionedGlyph{c, x, static_cast<uint32_t>(lines.size())});
+        x += advance;
+        if (isBreakAfter(c)) {
+            lastBreak = i + 1;
+        }
+    }
+    finishLine(lineStart, static_cast<uint32_t>(glyphs.size()));
+
+    paragraph->height = static_cast<float>(lines.size() * font.size * font.lineHeight);
+    paragraph->text = std::move(text);
+    return paragraph;
+}
+
+uint64_t TextLayoutEngine::hashParagraph(const char32_t* chars, size_t count) {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < count; i++) {
+        hash ^= static_cast<uint64_t>(chars[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+} // namespace Lienzo
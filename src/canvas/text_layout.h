@@ -0,0 +1,105 @@
+#pragma once
+
+#include "glyph_atlas.h"
+#include "../collaboration/crdt.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Lienzo {
+
+// Glyph placed on a line, relative to its paragraph
+struct PositionedGlyph {
+    char32_t codepoint;
+    float x;
+    uint32_t line;
+};
+
+// Line-broken layout of one paragraph (text between newlines)
+struct ParagraphLayout {
+    struct Line {
+        uint32_t start;   // Glyph range [start, end)
+        uint32_t end;
+        float width;      // Without trailing spaces
+    };
+
+    std::u32string text;
+    std::vector<PositionedGlyph> glyphs;
+    std::vector<Line> lines;
+    float height = 0.0f;
+};
+
+// Layout of a whole text node: paragraphs stacked top to bottom
+// Paragraph layouts are shared with the cache, so unchanged paragraphs
+// cost nothing when the text is edited elsewhere.
+struct TextLayout {
+    struct Paragraph {
+        std::shared_ptr<const ParagraphLayout> layout;
+        float y;
+    };
+
+    std::vector<Paragraph> paragraphs;
+    float width = 0.0f;       // Widest line
+    float height = 0.0f;
+    float lineHeight = 0.0f;
+    float ascent = 0.0f;      // Baseline offset from the top of a line
+    size_t lineCount = 0;
+    uint64_t revision = 0;    // Changes whenever the layout is rebuilt
+};
+
+// Greedy line breaking for "text" nodes, cached per node
+//
+// A node's layout is reused as long as its text version, box width and
+// font are unchanged. When the text changes, paragraphs whose content is
+// the same as before (and width/font unchanged) keep their layout; only
+// edited or new paragraphs are broken into lines again.
+class TextLayoutEngine {
+public:
+    explicit TextLayoutEngine(GlyphRasterizer& rasterizer);
+
+    // Layout of a text node's content (its TextSequence, or the plain
+    // "text" property of older documents)
+    const TextLayout& layout(const CRDTNode& node, double width, const FontDescriptor& font);
+    // Layout of arbitrary text cached under key; version must change with text
+    const TextLayout& layout(const std::string& key, uint64_t version, const std::string& text,
+                             double width, const FontDescriptor& font);
+
+    void evict(const std::string& key);
+    void clear();
+
+    // Statistics
+    size_t getParagraphsLaidOut() const { return paragraphsLaidOut; }
+    size_t getParagraphsReused() const { return paragraphsReused; }
+    size_t getLayoutHits() const { return layoutHits; }
+    size_t getCachedNodeCount() const { return entries.size(); }
+
+private:
+    struct Entry {
+        const void* source = nullptr;   // TextSequence the version belongs to
+        uint64_t version = 0;
+        double width = 0.0;
+        std::string fontKey;
+        TextLayout layout;
+        // Paragraph layouts of the current text, by content hash
+        std::unordered_map<uint64_t, std::shared_ptr<const ParagraphLayout>> paragraphs;
+    };
+
+    GlyphRasterizer& rasterizer;
+    std::unordered_map<std::string, Entry> entries;
+    // font key -> codepoint -> advance
+    std::unordered_map<std::string, std::unordered_map<char32_t, float>> advances;
+    size_t paragraphsLaidOut;
+    size_t paragraphsReused;
+    size_t layoutHits;
+    uint64_t nextRevision;
+
+    void rebuild(Entry& entry, const std::string& text, double width, const FontDescriptor& font);
+    std::shared_ptr<const ParagraphLayout> breakLines(std::u32string text, double width,
+                                                     const FontDescriptor& font,
+                                                     std::unordered_map<char32_t, float>& fontAdvances);
+    static uint64_t hashParagraph(const char32_t* chars, size_t count);
+};
+
+} // namespace Lienzo
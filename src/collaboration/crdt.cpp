@@ -1,34 +1,177 @@
 #include "crdt.h"
+#include "crdt_codec.h"
+#include "../core/profiler.h"
+#include "text_sequence.h"
 #include <sstream>
 #include <algorithm>
+#include <charconv>
+#include <chrono>
 #include <cstdlib>
 #include <ctime>
+#include <map>
+#include <unordered_set>
 
 namespace Lienzo {
 
+CRDTId CRDTId::fromString(std::string_view str) {
+    // Site IDs may contain ':', the clock never does
+    size_t colon = str.rfind(':');
+    if (colon == std::string_view::npos || colon + 1 == str.size()) {
+        return CRDTId();
+    }
+    uint64_t clock = 0;
+    const char* end = str.data() + str.size();
+    auto parsed = std::from_chars(str.data() + colon + 1, end, clock);
+    if (parsed.ec != std::errc() || parsed.ptr != end) {
+        return CRDTId();
+    }
+    return CRDTId(std::string(str.substr(0, colon)), clock);
+}
+
+// CRDTOperation factories
+CRDTOperation CRDTOperation::createNode(const CRDTId& id, const std::string& nodeType) {
+    CRDTOperation op;
+    op.type = CRDTOperationType::CreateNode;
+    op.timestamp = id;
+    op.nodeId = id;
+    op.key = nodeType;
+    return op;
+}
+
+CRDTOperation CRDTOperation::deleteNode(const CRDTId& id, const CRDTId& timestamp) {
+    CRDTOperation op;
+    op.type = CRDTOperationType::DeleteNode;
+    op.timestamp = timestamp;
+    op.nodeId = id;
+    return op;
+}
+
+CRDTOperation CRDTOperation::restoreNode(const CRDTId& id, const CRDTId& timestamp) {
+    CRDTOperation op;
+    op.type = CRDTOperationType::RestoreNode;
+    op.timestamp = timestamp;
+    op.nodeId = id;
+    return op;
+}
+
+CRDTOperation CRDTOperation::setProperty(const CRDTId& id, const std::string& key,
+                                         const std::string& value, const CRDTId& timestamp) {
+    CRDTOperation op;
+    op.type = CRDTOperationType::SetProperty;
+    op.timestamp = timestamp;
+    op.nodeId = id;
+    op.key = key;
+    op.value = value;
+    return op;
+}
+
+CRDTOperation CRDTOperation::addChild(const CRDTId& parentId, const CRDTId& childId,
+                                      const CRDTId& timestamp) {
+    CRDTOperation op;
+    op.type = CRDTOperationType::AddChild;
+    op.timestamp = timestamp;
+    op.nodeId = parentId;
+    op.childId = childId;
+    return op;
+}
+
+CRDTOperation CRDTOperation::removeChild(const CRDTId& parentId, const CRDTId& childId,
+                                         const CRDTId& timestamp) {
+    CRDTOperation op;
+    op.type = CRDTOperationType::RemoveChild;
+    op.timestamp = timestamp;
+    op.nodeId = parentId;
+    op.childId = childId;
+    return op;
+}
+
+CRDTOperation CRDTOperation::insertText(const CRDTId& nodeId, const CRDTId& first,
+                                         const CRDTId& origin, const std::string& text) {
+    CRDTOperation op;
+    op.type = CRDTOperationType::InsertText;
+    op.timestamp = first;
+    op.nodeId = nodeId;
+    op.childId = origin;
+    op.value = text;
+    return op;
+}
+
+CRDTOperation CRDTOperation::deleteText(const CRDTId& nodeId, const CRDTId& first, size_t count) {
+    CRDTOperation op;
+    op.type = CRDTOperationType::DeleteText;
+    op.timestamp = first;
+    op.nodeId = nodeId;
+    op.childId = CRDTId(first.siteId, first.logicalClock + count - 1);
+    return op;
+}
+
+CRDTOperation CRDTOperation::cloneSubtree(const CRDTId& sourceId, const CRDTId& first, const CRDTId& last,
+                                          uint64_t sourceDigest) {
+    CRDTOperation op;
+    op.type = CRDTOperationType::CloneSubtree;
+    op.timestamp = first;
+    op.nodeId = sourceId;
+    op.childId = last;
+    op.value = std::to_string(sourceDigest);
+    return op;
+}
+
 // CRDTNode implementation
-CRDTNode::CRDTNode(const CRDTId& id, const std::string& type)
-    : id(id), type(type), deleted(false), deletedTimestamp() {
+CRDTNode::CRDTNode(const CRDTId& id, const std::string& type, const allocator_type& alloc)
+    : id(id), type(type), deleted(false), deletedTimestamp(),
+      properties(alloc), children(alloc) {
+}
+
+CRDTNode::CRDTNode(const CRDTNode& other, const allocator_type& alloc)
+    : id(other.id), type(other.type), deleted(other.deleted),
+      deletedTimestamp(other.deletedTimestamp),
+      properties(other.properties, alloc), children(other.children, alloc),
+      text(other.text ? std::make_unique<TextSequence>(*other.text, alloc) : nullptr) {
 }
 
-void CRDTNode::markDeleted(const CRDTId& timestamp) {
-    if (!deleted || timestamp.logicalClock > deletedTimestamp.logicalClock ||
-        (timestamp.logicalClock == deletedTimestamp.logicalClock && 
+CRDTNode::~CRDTNode() = default;
+
+TextSequence& CRDTNode::ensureText() {
+    if (!text) {
+        text = std::make_unique<TextSequence>(allocator_type(properties.get_allocator().resource()));
+    }
+    return *text;
+}
+
+bool CRDTNode::markDeleted(const CRDTId& timestamp) {
+    // A restore stamped later keeps the node
+    if (timestamp.logicalClock > deletedTimestamp.logicalClock ||
+        (timestamp.logicalClock == deletedTimestamp.logicalClock &&
          timestamp.siteId > deletedTimestamp.siteId)) {
         deleted = true;
         deletedTimestamp = timestamp;
+        return true;
     }
+    return false;
 }
 
-void CRDTNode::setProperty(const std::string& key, const std::string& value, 
+bool CRDTNode::restore(const CRDTId& timestamp) {
+    if (timestamp.logicalClock > deletedTimestamp.logicalClock ||
+        (timestamp.logicalClock == deletedTimestamp.logicalClock &&
+         timestamp.siteId > deletedTimestamp.siteId)) {
+        deleted = false;
+        deletedTimestamp = timestamp;
+        return true;
+    }
+    return false;
+}
+
+bool CRDTNode::setProperty(const std::string& key, const std::string& value,
                            const CRDTId& timestamp) {
     auto it = properties.find(key);
     if (it != properties.end()) {
+        CRDTId previous = it->second.timestamp;
         CRDTProperty<std::string> prop(value, timestamp);
         it->second.merge(prop);
-    } else {
-        properties[key] = CRDTProperty<std::string>(value, timestamp);
+        return it->second.timestamp != previous;
     }
+    properties[key] = CRDTProperty<std::string>(value, timestamp);
+    return true;
 }
 
 std::string CRDTNode::getProperty(const std::string& key) const {
@@ -41,44 +184,84 @@ std::string CRDTNode::getProperty(const std::string& key) const {
 
 bool CRDTNode::hasProperty(const std::string& key) const {
     auto it = properties.find(key);
-    return it != properties.end() && !it->second.timestamp.siteId.empty();
+    return it != properties.end() && !it->second.timestamp.siteId.empty() && !it->second.value.empty();
 }
 
-void CRDTNode::addChild(const CRDTId& childId, const CRDTId& timestamp) {
-    // Check if child already exists
-    for (auto& child : children) {
-        if (child.childId == childId) {
-            // Re-add if it was deleted
-            if (child.deleted) {
-                if (timestamp.logicalClock > child.deletedTimestamp.logicalClock ||
-                    (timestamp.logicalClock == child.deletedTimestamp.logicalClock &&
-                     timestamp.siteId > child.deletedTimestamp.siteId)) {
-                    child.deleted = false;
-                    child.addedTimestamp = timestamp;
-                    child.deletedTimestamp = CRDTId();
-                }
-            }
-            return;
+namespace {
+
+// Last-Write-Wins order: clock first, then site
+bool isLater(const CRDTId& a, const CRDTId& b) {
+    return a.logicalClock > b.logicalClock ||
+           (a.logicalClock == b.logicalClock && a.siteId > b.siteId);
+}
+
+bool isBefore(const CRDTNode::ChildEntry& a, const CRDTNode::ChildEntry& b) {
+    if (a.addedTimestamp != b.addedTimestamp) {
+        return isLater(b.addedTimestamp, a.addedTimestamp);
+    }
+    return a.childId < b.childId;
+}
+
+} // namespace
+
+void CRDTNode::insertChildEntry(const ChildEntry& entry) {
+    // New entries usually carry the latest timestamp: search from the end
+    auto it = children.end();
+    while (it != children.begin() && isBefore(entry, *(it - 1))) {
+        --it;
+    }
+    children.insert(it, entry);
+}
+
+bool CRDTNode::addChild(const CRDTId& childId, const CRDTId& timestamp) {
+    for (auto it = children.begin(); it != children.end(); ++it) {
+        if (it->childId != childId) {
+            continue;
         }
+        // The latest add places the entry; it is live unless a later
+        // removal has been seen
+        if (!isLater(timestamp, it->addedTimestamp)) {
+            return false;
+        }
+        ChildEntry entry = *it;
+        entry.addedTimestamp = timestamp;
+        entry.deleted = isLater(entry.deletedTimestamp, timestamp);
+        children.erase(it);
+        insertChildEntry(entry);
+        return true;
     }
-    
-    // Add new child
-    children.push_back(ChildEntry(childId, timestamp));
+
+    insertChildEntry(ChildEntry(childId, timestamp));
+    return true;
 }
 
-void CRDTNode::removeChild(const CRDTId& childId, const CRDTId& timestamp) {
+bool CRDTNode::removeChild(const CRDTId& childId, const CRDTId& timestamp) {
     for (auto& child : children) {
         if (child.childId == childId) {
-            if (!child.deleted || 
-                timestamp.logicalClock > child.deletedTimestamp.logicalClock ||
-                (timestamp.logicalClock == child.deletedTimestamp.logicalClock &&
-                 timestamp.siteId > child.deletedTimestamp.siteId)) {
-                child.deleted = true;
-                child.deletedTimestamp = timestamp;
+            if (!isLater(timestamp, child.deletedTimestamp)) {
+                return false;
             }
-            return;
+            child.deletedTimestamp = timestamp;
+            child.deleted = isLater(timestamp, child.addedTimestamp);
+            return true;
         }
     }
+    return false;
+}
+
+void CRDTNode::appendChildEntry(const ChildEntry& entry) {
+    insertChildEntry(entry);
+}
+
+void CRDTNode::copyContent(const CRDTNode& source, const CRDTId& timestamp) {
+    properties.reserve(source.properties.size());
+    for (const auto& prop : source.properties) {
+        properties.emplace(prop.first, CRDTProperty<std::string>(prop.second.value, timestamp));
+    }
+    if (source.text && source.text->length() > 0) {
+        ensureText().integrateInsert(CRDTId(timestamp.siteId, timestamp.logicalClock + 1), CRDTId(),
+                                     TextSequence::decodeUtf8(source.text->toString()));
+    }
 }
 
 std::vector<CRDTId> CRDTNode::getChildren() const {
@@ -91,16 +274,93 @@ std::vector<CRDTId> CRDTNode::getChildren() const {
     return result;
 }
 
+bool CRDTNode::applyOperation(const CRDTOperation& op) {
+    switch (op.type) {
+        case CRDTOperationType::DeleteNode:
+            return markDeleted(op.timestamp);
+        case CRDTOperationType::RestoreNode:
+            return restore(op.timestamp);
+        case CRDTOperationType::SetProperty:
+            return setProperty(op.key, op.value, op.timestamp);
+        case CRDTOperationType::AddChild:
+            return addChild(op.childId, op.timestamp);
+        case CRDTOperationType::RemoveChild:
+            // A removal may arrive before the matching add; record the
+            // tombstone so the later add loses against it
+            if (!removeChild(op.childId, op.timestamp)) {
+                for (const auto& child : children) {
+                    if (child.childId == op.childId) {
+                        return false;
+                    }
+                }
+                insertChildEntry(ChildEntry(op.childId, CRDTId()));
+                return removeChild(op.childId, op.timestamp);
+            }
+            return true;
+        case CRDTOperationType::InsertText:
+            return ensureText().integrateInsert(op.timestamp, op.childId,
+                                                TextSequence::decodeUtf8(op.value));
+        case CRDTOperationType::DeleteText:
+            if (op.childId.siteId != op.timestamp.siteId ||
+                op.childId.logicalClock < op.timestamp.logicalClock) {
+                return false;
+            }
+            return ensureText().integrateDelete(
+                op.timestamp, static_cast<size_t>(op.childId.logicalClock - op.timestamp.logicalClock + 1));
+        case CRDTOperationType::CreateNode:
+        case CRDTOperationType::CloneSubtree:
+            break;
+    }
+    return false;
+}
+
+std::vector<CRDTOperation> CRDTNode::toOperations() const {
+    std::vector<CRDTOperation> ops;
+    ops.reserve(1 + properties.size() + children.size());
+    ops.push_back(CRDTOperation::createNode(id, type));
+    for (const auto& prop : properties) {
+        ops.push_back(CRDTOperation::setProperty(id, prop.first, prop.second.value,
+                                                 prop.second.timestamp));
+    }
+    for (const auto& child : children) {
+        ops.push_back(CRDTOperation::addChild(id, child.childId, child.addedTimestamp));
+        if (child.deleted) {
+            ops.push_back(CRDTOperation::removeChild(id, child.childId, child.deletedTimestamp));
+        }
+    }
+    if (text) {
+        // Runs in document order, so every origin precedes its use
+        auto runs = text->getRuns();
+        for (const auto& run : runs) {
+            ops.push_back(CRDTOperation::insertText(id, run.id, run.origin,
+                                                    TextSequence::encodeUtf8(run.chars)));
+        }
+        for (const auto& run : runs) {
+            if (run.deleted) {
+                ops.push_back(CRDTOperation::deleteText(id, run.id, run.chars.size()));
+            }
+        }
+    }
+    if (deleted) {
+        ops.push_back(CRDTOperation::deleteNode(id, deletedTimestamp));
+    } else if (!deletedTimestamp.siteId.empty()) {
+        ops.push_back(CRDTOperation::restoreNode(id, deletedTimestamp));
+    }
+    return ops;
+}
+
 void CRDTNode::merge(const CRDTNode& other) {
     if (other.id != id || other.type != type) {
         return; // Can only merge nodes with same ID and type
     }
-    
+
     // Merge deletion state
     if (other.deleted) {
         markDeleted(other.deletedTimestamp);
+    } else if (!other.deletedTimestamp.siteId.empty()) {
+        restore(other.deletedTimestamp);
     }
-    
+
     // Merge properties (LWW)
     for (const auto& prop : other.properties) {
         auto it = properties.find(prop.first);
@@ -110,25 +370,32 @@ void CRDTNode::merge(const CRDTNode& other) {
             properties[prop.first] = prop.second;
         }
     }
-    
+
+    if (other.text) {
+        ensureText().merge(*other.text);
+    }
+
     // Merge children
     // For simplicity, we merge all child entries and let getChildren() filter deleted ones
+    if (children.empty()) {
+        children.assign(other.children.begin(), other.children.end());
+        return;
+    }
     for (const auto& otherChild : other.children) {
         bool found = false;
         for (auto& child : children) {
             if (child.childId == otherChild.childId) {
                 // Merge child state
+                addChild(otherChild.childId, otherChild.addedTimestamp);
                 if (otherChild.deleted) {
                     removeChild(otherChild.childId, otherChild.deletedTimestamp);
-                } else {
-                    addChild(otherChild.childId, otherChild.addedTimestamp);
                 }
                 found = true;
                 break;
             }
         }
         if (!found) {
-            children.push_back(otherChild);
+            insertChildEntry(otherChild);
         }
     }
 }
@@ -143,48 +410,247 @@ void CRDTNode::deserialize(const std::string& data) {
 }
 
 // CRDTDocument implementation
+const char CRDTDocument::kSnapshotMagic[4] = {'L', 'N', 'Z', 'S'};
+
 CRDTDocument::CRDTDocument(const std::string& siteId)
-    : siteId(siteId), logicalClock(0) {
+    : memory(std::make_unique<DocumentMemoryResource>()),
+      siteId(siteId), logicalClock(0), rootId(sharedRootId()),
+      nodes(memory.get()), nextListenerHandle(1), batchDepth(0),
+      expandingClone(false), localChanged(false), lastRemoteClock(nullptr) {
     // Create root node
-    rootId = generateId();
-    auto root = std::make_shared<CRDTNode>(rootId, "root");
-    nodes[rootId.toString()] = root;
+    nodes[rootId.toString()] = allocateNode(rootId, "root");
+}
+
+std::shared_ptr<CRDTNode> CRDTDocument::allocateNode(const CRDTId& id, const std::string& type) {
+    // Node, shared_ptr control block and containers all come from the arena;
+    // polymorphic_allocator passes itself on to CRDTNode's containers
+    return std::allocate_shared<CRDTNode>(
+        std::pmr::polymorphic_allocator<CRDTNode>(memory.get()), id, type);
+}
+
+void CRDTDocument::reserve(size_t nodeCount) {
+    nodes.reserve(nodeCount);
+}
+
+DocumentMemoryUsage CRDTDocument::getMemoryUsage() const {
+    DocumentMemoryUsage usage;
+    usage.nodeCount = nodes.size();
+    usage.bytesInUse = memory->getBytesInUse();
+    usage.peakBytesInUse = memory->getPeakBytesInUse();
+    usage.bytesReserved = memory->getBytesReserved();
+    usage.allocationCount = memory->getAllocationCount();
+    return usage;
+}
+
+DocumentMetrics CRDTDocument::getMetrics() const {
+    DocumentMetrics metrics;
+    metrics.counters = counters;
+    metrics.memory = getMemoryUsage();
+    metrics.residentNodes = nodes.size();
+    metrics.logicalClock = logicalClock;
+
+    // Consecutive nodes mostly share a type, so the last entry is
+    // remembered instead of hashing every type
+    std::map<std::string, size_t> types;
+    const std::string* lastType = nullptr;
+    size_t* lastTypeCount = nullptr;
+    for (const auto& pair : nodes) {
+        const CRDTNode& node = *pair.second;
+        if (node.isDeleted()) {
+            metrics.deletedNodes++;
+        } else {
+            metrics.liveNodes++;
+            if (!lastType || node.getType() != *lastType) {
+                auto it = types.try_emplace(node.getType(), 0).first;
+                lastType = &it->first;
+                lastTypeCount = &it->second;
+            }
+            (*lastTypeCount)++;
+        }
+        metrics.properties += node.getProperties().size();
+        for (const auto& child : node.getChildEntries()) {
+            (child.deleted ? metrics.removedChildEntries : metrics.liveChildEntries)++;
+        }
+        if (const TextSequence* text = node.getText()) {
+            metrics.textCharacters += text->length();
+            metrics.textRuns += text->getRunCount();
+        }
+    }
+    metrics.liveNodesByType.assign(types.begin(), types.end());
+    metrics.siteClocks.assign(remoteClocks.begin(), remoteClocks.end());
+    metrics.siteClocks.emplace_back(siteId, logicalClock);
+    std::sort(metrics.siteClocks.begin(), metrics.siteClocks.end());
+    return metrics;
 }
 
 CRDTId CRDTDocument::generateId() {
     return CRDTId(siteId, ++logicalClock);
 }
 
+void CRDTDocument::advanceClock(uint64_t clock) {
+    if (clock > logicalClock) {
+        logicalClock = clock;
+    }
+}
+
+CRDTId CRDTDocument::reserveIds(size_t count) {
+    CRDTId first(siteId, logicalClock + 1);
+    logicalClock += count;
+    return first;
+}
+
+void CRDTDocument::observeId(const CRDTId& id) {
+    // Lamport clock: whatever we stamp next must beat every timestamp we
+    // have seen, from any site (including our own, e.g. back from storage).
+    // Otherwise a local write could lose LWW to a value already on screen.
+    advanceClock(id.logicalClock);
+    // Clock 0 is the shared root and empty IDs
+    if (id.siteId == siteId || id.logicalClock == 0) {
+        return;
+    }
+    if (!lastRemoteClock || lastRemoteClock->first != id.siteId) {
+        lastRemoteClock = &*remoteClocks.try_emplace(id.siteId, 0).first;
+    }
+    lastRemoteClock->second = std::max(lastRemoteClock->second, id.logicalClock);
+}
+
+void CRDTDocument::observeNodeClocks(const CRDTNode& node) {
+    observeId(node.getId());
+    observeId(node.getDeletedTimestamp());
+    for (const auto& property : node.getProperties()) {
+        observeId(property.second.timestamp);
+    }
+    for (const auto& child : node.getChildEntries()) {
+        observeId(child.addedTimestamp);
+        if (child.deleted) {
+            observeId(child.deletedTimestamp);
+        }
+    }
+    if (node.getText()) {
+        std::unordered_map<std::string, uint64_t> textClocks;
+        node.getText()->getSiteClocks(textClocks);
+        for (const auto& pair : textClocks) {
+            observeId(CRDTId(pair.first, pair.second));
+        }
+    }
+}
+
+size_t CRDTDocument::addOperationListener(OperationListener listener) {
+    size_t handle = nextListenerHandle++;
+    listeners.emplace_back(handle, std::move(listener));
+    return handle;
+}
+
+void CRDTDocument::removeOperationListener(size_t handle) {
+    listeners.erase(
+        std::remove_if(listeners.begin(), listeners.end(),
+                       [handle](const std::pair<size_t, OperationListener>& entry) {
+                           return entry.first == handle;
+                       }),
+        listeners.end()
+    );
+}
+
+void CRDTDocument::beginBatch() {
+    batchDepth++;
+}
+
+void CRDTDocument::endBatch() {
+    if (batchDepth == 0) {
+        return;
+    }
+    if (--batchDepth == 0) {
+        for (const auto& entry : batchListeners) {
+            entry.second();
+        }
+    }
+}
+
+size_t CRDTDocument::addBatchListener(BatchListener listener) {
+    size_t handle = nextListenerHandle++;
+    batchListeners.emplace_back(handle, std::move(listener));
+    return handle;
+}
+
+void CRDTDocument::removeBatchListener(size_t handle) {
+    batchListeners.erase(
+        std::remove_if(batchListeners.begin(), batchListeners.end(),
+                       [handle](const std::pair<size_t, BatchListener>& entry) {
+                           return entry.first == handle;
+                       }),
+        batchListeners.end()
+    );
+}
+
+void CRDTDocument::notify(const CRDTOperation& op, bool local) const {
+    for (const auto& entry : listeners) {
+        entry.second(op, local);
+    }
+}
+
 CRDTId CRDTDocument::createNode(const std::string& type) {
     CRDTId id = generateId();
-    auto node = std::make_shared<CRDTNode>(id, type);
-    nodes[id.toString()] = node;
+    nodes[id.toString()] = allocateNode(id, type);
+    counters.localOperations++;
+    localChanged = true;
+    if (!listeners.empty()) {
+        notify(CRDTOperation::createNode(id, type), true);
+    }
     return id;
 }
 
 CRDTId CRDTDocument::createNodeWithId(const CRDTId& id, const std::string& type) {
-    auto node = std::make_shared<CRDTNode>(id, type);
-    nodes[id.toString()] = node;
+    nodes[id.toString()] = allocateNode(id, type);
     // Update logical clock if needed
-    if (id.siteId == siteId && id.logicalClock > logicalClock) {
-        logicalClock = id.logicalClock;
+    observeId(id);
+    counters.localOperations++;
+    localChanged = true;
+    if (!listeners.empty()) {
+        notify(CRDTOperation::createNode(id, type), true);
     }
     return id;
 }
 
 std::shared_ptr<CRDTNode> CRDTDocument::getNode(const CRDTId& id) const {
-    auto it = nodes.find(id.toString());
+    std::string key = id.toString();
+    auto it = nodes.find(key);
     if (it != nodes.end()) {
         return it->second;
     }
+    if (nodeSource) {
+        // Fault the node in from the backing store
+        auto node = nodeSource->loadNode(id, CRDTNode::allocator_type(memory.get()));
+        if (node) {
+            nodes[key] = node;
+            return node;
+        }
+    }
     return nullptr;
 }
 
 void CRDTDocument::deleteNode(const CRDTId& id) {
     auto node = getNode(id);
     if (node) {
+        localChanged = !node->isDeleted();
         CRDTId timestamp = generateId();
         node->markDeleted(timestamp);
+        counters.localOperations++;
+        if (!listeners.empty()) {
+            notify(CRDTOperation::deleteNode(id, timestamp), true);
+        }
+    }
+}
+
+void CRDTDocument::restoreNode(const CRDTId& id) {
+    auto node = getNode(id);
+    if (node) {
+        localChanged = node->isDeleted();
+        CRDTId timestamp = generateId();
+        node->restore(timestamp);
+        counters.localOperations++;
+        if (!listeners.empty()) {
+            notify(CRDTOperation::restoreNode(id, timestamp), true);
+        }
     }
 }
 
@@ -193,7 +659,14 @@ void CRDTDocument::setNodeProperty(const CRDTId& nodeId, const std::string& key,
     auto node = getNode(nodeId);
     if (node) {
         CRDTId timestamp = generateId();
-        node->setProperty(key, value, timestamp);
+        if (!listeners.empty()) {
+            replacedValue = node->getProperty(key);
+        }
+        localChanged = node->setProperty(key, value, timestamp);
+        counters.localOperations++;
+        if (!listeners.empty()) {
+            notify(CRDTOperation::setProperty(nodeId, key, value, timestamp), true);
+        }
     }
 }
 
@@ -208,16 +681,34 @@ std::string CRDTDocument::getNodeProperty(const CRDTId& nodeId, const std::strin
 void CRDTDocument::addChild(const CRDTId& parentId, const CRDTId& childId) {
     auto parent = getNode(parentId);
     if (parent) {
+        // Adding a live child again only moves it to the end
+        bool live = false;
+        for (const auto& child : parent->getChildEntries()) {
+            live = live || (child.childId == childId && !child.deleted);
+        }
         CRDTId timestamp = generateId();
-        parent->addChild(childId, timestamp);
+        localChanged = parent->addChild(childId, timestamp) && !live;
+        counters.localOperations++;
+        if (!listeners.empty()) {
+            notify(CRDTOperation::addChild(parentId, childId, timestamp), true);
+        }
     }
 }
 
 void CRDTDocument::removeChild(const CRDTId& parentId, const CRDTId& childId) {
     auto parent = getNode(parentId);
     if (parent) {
+        // Removing a removed child only re-stamps its tombstone
+        localChanged = false;
+        for (const auto& child : parent->getChildEntries()) {
+            localChanged = localChanged || (child.childId == childId && !child.deleted);
+        }
         CRDTId timestamp = generateId();
         parent->removeChild(childId, timestamp);
+        counters.localOperations++;
+        if (!listeners.empty()) {
+            notify(CRDTOperation::removeChild(parentId, childId, timestamp), true);
+        }
     }
 }
 
@@ -229,59 +720,582 @@ std::vector<CRDTId> CRDTDocument::getChildren(const CRDTId& parentId) const {
     return std::vector<CRDTId>();
 }
 
+namespace {
+
+// FNV-1a over length-prefixed strings and little-endian integers; the same
+// on every platform, since replicas compare clone digests
+struct CloneHasher {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    void add(uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            hash ^= (value >> (i * 8)) & 0xff;
+            hash *= 0x100000001b3ULL;
+        }
+    }
+    void add(const std::string& text) {
+        add(static_cast<uint64_t>(text.size()));
+        for (unsigned char c : text) {
+            hash ^= c;
+            hash *= 0x100000001b3ULL;
+        }
+    }
+};
+
+// A node to copy: its place in the reserved range and its copied children
+struct CloneSource {
+    std::shared_ptr<CRDTNode> node;
+    uint64_t offset;
+    std::vector<size_t> children;   // Indexes into the clone order
+};
+
+} // namespace
+
+CRDTId CRDTDocument::cloneSubtree(const CRDTId& sourceId, const CRDTId& parentId) {
+    LIENZO_PROFILE_SCOPE("CRDTDocument::cloneSubtree");
+    CRDTOperation op;
+    op.type = CRDTOperationType::CloneSubtree;
+    op.nodeId = sourceId;
+    beginBatch();
+    localChanged = true;
+    bool cloned = integrateClone(op, true);
+    if (cloned) {
+        counters.localOperations++;
+        addChild(parentId, op.timestamp);
+    }
+    endBatch();
+    return cloned ? op.timestamp : CRDTId();
+}
+
+bool CRDTDocument::integrateClone(CRDTOperation& op, bool local) {
+    auto source = getNode(op.nodeId);
+    if (!source || source->isDeleted() || (!local && getNode(op.timestamp))) {
+        return false;
+    }
+
+    // Live nodes in pre-order; one listed by several parents is copied once.
+    // Each takes one ID, plus one per character of its text.
+    std::vector<CloneSource> order;
+    std::unordered_map<std::string, size_t> positions;  // key: source id.toString()
+    uint64_t count = 0;
+    std::vector<std::shared_ptr<CRDTNode>> stack{source};
+    while (!stack.empty()) {
+        auto node = std::move(stack.back());
+        stack.pop_back();
+        if (!positions.emplace(node->getId().toString(), order.size()).second) {
+            continue;
+        }
+        order.push_back(CloneSource{node, count, {}});
+        count += 1 + (node->getText() ? node->getText()->length() : 0);
+        const auto& entries = node->getChildEntries();
+        for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+            auto child = it->deleted ? nullptr : getNode(it->childId);
+            if (child && !child->isDeleted()) {
+                stack.push_back(std::move(child));
+            }
+        }
+    }
+
+    // Digest of everything the copy is made of, so replicas only expand a
+    // clone when their source matches the sender's
+    CloneHasher hasher;
+    for (auto& entry : order) {
+        const CRDTNode& node = *entry.node;
+        hasher.add(node.getType());
+        uint64_t properties = 0;    // Summed: the map has no stable order
+        for (const auto& prop : node.getProperties()) {
+            CloneHasher part;
+            part.add(prop.first);
+            part.add(prop.second.value);
+            properties += part.hash;
+        }
+        hasher.add(properties);
+        for (const auto& child : node.getChildEntries()) {
+            auto it = child.deleted ? positions.end() : positions.find(child.childId.toString());
+            if (it != positions.end()) {
+                entry.children.push_back(it->second);
+            }
+        }
+        hasher.add(static_cast<uint64_t>(entry.children.size()));
+        for (size_t child : entry.children) {
+            hasher.add(static_cast<uint64_t>(child));
+        }
+        hasher.add(node.getText() ? node.getText()->toString() : std::string());
+    }
+
+    if (local) {
+        CRDTId first = reserveIds(static_cast<size_t>(count));
+        op = CRDTOperation::cloneSubtree(op.nodeId, first, CRDTId(siteId, first.logicalClock + count - 1),
+                                         hasher.hash);
+    } else if (op.childId.siteId != op.timestamp.siteId ||
+               op.childId.logicalClock < op.timestamp.logicalClock ||
+               op.childId.logicalClock - op.timestamp.logicalClock + 1 != count ||
+               op.value != std::to_string(hasher.hash)) {
+        // Our source differs from the sender's; it has to send expandClone()
+        return false;
+    }
+
+    const CRDTId& first = op.timestamp;
+    auto idAt = [&](size_t index) {
+        return CRDTId(first.siteId, first.logicalClock + order[index].offset);
+    };
+    nodes.reserve(nodes.size() + order.size());
+    std::vector<std::shared_ptr<CRDTNode>> copies;
+    copies.reserve(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        CRDTId id = idAt(i);
+        auto copy = allocateNode(id, order[i].node->getType());
+        copy->copyContent(*order[i].node, id);
+        for (size_t child : order[i].children) {
+            CRDTId childId = idAt(child);
+            copy->appendChildEntry(CRDTNode::ChildEntry(childId, childId));
+        }
+        nodes[id.toString()] = copy;
+        copies.push_back(std::move(copy));
+    }
+
+    if (!listeners.empty()) {
+        notify(op, local);
+        expandingClone = true;
+        for (const auto& copy : copies) {
+            for (const auto& expanded : copy->toOperations()) {
+                notify(expanded, local);
+            }
+        }
+        expandingClone = false;
+    }
+    return true;
+}
+
+std::vector<CRDTOperation> CRDTDocument::expandClone(const CRDTOperation& clone) const {
+    std::vector<CRDTOperation> ops;
+    if (clone.type != CRDTOperationType::CloneSubtree || clone.childId.siteId != clone.timestamp.siteId) {
+        return ops;
+    }
+    // Text characters use IDs of the range too; only the nodes are found
+    for (uint64_t clock = clone.timestamp.logicalClock; clock <= clone.childId.logicalClock; clock++) {
+        if (auto node = getNode(CRDTId(clone.timestamp.siteId, clock))) {
+            auto nodeOps = node->toOperations();
+            ops.insert(ops.end(), nodeOps.begin(), nodeOps.end());
+        }
+    }
+    return ops;
+}
+
+bool CRDTDocument::insertText(const CRDTId& nodeId, size_t index, const std::string& text) {
+    auto node = getNode(nodeId);
+    std::u32string chars = TextSequence::decodeUtf8(text);
+    if (!node || chars.empty()) {
+        return false;
+    }
+    TextSequence& sequence = node->ensureText();
+    // One clock per character; all of them above every ID in the text, so
+    // the run lands right at the cursor
+    advanceClock(sequence.getMaxClock());
+    CRDTId first = reserveIds(chars.size());
+    CRDTId origin = sequence.insertAt(index, chars, first);
+    counters.localOperations++;
+    localChanged = true;
+    if (!listeners.empty()) {
+        notify(CRDTOperation::insertText(nodeId, first, origin, TextSequence::encodeUtf8(chars)), true);
+    }
+    return true;
+}
+
+bool CRDTDocument::deleteText(const CRDTId& nodeId, size_t index, size_t length) {
+    auto node = getNode(nodeId);
+    if (!node || !node->getText() || length == 0) {
+        return false;
+    }
+    auto ranges = node->getText()->eraseAt(index, length);
+    counters.localOperations += ranges.size();
+    localChanged = true;
+    if (!listeners.empty()) {
+        // One edit, even when it spans several runs (one step for undo)
+        beginBatch();
+        for (const auto& range : ranges) {
+            notify(CRDTOperation::deleteText(nodeId, range.first, range.second), true);
+        }
+        endBatch();
+    }
+    return !ranges.empty();
+}
+
+bool CRDTDocument::setText(const CRDTId& nodeId, const std::string& text) {
+    auto node = getNode(nodeId);
+    if (!node) {
+        return false;
+    }
+    std::u32string current = node->getText()
+        ? TextSequence::decodeUtf8(node->getText()->toString()) : std::u32string();
+    std::u32string next = TextSequence::decodeUtf8(text);
+
+    // Keep the common prefix and suffix; only the span between them changes
+    size_t prefix = 0;
+    while (prefix < current.size() && prefix < next.size() && current[prefix] == next[prefix]) {
+        prefix++;
+    }
+    size_t suffix = 0;
+    while (suffix < current.size() - prefix && suffix < next.size() - prefix &&
+           current[current.size() - 1 - suffix] == next[next.size() - 1 - suffix]) {
+        suffix++;
+    }
+    bool changed = false;
+    if (current.size() > prefix + suffix) {
+        changed |= deleteText(nodeId, prefix, current.size() - prefix - suffix);
+    }
+    if (next.size() > prefix + suffix) {
+        changed |= insertText(nodeId, prefix,
+                              TextSequence::encodeUtf8(next.substr(prefix, next.size() - prefix - suffix)));
+    }
+    return changed;
+}
+
+std::string CRDTDocument::getText(const CRDTId& nodeId) const {
+    auto node = getNode(nodeId);
+    if (node && node->getText()) {
+        return node->getText()->toString();
+    }
+    return "";
+}
+
+bool CRDTDocument::deleteTextById(const CRDTId& nodeId, const CRDTId& first, size_t count) {
+    auto node = getNode(nodeId);
+    if (!node || !node->getText()) {
+        return false;
+    }
+    // Characters already deleted are left out of the operations
+    auto ranges = node->getText()->getVisibleRanges(first, count);
+    for (const auto& range : ranges) {
+        node->getText()->integrateDelete(range.first, range.second);
+    }
+    counters.localOperations += ranges.size();
+    localChanged = !ranges.empty();
+    if (!listeners.empty()) {
+        beginBatch();
+        for (const auto& range : ranges) {
+            notify(CRDTOperation::deleteText(nodeId, range.first, range.second), true);
+        }
+        endBatch();
+    }
+    return !ranges.empty();
+}
+
+CRDTId CRDTDocument::insertTextAfter(const CRDTId& nodeId, const CRDTId& origin, const std::string& text) {
+    auto node = getNode(nodeId);
+    std::u32string chars = TextSequence::decodeUtf8(text);
+    if (!node || chars.empty()) {
+        return CRDTId();
+    }
+    TextSequence& sequence = node->ensureText();
+    // Above every ID in the text, so the run lands right after origin
+    advanceClock(sequence.getMaxClock());
+    CRDTId first = reserveIds(chars.size());
+    if (!sequence.integrateInsert(first, origin, chars)) {
+        return CRDTId();
+    }
+    counters.localOperations++;
+    localChanged = true;
+    if (!listeners.empty()) {
+        notify(CRDTOperation::insertText(nodeId, first, origin, text), true);
+    }
+    return first;
+}
+
+bool CRDTDocument::applyOperation(const CRDTOperation& op) {
+    observeId(op.timestamp);
+    if (op.type == CRDTOperationType::InsertText) {
+        // Covers every character of the run, not just the first
+        size_t count = TextSequence::decodeUtf8(op.value).size();
+        if (count > 1) {
+            observeId(CRDTId(op.timestamp.siteId, op.timestamp.logicalClock + count - 1));
+        }
+    }
+
+    if (op.type == CRDTOperationType::CloneSubtree) {
+        // The whole reserved range
+        observeId(op.childId);
+        CRDTOperation clone = op;
+        bool cloned = integrateClone(clone, false);
+        if (cloned) {
+            counters.remoteOperations++;
+        } else {
+            counters.rejectedOperations++;
+        }
+        return cloned;
+    }
+
+    bool changed = false;
+    if (op.type == CRDTOperationType::CreateNode) {
+        if (!getNode(op.nodeId)) {
+            nodes[op.nodeId.toString()] = allocateNode(op.nodeId, op.key);
+            changed = true;
+        }
+    } else {
+        auto node = getNode(op.nodeId);
+        changed = node && node->applyOperation(op);
+    }
+
+    if (changed) {
+        counters.remoteOperations++;
+    } else {
+        counters.rejectedOperations++;
+    }
+    if (changed && !listeners.empty()) {
+        notify(op, false);
+    }
+    return changed;
+}
+
+void CRDTDocument::mergeNode(CRDTNode& node, const CRDTNode& other) {
+    // Same result as CRDTNode::merge, but reports each change that wins
+    if (other.getId() != node.getId() || other.getType() != node.getType()) {
+        return;
+    }
+    for (const auto& op : other.toOperations()) {
+        if (op.type != CRDTOperationType::CreateNode && node.applyOperation(op)) {
+            notify(op, false);
+        }
+    }
+}
+
+void CRDTDocument::integrateNode(std::shared_ptr<CRDTNode> node) {
+    // Before listeners run, so writes they make in response beat it
+    observeNodeClocks(*node);
+    std::string key = node->getId().toString();
+    auto it = nodes.find(key);
+    if (it == nodes.end() && nodeSource) {
+        getNode(node->getId());
+        it = nodes.find(key);
+    }
+    if (it != nodes.end()) {
+        // Node exists, merge it
+        if (listeners.empty()) {
+            it->second->merge(*node);
+        } else {
+            mergeNode(*it->second, *node);
+        }
+        return;
+    }
+    nodes[key] = node;
+    if (!listeners.empty()) {
+        for (const auto& op : node->toOperations()) {
+            notify(op, false);
+        }
+    }
+}
+
 void CRDTDocument::merge(const CRDTDocument& other) {
+    LIENZO_PROFILE_SCOPE("CRDTDocument::merge");
+    auto start = std::chrono::steady_clock::now();
+    other.loadAllNodes();
+
     // Merge all nodes from other document
     for (const auto& pair : other.nodes) {
         auto it = nodes.find(pair.first);
-        if (it != nodes.end()) {
+        if (it != nodes.end() && listeners.empty()) {
             // Node exists, merge it
             it->second->merge(*pair.second);
+            observeNodeClocks(*pair.second);
         } else {
-            // New node, add it
-            nodes[pair.first] = std::make_shared<CRDTNode>(*pair.second);
+            // Copy into this document's arena (unless it turns out to exist)
+            integrateNode(std::allocate_shared<CRDTNode>(
+                std::pmr::polymorphic_allocator<CRDTNode>(memory.get()), *pair.second));
         }
     }
-    
-    // Update logical clock if we received operations from our own site
-    // (this handles the case where we receive our own operations back)
-    for (const auto& pair : other.nodes) {
-        CRDTId id;
-        // Parse ID from string (format: "siteId:clock")
-        size_t colonPos = pair.first.find(':');
-        if (colonPos != std::string::npos) {
-            std::string site = pair.first.substr(0, colonPos);
-            if (site == siteId) {
-                uint64_t clock = std::stoull(pair.first.substr(colonPos + 1));
-                if (clock > logicalClock) {
-                    logicalClock = clock;
+
+    counters.recordMerge(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count()));
+}
+
+std::vector<std::shared_ptr<CRDTNode>> CRDTDocument::getNodesInTreeOrder() const {
+    loadAllNodes();
+    std::vector<std::shared_ptr<CRDTNode>> ordered;
+    ordered.reserve(nodes.size());
+    std::unordered_set<const CRDTNode*> visited;
+    auto visit = [&](const std::shared_ptr<CRDTNode>& node) {
+        if (node && visited.insert(node.get()).second) {
+            ordered.push_back(node);
+            return true;
+        }
+        return false;
+    };
+    auto lookup = [this](const CRDTId& id) {
+        auto it = nodes.find(id.toString());
+        return it != nodes.end() ? it->second : nullptr;
+    };
+
+    // Root, then every top-level node, so a reader can lay out frames early
+    auto root = lookup(rootId);
+    visit(root);
+    for (const auto& entry : root->getChildEntries()) {
+        visit(lookup(entry.childId));
+    }
+
+    // Then each top-level node's subtree, depth first, in turn
+    std::vector<std::shared_ptr<CRDTNode>> stack;
+    for (const auto& entry : root->getChildEntries()) {
+        auto top = lookup(entry.childId);
+        if (!top) {
+            continue;
+        }
+        stack.push_back(top);
+        while (!stack.empty()) {
+            auto node = stack.back();
+            stack.pop_back();
+            const auto& children = node->getChildEntries();
+            for (auto child = children.rbegin(); child != children.rend(); ++child) {
+                auto childNode = lookup(child->childId);
+                if (visit(childNode)) {
+                    stack.push_back(childNode);
                 }
             }
         }
     }
+
+    // Finally nodes that are not reachable from the root
+    for (const auto& pair : nodes) {
+        visit(pair.second);
+    }
+    return ordered;
 }
 
 std::string CRDTDocument::serialize() const {
-    // TODO: Implement JSON serialization
-    return "";
+    // Binary snapshot: header, node records in tree order, site clock table
+    ByteWriter writer;
+    writer.putBytes(kSnapshotMagic, 4);
+    writer.putVarint(kSnapshotVersion);
+
+    auto ordered = getNodesInTreeOrder();
+    writer.putVarint(ordered.size());
+    std::map<std::string, uint64_t> clocks;
+    auto observe = [&clocks](const CRDTId& stamp) {
+        if (!stamp.siteId.empty()) {
+            uint64_t& clock = clocks[stamp.siteId];
+            clock = std::max(clock, stamp.logicalClock);
+        }
+    };
+    ByteWriter record;
+    for (const auto& node : ordered) {
+        record.clear();
+        CRDTCodec::encodeNode(record, *node);
+        writer.putVarint(record.size());
+        writer.putBytes(record.data().data(), record.size());
+
+        observe(node->getId());
+        observe(node->getDeletedTimestamp());
+        for (const auto& prop : node->getProperties()) {
+            observe(prop.second.timestamp);
+        }
+        for (const auto& child : node->getChildEntries()) {
+            observe(child.addedTimestamp);
+            observe(child.deletedTimestamp);
+        }
+        if (node->getText()) {
+            std::unordered_map<std::string, uint64_t> textClocks;
+            node->getText()->getSiteClocks(textClocks);
+            for (const auto& pair : textClocks) {
+                observe(CRDTId(pair.first, pair.second));
+            }
+        }
+    }
+
+    // Highest clock per site, so a site resumes past its own edits
+    writer.putVarint(clocks.size());
+    for (const auto& pair : clocks) {
+        writer.putString(pair.first);
+        writer.putVarint(pair.second);
+    }
+    return writer.data();
 }
 
-void CRDTDocument::deserialize(const std::string& data) {
-    // TODO: Implement JSON deserialization
+bool CRDTDocument::deserialize(const std::string& data) {
+    // Merges the snapshot into this document; existing state is kept
+    ByteReader reader(data.data(), data.size());
+    char magic[4];
+    uint64_t version, count;
+    for (char& c : magic) {
+        uint8_t byte;
+        if (!reader.getByte(byte)) {
+            return false;
+        }
+        c = static_cast<char>(byte);
+    }
+    if (!std::equal(magic, magic + 4, kSnapshotMagic) || !reader.getVarint(version) ||
+        version != kSnapshotVersion || !reader.getVarint(count)) {
+        return false;
+    }
+
+    reserve(nodes.size() + static_cast<size_t>(count));
+    CRDTNode::allocator_type alloc(memory.get());
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t size;
+        if (!reader.getVarint(size) || size > reader.remaining()) {
+            return false;
+        }
+        ByteReader recordReader(reader.position(), static_cast<size_t>(size));
+        auto node = CRDTCodec::decodeNode(recordReader, alloc);
+        if (!node) {
+            return false;
+        }
+        reader.skip(static_cast<size_t>(size));
+        integrateNode(node);
+    }
+
+    uint64_t siteCount;
+    if (!reader.getVarint(siteCount)) {
+        return false;
+    }
+    for (uint64_t i = 0; i < siteCount; i++) {
+        std::string site;
+        uint64_t clock;
+        if (!reader.getString(site) || !reader.getVarint(clock)) {
+            return false;
+        }
+        observeId(CRDTId(site, clock));
+    }
+    return true;
+}
+
+void CRDTDocument::setNodeSource(std::shared_ptr<CRDTNodeSource> source) {
+    nodeSource = std::move(source);
+    if (!nodeSource) {
+        return;
+    }
+    // Nodes already resident (at least the root) take in their stored state
+    CRDTNode::allocator_type alloc(memory.get());
+    for (auto& pair : nodes) {
+        auto stored = nodeSource->loadNode(pair.second->getId(), alloc);
+        if (stored) {
+            pair.second->merge(*stored);
+        }
+    }
+}
+
+void CRDTDocument::loadAllNodes() const {
+    if (!nodeSource) {
+        return;
+    }
+    for (const auto& id : nodeSource->getNodeIds()) {
+        getNode(id);
+    }
 }
 
 std::vector<CRDTId> CRDTDocument::getAllNodeIds() const {
     std::vector<CRDTId> result;
+    result.reserve(nodes.size());
     for (const auto& pair : nodes) {
-        CRDTId id;
-        size_t colonPos = pair.first.find(':');
-        if (colonPos != std::string::npos) {
-            std::string site = pair.first.substr(0, colonPos);
-            uint64_t clock = std::stoull(pair.first.substr(colonPos + 1));
-            result.push_back(CRDTId(site, clock));
+        result.push_back(pair.second->getId());
+    }
+    if (nodeSource) {
+        // Include stored nodes that have not been faulted in yet
+        for (const auto& id : nodeSource->getNodeIds()) {
+            if (nodes.find(id.toString()) == nodes.end()) {
+                result.push_back(id);
+            }
         }
     }
     return result;
 }
 
 } // namespace Lienzo
-
@@ -1,13 +1,20 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <cstdint>
 #include <unordered_map>
 #include <vector>
 #include <memory>
+#include <memory_resource>
+#include <functional>
+#include "document_memory.h"
+#include "document_metrics.h"
 
 namespace Lienzo {
 
+class TextSequence;
+
 // Unique identifier for CRDT nodes
 // Format: siteId:logicalClock (e.g., "user1:42")
 struct CRDTId {
@@ -21,6 +28,9 @@ struct CRDTId {
         return siteId + ":" + std::to_string(logicalClock);
     }
     
+    // Inverse of toString; the empty ID if str is not "site:clock"
+    static CRDTId fromString(std::string_view str);
+    
     bool operator==(const CRDTId& other) const {
         return siteId == other.siteId && logicalClock == other.logicalClock;
     }
@@ -57,27 +67,121 @@ struct CRDTProperty {
     }
 };
 
+// Operation kinds exchanged between replicas and written to storage
+enum class CRDTOperationType : uint8_t {
+    CreateNode = 1,
+    DeleteNode = 2,
+    SetProperty = 3,
+    AddChild = 4,
+    RemoveChild = 5,
+    InsertText = 6,
+    DeleteText = 7,
+    CloneSubtree = 8,
+    RestoreNode = 9
+};
+
+// A single CRDT operation
+// Every document mutation (local edit or merged remote state) can be
+// expressed as one of these; applying the same operation twice is a no-op.
+struct CRDTOperation {
+    CRDTOperationType type;
+    CRDTId timestamp;   // ID of this operation (the new node's ID for CreateNode,
+                        // the first character's ID for InsertText/DeleteText,
+                        // the first ID of the copy for CloneSubtree)
+    CRDTId nodeId;      // Target node (the parent for AddChild/RemoveChild, the
+                        // source for CloneSubtree)
+    CRDTId childId;     // Child for AddChild/RemoveChild, origin character for
+                        // InsertText, last deleted character for DeleteText,
+                        // last ID of the copy for CloneSubtree
+    std::string key;    // Property key, or node type for CreateNode
+    std::string value;  // Property value for SetProperty, UTF-8 text for InsertText,
+                        // source digest (decimal) for CloneSubtree
+    
+    CRDTOperation() : type(CRDTOperationType::CreateNode) {}
+    
+    static CRDTOperation createNode(const CRDTId& id, const std::string& nodeType);
+    static CRDTOperation deleteNode(const CRDTId& id, const CRDTId& timestamp);
+    static CRDTOperation restoreNode(const CRDTId& id, const CRDTId& timestamp);
+    static CRDTOperation setProperty(const CRDTId& id, const std::string& key,
+                                     const std::string& value, const CRDTId& timestamp);
+    static CRDTOperation addChild(const CRDTId& parentId, const CRDTId& childId,
+                                  const CRDTId& timestamp);
+    static CRDTOperation removeChild(const CRDTId& parentId, const CRDTId& childId,
+                                     const CRDTId& timestamp);
+    static CRDTOperation insertText(const CRDTId& nodeId, const CRDTId& first,
+                                    const CRDTId& origin, const std::string& text);
+    static CRDTOperation deleteText(const CRDTId& nodeId, const CRDTId& first, size_t count);
+    static CRDTOperation cloneSubtree(const CRDTId& sourceId, const CRDTId& first, const CRDTId& last,
+                                      uint64_t sourceDigest);
+};
+
 // Base class for all CRDT nodes
+// Nodes owned by a CRDTDocument allocate their property map and child list
+// from the document's memory resource (see DocumentMemoryResource)
 class CRDTNode {
 public:
-    CRDTNode(const CRDTId& id, const std::string& type);
-    virtual ~CRDTNode() = default;
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+    
+    // Children with tombstones, ordered by the timestamp of their latest add
+    // (then by child ID) so every replica lists them alike
+    struct ChildEntry {
+        CRDTId childId;
+        CRDTId addedTimestamp;
+        bool deleted;
+        CRDTId deletedTimestamp;
+        
+        ChildEntry(const CRDTId& id, const CRDTId& ts) 
+            : childId(id), addedTimestamp(ts), deleted(false), deletedTimestamp() {}
+    };
+    using PropertyMap = std::pmr::unordered_map<std::string, CRDTProperty<std::string>>;
+    
+    CRDTNode(const CRDTId& id, const std::string& type,
+             const allocator_type& alloc = allocator_type());
+    CRDTNode(const CRDTNode& other, const allocator_type& alloc = allocator_type());
+    virtual ~CRDTNode();
     
     // CRDT properties
-    CRDTId getId() const { return id; }
-    std::string getType() const { return type; }
+    const CRDTId& getId() const { return id; }
+    const std::string& getType() const { return type; }
+    // Deletion is a Last-Write-Wins flag: the later of delete and restore wins
     bool isDeleted() const { return deleted; }
-    void markDeleted(const CRDTId& timestamp);
+    // Timestamp of the last delete or restore; empty if there was none
+    CRDTId getDeletedTimestamp() const { return deletedTimestamp; }
+    bool markDeleted(const CRDTId& timestamp);
+    bool restore(const CRDTId& timestamp);
     
     // Property management (Last-Write-Wins)
-    void setProperty(const std::string& key, const std::string& value, const CRDTId& timestamp);
+    // Mutators return true when the node's state changed. An empty value
+    // clears a property: hasProperty is false and getProperty returns "".
+    bool setProperty(const std::string& key, const std::string& value, const CRDTId& timestamp);
     std::string getProperty(const std::string& key) const;
     bool hasProperty(const std::string& key) const;
+    const PropertyMap& getProperties() const { return properties; }
     
-    // Children management (ordered list CRDT)
-    void addChild(const CRDTId& childId, const CRDTId& timestamp);
-    void removeChild(const CRDTId& childId, const CRDTId& timestamp);
+    // Children management (ordered list CRDT). An entry is live when its
+    // latest add is later than its latest removal; adding a live child
+    // again moves it to the end.
+    bool addChild(const CRDTId& childId, const CRDTId& timestamp);
+    bool removeChild(const CRDTId& childId, const CRDTId& timestamp);
     std::vector<CRDTId> getChildren() const;
+    const std::pmr::vector<ChildEntry>& getChildEntries() const { return children; }
+    // Insert a stored entry as-is, without the duplicate scan (decoding and
+    // clone expansion only)
+    void appendChildEntry(const ChildEntry& entry);
+    
+    // Copy source's properties and visible text into this (new) node, all
+    // stamped with timestamp; the characters take the IDs right after it
+    void copyContent(const CRDTNode& source, const CRDTId& timestamp);
+    
+    // Text content (sequence CRDT); null until the first text edit
+    TextSequence* getText() const { return text.get(); }
+    TextSequence& ensureText();
+    
+    // Apply a node-level operation (everything except CreateNode)
+    bool applyOperation(const CRDTOperation& op);
+    
+    // Operations that rebuild this node's full state on another replica
+    std::vector<CRDTOperation> toOperations() const;
     
     // Merge this node with another node's state
     void merge(const CRDTNode& other);
@@ -93,24 +197,40 @@ protected:
     CRDTId deletedTimestamp;
     
     // Properties with LWW semantics
-    std::unordered_map<std::string, CRDTProperty<std::string>> properties;
+    PropertyMap properties;
     
-    // Children with tombstones
-    struct ChildEntry {
-        CRDTId childId;
-        CRDTId addedTimestamp;
-        bool deleted;
-        CRDTId deletedTimestamp;
-        
-        ChildEntry(const CRDTId& id, const CRDTId& ts) 
-            : childId(id), addedTimestamp(ts), deleted(false), deletedTimestamp() {}
-    };
-    std::vector<ChildEntry> children;
+    std::pmr::vector<ChildEntry> children;
+    
+    std::unique_ptr<TextSequence> text;
+
+private:
+    void insertChildEntry(const ChildEntry& entry);
+};
+
+// Backing store that can supply nodes on demand
+// A document with a node source starts out (nearly) empty and faults nodes
+// in on first access instead of parsing everything up front.
+class CRDTNodeSource {
+public:
+    virtual ~CRDTNodeSource() = default;
+    
+    // Decode one node, allocating it with alloc; nullptr if unknown
+    virtual std::shared_ptr<CRDTNode> loadNode(const CRDTId& id,
+                                               const CRDTNode::allocator_type& alloc) = 0;
+    
+    // IDs of every node the source can supply
+    virtual std::vector<CRDTId> getNodeIds() const = 0;
 };
 
 // CRDT-based document graph
 class CRDTDocument {
 public:
+    // Called for every operation that changed the document, local or remote
+    using OperationListener = std::function<void(const CRDTOperation& op, bool local)>;
+    
+    // All replicas share the same root so their trees line up after merge
+    static CRDTId sharedRootId() { return CRDTId("root", 0); }
+    
     CRDTDocument(const std::string& siteId);
     
     // Node operations
@@ -118,6 +238,8 @@ public:
     CRDTId createNodeWithId(const CRDTId& id, const std::string& type);
     std::shared_ptr<CRDTNode> getNode(const CRDTId& id) const;
     void deleteNode(const CRDTId& id);
+    // Undo a delete; the node comes back wherever it is still a child
+    void restoreNode(const CRDTId& id);
     
     // Property operations
     void setNodeProperty(const CRDTId& nodeId, const std::string& key, 
@@ -129,27 +251,142 @@ public:
     void removeChild(const CRDTId& parentId, const CRDTId& childId);
     std::vector<CRDTId> getChildren(const CRDTId& parentId) const;
     
+    // Text operations (per-character sequence CRDT)
+    // Indexes and lengths count Unicode code points; each call emits one
+    // InsertText or a few DeleteText operations proportional to the edit
+    bool insertText(const CRDTId& nodeId, size_t index, const std::string& text);
+    bool deleteText(const CRDTId& nodeId, size_t index, size_t length);
+    // Replace the whole text, editing only the span that differs
+    bool setText(const CRDTId& nodeId, const std::string& text);
+    std::string getText(const CRDTId& nodeId) const;
+    // Edits by character ID rather than index, for reverting earlier edits:
+    // delete whichever of the count characters from first on are still
+    // visible, or insert text right after the character origin (deleted or
+    // not; empty for the start) and return the ID of its first character
+    bool deleteTextById(const CRDTId& nodeId, const CRDTId& first, size_t count);
+    CRDTId insertTextAfter(const CRDTId& nodeId, const CRDTId& origin, const std::string& text);
+    
     // Merge with another document state
     void merge(const CRDTDocument& other);
     
+    // Apply an operation received from another replica or read from storage
+    // Returns false if it changed nothing (duplicate, stale or unknown target)
+    bool applyOperation(const CRDTOperation& op);
+    
+    // Operation listeners; the returned handle removes the listener again
+    size_t addOperationListener(OperationListener listener);
+    void removeOperationListener(size_t handle);
+    // While a local operation is being notified: whether it changed the
+    // document (deleting a deleted node does not) and, for SetProperty, the
+    // value it replaced ("" if the property was unset). Lets listeners
+    // record inverse operations (see UndoManager).
+    bool didLocalOperationChange() const { return localChanged; }
+    const std::string& getReplacedValue() const { return replacedValue; }
+    
+    // Batches group operations into one logical change (one undo step, one
+    // plugin change set). They nest; batch listeners run when the outermost
+    // batch ends. Operations still reach operation listeners one by one.
+    using BatchListener = std::function<void()>;
+    void beginBatch();
+    void endBatch();
+    bool isInBatch() const { return batchDepth > 0; }
+    size_t addBatchListener(BatchListener listener);
+    void removeBatchListener(size_t handle);
+    
     // Get root node
     CRDTId getRootId() const { return rootId; }
     
-    // Serialization for network sync
+    // Site and clock
+    const std::string& getSiteId() const { return siteId; }
+    uint64_t getLogicalClock() const { return logicalClock; }
+    // Make sure future local IDs are greater than clock. The clock is a
+    // Lamport clock: every received ID and timestamp advances it too.
+    void advanceClock(uint64_t clock);
+    // Reserve count consecutive IDs of this site; returns the first
+    CRDTId reserveIds(size_t count);
+    
+    // Duplicate a subtree (its live nodes) and add the copy under parentId;
+    // returns the copy's root, or an empty ID if sourceId is unknown.
+    // The copy uses one reserved ID range and is sent as a single
+    // CloneSubtree operation that replicas expand themselves, provided their
+    // source subtree matches the digest it carries. Listeners get the
+    // CloneSubtree first, then the operations it expands to while
+    // isExpandingClone() is true: forward the former to peers and store or
+    // index the latter.
+    CRDTId cloneSubtree(const CRDTId& sourceId, const CRDTId& parentId);
+    bool isExpandingClone() const { return expandingClone; }
+    // The CloneSubtree as ordinary operations, from this replica's copy. For
+    // peers that reject it (applyOperation false with the source present):
+    // their source changed concurrently, so they cannot rebuild the copy.
+    std::vector<CRDTOperation> expandClone(const CRDTOperation& clone) const;
+    
+    // Binary snapshot of the full document state
+    // Records are ordered root first, then top-level nodes, then each
+    // top-level node's subtree in turn, then unattached nodes.
+    static const char kSnapshotMagic[4];
+    static const uint64_t kSnapshotVersion = 1;
     std::string serialize() const;
-    void deserialize(const std::string& data);
+    // Merge a snapshot into this document; false if it is malformed
+    bool deserialize(const std::string& data);
+    
+    // Merge a node decoded with getAllocator() into the document
+    void integrateNode(std::shared_ptr<CRDTNode> node);
+    CRDTNode::allocator_type getAllocator() const { return CRDTNode::allocator_type(memory.get()); }
+    
+    // Every node, in snapshot order (see serialize)
+    std::vector<std::shared_ptr<CRDTNode>> getNodesInTreeOrder() const;
     
     // Get all nodes (for iteration)
     std::vector<CRDTId> getAllNodeIds() const;
+    size_t getNodeCount() const { return nodes.size(); }
+    
+    // Attach a lazy backing store; nodes not yet resident are loaded from it
+    void setNodeSource(std::shared_ptr<CRDTNodeSource> source);
+    // Fault in every node from the node source
+    void loadAllNodes() const;
+    
+    // Pre-size the node table before bulk loads
+    void reserve(size_t nodeCount);
+    
+    // Memory held by this document's node arena
+    DocumentMemoryUsage getMemoryUsage() const;
+    
+    // Operation and merge counters, kept up to date at no real cost
+    const DocumentCounters& getCounters() const { return counters; }
+    // Counters plus a scan of the resident nodes (O(nodes); for polling)
+    DocumentMetrics getMetrics() const;
     
 private:
+    // Declared first so it outlives every node allocated from it
+    std::unique_ptr<DocumentMemoryResource> memory;
     std::string siteId;
     uint64_t logicalClock;
     CRDTId rootId;
-    std::unordered_map<std::string, std::shared_ptr<CRDTNode>> nodes; // key: id.toString()
+    // Resident nodes; mutable because getNode() faults nodes in from nodeSource
+    mutable std::pmr::unordered_map<std::string, std::shared_ptr<CRDTNode>> nodes; // key: id.toString()
+    std::shared_ptr<CRDTNodeSource> nodeSource;
+    std::vector<std::pair<size_t, OperationListener>> listeners;
+    std::vector<std::pair<size_t, BatchListener>> batchListeners;
+    size_t nextListenerHandle;
+    int batchDepth;
+    bool expandingClone;
+    bool localChanged;
+    std::string replacedValue;
+    DocumentCounters counters;
+    // Highest clock seen from each other site (for metrics); remote
+    // operations mostly come in runs from one site, so the last entry is
+    // remembered to skip hashing
+    std::unordered_map<std::string, uint64_t> remoteClocks;
+    std::pair<const std::string, uint64_t>* lastRemoteClock;
     
     CRDTId generateId();
+    std::shared_ptr<CRDTNode> allocateNode(const CRDTId& id, const std::string& type);
     void ensureNodeExists(const CRDTId& id, const std::string& type);
+    void observeId(const CRDTId& id);
+    void observeNodeClocks(const CRDTNode& node);
+    void notify(const CRDTOperation& op, bool local) const;
+    bool integrateClone(CRDTOperation& op, bool local);
+    void mergeNode(CRDTNode& node, const CRDTNode& other);
 };
 
 } // namespace Lienzo
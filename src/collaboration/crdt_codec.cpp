@@ -0,0 +1,326 @@
+#include "crdt_codec.h"
+#include "text_sequence.h"
+#include <cstdlib>
+
+namespace Lienzo {
+
+// ByteWriter implementation
+void ByteWriter::putVarint(uint64_t value) {
+    while (value >= 0x80) {
+        putByte(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    putByte(static_cast<uint8_t>(value));
+}
+
+void ByteWriter::putString(const std::string& value) {
+    putVarint(value.size());
+    buffer.append(value);
+}
+
+void ByteWriter::putId(const CRDTId& id) {
+    putString(id.siteId);
+    putVarint(id.logicalClock);
+}
+
+void ByteWriter::putFixed32(uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        putByte(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void ByteWriter::putFixed64(uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        putByte(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+// ByteReader implementation
+bool ByteReader::getByte(uint8_t& value) {
+    if (cursor >= end) {
+        return false;
+    }
+    value = *cursor++;
+    return true;
+}
+
+bool ByteReader::getVarint(uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte;
+        if (!getByte(byte)) {
+            return false;
+        }
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ByteReader::getString(std::string& value) {
+    uint64_t size;
+    if (!getVarint(size) || size > remaining()) {
+        return false;
+    }
+    value.assign(reinterpret_cast<const char*>(cursor), static_cast<size_t>(size));
+    cursor += size;
+    return true;
+}
+
+bool ByteReader::getId(CRDTId& id) {
+    return getString(id.siteId) && getVarint(id.logicalClock);
+}
+
+bool ByteReader::getFixed32(uint32_t& value) {
+    if (remaining() < 4) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= static_cast<uint32_t>(cursor[i]) << (8 * i);
+    }
+    cursor += 4;
+    return true;
+}
+
+bool ByteReader::getFixed64(uint64_t& value) {
+    if (remaining() < 8) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= static_cast<uint64_t>(cursor[i]) << (8 * i);
+    }
+    cursor += 8;
+    return true;
+}
+
+bool ByteReader::skip(size_t size) {
+    if (size > remaining()) {
+        return false;
+    }
+    cursor += size;
+    return true;
+}
+
+namespace CRDTCodec {
+
+// Node flags
+static const uint8_t kNodeDeleted = 0x01;
+static const uint8_t kNodeRestored = 0x02;
+// Child entry flags
+static const uint8_t kChildDeleted = 0x01;
+// Text run flags
+static const uint8_t kRunDeleted = 0x01;
+
+void encodeNode(ByteWriter& writer, const CRDTNode& node) {
+    writer.putId(node.getId());
+    writer.putString(node.getType());
+    // A restore is kept too, so a delete it beat cannot win later
+    bool restored = !node.isDeleted() && !node.getDeletedTimestamp().siteId.empty();
+    writer.putByte(node.isDeleted() ? kNodeDeleted : restored ? kNodeRestored : 0);
+    if (node.isDeleted() || restored) {
+        writer.putId(node.getDeletedTimestamp());
+    }
+    
+    const auto& properties = node.getProperties();
+    writer.putVarint(properties.size());
+    for (const auto& prop : properties) {
+        writer.putString(prop.first);
+        writer.putString(prop.second.value);
+        writer.putId(prop.second.timestamp);
+    }
+    
+    const auto& children = node.getChildEntries();
+    writer.putVarint(children.size());
+    for (const auto& child : children) {
+        writer.putId(child.childId);
+        writer.putId(child.addedTimestamp);
+        writer.putByte(child.deleted ? kChildDeleted : 0);
+        if (child.deleted) {
+            writer.putId(child.deletedTimestamp);
+        }
+    }
+    
+    // Text runs, omitted for nodes without text (older records end here too)
+    if (node.getText()) {
+        auto runs = node.getText()->getRuns();
+        writer.putVarint(runs.size());
+        for (const auto& run : runs) {
+            writer.putId(run.id);
+            writer.putId(run.origin);
+            writer.putString(TextSequence::encodeUtf8(run.chars));
+            writer.putByte(run.deleted ? kRunDeleted : 0);
+        }
+    }
+}
+
+std::shared_ptr<CRDTNode> decodeNode(ByteReader& reader, const CRDTNode::allocator_type& alloc) {
+    CRDTId id;
+    std::string type;
+    uint8_t flags;
+    if (!reader.getId(id) || !reader.getString(type) || !reader.getByte(flags)) {
+        return nullptr;
+    }
+    auto node = std::allocate_shared<CRDTNode>(
+        std::pmr::polymorphic_allocator<CRDTNode>(alloc.resource()), id, type);
+    
+    if (flags & (kNodeDeleted | kNodeRestored)) {
+        CRDTId timestamp;
+        if (!reader.getId(timestamp)) {
+            return nullptr;
+        }
+        if (flags & kNodeDeleted) {
+            node->markDeleted(timestamp);
+        } else {
+            node->restore(timestamp);
+        }
+    }
+    
+    uint64_t propertyCount;
+    if (!reader.getVarint(propertyCount)) {
+        return nullptr;
+    }
+    std::string key, value;
+    CRDTId timestamp;
+    for (uint64_t i = 0; i < propertyCount; i++) {
+        if (!reader.getString(key) || !reader.getString(value) || !reader.getId(timestamp)) {
+            return nullptr;
+        }
+        node->setProperty(key, value, timestamp);
+    }
+    
+    uint64_t childCount;
+    if (!reader.getVarint(childCount)) {
+        return nullptr;
+    }
+    for (uint64_t i = 0; i < childCount; i++) {
+        CRDTNode::ChildEntry entry{CRDTId(), CRDTId()};
+        uint8_t flags;
+        if (!reader.getId(entry.childId) || !reader.getId(entry.addedTimestamp) ||
+            !reader.getByte(flags)) {
+            return nullptr;
+        }
+        if (flags & kChildDeleted) {
+            entry.deleted = true;
+            if (!reader.getId(entry.deletedTimestamp)) {
+                return nullptr;
+            }
+        }
+        // Entries were unique when encoded, so skip addChild's duplicate scan
+        node->appendChildEntry(entry);
+    }
+    
+    if (reader.remaining() > 0) {
+        uint64_t runCount;
+        if (!reader.getVarint(runCount)) {
+            return nullptr;
+        }
+        TextSequence& text = node->ensureText();
+        TextSequence::Run run;
+        std::string chars;
+        uint8_t flags;
+        for (uint64_t i = 0; i < runCount; i++) {
+            if (!reader.getId(run.id) || !reader.getId(run.origin) ||
+                !reader.getString(chars) || !reader.getByte(flags)) {
+                return nullptr;
+            }
+            run.chars = TextSequence::decodeUtf8(chars);
+            run.deleted = (flags & kRunDeleted) != 0;
+            // Runs were stored in document order
+            text.appendRun(run);
+        }
+    }
+    return node;
+}
+
+void encodeOperation(ByteWriter& writer, const CRDTOperation& op) {
+    writer.putByte(static_cast<uint8_t>(op.type));
+    writer.putId(op.timestamp);
+    switch (op.type) {
+        case CRDTOperationType::CreateNode:
+            // nodeId == timestamp
+            writer.putString(op.key);
+            break;
+        case CRDTOperationType::DeleteNode:
+        case CRDTOperationType::RestoreNode:
+            writer.putId(op.nodeId);
+            break;
+        case CRDTOperationType::SetProperty:
+            writer.putId(op.nodeId);
+            writer.putString(op.key);
+            writer.putString(op.value);
+            break;
+        case CRDTOperationType::AddChild:
+        case CRDTOperationType::RemoveChild:
+            writer.putId(op.nodeId);
+            writer.putId(op.childId);
+            break;
+        case CRDTOperationType::InsertText:
+            writer.putId(op.nodeId);
+            writer.putId(op.childId);
+            writer.putString(op.value);
+            break;
+        case CRDTOperationType::DeleteText:
+            // The last character shares the first one's site
+            writer.putId(op.nodeId);
+            writer.putVarint(op.childId.logicalClock - op.timestamp.logicalClock + 1);
+            break;
+        case CRDTOperationType::CloneSubtree:
+            // Same range encoding as DeleteText; the digest as raw bits
+            writer.putId(op.nodeId);
+            writer.putVarint(op.childId.logicalClock - op.timestamp.logicalClock + 1);
+            writer.putFixed64(std::strtoull(op.value.c_str(), nullptr, 10));
+            break;
+    }
+}
+
+bool decodeOperation(ByteReader& reader, CRDTOperation& op) {
+    uint8_t type;
+    if (!reader.getByte(type) || !reader.getId(op.timestamp)) {
+        return false;
+    }
+    op.type = static_cast<CRDTOperationType>(type);
+    switch (op.type) {
+        case CRDTOperationType::CreateNode:
+            op.nodeId = op.timestamp;
+            return reader.getString(op.key);
+        case CRDTOperationType::DeleteNode:
+        case CRDTOperationType::RestoreNode:
+            return reader.getId(op.nodeId);
+        case CRDTOperationType::SetProperty:
+            return reader.getId(op.nodeId) && reader.getString(op.key) &&
+                   reader.getString(op.value);
+        case CRDTOperationType::AddChild:
+        case CRDTOperationType::RemoveChild:
+            return reader.getId(op.nodeId) && reader.getId(op.childId);
+        case CRDTOperationType::InsertText:
+            return reader.getId(op.nodeId) && reader.getId(op.childId) &&
+                   reader.getString(op.value);
+        case CRDTOperationType::DeleteText: {
+            uint64_t count;
+            if (!reader.getId(op.nodeId) || !reader.getVarint(count) || count == 0) {
+                return false;
+            }
+            op.childId = CRDTId(op.timestamp.siteId, op.timestamp.logicalClock + count - 1);
+            return true;
+        }
+        case CRDTOperationType::CloneSubtree: {
+            uint64_t count, digest;
+            if (!reader.getId(op.nodeId) || !reader.getVarint(count) || count == 0 ||
+                !reader.getFixed64(digest)) {
+                return false;
+            }
+            op.childId = CRDTId(op.timestamp.siteId, op.timestamp.logicalClock + count - 1);
+            op.value = std::to_string(digest);
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace CRDTCodec
+
+} // namespace Lienzo
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "crdt.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace Lienzo {
+
+// Compact binary encoding for CRDT nodes and operations
+// Integers are LEB128 varints, strings are length-prefixed, IDs are
+// (siteId, clock). Shared by document storage and the network layer.
+
+class ByteWriter {
+public:
+    void putByte(uint8_t value) { buffer.push_back(static_cast<char>(value)); }
+    void putVarint(uint64_t value);
+    void putString(const std::string& value);
+    void putId(const CRDTId& id);
+    void putFixed32(uint32_t value);
+    void putFixed64(uint64_t value);
+    void putBytes(const void* data, size_t size) {
+        buffer.append(static_cast<const char*>(data), size);
+    }
+    
+    const std::string& data() const { return buffer; }
+    std::string& data() { return buffer; }
+    size_t size() const { return buffer.size(); }
+    void clear() { buffer.clear(); }
+    
+private:
+    std::string buffer;
+};
+
+// Reads from a borrowed buffer; every getter returns false on truncation
+class ByteReader {
+public:
+    ByteReader(const void* data, size_t size)
+        : cursor(static_cast<const uint8_t*>(data)),
+          end(static_cast<const uint8_t*>(data) + size) {}
+    
+    bool getByte(uint8_t& value);
+    bool getVarint(uint64_t& value);
+    bool getString(std::string& value);
+    bool getId(CRDTId& id);
+    bool getFixed32(uint32_t& value);
+    bool getFixed64(uint64_t& value);
+    bool skip(size_t size);
+    
+    size_t remaining() const { return static_cast<size_t>(end - cursor); }
+    const uint8_t* position() const { return cursor; }
+    
+private:
+    const uint8_t* cursor;
+    const uint8_t* end;
+};
+
+namespace CRDTCodec {
+
+// Full node state: identity, tombstone, LWW properties and child entries
+void encodeNode(ByteWriter& writer, const CRDTNode& node);
+std::shared_ptr<CRDTNode> decodeNode(ByteReader& reader,
+                                     const CRDTNode::allocator_type& alloc = CRDTNode::allocator_type());
+
+void encodeOperation(ByteWriter& writer, const CRDTOperation& op);
+bool decodeOperation(ByteReader& reader, CRDTOperation& op);
+
+} // namespace CRDTCodec
+
+} // namespace Lienzo
@@ -0,0 +1,424 @@
+#include "document_digest.h"
+#include "crdt_codec.h"
+#include "text_sequence.h"
+
+namespace Lienzo {
+
+namespace {
+
+// FNV-1a over explicitly little-endian fields, finished with a 64-bit
+// mixer; the same on every platform, unlike std::hash
+class Hasher {
+public:
+    void add(uint64_t value) {
+        for (int i = 0; i < 8; i++) {
+            byte(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+    void add(const std::string& value) {
+        add(static_cast<uint64_t>(value.size()));
+        for (char c : value) {
+            byte(static_cast<uint8_t>(c));
+        }
+    }
+    void add(const CRDTId& id) {
+        add(id.siteId);
+        add(id.logicalClock);
+    }
+    uint64_t finish() const { return mix(hash); }
+
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return x;
+    }
+
+private:
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    void byte(uint8_t b) {
+        hash ^= b;
+        hash *= 0x100000001b3ULL;
+    }
+};
+
+enum : uint64_t {
+    kNodeTag = 1,
+    kPropertyTag,
+    kChildTag,
+    kCharacterTag
+};
+
+} // namespace
+
+DocumentDigest::DocumentDigest(CRDTDocument& document) : document(document), nodeHashes(0) {
+    listenerHandle = document.addOperationListener([this](const CRDTOperation& op, bool) {
+        onOperation(op);
+    });
+    rebuild();
+}
+
+DocumentDigest::~DocumentDigest() {
+    document.removeOperationListener(listenerHandle);
+}
+
+uint64_t DocumentDigest::hashNode(const CRDTNode& node) {
+    // Parts are summed, so property and child order do not matter
+    Hasher base;
+    base.add(kNodeTag);
+    base.add(node.getId());
+    base.add(node.getType());
+    // Restores too: replicas that missed one would let an older delete win
+    base.add(static_cast<uint64_t>(node.isDeleted() ? 1 : 0));
+    base.add(node.getDeletedTimestamp());
+    uint64_t digest = base.finish();
+    for (const auto& property : node.getProperties()) {
+        Hasher part;
+        part.add(kPropertyTag);
+        part.add(property.first);
+        part.add(property.second.value);
+        part.add(property.second.timestamp);
+        digest += part.finish();
+    }
+    for (const auto& child : node.getChildEntries()) {
+        Hasher part;
+        part.add(kChildTag);
+        part.add(child.childId);
+        part.add(child.addedTimestamp);
+        part.add(child.deleted ? child.deletedTimestamp : CRDTId());
+        digest += part.finish();
+    }
+    if (const TextSequence* text = node.getText()) {
+        // Per character: replicas may split the same characters into runs differently
+        for (const auto& run : text->getRuns()) {
+            for (size_t i = 0; i < run.chars.size(); i++) {
+                Hasher part;
+                part.add(kCharacterTag);
+                part.add(run.id.siteId);
+                part.add(run.id.logicalClock + i);
+                part.add(static_cast<uint64_t>(run.chars[i]));
+                part.add(run.deleted ? 1 : 0);
+                digest += part.finish();
+            }
+        }
+    }
+    return digest;
+}
+
+void DocumentDigest::rebuild() {
+    entries.clear();
+    ensureEntry(document.getRootId());
+    ensureEntry(unattachedId());
+    std::vector<CRDTId> ids = document.getAllNodeIds();
+    for (const auto& id : ids) {
+        ensureEntry(id);
+    }
+    for (const auto& id : ids) {
+        auto node = document.getNode(id);
+        for (const auto& child : node->getChildEntries()) {
+            addReferrer(child.childId, id);
+        }
+    }
+}
+
+DocumentDigest::Entry* DocumentDigest::findEntry(const CRDTId& id) {
+    auto it = entries.find(id.toString());
+    return it != entries.end() ? &it->second : nullptr;
+}
+
+DocumentDigest::Entry& DocumentDigest::ensureEntry(const CRDTId& id) {
+    auto inserted = entries.try_emplace(id.toString());
+    Entry& entry = inserted.first->second;
+    if (inserted.second) {
+        entry.id = id;
+        if (id != document.getRootId()) {
+            // New entries start dirty: queue them on their parent
+            Entry& parent = ensureEntry(parentOf(entry));
+            parent.children.insert(id);
+            parent.dirtyChildren.push_back(&entry);
+            markDirty(parent.id);
+        }
+    }
+    return entry;
+}
+
+CRDTId DocumentDigest::parentOf(const Entry& entry) const {
+    if (entry.id == document.getRootId()) {
+        return CRDTId();
+    }
+    if (entry.id == unattachedId()) {
+        return document.getRootId();
+    }
+    return entry.referrers.empty() ? unattachedId() : *entry.referrers.begin();
+}
+
+void DocumentDigest::addReferrer(const CRDTId& child, const CRDTId& parent) {
+    ensureEntry(parent);
+    Entry& entry = ensureEntry(child);
+    CRDTId before = parentOf(entry);
+    if (!entry.referrers.insert(parent).second) {
+        return;
+    }
+    CRDTId after = parentOf(entry);
+    if (after == before) {
+        return;
+    }
+    if (Entry* old = findEntry(before)) {
+        old->children.erase(child);
+        old->childSum -= entry.counted;
+        markDirty(before);
+    }
+    entry.counted = 0;
+    Entry& parentEntry = ensureEntry(after);
+    parentEntry.children.insert(child);
+    parentEntry.dirtyChildren.push_back(&entry);
+    markDirty(after);
+}
+
+void DocumentDigest::markDirty(const CRDTId& id) {
+    // Ancestors of a dirty entry are dirty, so the walk stops at the first
+    // one that already is (which also ends it on a parent cycle)
+    Entry* entry = findEntry(id);
+    while (entry && !entry->subtreeDirty) {
+        entry->subtreeDirty = true;
+        CRDTId parent = parentOf(*entry);
+        Entry* parentEntry = parent.siteId.empty() ? nullptr : findEntry(parent);
+        if (parentEntry) {
+            parentEntry->dirtyChildren.push_back(entry);
+        }
+        entry = parentEntry;
+    }
+}
+
+void DocumentDigest::onOperation(const CRDTOperation& op) {
+    if (op.type == CRDTOperationType::CloneSubtree) {
+        return;     // Its expansion follows
+    }
+    ensureEntry(op.nodeId).nodeDirty = true;
+    markDirty(op.nodeId);
+    if (op.type == CRDTOperationType::AddChild) {
+        addReferrer(op.childId, op.nodeId);
+    }
+}
+
+uint64_t DocumentDigest::subtreeDigest(Entry& entry) {
+    if (!entry.subtreeDirty) {
+        return entry.subtree;
+    }
+    if (entry.visiting) {
+        return 0;   // Parent cycle (each node lists the other)
+    }
+    entry.visiting = true;
+    if (entry.nodeDirty) {
+        auto node = entry.id == unattachedId() ? nullptr : document.getNode(entry.id);
+        entry.node = node ? hashNode(*node) : 0;
+        entry.nodeDirty = false;
+        nodeHashes++;
+    }
+    // Children that moved elsewhere since they were queued are skipped;
+    // one queued twice is counted once, as its old share is taken out first
+    std::vector<Entry*> changed;
+    changed.swap(entry.dirtyChildren);
+    for (Entry* child : changed) {
+        if (parentOf(*child) != entry.id) {
+            continue;
+        }
+        entry.childSum -= child->counted;
+        child->counted = subtreeDigest(*child);
+        entry.childSum += child->counted;
+    }
+    uint64_t sum = entry.node + entry.childSum;
+    entry.subtree = sum == 0 ? 0 : Hasher::mix(sum);
+    entry.subtreeDirty = false;
+    entry.visiting = false;
+    return entry.subtree;
+}
+
+uint64_t DocumentDigest::getRootDigest() {
+    return subtreeDigest(ensureEntry(document.getRootId()));
+}
+
+DigestEntry DocumentDigest::getEntry(const CRDTId& id) {
+    DigestEntry result;
+    result.id = id;
+    if (Entry* entry = findEntry(id)) {
+        result.subtree = subtreeDigest(*entry);
+        result.node = entry->node;
+    }
+    return result;
+}
+
+void DocumentDigest::getChildren(const CRDTId& id, std::vector<DigestEntry>& children) {
+    children.clear();
+    Entry* entry = findEntry(id);
+    if (!entry) {
+        return;
+    }
+    for (const auto& child : entry->children) {
+        children.push_back(getEntry(child));
+    }
+}
+
+void DocumentDigest::collectSubtree(const CRDTId& id, std::vector<CRDTId>& ids) {
+    std::vector<CRDTId> stack = {id};
+    std::unordered_set<std::string> seen;
+    while (!stack.empty()) {
+        CRDTId current = stack.back();
+        stack.pop_back();
+        Entry* entry = findEntry(current);
+        if (!entry || !seen.insert(current.toString()).second) {
+            continue;
+        }
+        if (current != unattachedId()) {
+            ids.push_back(current);
+        }
+        stack.insert(stack.end(), entry->children.begin(), entry->children.end());
+    }
+}
+
+std::string DocumentDigest::answer(const std::string& request) {
+    ByteReader reader(request.data(), request.size());
+    ByteWriter writer;
+    uint64_t count;
+    if (!reader.getVarint(count)) {
+        return std::string();
+    }
+    std::vector<DigestEntry> children;
+    CRDTId id;
+    for (uint64_t i = 0; i < count && reader.getId(id); i++) {
+        DigestEntry self = getEntry(id);
+        getChildren(id, children);
+        writer.putId(id);
+        writer.putFixed64(self.node);
+        writer.putFixed64(self.subtree);
+        writer.putVarint(children.size());
+        for (const auto& child : children) {
+            writer.putId(child.id);
+            writer.putFixed64(child.node);
+            writer.putFixed64(child.subtree);
+        }
+    }
+    return writer.data();
+}
+
+std::string DocumentDigest::encodeNodes(const std::vector<CRDTId>& ids) const {
+    ByteWriter writer;
+    ByteWriter record;
+    std::vector<std::shared_ptr<CRDTNode>> found;
+    for (const auto& id : ids) {
+        if (auto node = document.getNode(id)) {
+            found.push_back(node);
+        }
+    }
+    writer.putVarint(found.size());
+    for (const auto& node : found) {
+        record.clear();
+        CRDTCodec::encodeNode(record, *node);
+        writer.putVarint(record.size());
+        writer.putBytes(record.data().data(), record.size());
+    }
+    return writer.data();
+}
+
+bool DocumentDigest::mergeNodes(const std::string& data) {
+    ByteReader reader(data.data(), data.size());
+    uint64_t count;
+    if (!reader.getVarint(count)) {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t size;
+        if (!reader.getVarint(size) || size > reader.remaining()) {
+            return false;
+        }
+        ByteReader recordReader(reader.position(), static_cast<size_t>(size));
+        auto node = CRDTCodec::decodeNode(recordReader, document.getAllocator());
+        if (!node) {
+            return false;
+        }
+        reader.skip(static_cast<size_t>(size));
+        document.integrateNode(node);
+    }
+    return true;
+}
+
+// DigestReconciler implementation
+DigestReconciler::DigestReconciler(DocumentDigest& local) : local(local), roundTrips(0) {
+}
+
+std::string DigestReconciler::start() {
+    requested.clear();
+    divergent.clear();
+    roundTrips = 0;
+    CRDTId root = CRDTDocument::sharedRootId();
+    requested.insert(root.toString());
+    ByteWriter writer;
+    writer.putVarint(1);
+    writer.putId(root);
+    return writer.data();
+}
+
+std::string DigestReconciler::receive(const std::string& reply) {
+    roundTrips++;
+    ByteReader reader(reply.data(), reply.size());
+    std::vector<CRDTId> next;
+    std::vector<CRDTId> subtree;
+    std::vector<DigestEntry> localChildren;
+    CRDTId id;
+    while (reader.remaining() > 0) {
+        uint64_t remoteNode, remoteSubtree, childCount;
+        if (!reader.getId(id) || !reader.getFixed64(remoteNode) || !reader.getFixed64(remoteSubtree) ||
+            !reader.getVarint(childCount)) {
+            return std::string();
+        }
+        DigestEntry mine = local.getEntry(id);
+        if (remoteSubtree == 0 && remoteNode == 0) {
+            // The remote side has none of it
+            subtree.clear();
+            local.collectSubtree(id, subtree);
+            divergent.insert(subtree.begin(), subtree.end());
+            continue;
+        }
+        if (mine.node != remoteNode && id != DocumentDigest::unattachedId()) {
+            divergent.insert(id);
+        }
+
+        // Descend into children whose subtrees differ, whichever side has them
+        std::set<CRDTId> seen;
+        for (uint64_t i = 0; i < childCount; i++) {
+            CRDTId child;
+            uint64_t childNode, childSubtree;
+            if (!reader.getId(child) || !reader.getFixed64(childNode) || !reader.getFixed64(childSubtree)) {
+                return std::string();
+            }
+            seen.insert(child);
+            if (local.getEntry(child).subtree != childSubtree && requested.insert(child.toString()).second) {
+                next.push_back(child);
+            }
+        }
+        local.getChildren(id, localChildren);
+        for (const auto& child : localChildren) {
+            if (!seen.count(child.id) && requested.insert(child.id.toString()).second) {
+                next.push_back(child.id);
+            }
+        }
+    }
+    if (next.empty()) {
+        return std::string();
+    }
+    ByteWriter writer;
+    writer.putVarint(next.size());
+    for (const auto& child : next) {
+        writer.putId(child);
+    }
+    return writer.data();
+}
+
+std::vector<CRDTId> DigestReconciler::getDivergentNodes() const {
+    return std::vector<CRDTId>(divergent.begin(), divergent.end());
+}
+
+} // namespace Lienzo
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "crdt.h"
+#include <cstdint>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Lienzo {
+
+struct DigestEntry {
+    CRDTId id;
+    uint64_t node = 0;      // The node's own state; 0 if this replica does not have it
+    uint64_t subtree = 0;   // The node and everything below it in the digest tree
+};
+
+// Incremental hash tree over a CRDTDocument, for anti-entropy
+//
+// Every node has a digest of its full CRDT state (properties with their
+// timestamps, child entries, tombstone, text characters), independent of
+// the order things arrived in. Digests roll up the document tree: a
+// node's subtree digest covers its own and its children's, up to the
+// root. A node listed by several parents counts under the smallest parent
+// ID; nodes no one lists hang off a virtual group under the root
+// (unattachedId()). Two replicas with equal root digests hold the same
+// state; otherwise the differences are found by descending only into
+// subtrees whose digests differ (see DigestReconciler).
+//
+// Operations only mark the node and its ancestors dirty; digests are
+// recomputed when asked for. Each entry keeps the sum of its children's
+// subtree digests and a list of the children that changed, so a
+// recomputation costs O(changed nodes x depth), not O(fanout).
+class DocumentDigest {
+public:
+    explicit DocumentDigest(CRDTDocument& document);
+    ~DocumentDigest();
+    DocumentDigest(const DocumentDigest&) = delete;
+    DocumentDigest& operator=(const DocumentDigest&) = delete;
+
+    uint64_t getRootDigest();
+    // Digests of any node, wherever it sits; zeros if unknown
+    DigestEntry getEntry(const CRDTId& id);
+    // Children of id in the digest tree, sorted by ID
+    void getChildren(const CRDTId& id, std::vector<DigestEntry>& children);
+    // id and every node below it in the digest tree
+    void collectSubtree(const CRDTId& id, std::vector<CRDTId>& ids);
+
+    static CRDTId unattachedId() { return CRDTId("unattached", 0); }
+
+    // Reply to a DigestReconciler request: for every requested ID, its
+    // digests and its children's
+    std::string answer(const std::string& request);
+
+    // Full state of the given nodes (those this replica has), and the
+    // other side of it: merge such a message into the document
+    std::string encodeNodes(const std::vector<CRDTId>& ids) const;
+    bool mergeNodes(const std::string& data);
+
+    // Recompute everything from the document
+    void rebuild();
+
+    // Digest of one node's state
+    static uint64_t hashNode(const CRDTNode& node);
+
+    // Statistics
+    size_t getNodeHashes() const { return nodeHashes; }
+
+private:
+    struct Entry {
+        CRDTId id;
+        std::set<CRDTId> referrers;     // Nodes with a child entry for this one
+        std::set<CRDTId> children;      // Entries whose digest parent this is
+        std::vector<Entry*> dirtyChildren;
+        uint64_t node = 0;
+        uint64_t subtree = 0;
+        uint64_t childSum = 0;          // Sum of the children's counted digests
+        uint64_t counted = 0;           // This subtree's share of the parent's childSum
+        bool nodeDirty = true;
+        bool subtreeDirty = true;
+        bool visiting = false;
+    };
+
+    CRDTDocument& document;
+    size_t listenerHandle;
+    std::unordered_map<std::string, Entry> entries;     // key: id.toString()
+    size_t nodeHashes;
+
+    void onOperation(const CRDTOperation& op);
+    Entry& ensureEntry(const CRDTId& id);
+    Entry* findEntry(const CRDTId& id);
+    CRDTId parentOf(const Entry& entry) const;
+    void addReferrer(const CRDTId& child, const CRDTId& parent);
+    void markDirty(const CRDTId& id);
+    uint64_t subtreeDigest(Entry& entry);
+};
+
+// Finds the nodes that differ between this replica and a remote one,
+// through DocumentDigest::answer on the remote side
+//
+//   request = reconciler.start();
+//   while (!request.empty()) request = reconciler.receive(remote.answer(request));
+//
+// Each round trip descends one level, and only into subtrees whose
+// digests differ, so the exchange grows with the number of differences
+// and the depth of the tree rather than the document size. Afterwards
+// both sides swap encodeNodes(getDivergentNodes()) and merge them.
+class DigestReconciler {
+public:
+    explicit DigestReconciler(DocumentDigest& local);
+
+    // The first request (the root's digests)
+    std::string start();
+    // Take a reply; returns the next request, or empty when done
+    std::string receive(const std::string& reply);
+
+    // Nodes whose state differs, or that only one side has, sorted
+    std::vector<CRDTId> getDivergentNodes() const;
+    size_t getRoundTrips() const { return roundTrips; }
+
+private:
+    DocumentDigest& local;
+    std::unordered_set<std::string> requested;
+    std::set<CRDTId> divergent;
+    size_t roundTrips;
+};
+
+} // namespace Lienzo
@@ -0,0 +1,60 @@
+#include "document_memory.h"
+
+namespace Lienzo {
+
+// Pool options tuned for CRDT nodes: most blocks (nodes, hash buckets,
+// property entries, child entries) are well under 512 bytes
+static std::pmr::pool_options documentPoolOptions() {
+    std::pmr::pool_options options;
+    options.max_blocks_per_chunk = 4096;
+    options.largest_required_pool_block = 512;
+    return options;
+}
+
+void* DocumentMemoryResource::CountingUpstream::do_allocate(size_t bytes, size_t alignment) {
+    void* p = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    bytesReserved += bytes;
+    return p;
+}
+
+void DocumentMemoryResource::CountingUpstream::do_deallocate(void* p, size_t bytes,
+                                                             size_t alignment) {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    bytesReserved -= bytes;
+}
+
+bool DocumentMemoryResource::CountingUpstream::do_is_equal(
+    const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+DocumentMemoryResource::DocumentMemoryResource()
+    : upstream(), pool(documentPoolOptions(), &upstream),
+      bytesInUse(0), peakBytesInUse(0), allocationCount(0) {
+}
+
+DocumentMemoryResource::~DocumentMemoryResource() {
+    pool.release();
+}
+
+void* DocumentMemoryResource::do_allocate(size_t bytes, size_t alignment) {
+    void* p = pool.allocate(bytes, alignment);
+    bytesInUse += bytes;
+    allocationCount++;
+    if (bytesInUse > peakBytesInUse) {
+        peakBytesInUse = bytesInUse;
+    }
+    return p;
+}
+
+void DocumentMemoryResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    pool.deallocate(p, bytes, alignment);
+    bytesInUse -= bytes;
+    allocationCount--;
+}
+
+bool DocumentMemoryResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+} // namespace Lienzo
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace Lienzo {
+
+// Memory usage snapshot for a single CRDTDocument
+struct DocumentMemoryUsage {
+    size_t nodeCount = 0;
+    size_t bytesInUse = 0;      // Bytes currently handed out to nodes, properties and children
+    size_t peakBytesInUse = 0;  // High-water mark of bytesInUse
+    size_t bytesReserved = 0;   // Bytes obtained from the system by the pools
+    size_t allocationCount = 0; // Live allocations served by the pools
+};
+
+// Document-owned memory resource
+// Nodes, property maps and child lists of one document are carved out of
+// size-class pools backed by large chunks, instead of one heap allocation
+// each. Everything is released at once when the document goes away.
+// Not thread-safe: a document is only mutated from one thread.
+class DocumentMemoryResource : public std::pmr::memory_resource {
+public:
+    DocumentMemoryResource();
+    ~DocumentMemoryResource() override;
+
+    DocumentMemoryResource(const DocumentMemoryResource&) = delete;
+    DocumentMemoryResource& operator=(const DocumentMemoryResource&) = delete;
+
+    size_t getBytesInUse() const { return bytesInUse; }
+    size_t getPeakBytesInUse() const { return peakBytesInUse; }
+    size_t getBytesReserved() const { return upstream.bytesReserved; }
+    size_t getAllocationCount() const { return allocationCount; }
+
+private:
+    // Counts what the pools request from the system heap
+    class CountingUpstream : public std::pmr::memory_resource {
+    public:
+        size_t bytesReserved = 0;
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+    };
+
+    CountingUpstream upstream;
+    std::pmr::unsynchronized_pool_resource pool;
+    size_t bytesInUse;
+    size_t peakBytesInUse;
+    size_t allocationCount;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+} // namespace Lienzo
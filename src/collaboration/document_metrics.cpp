@@ -0,0 +1,24 @@
+#include "document_metrics.h"
+
+namespace Lienzo {
+
+void DocumentCounters::recordMerge(uint64_t micros) {
+    merges++;
+    mergeMicros += micros;
+    size_t bucket = 0;
+    while (bucket + 1 < kLatencyBuckets && micros >= (uint64_t(1) << bucket)) {
+        bucket++;
+    }
+    mergeLatency[bucket]++;
+}
+
+size_t DocumentMetrics::getLiveNodes(const std::string& type) const {
+    for (const auto& entry : liveNodesByType) {
+        if (entry.first == type) {
+            return entry.second;
+        }
+    }
+    return 0;
+}
+
+} // namespace Lienzo
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "document_memory.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Lienzo {
+
+// Counters a CRDTDocument keeps on its hot paths (plain increments)
+struct DocumentCounters {
+    static const size_t kLatencyBuckets = 20;
+
+    uint64_t localOperations = 0;
+    uint64_t remoteOperations = 0;      // Received operations that changed the document
+    uint64_t rejectedOperations = 0;    // ... that changed nothing (duplicate, stale, unknown target)
+    uint64_t merges = 0;
+    uint64_t mergeMicros = 0;           // Total time spent merging
+    // Merges by duration: bucket i counts those under 2^i microseconds,
+    // the last bucket everything slower
+    uint64_t mergeLatency[kLatencyBuckets] = {};
+
+    void recordMerge(uint64_t micros);
+};
+
+// Point-in-time view of one document, for dashboards
+// Counters and clocks are kept as operations arrive; node, property and
+// child counts come from a scan of the resident nodes at poll time.
+// Operation rates are the difference between two polls' counters.
+struct DocumentMetrics {
+    DocumentCounters counters;
+    DocumentMemoryUsage memory;
+
+    // Resident nodes only; nodes still in a lazy node source are not loaded
+    size_t residentNodes = 0;
+    size_t liveNodes = 0;
+    size_t deletedNodes = 0;
+    std::vector<std::pair<std::string, size_t>> liveNodesByType;    // Sorted by type
+    size_t properties = 0;
+    size_t liveChildEntries = 0;
+    size_t removedChildEntries = 0;
+    size_t textCharacters = 0;          // Visible characters in text sequences
+    size_t textRuns = 0;                // Runs in text sequences, tombstones included
+
+    // This replica's clock, and the highest clock seen from each site in
+    // received operations, merges and snapshots (this site included)
+    uint64_t logicalClock = 0;
+    std::vector<std::pair<std::string, uint64_t>> siteClocks;     // Sorted by site
+
+    size_t getLiveNodes(const std::string& type) const;
+};
+
+} // namespace Lienzo
@@ -0,0 +1,411 @@
+#include "document_store.h"
+
+#ifndef __EMSCRIPTEN__
+
+#include "crdt_codec.h"
+#include "text_sequence.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Lienzo {
+
+namespace {
+
+const char kMagic[8] = {'L', 'I', 'E', 'N', 'Z', 'O', 'D', 'B'};
+const uint32_t kVersion = 1;
+
+struct StoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t pageSize;
+    uint64_t recordsOffset;
+    uint64_t recordsSize;
+    uint64_t siteTableOffset;
+    uint64_t siteTableSize;
+    uint64_t indexOffset;
+    uint64_t indexCount;
+    uint64_t logOffset;
+};
+
+uint64_t pageAlign(uint64_t offset) {
+    uint64_t page = MappedDocumentStore::kPageSize;
+    return (offset + page - 1) / page * page;
+}
+
+void padTo(std::string& buffer, uint64_t offset) {
+    buffer.resize(static_cast<size_t>(offset), '\0');
+}
+
+bool writeAll(int fd, const char* data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t written = ::pwrite(fd, data, size, offset);
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+        offset += written;
+    }
+    return true;
+}
+
+} // namespace
+
+MappedDocumentStore::MappedDocumentStore()
+    : fd(-1), mapping(nullptr), mappingSize(0), index(nullptr), indexCount(0),
+      logEnd(0), attachedDocument(nullptr), listenerHandle(0),
+      loadedNodeCount(0), loggedOperationCount(0) {
+}
+
+MappedDocumentStore::~MappedDocumentStore() {
+    // While attached, the document holds a reference to this store, so the
+    // document's listener never outlives it
+    if (mapping) {
+        ::munmap(const_cast<uint8_t*>(mapping), mappingSize);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+bool MappedDocumentStore::write(const std::string& path, const CRDTDocument& doc) {
+    doc.loadAllNodes();
+    std::vector<CRDTId> ids = doc.getAllNodeIds();
+    std::sort(ids.begin(), ids.end());
+
+    // Site table: every site that appears in an ID or timestamp, with the
+    // highest clock it used, so a reopening site resumes past its own edits
+    std::map<std::string, uint64_t> clocks;
+    auto observe = [&clocks](const CRDTId& stamp) {
+        if (!stamp.siteId.empty()) {
+            uint64_t& clock = clocks[stamp.siteId];
+            clock = std::max(clock, stamp.logicalClock);
+        }
+    };
+    for (const auto& id : ids) {
+        auto node = doc.getNode(id);
+        observe(id);
+        for (const auto& prop : node->getProperties()) {
+            observe(prop.second.timestamp);
+        }
+        for (const auto& child : node->getChildEntries()) {
+            observe(child.addedTimestamp);
+            observe(child.deletedTimestamp);
+        }
+        observe(node->getDeletedTimestamp());
+        if (node->getText()) {
+            std::unordered_map<std::string, uint64_t> textClocks;
+            node->getText()->getSiteClocks(textClocks);
+            for (const auto& pair : textClocks) {
+                observe(CRDTId(pair.first, pair.second));
+            }
+        }
+    }
+    std::vector<std::string> siteNames;
+    for (const auto& pair : clocks) {
+        siteNames.push_back(pair.first);
+    }
+
+    std::string file(sizeof(StoreHeader), '\0');
+    StoreHeader header = {};
+    std::copy(kMagic, kMagic + 8, header.magic);
+    header.version = kVersion;
+    header.pageSize = kPageSize;
+
+    // Node records, in index order
+    header.recordsOffset = pageAlign(file.size());
+    padTo(file, header.recordsOffset);
+    std::vector<IndexEntry> entries;
+    entries.reserve(ids.size());
+    ByteWriter writer;
+    size_t siteIndex = 0;
+    for (const auto& id : ids) {
+        auto node = doc.getNode(id);
+        while (siteNames[siteIndex] != id.siteId) {
+            siteIndex++;
+        }
+        writer.clear();
+        CRDTCodec::encodeNode(writer, *node);
+
+        IndexEntry entry;
+        entry.siteIndex = static_cast<uint32_t>(siteIndex);
+        entry.length = static_cast<uint32_t>(writer.size());
+        entry.clock = id.logicalClock;
+        entry.offset = file.size();
+        entries.push_back(entry);
+        file.append(writer.data());
+    }
+    header.recordsSize = file.size() - header.recordsOffset;
+
+    // Site table
+    header.siteTableOffset = file.size();
+    writer.clear();
+    writer.putVarint(clocks.size());
+    for (const auto& pair : clocks) {
+        writer.putString(pair.first);
+        writer.putVarint(pair.second);
+    }
+    file.append(writer.data());
+    header.siteTableSize = writer.size();
+
+    // Index
+    header.indexOffset = pageAlign(file.size());
+    padTo(file, header.indexOffset);
+    header.indexCount = entries.size();
+    file.append(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(IndexEntry));
+
+    // Empty op log
+    header.logOffset = pageAlign(file.size());
+    padTo(file, header.logOffset);
+    std::copy(reinterpret_cast<const char*>(&header),
+              reinterpret_cast<const char*>(&header) + sizeof(header), file.begin());
+
+    // Write to a temporary file and rename so readers never see a partial store
+    std::string tempPath = path + ".tmp";
+    int out = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        return false;
+    }
+    bool ok = writeAll(out, file.data(), file.size(), 0) && ::fsync(out) == 0;
+    ::close(out);
+    if (!ok || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        ::unlink(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<MappedDocumentStore> MappedDocumentStore::open(const std::string& path) {
+    std::shared_ptr<MappedDocumentStore> store(new MappedDocumentStore());
+    if (!store->mapFile(path)) {
+        return nullptr;
+    }
+    return store;
+}
+
+bool MappedDocumentStore::mapFile(const std::string& path) {
+    fd = ::open(path.c_str(), O_RDWR);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(StoreHeader)) {
+        return false;
+    }
+    mappingSize = static_cast<size_t>(info.st_size);
+    void* mapped = ::mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        mappingSize = 0;
+        return false;
+    }
+    mapping = static_cast<const uint8_t*>(mapped);
+
+    StoreHeader header;
+    std::copy(mapping, mapping + sizeof(header), reinterpret_cast<uint8_t*>(&header));
+    if (!std::equal(kMagic, kMagic + 8, header.magic) || header.version != kVersion ||
+        header.pageSize != kPageSize || header.logOffset > mappingSize ||
+        header.siteTableOffset + header.siteTableSize > mappingSize ||
+        header.indexOffset + header.indexCount * sizeof(IndexEntry) > mappingSize) {
+        return false;
+    }
+
+    // Site table
+    ByteReader reader(mapping + header.siteTableOffset, static_cast<size_t>(header.siteTableSize));
+    uint64_t siteCount;
+    if (!reader.getVarint(siteCount)) {
+        return false;
+    }
+    sites.resize(static_cast<size_t>(siteCount));
+    for (uint64_t i = 0; i < siteCount; i++) {
+        uint64_t clock;
+        if (!reader.getString(sites[i]) || !reader.getVarint(clock)) {
+            return false;
+        }
+        siteClocks[sites[i]] = clock;
+    }
+
+    // The index is used in place, straight from the mapping
+    index = reinterpret_cast<const IndexEntry*>(mapping + header.indexOffset);
+    indexCount = static_cast<size_t>(header.indexCount);
+
+    // Advise the kernel that record access is random
+    ::madvise(const_cast<uint8_t*>(mapping), mappingSize, MADV_RANDOM);
+
+    return readLog(header.logOffset);
+}
+
+bool MappedDocumentStore::readLog(uint64_t logOffset) {
+    // Operations are small; group them by target so loadNode can replay
+    // them after decoding the node's record
+    uint64_t offset = logOffset;
+    while (offset + 4 <= mappingSize) {
+        ByteReader frame(mapping + offset, mappingSize - static_cast<size_t>(offset));
+        uint32_t length;
+        frame.getFixed32(length);
+        if (length > frame.remaining()) {
+            break; // Torn write at the tail; overwritten by the next append
+        }
+        CRDTOperation op;
+        ByteReader payload(frame.position(), length);
+        if (!CRDTCodec::decodeOperation(payload, op)) {
+            break;
+        }
+        offset += 4 + length;
+        loggedOperationCount++;
+
+        uint64_t& clock = siteClocks[op.timestamp.siteId];
+        clock = std::max(clock, op.type == CRDTOperationType::InsertText
+            ? op.timestamp.logicalClock + std::max<size_t>(TextSequence::decodeUtf8(op.value).size(), 1) - 1
+            : op.timestamp.logicalClock);
+
+        std::string key = op.nodeId.toString();
+        if (op.type == CRDTOperationType::CreateNode) {
+            if (!findEntry(op.nodeId)) {
+                logOnlyNodes[key] = LogNode{op.nodeId, op.key};
+            }
+        } else {
+            pendingOperations[key].push_back(std::move(op));
+        }
+    }
+    logEnd = offset;
+
+    // Drop a torn tail so appends never leave stale bytes behind them
+    if (logEnd < mappingSize && ::ftruncate(fd, static_cast<off_t>(logEnd)) != 0) {
+        return false;
+    }
+    return true;
+}
+
+const MappedDocumentStore::IndexEntry* MappedDocumentStore::findEntry(const CRDTId& id) const {
+    auto site = std::lower_bound(sites.begin(), sites.end(), id.siteId);
+    if (site == sites.end() || *site != id.siteId) {
+        return nullptr;
+    }
+    uint32_t siteIndex = static_cast<uint32_t>(site - sites.begin());
+    const IndexEntry* first = index;
+    const IndexEntry* last = index + indexCount;
+    const IndexEntry* entry = std::lower_bound(first, last, std::make_pair(siteIndex, id.logicalClock),
+        [](const IndexEntry& e, const std::pair<uint32_t, uint64_t>& key) {
+            return e.siteIndex < key.first ||
+                   (e.siteIndex == key.first && e.clock < key.second);
+        });
+    if (entry != last && entry->siteIndex == siteIndex && entry->clock == id.logicalClock) {
+        return entry;
+    }
+    return nullptr;
+}
+
+void MappedDocumentStore::applyPending(const std::string& key, CRDTNode& node) {
+    auto it = pendingOperations.find(key);
+    if (it != pendingOperations.end()) {
+        for (const auto& op : it->second) {
+            node.applyOperation(op);
+        }
+        pendingOperations.erase(it);
+    }
+}
+
+std::shared_ptr<CRDTNode> MappedDocumentStore::loadNode(const CRDTId& id,
+                                                        const CRDTNode::allocator_type& alloc) {
+    std::string key = id.toString();
+    std::shared_ptr<CRDTNode> node;
+    const IndexEntry* entry = findEntry(id);
+    if (entry) {
+        if (entry->offset + entry->length > mappingSize) {
+            return nullptr;
+        }
+        ByteReader reader(mapping + entry->offset, entry->length);
+        node = CRDTCodec::decodeNode(reader, alloc);
+    } else {
+        auto logNode = logOnlyNodes.find(key);
+        if (logNode == logOnlyNodes.end()) {
+            return nullptr;
+        }
+        node = std::allocate_shared<CRDTNode>(
+            std::pmr::polymorphic_allocator<CRDTNode>(alloc.resource()),
+            logNode->second.id, logNode->second.type);
+        logOnlyNodes.erase(logNode);
+    }
+    if (node) {
+        applyPending(key, *node);
+        loadedNodeCount++;
+    }
+    return node;
+}
+
+std::vector<CRDTId> MappedDocumentStore::getNodeIds() const {
+    std::vector<CRDTId> ids;
+    ids.reserve(indexCount + logOnlyNodes.size());
+    for (size_t i = 0; i < indexCount; i++) {
+        ids.push_back(CRDTId(sites[index[i].siteIndex], index[i].clock));
+    }
+    for (const auto& pair : logOnlyNodes) {
+        ids.push_back(pair.second.id);
+    }
+    return ids;
+}
+
+void MappedDocumentStore::attach(CRDTDocument& doc) {
+    detach();
+    attachedDocument = &doc;
+
+    // Resume the local clock past everything in the store: nodes are
+    // faulted in lazily, so the document would not see their timestamps
+    // before its next local write
+    for (const auto& site : siteClocks) {
+        doc.advanceClock(site.second);
+    }
+
+    doc.setNodeSource(shared_from_this());
+    listenerHandle = doc.addOperationListener([this](const CRDTOperation& op, bool) {
+        // Clones are logged as the operations they expand to, so replay never
+        // depends on the source matching
+        if (op.type != CRDTOperationType::CloneSubtree) {
+            appendOperation(op);
+        }
+    });
+}
+
+void MappedDocumentStore::detach() {
+    if (!attachedDocument) {
+        return;
+    }
+    attachedDocument->loadAllNodes();
+    attachedDocument->removeOperationListener(listenerHandle);
+    CRDTDocument* doc = attachedDocument;
+    attachedDocument = nullptr;
+    doc->setNodeSource(nullptr); // May release the last reference to this store
+}
+
+bool MappedDocumentStore::appendOperation(const CRDTOperation& op) {
+    ByteWriter writer;
+    writer.putFixed32(0);
+    CRDTCodec::encodeOperation(writer, op);
+    uint32_t length = static_cast<uint32_t>(writer.size() - 4);
+    std::string& frame = writer.data();
+    for (int i = 0; i < 4; i++) {
+        frame[i] = static_cast<char>(length >> (8 * i));
+    }
+
+    // Positional write at the end of the last complete record; existing
+    // data (and the mapping) is never touched
+    if (!writeAll(fd, frame.data(), frame.size(), static_cast<off_t>(logEnd))) {
+        return false;
+    }
+    logEnd += frame.size();
+    loggedOperationCount++;
+    return true;
+}
+
+bool MappedDocumentStore::flush() {
+    return ::fdatasync(fd) == 0;
+}
+
+} // namespace Lienzo
+
+#endif // __EMSCRIPTEN__
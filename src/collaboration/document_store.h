@@ -0,0 +1,101 @@
+#pragma once
+
+#include "crdt.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Lienzo {
+
+// Memory-mapped document file for native tooling (not built for WASM)
+//
+// File layout, little-endian:
+//   page 0      header
+//   records     node records (CRDTCodec::encodeNode), starting on a page boundary
+//   site table  site IDs, sorted, with the highest clock stored per site
+//   index       fixed-size entries sorted by (site, clock), page-aligned
+//   op log      [u32 length][CRDTCodec::encodeOperation] records up to EOF,
+//               starting on a page boundary; new operations are appended here
+//
+// Opening maps the file and reads the header, site table and op log only.
+// Node records stay on disk until the attached document asks for them, so
+// opening cost does not depend on the number of nodes.
+class MappedDocumentStore : public CRDTNodeSource,
+                            public std::enable_shared_from_this<MappedDocumentStore> {
+public:
+    static const uint32_t kPageSize = 4096;
+
+    ~MappedDocumentStore() override;
+
+    // Write the full state of doc as a new store file at path
+    static bool write(const std::string& path, const CRDTDocument& doc);
+
+    // Map an existing store file; nullptr if missing or malformed
+    static std::shared_ptr<MappedDocumentStore> open(const std::string& path);
+
+    // Back doc with this store: nodes are faulted in on first access and
+    // every change to doc is appended to the op log
+    void attach(CRDTDocument& doc);
+    // Load everything into the document and stop logging its changes
+    void detach();
+
+    // Append one operation to the op log without rewriting the file
+    bool appendOperation(const CRDTOperation& op);
+    // Flush appended operations to disk
+    bool flush();
+
+    // CRDTNodeSource
+    std::shared_ptr<CRDTNode> loadNode(const CRDTId& id,
+                                       const CRDTNode::allocator_type& alloc) override;
+    std::vector<CRDTId> getNodeIds() const override;
+
+    // Statistics
+    size_t getIndexedNodeCount() const { return indexCount; }
+    size_t getLoadedNodeCount() const { return loadedNodeCount; }
+    size_t getLoggedOperationCount() const { return loggedOperationCount; }
+    uint64_t getFileSize() const { return logEnd; }
+
+private:
+    // On-disk index entry; 24 bytes keeps the 64-bit fields aligned
+    struct IndexEntry {
+        uint32_t siteIndex;
+        uint32_t length;
+        uint64_t clock;
+        uint64_t offset;
+    };
+
+    MappedDocumentStore();
+
+    int fd;
+    const uint8_t* mapping;
+    size_t mappingSize;
+
+    std::vector<std::string> sites;       // Sorted site table the index refers to
+    std::unordered_map<std::string, uint64_t> siteClocks; // Highest clock per site
+    const IndexEntry* index;
+    size_t indexCount;
+    uint64_t logEnd;                      // Offset just past the last complete op
+
+    // Logged operations not yet applied to a loaded node, by target node
+    std::unordered_map<std::string, std::vector<CRDTOperation>> pendingOperations;
+    // Nodes created after the store was written (only in the op log)
+    struct LogNode {
+        CRDTId id;
+        std::string type;
+    };
+    std::unordered_map<std::string, LogNode> logOnlyNodes;
+
+    CRDTDocument* attachedDocument;
+    size_t listenerHandle;
+    size_t loadedNodeCount;
+    size_t loggedOperationCount;
+
+    bool mapFile(const std::string& path);
+    bool readLog(uint64_t logOffset);
+    const IndexEntry* findEntry(const CRDTId& id) const;
+    void applyPending(const std::string& key, CRDTNode& node);
+};
+
+} // namespace Lienzo
@@ -1,39 +1,419 @@
 #include "dom_graph.h"
-#include <sstream>
+#include <algorithm>
 
 namespace Lienzo {
 
-DOMGraph::DOMGraph() {
-    root = std::make_shared<DOMNode>("root", "root");
-    nodeMap["root"] = root;
+const uint32_t DOMGraph::kNone;
+const uint32_t DOMGraph::kPlacing;
+
+DOMGraph::DOMGraph(CRDTDocument& document)
+    : document(document), structureVersion(0), contentVersion(0), patchCount(0), rebuildCount(0) {
+    listenerHandle = document.addOperationListener([this](const CRDTOperation& op, bool) {
+        onOperation(op);
+    });
+    rebuild();
 }
 
-std::shared_ptr<DOMNode> DOMGraph::createNode(const std::string& type) {
-    // TODO: Generate unique ID
-    std::string id = "node_" + std::to_string(nodeMap.size());
-    auto node = std::make_shared<DOMNode>(id, type);
-    nodeMap[id] = node;
-    return node;
+DOMGraph::~DOMGraph() {
+    document.removeOperationListener(listenerHandle);
 }
 
-void DOMGraph::addChild(std::shared_ptr<DOMNode> parent, std::shared_ptr<DOMNode> child) {
-    if (parent && child) {
-        parent->children.push_back(child);
+uint32_t DOMGraph::indexOf(const CRDTId& id) const {
+    auto it = handles.find(id.toString());
+    if (it == handles.end()) {
+        return kNone;
     }
+    return positions[it->second];
 }
 
-void DOMGraph::applyOperation(const std::string& operation) {
-    // TODO: Implement operation transformation
+uint32_t DOMGraph::handleFor(const CRDTId& id) {
+    auto result = handles.emplace(id.toString(), static_cast<uint32_t>(slots.size()));
+    if (result.second) {
+        slots.push_back(Slot{id, nullptr, 0, 0, kNone});
+        positions.push_back(kNone);
+    }
+    return result.first->second;
 }
 
-std::string DOMGraph::serialize() const {
-    // TODO: Implement serialization
-    return "";
+const CRDTNode* DOMGraph::resolve(uint32_t handle) {
+    Slot& slot = slots[handle];
+    if (!slot.node) {
+        slot.node = document.getNode(slot.id);
+    }
+    return slot.node.get();
 }
 
-void DOMGraph::deserialize(const std::string& data) {
-    // TODO: Implement deserialization
+void DOMGraph::rebuild() {
+    nodes.clear();
+    std::fill(positions.begin(), positions.end(), kNone);
+    for (auto& slot : slots) {
+        slot.references = 0;
+    }
+    waiting.clear();
+
+    uint32_t root = handleFor(document.getRootId());
+    const CRDTNode* rootNode = resolve(root);
+    if (rootNode && !rootNode->isDeleted()) {
+        std::vector<Node> fragment;
+        collect(root, kPlacing, fragment);
+        splice(kNone, 0, kNone, fragment);
+    }
+    rebuildCount++;
+    structureVersion++;
 }
 
-} // namespace Lienzo
+void DOMGraph::onOperation(const CRDTOperation& op) {
+    bool consistent = true;
+    switch (op.type) {
+        case CRDTOperationType::CreateNode: {
+            // Visible parents may have been waiting for this node
+            auto handle = handles.find(op.nodeId.toString());
+            if (handle == handles.end()) {
+                break;
+            }
+            Slot& slot = slots[handle->second];
+            if (slot.node && slot.node != document.getNode(op.nodeId)) {
+                // The entry was replaced: a view of the old node cannot be
+                // patched into one of the new
+                slot.node = nullptr;
+                if (positions[handle->second] != kNone) {
+                    consistent = false;
+                    break;
+                }
+            }
+            auto parents = waiting.find(handle->second);
+            if (parents == waiting.end()) {
+                break;
+            }
+            std::vector<uint32_t> waitingParents = std::move(parents->second);
+            waiting.erase(parents);
+            for (uint32_t parent : waitingParents) {
+                if (!attach(parent, handle->second)) {
+                    consistent = false;
+                    break;
+                }
+            }
+            break;
+        }
+        case CRDTOperationType::DeleteNode: {
+            uint32_t position = indexOf(op.nodeId);
+            if (position != kNone) {
+                uint32_t parent = nodes[position].parent;
+                if (parent != kNone) {
+                    slots[nodes[position].handle].parentHint = nodes[parent].handle;
+                }
+                consistent = detach(position);
+            }
+            break;
+        }
+        case CRDTOperationType::RestoreNode: {
+            auto handle = handles.find(op.nodeId.toString());
+            if (handle == handles.end() || positions[handle->second] != kNone) {
+                break;
+            }
+            uint32_t hint = slots[handle->second].parentHint;
+            if (hint != kNone && positions[hint] != kNone) {
+                consistent = attach(hint, handle->second);
+            }
+            // Still referenced by a visible parent other than the hint
+            if (consistent && positions[handle->second] == kNone && slots[handle->second].references > 0) {
+                consistent = false;
+            }
+            break;
+        }
+        case CRDTOperationType::AddChild: {
+            uint32_t parentPosition = indexOf(op.nodeId);
+            if (parentPosition == kNone) {
+                break;
+            }
+            uint32_t parentHandle = nodes[parentPosition].handle;
+            uint32_t child = handleFor(op.childId);
+            uint32_t position = positions[child];
+            if (position != kNone && nodes[position].parent == parentPosition) {
+                // Added again: the entry moved to the end of its siblings
+                slots[child].references--;
+                consistent = detach(position);
+                slots[child].references++;
+                consistent = consistent && attach(parentHandle, child);
+                break;
+            }
+            slots[child].references++;
+            consistent = attach(parentHandle, child);
+            break;
+        }
+        case CRDTOperationType::RemoveChild: {
+            uint32_t parentPosition = indexOf(op.nodeId);
+            if (parentPosition == kNone) {
+                break;
+            }
+            // Only an entry shown under this parent is known to have been
+            // live (a tombstone can be re-stamped); otherwise the count stays
+            // high, which at worst costs a rebuild later
+            uint32_t child = handleFor(op.childId);
+            uint32_t position = positions[child];
+            if (position == kNone || nodes[position].parent != parentPosition) {
+                break;
+            }
+            // A removal older than the latest add leaves the entry live
+            for (const auto& entry : nodes[parentPosition].node->getChildEntries()) {
+                if (entry.childId == op.childId && entry.deleted) {
+                    slots[child].references--;
+                    consistent = detach(position);
+                    break;
+                }
+            }
+            break;
+        }
+        case CRDTOperationType::SetProperty:
+        case CRDTOperationType::InsertText:
+        case CRDTOperationType::DeleteText: {
+            auto handle = handles.find(op.nodeId.toString());
+            if (handle != handles.end()) {
+                slots[handle->second].version++;
+                contentVersion++;
+            }
+            break;
+        }
+        case CRDTOperationType::CloneSubtree:
+            // Its expansion follows
+            break;
+    }
+    if (!consistent) {
+        rebuild();
+    }
+}
+
+bool DOMGraph::attach(uint32_t parentHandle, uint32_t childHandle) {
+    uint32_t parent = positions[parentHandle];
+    if (parent == kNone) {
+        return true;
+    }
+    const CRDTNode* child = resolve(childHandle);
+    if (!child) {
+        auto& parents = waiting[childHandle];
+        if (parents.empty() || parents.back() != parentHandle) {
+            parents.push_back(parentHandle);
+        }
+        return true;
+    }
+    if (child->isDeleted()) {
+        slots[childHandle].parentHint = parentHandle;
+        return true;
+    }
+    uint32_t existing = positions[childHandle];
+    if (existing != kNone && nodes[existing].parent == parent) {
+        return true;
+    }
+
+    // Insert after the subtree of the nearest earlier sibling on display
+    const auto& entries = nodes[parent].node->getChildEntries();
+    size_t entry = 0;
+    while (entry < entries.size() &&
+           (entries[entry].deleted || entries[entry].childId != slots[childHandle].id)) {
+        entry++;
+    }
+    if (entry == entries.size()) {
+        return true;
+    }
+    uint32_t at = parent + 1;
+    uint32_t previous = kNone;
+    while (entry-- > 0) {
+        if (entries[entry].deleted) {
+            continue;
+        }
+        auto sibling = handles.find(entries[entry].childId.toString());
+        if (sibling == handles.end()) {
+            continue;
+        }
+        uint32_t position = positions[sibling->second];
+        if (position != kNone && nodes[position].parent == parent) {
+            previous = position;
+            at = position + nodes[position].subtreeSize;
+            break;
+        }
+    }
+
+    // Shown under an earlier parent already: that one keeps it
+    if (existing != kNone) {
+        return existing < at;
+    }
+    std::vector<Node> fragment;
+    if (!collect(childHandle, at, fragment)) {
+        return false;
+    }
+    splice(parent, at, previous, fragment);
+    patchCount++;
+    return true;
+}
+
+bool DOMGraph::detach(uint32_t position) {
+    uint32_t count = nodes[position].subtreeSize;
+    uint32_t end = position + count;
+    uint32_t parent = nodes[position].parent;
+    uint32_t next = nodes[position].nextSibling;
+
+    // The dropped nodes' child entries no longer count as references
+    std::vector<uint32_t> dropped;
+    dropped.reserve(count);
+    for (uint32_t i = position; i < end; i++) {
+        dropped.push_back(nodes[i].handle);
+        positions[nodes[i].handle] = kNone;
+        for (const auto& entry : nodes[i].node->getChildEntries()) {
+            if (entry.deleted) {
+                continue;
+            }
+            auto handle = handles.find(entry.childId.toString());
+            if (handle != handles.end() && slots[handle->second].references > 0) {
+                slots[handle->second].references--;
+            }
+        }
+    }
+
+    if (parent != kNone) {
+        // Previous sibling: climb from the node just before this subtree
+        uint32_t previous = position - 1;
+        while (previous != parent && nodes[previous].parent != parent) {
+            previous = nodes[previous].parent;
+        }
+        if (previous == parent) {
+            nodes[parent].firstChild = next;
+        } else {
+            nodes[previous].nextSibling = next;
+        }
+        for (uint32_t ancestor = parent; ancestor != kNone; ancestor = nodes[ancestor].parent) {
+            nodes[ancestor].subtreeSize -= count;
+        }
+    }
+    nodes.erase(nodes.begin() + position, nodes.begin() + end);
+    shiftIndices(end, -static_cast<int64_t>(count));
+    updatePositions(position);
+    structureVersion++;
+    patchCount++;
+
+    // A dropped node another visible parent still points at has to move there
+    for (uint32_t handle : dropped) {
+        if (slots[handle].references > 0 && !slots[handle].node->isDeleted()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DOMGraph::collect(uint32_t rootHandle, uint32_t limit, std::vector<Node>& out) {
+    struct Frame {
+        uint32_t index;
+        size_t next;        // Next child entry to look at
+        uint32_t lastChild;
+    };
+    auto place = [&](uint32_t handle, uint32_t parent, uint32_t depth) {
+        out.push_back(Node{slots[handle].node.get(), parent, kNone, kNone, 1, depth, handle});
+        positions[handle] = kPlacing;
+        return static_cast<uint32_t>(out.size() - 1);
+    };
+
+    std::vector<Frame> stack;
+    stack.push_back(Frame{place(rootHandle, kNone, 0), 0, kNone});
+    while (!stack.empty()) {
+        Frame& frame = stack.back();
+        const auto& entries = out[frame.index].node->getChildEntries();
+        uint32_t child = kNone;
+        while (child == kNone && frame.next < entries.size()) {
+            const auto& entry = entries[frame.next++];
+            if (entry.deleted) {
+                continue;
+            }
+            uint32_t handle = handleFor(entry.childId);
+            slots[handle].references++;
+            const CRDTNode* node = resolve(handle);
+            if (!node) {
+                waiting[handle].push_back(out[frame.index].handle);
+                continue;
+            }
+            uint32_t position = positions[handle];
+            if (node->isDeleted()) {
+                slots[handle].parentHint = out[frame.index].handle;
+                continue;
+            }
+            if (position == kPlacing) {
+                continue;
+            }
+            if (position != kNone) {
+                if (position < limit) {
+                    continue;   // Shown earlier in pre-order
+                }
+                return false;
+            }
+            child = handle;
+        }
+
+        if (child == kNone) {
+            out[frame.index].subtreeSize = static_cast<uint32_t>(out.size()) - frame.index;
+            stack.pop_back();
+            continue;
+        }
+        uint32_t index = place(child, frame.index, out[frame.index].depth + 1);
+        if (frame.lastChild == kNone) {
+            out[frame.index].firstChild = index;
+        } else {
+            out[frame.lastChild].nextSibling = index;
+        }
+        frame.lastChild = index;
+        stack.push_back(Frame{index, 0, kNone});
+    }
+    return true;
+}
+
+void DOMGraph::splice(uint32_t parent, uint32_t at, uint32_t previous, std::vector<Node>& fragment) {
+    uint32_t count = static_cast<uint32_t>(fragment.size());
+    uint32_t next = kNone;
+    if (at < nodes.size() && nodes[at].parent == parent) {
+        next = at + count;
+    }
+    shiftIndices(at, count);
 
+    uint32_t depth = parent == kNone ? 0 : nodes[parent].depth + 1;
+    for (auto& node : fragment) {
+        node.parent = node.parent == kNone ? parent : node.parent + at;
+        if (node.firstChild != kNone) {
+            node.firstChild += at;
+        }
+        if (node.nextSibling != kNone) {
+            node.nextSibling += at;
+        }
+        node.depth += depth;
+    }
+    fragment.front().nextSibling = next;
+    nodes.insert(nodes.begin() + at, fragment.begin(), fragment.end());
+
+    if (parent != kNone) {
+        if (previous == kNone) {
+            nodes[parent].firstChild = at;
+        } else {
+            nodes[previous].nextSibling = at;
+        }
+        for (uint32_t ancestor = parent; ancestor != kNone; ancestor = nodes[ancestor].parent) {
+            nodes[ancestor].subtreeSize += count;
+        }
+    }
+    updatePositions(at);
+    structureVersion++;
+}
+
+void DOMGraph::shiftIndices(uint32_t from, int64_t delta) {
+    // Branch-free so the loop vectorizes; kNone is never shifted
+    uint32_t span = kNone - from;
+    uint32_t step = static_cast<uint32_t>(delta);
+    for (auto& node : nodes) {
+        node.parent += (node.parent - from < span) ? step : 0;
+        node.firstChild += (node.firstChild - from < span) ? step : 0;
+        node.nextSibling += (node.nextSibling - from < span) ? step : 0;
+    }
+}
+
+void DOMGraph::updatePositions(uint32_t from) {
+    for (uint32_t i = from; i < nodes.size(); i++) {
+        positions[nodes[i].handle] = i;
+    }
+}
+
+} // namespace Lienzo
@@ -1,41 +1,108 @@
 #pragma once
 
-#include <string>
-#include <vector>
+#include "crdt.h"
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace Lienzo {
 
-// Mergable DOM graph structure for collaboration
-// Similar to Figma's approach
-
-struct DOMNode {
-    std::string id;
-    std::string type;
-    std::unordered_map<std::string, std::string> properties;
-    std::vector<std::shared_ptr<DOMNode>> children;
-    
-    DOMNode(const std::string& id, const std::string& type)
-        : id(id), type(type) {}
-};
-
+// Flattened, read-only view of a CRDTDocument's tree
+//
+// Visible nodes (existing, not deleted, reachable from the root) are kept
+// in one array in pre-order, so a node's subtree is the contiguous range
+// [index, index + subtreeSize). Rendering and hit testing walk it with a
+// linear scan instead of looking children up by ID.
+//
+// The view subscribes to the document's operations and patches itself:
+// an added child splices its subtree in, a removed or deleted one cuts
+// its range out, and property/text changes only bump the node's version.
+// A node reachable through several parents is shown under the first one
+// in pre-order; edits that would move such a node fall back to a rebuild.
 class DOMGraph {
 public:
-    DOMGraph();
-    
-    std::shared_ptr<DOMNode> createNode(const std::string& type);
-    void addChild(std::shared_ptr<DOMNode> parent, std::shared_ptr<DOMNode> child);
-    
-    // Merge operations for collaboration
-    void applyOperation(const std::string& operation);
-    std::string serialize() const;
-    void deserialize(const std::string& data);
-    
+    static const uint32_t kNone = 0xFFFFFFFF;
+
+    struct Node {
+        const CRDTNode* node;   // Kept alive by the view while it is shown
+        uint32_t parent;        // Indices into getNodes(), or kNone
+        uint32_t firstChild;
+        uint32_t nextSibling;
+        uint32_t subtreeSize;   // Including the node itself
+        uint32_t depth;         // 0 for the root
+        uint32_t handle;        // Stable per node ID (see getVersion)
+    };
+
+    explicit DOMGraph(CRDTDocument& document);
+    ~DOMGraph();
+    DOMGraph(const DOMGraph&) = delete;
+    DOMGraph& operator=(const DOMGraph&) = delete;
+
+    // Visible nodes in pre-order; [0] is the root
+    const std::vector<Node>& getNodes() const { return nodes; }
+    size_t size() const { return nodes.size(); }
+    const Node& operator[](uint32_t index) const { return nodes[index]; }
+
+    // Index of a visible node, kNone otherwise
+    uint32_t indexOf(const CRDTId& id) const;
+    const CRDTId& getId(uint32_t index) const { return slots[nodes[index].handle].id; }
+    // Bumped whenever the node's properties or text change
+    uint64_t getVersion(uint32_t index) const { return slots[nodes[index].handle].version; }
+    // Bumped whenever nodes are added, removed or moved
+    uint64_t getStructureVersion() const { return structureVersion; }
+    // Bumped whenever any node's version is
+    uint64_t getContentVersion() const { return contentVersion; }
+
+    // Recompute everything from the document
+    void rebuild();
+
+    // Statistics
+    size_t getPatchCount() const { return patchCount; }
+    size_t getRebuildCount() const { return rebuildCount; }
+
 private:
-    std::shared_ptr<DOMNode> root;
-    std::unordered_map<std::string, std::shared_ptr<DOMNode>> nodeMap;
+    static const uint32_t kPlacing = kNone - 1;
+
+    // Per node ID, including nodes that are not visible
+    struct Slot {
+        CRDTId id;
+        // Held, not borrowed: createNodeWithId can replace the document's entry
+        std::shared_ptr<const CRDTNode> node;
+        uint32_t references;    // Live child entries of visible nodes that point here
+                                // (never less; may overcount until a rebuild)
+        uint64_t version;
+        uint32_t parentHint;    // Handle of a parent it was last seen under while
+                                // deleted (or kNone); where a restore puts it back
+    };
+
+    CRDTDocument& document;
+    size_t listenerHandle;
+    std::vector<Node> nodes;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> positions;    // Per handle: index in nodes, or kNone
+    std::unordered_map<std::string, uint32_t> handles;
+    // Missing child -> visible parents waiting for its CreateNode
+    std::unordered_map<uint32_t, std::vector<uint32_t>> waiting;
+    uint64_t structureVersion;
+    uint64_t contentVersion;
+    size_t patchCount;
+    size_t rebuildCount;
+
+    void onOperation(const CRDTOperation& op);
+    uint32_t handleFor(const CRDTId& id);
+    const CRDTNode* resolve(uint32_t handle);
+
+    // Patches; false means the view must be rebuilt
+    bool attach(uint32_t parentHandle, uint32_t childHandle);
+    bool detach(uint32_t position);
+    // Pre-order walk of a new subtree; children placed at or after limit conflict
+    bool collect(uint32_t rootHandle, uint32_t limit, std::vector<Node>& out);
+    // Insert a collected subtree at index at, after sibling previous (or first)
+    void splice(uint32_t parent, uint32_t at, uint32_t previous, std::vector<Node>& fragment);
+    void shiftIndices(uint32_t from, int64_t delta);
+    void updatePositions(uint32_t from);
 };
 
 } // namespace Lienzo
-
@@ -0,0 +1,199 @@
+#include "op_trace.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace Lienzo {
+
+const char OpTraceRecorder::kMagic[4] = {'L', 'Z', 'O', 'T'};
+const uint64_t OpTraceRecorder::kVersion = 1;
+const size_t OpTraceRecorder::kFlushBytes = 64 * 1024;
+
+namespace {
+
+const uint8_t kFlagLocal = 1;
+
+} // namespace
+
+OpTraceRecorder::OpTraceRecorder(CRDTDocument& document)
+    : document(document), file(nullptr), listenerHandle(0), attached(false), ok(true),
+      lastMicros(0), records(0), flushedBytes(0) {
+    attach();
+}
+
+OpTraceRecorder::OpTraceRecorder(CRDTDocument& document, const std::string& path)
+    : document(document), path(path), file(nullptr), listenerHandle(0), attached(false), ok(true),
+      lastMicros(0), records(0), flushedBytes(0) {
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        ok = false;
+        return;
+    }
+    attach();
+}
+
+OpTraceRecorder::~OpTraceRecorder() {
+    stop();
+}
+
+void OpTraceRecorder::attach() {
+    writer.putBytes(kMagic, 4);
+    writer.putVarint(kVersion);
+    start = std::chrono::steady_clock::now();
+    listenerHandle = document.addOperationListener([this](const CRDTOperation& op, bool local) {
+        // Clones are recorded as sent, without their expansion
+        if (!document.isExpandingClone()) {
+            append(op, local);
+        }
+    });
+    attached = true;
+}
+
+void OpTraceRecorder::append(const CRDTOperation& op, bool local) {
+    uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    scratch.clear();
+    CRDTCodec::encodeOperation(scratch, op);
+    writer.putVarint(now - lastMicros);
+    writer.putByte(local ? kFlagLocal : 0);
+    writer.putVarint(scratch.size());
+    writer.putBytes(scratch.data().data(), scratch.size());
+    lastMicros = now;
+    records++;
+    if (file && writer.size() >= kFlushBytes) {
+        flush();
+    }
+}
+
+void OpTraceRecorder::flush() {
+    if (!file || writer.size() == 0) {
+        return;
+    }
+    if (std::fwrite(writer.data().data(), 1, writer.size(), file) != writer.size()) {
+        ok = false;
+    }
+    flushedBytes += writer.size();
+    writer.clear();
+}
+
+void OpTraceRecorder::stop() {
+    if (attached) {
+        document.removeOperationListener(listenerHandle);
+        attached = false;
+    }
+    if (file) {
+        flush();
+        if (std::fclose(file) != 0) {
+            ok = false;
+        }
+        file = nullptr;
+    }
+}
+
+OpTraceReader::OpTraceReader(const void* data, size_t size)
+    : reader(data, size), valid(false), error(false), timeMicros(0) {
+    uint64_t version;
+    valid = size >= 4 && std::equal(OpTraceRecorder::kMagic, OpTraceRecorder::kMagic + 4,
+                                    static_cast<const char*>(data)) &&
+            reader.skip(4) && reader.getVarint(version) && version == OpTraceRecorder::kVersion;
+    error = !valid;
+}
+
+bool OpTraceReader::next(OpTraceRecord& record) {
+    if (!valid || error || reader.remaining() == 0) {
+        return false;
+    }
+    uint64_t delta, length;
+    uint8_t flags;
+    if (!reader.getVarint(delta) || !reader.getByte(flags) || !reader.getVarint(length) ||
+        length > reader.remaining()) {
+        error = true;
+        return false;
+    }
+    ByteReader body(reader.position(), static_cast<size_t>(length));
+    reader.skip(static_cast<size_t>(length));
+    timeMicros += delta;
+    record.timeMicros = timeMicros;
+    record.local = (flags & kFlagLocal) != 0;
+    record.known = CRDTCodec::decodeOperation(body, record.op);
+    return true;
+}
+
+bool readOpTraceFile(const std::string& path, std::string& data) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    data.clear();
+    char buffer[1 << 16];
+    size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.append(buffer, read);
+    }
+    bool ok = !std::ferror(file);
+    std::fclose(file);
+    return ok;
+}
+
+bool replayOpTrace(const std::string& trace, const OpTraceReplayOptions& options,
+                   OpTraceReplayStats& stats) {
+    stats = OpTraceReplayStats();
+    OpTraceReader reader(trace.data(), trace.size());
+    if (!reader.isValid() || options.replicas == 0) {
+        return false;
+    }
+    std::vector<std::unique_ptr<CRDTDocument>> replicas;
+    for (size_t i = 0; i < options.replicas; i++) {
+        replicas.push_back(std::make_unique<CRDTDocument>("replay-" + std::to_string(i)));
+    }
+
+    // Nanoseconds per application, saturating
+    std::vector<uint32_t> latencies;
+    double speed = options.speed > 0.0 ? options.speed : 1.0;
+    auto start = std::chrono::steady_clock::now();
+    OpTraceRecord record;
+    while (reader.next(record)) {
+        stats.records++;
+        if (!record.known) {
+            stats.skipped++;
+            continue;
+        }
+        if (options.realTime) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds(
+                static_cast<int64_t>(static_cast<double>(record.timeMicros) / speed)));
+        }
+        for (auto& replica : replicas) {
+            auto before = std::chrono::steady_clock::now();
+            if (replica->applyOperation(record.op)) {
+                stats.applied++;
+            }
+            auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - before).count();
+            latencies.push_back(static_cast<uint32_t>(std::min<int64_t>(nanos, UINT32_MAX)));
+        }
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.opsPerSecond = stats.seconds > 0.0 ? static_cast<double>(latencies.size()) / stats.seconds : 0.0;
+
+    if (!latencies.empty()) {
+        auto percentile = [&](double fraction) {
+            size_t index = std::min(latencies.size() - 1,
+                                    static_cast<size_t>(fraction * static_cast<double>(latencies.size())));
+            std::nth_element(latencies.begin(), latencies.begin() + index, latencies.end());
+            return static_cast<double>(latencies[index]) / 1000.0;
+        };
+        stats.latencyP50Micros = percentile(0.50);
+        stats.latencyP90Micros = percentile(0.90);
+        stats.latencyP99Micros = percentile(0.99);
+        stats.latencyMaxMicros = static_cast<double>(*std::max_element(latencies.begin(), latencies.end())) / 1000.0;
+    }
+    for (const auto& replica : replicas) {
+        stats.peakBytesInUse += replica->getMemoryUsage().peakBytesInUse;
+    }
+    stats.nodes = replicas.front()->getNodeCount();
+    return !reader.hasError();
+}
+
+} // namespace Lienzo
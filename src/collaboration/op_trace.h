@@ -0,0 +1,125 @@
+#pragma once
+
+#include "crdt.h"
+#include "crdt_codec.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace Lienzo {
+
+// Recorded editing sessions, for load testing with real operation mixes
+//
+// A trace holds every operation a document saw, local or remote, with the
+// time it happened:
+//   [magic "LZOT"][varint version]
+//   records: [varint microseconds since the previous record][u8 flags]
+//            [varint length][CRDTCodec::encodeOperation]
+// Times are deltas, so most records spend a byte or two on them, and the
+// length lets readers skip operations they do not know.
+
+struct OpTraceRecord {
+    uint64_t timeMicros = 0;    // Since the trace started
+    bool local = true;
+    bool known = true;          // False for operation types this build cannot decode
+    CRDTOperation op;
+};
+
+class OpTraceRecorder {
+public:
+    static const char kMagic[4];
+    static const uint64_t kVersion;
+    static const size_t kFlushBytes;
+
+    // Record into memory (see getData)
+    explicit OpTraceRecorder(CRDTDocument& document);
+    // Record into a file, written in kFlushBytes chunks
+    OpTraceRecorder(CRDTDocument& document, const std::string& path);
+    ~OpTraceRecorder();
+    OpTraceRecorder(const OpTraceRecorder&) = delete;
+    OpTraceRecorder& operator=(const OpTraceRecorder&) = delete;
+
+    // False once the file could not be created or written
+    bool isOk() const { return ok; }
+    // Stop listening and flush; the trace is complete afterwards
+    void stop();
+
+    // In-memory traces only
+    const std::string& getData() const { return writer.data(); }
+
+    // Statistics
+    size_t getRecordCount() const { return records; }
+    uint64_t getBytes() const { return flushedBytes + writer.size(); }
+
+private:
+    CRDTDocument& document;
+    std::string path;
+    std::FILE* file;
+    size_t listenerHandle;
+    bool attached;
+    bool ok;
+    ByteWriter writer;
+    ByteWriter scratch;
+    std::chrono::steady_clock::time_point start;
+    uint64_t lastMicros;
+    size_t records;
+    uint64_t flushedBytes;
+
+    void attach();
+    void append(const CRDTOperation& op, bool local);
+    void flush();
+};
+
+// Reads a trace from a borrowed buffer
+class OpTraceReader {
+public:
+    OpTraceReader(const void* data, size_t size);
+
+    // Whether the header is a trace this version understands
+    bool isValid() const { return valid; }
+    // Next record; false at the end, or at a damaged record (see hasError)
+    bool next(OpTraceRecord& record);
+    bool hasError() const { return error; }
+
+private:
+    ByteReader reader;
+    bool valid;
+    bool error;
+    uint64_t timeMicros;
+};
+
+// Whole trace file into data
+bool readOpTraceFile(const std::string& path, std::string& data);
+
+struct OpTraceReplayOptions {
+    size_t replicas = 1;
+    // Wait until each record's recorded time (divided by speed) before
+    // applying it, instead of replaying as fast as possible
+    bool realTime = false;
+    double speed = 1.0;
+};
+
+struct OpTraceReplayStats {
+    size_t records = 0;
+    size_t applied = 0;             // Operation applications that changed a replica
+    size_t skipped = 0;             // Records of unknown operation types
+    double seconds = 0.0;
+    double opsPerSecond = 0.0;      // Records times replicas, per second
+    // Time for one replica to apply one operation
+    double latencyP50Micros = 0.0;
+    double latencyP90Micros = 0.0;
+    double latencyP99Micros = 0.0;
+    double latencyMaxMicros = 0.0;
+    size_t peakBytesInUse = 0;      // Sum over replicas of their node arenas' high-water marks
+    size_t nodes = 0;               // In the first replica, at the end
+};
+
+// Feed a trace into fresh replicas
+// Every record is delivered to every replica through applyOperation, as the
+// network layer would deliver remote operations. False if the trace is
+// not valid or is damaged part-way (stats cover the records before that).
+bool replayOpTrace(const std::string& trace, const OpTraceReplayOptions& options,
+                   OpTraceReplayStats& stats);
+
+} // namespace Lienzo
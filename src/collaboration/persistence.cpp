@@ -0,0 +1,333 @@
+#include "persistence.h"
+#include "crdt_codec.h"
+#include <algorithm>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Lienzo {
+
+namespace {
+
+const char kSnapshotFileMagic[4] = {'L', 'N', 'Z', 'P'};
+const size_t kSnapshotHeaderSize = 12;
+
+bool readFile(const std::string& path, std::string& contents) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    contents.clear();
+    char buffer[1 << 16];
+    size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        contents.append(buffer, read);
+    }
+    std::fclose(file);
+    return true;
+}
+
+bool syncFile(std::FILE* file) {
+    if (std::fflush(file) != 0) {
+        return false;
+    }
+#ifndef __EMSCRIPTEN__
+    return ::fsync(fileno(file)) == 0;
+#else
+    return true;
+#endif
+}
+
+// Make renames and removals in a directory durable
+bool syncDirectory(const std::string& directory) {
+#ifndef __EMSCRIPTEN__
+    int fd = ::open(directory.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#else
+    (void)directory;
+    return true;
+#endif
+}
+
+// Write a snapshot next to its final path and rename it into place, then
+// drop the log segments it covers once the rename is on disk; on failure
+// they are left alone
+bool writeSnapshot(const std::string& directory, const std::string& path, uint64_t firstSegment,
+                   const std::string& data, const std::vector<std::string>& coveredSegments) {
+    ByteWriter header;
+    header.putBytes(kSnapshotFileMagic, 4);
+    header.putFixed64(firstSegment);
+
+    std::string tempPath = path + ".tmp";
+    std::FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = std::fwrite(header.data().data(), 1, header.size(), file) == header.size() &&
+              std::fwrite(data.data(), 1, data.size(), file) == data.size() &&
+              syncFile(file);
+    std::fclose(file);
+    if (!ok || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    // Until then a power loss can bring the old snapshot back, which still
+    // needs the segments
+    if (!syncDirectory(directory)) {
+        return false;
+    }
+    for (const auto& segment : coveredSegments) {
+        std::remove(segment.c_str());
+    }
+    return true;
+}
+
+} // namespace
+
+DocumentPersistence::DocumentPersistence(const std::string& directory,
+                                         const PersistenceOptions& options)
+    : directory(directory), options(options), document(nullptr), listenerHandle(0),
+      logFile(nullptr), firstSegment(0), activeSegment(0), logBytes(0),
+      checkpointCount(0), replayedOperations(0), logFailed(false), snapshotFailed(false),
+      checkpointRunning(false), checkpointWritten(false), checkpointPending(false),
+      checkpointFirstSegment(0) {
+#ifdef __EMSCRIPTEN__
+    this->options.backgroundCheckpoint = false;
+#endif
+}
+
+DocumentPersistence::~DocumentPersistence() {
+    close();
+}
+
+std::string DocumentPersistence::snapshotPath() const {
+    return directory + "/snapshot";
+}
+
+std::string DocumentPersistence::segmentPath(uint64_t segment) const {
+    return directory + "/log." + std::to_string(segment);
+}
+
+bool DocumentPersistence::open(CRDTDocument& doc) {
+    close();
+    ::mkdir(directory.c_str(), 0755);
+
+    // Snapshot
+    std::string contents;
+    firstSegment = 0;
+    if (readFile(snapshotPath(), contents)) {
+        ByteReader reader(contents.data(), contents.size());
+        if (contents.size() < kSnapshotHeaderSize ||
+            !std::equal(kSnapshotFileMagic, kSnapshotFileMagic + 4, contents.begin())) {
+            return false;
+        }
+        reader.skip(4);
+        reader.getFixed64(firstSegment);
+        if (!doc.deserialize(contents.substr(kSnapshotHeaderSize))) {
+            return false;
+        }
+    }
+    removeCoveredSegments();
+
+    // Segments written after the snapshot, oldest first
+    replayedOperations = 0;
+    logBytes = 0;
+    logFailed = false;
+    snapshotFailed = false;
+    uint64_t segment = firstSegment;
+    while (replaySegment(segment, doc)) {
+        segment++;
+    }
+
+    // Always start a fresh segment so a torn tail is never appended to
+    if (!openSegment(segment)) {
+        return false;
+    }
+    document = &doc;
+    listenerHandle = doc.addOperationListener([this](const CRDTOperation& op, bool) {
+        // Clones are logged as the operations they expand to
+        if (op.type != CRDTOperationType::CloneSubtree) {
+            append(op);
+        }
+    });
+    return true;
+}
+
+// Segments a checkpoint could not remove before a crash
+void DocumentPersistence::removeCoveredSegments() {
+    DIR* dir = ::opendir(directory.c_str());
+    if (!dir) {
+        return;
+    }
+    std::vector<std::string> covered;
+    while (struct dirent* entry = ::readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.compare(0, 4, "log.") != 0 || name.size() == 4 ||
+            name.find_first_not_of("0123456789", 4) != std::string::npos) {
+            continue;
+        }
+        if (std::stoull(name.substr(4)) < firstSegment) {
+            covered.push_back(directory + "/" + name);
+        }
+    }
+    ::closedir(dir);
+    for (const auto& segment : covered) {
+        std::remove(segment.c_str());
+    }
+}
+
+bool DocumentPersistence::replaySegment(uint64_t segment, CRDTDocument& doc) {
+    std::string contents;
+    if (!readFile(segmentPath(segment), contents)) {
+        return false;
+    }
+    ByteReader reader(contents.data(), contents.size());
+    uint32_t length;
+    while (reader.getFixed32(length) && length <= reader.remaining()) {
+        ByteReader payload(reader.position(), length);
+        CRDTOperation op;
+        if (!CRDTCodec::decodeOperation(payload, op)) {
+            break;
+        }
+        reader.skip(length);
+        doc.applyOperation(op);
+        replayedOperations++;
+    }
+    logBytes += contents.size();
+    return true;
+}
+
+bool DocumentPersistence::openSegment(uint64_t segment) {
+    logFile = std::fopen(segmentPath(segment).c_str(), "ab");
+    activeSegment = segment;
+    return logFile != nullptr;
+}
+
+void DocumentPersistence::closeSegment() {
+    if (!logFile) {
+        return;
+    }
+    if (!syncFile(logFile)) {
+        logFailed = true;
+    }
+    std::fclose(logFile);
+    logFile = nullptr;
+}
+
+void DocumentPersistence::append(const CRDTOperation& op) {
+    if (!logFile) {
+        logFailed = true;
+        return;
+    }
+    ByteWriter writer;
+    writer.putFixed32(0);
+    CRDTCodec::encodeOperation(writer, op);
+    uint32_t length = static_cast<uint32_t>(writer.size() - 4);
+    std::string& frame = writer.data();
+    for (int i = 0; i < 4; i++) {
+        frame[i] = static_cast<char>(length >> (8 * i));
+    }
+    bool written = std::fwrite(frame.data(), 1, frame.size(), logFile) == frame.size() &&
+                   std::fflush(logFile) == 0;
+    logBytes += frame.size();
+
+    if (!written) {
+        // The segment may end in a torn record: never append after it. A
+        // snapshot taken now holds the lost operation too.
+        logFailed = true;
+        if (checkpointRunning) {
+            closeSegment();
+            openSegment(activeSegment + 1);
+        } else {
+            checkpoint();
+        }
+    } else if (logBytes >= options.checkpointThresholdBytes) {
+        checkpoint();
+    }
+}
+
+bool DocumentPersistence::checkpoint() {
+    if (!document || checkpointRunning) {
+        return false; // The running checkpoint's log is picked up by the next one
+    }
+    finishCheckpoint();
+
+    // Seal the active segment; everything in it, and in every segment a
+    // failed snapshot left behind, is covered by the snapshot
+    closeSegment();
+    std::vector<std::string> covered;
+    for (uint64_t segment = firstSegment; segment <= activeSegment; segment++) {
+        covered.push_back(segmentPath(segment));
+    }
+    if (!openSegment(activeSegment + 1)) {
+        logFailed = true;
+        return false;
+    }
+    logBytes = 0;
+    logFailed = false;
+    checkpointCount++;
+
+    // Serializing reads the document, so it happens here; only the file
+    // write and fsync move to the background
+    std::string data = document->serialize();
+    std::string dir = directory;
+    std::string path = snapshotPath();
+    uint64_t first = activeSegment;
+    checkpointFirstSegment = first;
+    checkpointPending = true;
+    if (options.backgroundCheckpoint) {
+        checkpointRunning = true;
+        checkpointThread = std::thread([this, dir, path, first, data = std::move(data), covered]() {
+            checkpointWritten = writeSnapshot(dir, path, first, data, covered);
+            checkpointRunning = false;
+        });
+        return true;
+    }
+    checkpointWritten = writeSnapshot(dir, path, first, data, covered);
+    return finishCheckpoint();
+}
+
+// Join the last checkpoint and take its result: the covered segments are
+// gone only if the snapshot was written
+bool DocumentPersistence::finishCheckpoint() {
+    if (checkpointThread.joinable()) {
+        checkpointThread.join();
+    }
+    if (checkpointPending) {
+        checkpointPending = false;
+        snapshotFailed = !checkpointWritten;
+        if (!snapshotFailed) {
+            firstSegment = checkpointFirstSegment;
+        }
+    }
+    return !snapshotFailed;
+}
+
+bool DocumentPersistence::waitForCheckpoint() {
+    return finishCheckpoint();
+}
+
+bool DocumentPersistence::sync() {
+    if (!logFile || !syncFile(logFile)) {
+        logFailed = true;
+    }
+    return !hasFailed();
+}
+
+void DocumentPersistence::close() {
+    finishCheckpoint();
+    if (document) {
+        document->removeOperationListener(listenerHandle);
+        document = nullptr;
+    }
+    closeSegment();
+}
+
+} // namespace Lienzo
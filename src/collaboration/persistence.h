@@ -0,0 +1,97 @@
+#pragma once
+
+#include "crdt.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+namespace Lienzo {
+
+struct PersistenceOptions {
+    // Fold the op log into a new snapshot once it grows past this size
+    size_t checkpointThresholdBytes = 4 * 1024 * 1024;
+    // Write snapshots on a background thread (always synchronous on WASM)
+    bool backgroundCheckpoint = true;
+};
+
+// Durable document storage: a compacted snapshot plus op log segments
+//
+// Files in the directory:
+//   snapshot   [magic][u64 first log segment][CRDTDocument::serialize()]
+//   log.<N>    [u32 length][CRDTCodec::encodeOperation] records
+//
+// Every change to the open document is appended to the active segment.
+// When it passes the threshold the segment is closed, a new one started,
+// and a snapshot of the document is written that covers every closed
+// segment; those segments are then deleted. Opening reads the snapshot and
+// replays only the segments written after it, so open time is bounded by
+// snapshot size plus one threshold of log, not by total edit history.
+//
+// A failed log write seals the segment (nothing is appended after a torn
+// record) and starts a checkpoint. Segments are only deleted once a
+// snapshot covering them is fully on disk, its rename included; after a
+// failed snapshot they stay and the next checkpoint covers them again.
+// Segments a crash left behind below the snapshot are deleted on open.
+class DocumentPersistence {
+public:
+    DocumentPersistence(const std::string& directory,
+                        const PersistenceOptions& options = PersistenceOptions());
+    ~DocumentPersistence();
+
+    DocumentPersistence(const DocumentPersistence&) = delete;
+    DocumentPersistence& operator=(const DocumentPersistence&) = delete;
+
+    // Load the stored state into doc, then log every further change to it
+    bool open(CRDTDocument& doc);
+    void close();
+
+    // Fold the log into a new snapshot now. False if it could not start or,
+    // when synchronous, if the snapshot could not be written.
+    bool checkpoint();
+    // Block until a background checkpoint has finished; false if it failed
+    bool waitForCheckpoint();
+    // Flush the active segment to disk; false if it, or any earlier write
+    // not yet covered by a snapshot, failed
+    bool sync();
+    // Changes may be missing on disk until a checkpoint succeeds
+    bool hasFailed() const { return logFailed || snapshotFailed; }
+
+    // Statistics
+    uint64_t getLogBytes() const { return logBytes; }
+    uint64_t getActiveSegment() const { return activeSegment; }
+    size_t getCheckpointCount() const { return checkpointCount; }
+    size_t getReplayedOperationCount() const { return replayedOperations; }
+
+private:
+    std::string directory;
+    PersistenceOptions options;
+    CRDTDocument* document;
+    size_t listenerHandle;
+
+    std::FILE* logFile;
+    uint64_t firstSegment;    // Oldest segment not covered by the snapshot on disk
+    uint64_t activeSegment;
+    uint64_t logBytes;
+    size_t checkpointCount;
+    size_t replayedOperations;
+    bool logFailed;           // Since the last checkpoint started
+    bool snapshotFailed;      // The last checkpoint's
+    std::thread checkpointThread;
+    std::atomic<bool> checkpointRunning;
+    std::atomic<bool> checkpointWritten;
+    bool checkpointPending;   // Result not yet taken by finishCheckpoint
+    uint64_t checkpointFirstSegment;
+
+    std::string snapshotPath() const;
+    std::string segmentPath(uint64_t segment) const;
+    void removeCoveredSegments();
+    bool replaySegment(uint64_t segment, CRDTDocument& doc);
+    bool openSegment(uint64_t segment);
+    void closeSegment();
+    void append(const CRDTOperation& op);
+    bool finishCheckpoint();
+};
+
+} // namespace Lienzo
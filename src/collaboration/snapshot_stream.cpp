@@ -0,0 +1,182 @@
+#include "snapshot_stream.h"
+#include "crdt_codec.h"
+#include <algorithm>
+
+namespace Lienzo {
+
+SnapshotStreamDecoder::SnapshotStreamDecoder(CRDTDocument& doc)
+    : document(doc), state(State::Header), consumed(0),
+      totalNodes(0), decodedNodes(0), siteCount(0), sitesRead(0), rootReady(false) {
+}
+
+void SnapshotStreamDecoder::setFrameReadyCallback(FrameReadyCallback callback) {
+    onFrameReady = callback;
+}
+
+bool SnapshotStreamDecoder::push(const void* data, size_t size) {
+    if (state == State::Error) {
+        return false;
+    }
+    // Drop the consumed prefix before it dominates the buffer
+    if (consumed > 0 && consumed >= buffer.size() / 2) {
+        buffer.erase(0, consumed);
+        consumed = 0;
+    }
+    buffer.append(static_cast<const char*>(data), size);
+    return decodeAvailable();
+}
+
+bool SnapshotStreamDecoder::decodeAvailable() {
+    // Each step parses from a scratch reader and only commits the cursor
+    // once a whole item is available, so items may straddle chunks
+    while (state != State::Done && state != State::Error) {
+        ByteReader reader(buffer.data() + consumed, buffer.size() - consumed);
+        const uint8_t* start = reader.position();
+
+        if (state == State::Header) {
+            uint64_t version;
+            if (reader.remaining() < 4) {
+                return true;
+            }
+            if (!std::equal(CRDTDocument::kSnapshotMagic, CRDTDocument::kSnapshotMagic + 4,
+                            reinterpret_cast<const char*>(start))) {
+                state = State::Error;
+                return false;
+            }
+            reader.skip(4);
+            if (!reader.getVarint(version) || !reader.getVarint(totalNodes)) {
+                return true;
+            }
+            if (version != CRDTDocument::kSnapshotVersion) {
+                state = State::Error;
+                return false;
+            }
+            document.reserve(document.getNodeCount() + static_cast<size_t>(totalNodes));
+            state = totalNodes > 0 ? State::Records : State::SiteCount;
+        } else if (state == State::Records) {
+            uint64_t size;
+            if (!reader.getVarint(size) || size > reader.remaining()) {
+                return true;
+            }
+            ByteReader record(reader.position(), static_cast<size_t>(size));
+            auto node = CRDTCodec::decodeNode(record, document.getAllocator());
+            if (!node) {
+                state = State::Error;
+                return false;
+            }
+            reader.skip(static_cast<size_t>(size));
+            document.integrateNode(node);
+            decodedNodes++;
+            onNodeDecoded(*node);
+            if (decodedNodes == totalNodes) {
+                state = State::SiteCount;
+            }
+        } else if (state == State::SiteCount) {
+            if (!reader.getVarint(siteCount)) {
+                return true;
+            }
+            state = siteCount > 0 ? State::Sites : State::Done;
+        } else if (state == State::Sites) {
+            std::string site;
+            uint64_t clock;
+            if (!reader.getString(site) || !reader.getVarint(clock)) {
+                return true;
+            }
+            document.advanceClock(clock);
+            if (++sitesRead == siteCount) {
+                state = State::Done;
+            }
+        }
+        consumed += static_cast<size_t>(reader.position() - start);
+    }
+    return state != State::Error;
+}
+
+void SnapshotStreamDecoder::onNodeDecoded(const CRDTNode& node) {
+    std::string key = node.getId().toString();
+
+    if (node.getId() == document.getRootId()) {
+        // Every top-level node becomes a frame waiting for its subtree
+        rootReady = true;
+        for (const auto& entry : node.getChildEntries()) {
+            std::string frameKey = entry.childId.toString();
+            topLevel[frameKey] = entry.childId;
+            waiters[frameKey].push_back(frameKey);
+            outstanding[frameKey] = 1; // The frame's own record
+        }
+        return;
+    }
+
+    auto it = waiters.find(key);
+    if (it == waiters.end()) {
+        return; // Unattached node, or a subtree already reported
+    }
+    std::vector<std::string> frames = std::move(it->second);
+    waiters.erase(it);
+    for (const auto& frameKey : frames) {
+        expectChildren(node, frameKey);
+    }
+    for (const auto& frameKey : frames) {
+        if (--outstanding[frameKey] == 0) {
+            markReady(frameKey);
+        }
+    }
+}
+
+void SnapshotStreamDecoder::expectChildren(const CRDTNode& node, const std::string& frameKey) {
+    for (const auto& entry : node.getChildEntries()) {
+        if (document.getNode(entry.childId)) {
+            continue; // Already arrived
+        }
+        // A child shared by several frames holds up each of them
+        auto& frames = waiters[entry.childId.toString()];
+        if (std::find(frames.begin(), frames.end(), frameKey) == frames.end()) {
+            frames.push_back(frameKey);
+            outstanding[frameKey]++;
+        }
+    }
+}
+
+void SnapshotStreamDecoder::markReady(const std::string& frameKey) {
+    auto frame = topLevel.find(frameKey);
+    if (frame == topLevel.end()) {
+        return;
+    }
+    CRDTId frameId = frame->second;
+    topLevel.erase(frame);
+    outstanding.erase(frameKey);
+    readyFrames.push_back(frameId);
+    if (onFrameReady) {
+        onFrameReady(frameId);
+    }
+}
+
+bool SnapshotStreamDecoder::finish() {
+    if (state != State::Done) {
+        state = State::Error;
+        return false;
+    }
+    // Frames referencing nodes the snapshot never contained
+    std::vector<std::string> remaining;
+    for (const auto& pair : topLevel) {
+        remaining.push_back(pair.first);
+    }
+    for (const auto& frameKey : remaining) {
+        markReady(frameKey);
+    }
+    waiters.clear();
+    buffer.clear();
+    consumed = 0;
+    return true;
+}
+
+bool SnapshotStreamDecoder::popReadyFrame(CRDTId& frameId) {
+    if (readyFrames.empty()) {
+        return false;
+    }
+    frameId = readyFrames.front();
+    readyFrames.pop_front();
+    return true;
+}
+
+} // namespace Lienzo
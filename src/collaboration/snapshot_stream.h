@@ -0,0 +1,71 @@
+#pragma once
+
+#include "crdt.h"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Lienzo {
+
+// Incremental decoder for CRDTDocument snapshots
+//
+// Accepts the snapshot in chunks of any size (e.g. straight from a fetch
+// stream) and merges each node into the document as soon as its record is
+// complete. Snapshots list the root first, then every top-level node, then
+// each top-level subtree in turn, so the canvas can lay out frames right
+// away and paint each one when its "frame ready" event fires.
+class SnapshotStreamDecoder {
+public:
+    using FrameReadyCallback = std::function<void(const CRDTId& frameId)>;
+
+    explicit SnapshotStreamDecoder(CRDTDocument& doc);
+
+    void setFrameReadyCallback(FrameReadyCallback callback);
+
+    // Feed the next chunk; false once the stream is malformed
+    bool push(const void* data, size_t size);
+    // End of stream: frames still waiting on missing nodes are reported ready
+    bool finish();
+
+    // Frames that became ready, for callers that poll instead of using the callback
+    bool popReadyFrame(CRDTId& frameId);
+
+    bool isRootReady() const { return rootReady; }
+    bool isComplete() const { return state == State::Done; }
+    bool hasError() const { return state == State::Error; }
+    uint64_t getDecodedNodeCount() const { return decodedNodes; }
+    uint64_t getTotalNodeCount() const { return totalNodes; }
+
+private:
+    enum class State { Header, Records, SiteCount, Sites, Done, Error };
+
+    CRDTDocument& document;
+    FrameReadyCallback onFrameReady;
+    State state;
+
+    std::string buffer;        // Bytes received but not consumed yet
+    size_t consumed;           // Consumed prefix of buffer
+
+    uint64_t totalNodes;
+    uint64_t decodedNodes;
+    uint64_t siteCount;
+    uint64_t sitesRead;
+    bool rootReady;
+
+    // Top-level nodes waiting for each expected descendant, and how many
+    // descendants each top-level node is still waiting for
+    std::unordered_map<std::string, std::vector<std::string>> waiters;
+    std::unordered_map<std::string, size_t> outstanding;
+    std::unordered_map<std::string, CRDTId> topLevel;
+    std::deque<CRDTId> readyFrames;
+
+    bool decodeAvailable();
+    void onNodeDecoded(const CRDTNode& node);
+    void expectChildren(const CRDTNode& node, const std::string& frameKey);
+    void markReady(const std::string& frameKey);
+};
+
+} // namespace Lienzo
@@ -0,0 +1,593 @@
+#include "text_sequence.h"
+#include <algorithm>
+
+namespace Lienzo {
+
+TextSequence::TextSequence(const allocator_type& alloc)
+    : allocator(alloc), pieces(alloc), root(nullptr), siteIndex(alloc),
+      maxClock(0), version(0), seed(0x9E3779B9u) {
+}
+
+TextSequence::TextSequence(const TextSequence& other, const allocator_type& alloc)
+    : TextSequence(alloc) {
+    for (const Piece* piece = leftmost(other.root); piece; piece = successor(piece)) {
+        Piece* copy = newPiece(piece->siteId, piece->clock,
+                               piece->originSite, piece->originClock);
+        copy->chars = piece->chars;
+        copy->deleted = piece->deleted;
+        update(copy);
+        root = join(root, copy);
+        root->parent = nullptr;
+    }
+    pendingInserts = other.pendingInserts;
+    pendingDeletes = other.pendingDeletes;
+    maxClock = other.maxClock;
+    version = other.version;
+}
+
+size_t TextSequence::length() const {
+    return visibleOf(root);
+}
+
+std::string TextSequence::toString() const {
+    std::string result;
+    result.reserve(length());
+    for (const Piece* piece = leftmost(root); piece; piece = successor(piece)) {
+        if (!piece->deleted) {
+            appendUtf8(result, piece->chars.data(), piece->chars.size());
+        }
+    }
+    return result;
+}
+
+CRDTId TextSequence::insertAt(size_t index, const std::u32string& chars, const CRDTId& first) {
+    if (chars.empty()) {
+        return CRDTId();
+    }
+    index = std::min(index, length());
+
+    // New IDs are greater than every ID here, so the run goes directly
+    // after the character left of the cursor (ahead of any tombstones)
+    Piece* previous = nullptr;
+    CRDTId origin;
+    if (index > 0) {
+        size_t offset;
+        previous = findByIndex(index - 1, offset);
+        if (offset + 1 < previous->chars.size()) {
+            splitPiece(previous, offset + 1);
+        }
+        origin = CRDTId(std::string(previous->siteId), previous->clock + offset);
+    }
+    placeRun(previous, first.siteId, first.logicalClock, origin.siteId, origin.logicalClock, chars);
+    return origin;
+}
+
+std::vector<std::pair<CRDTId, size_t>> TextSequence::eraseAt(size_t index, size_t count) {
+    std::vector<std::pair<CRDTId, size_t>> ranges;
+    while (count > 0) {
+        size_t offset;
+        Piece* piece = findByIndex(index, offset);
+        if (!piece) {
+            break;
+        }
+        if (offset > 0) {
+            piece = splitPiece(piece, offset);
+        }
+        size_t removed = std::min(count, piece->chars.size());
+        if (removed < piece->chars.size()) {
+            splitPiece(piece, removed);
+        }
+        piece->deleted = true;
+        updatePath(piece);
+        version++;
+        count -= removed;
+
+        // Coalesce with the previous range when the IDs continue it
+        if (!ranges.empty() && ranges.back().first.siteId == piece->siteId.c_str() &&
+            ranges.back().first.logicalClock + ranges.back().second == piece->clock) {
+            ranges.back().second += removed;
+        } else {
+            ranges.emplace_back(CRDTId(std::string(piece->siteId), piece->clock), removed);
+        }
+    }
+    return ranges;
+}
+
+bool TextSequence::integrateInsert(const CRDTId& first, const CRDTId& origin,
+                                   const std::u32string& chars) {
+    bool changed = applyInsert(first.siteId, first.logicalClock,
+                               origin.siteId, origin.logicalClock, chars);
+    if (changed) {
+        retryPending();
+    }
+    return changed;
+}
+
+bool TextSequence::integrateDelete(const CRDTId& first, size_t count) {
+    return applyDelete(first.siteId, first.logicalClock, count);
+}
+
+bool TextSequence::merge(const TextSequence& other) {
+    bool changed = false;
+    // Document order guarantees every origin is integrated before it is needed
+    for (const Piece* piece = leftmost(other.root); piece; piece = successor(piece)) {
+        changed |= applyInsert(std::string(piece->siteId), piece->clock,
+                               std::string(piece->originSite), piece->originClock,
+                               std::u32string(piece->chars.begin(), piece->chars.end()));
+    }
+    for (const Piece* piece = leftmost(other.root); piece; piece = successor(piece)) {
+        if (piece->deleted) {
+            changed |= applyDelete(std::string(piece->siteId), piece->clock, piece->chars.size());
+        }
+    }
+    for (const auto& run : other.pendingInserts) {
+        changed |= applyInsert(run.id.siteId, run.id.logicalClock,
+                               run.origin.siteId, run.origin.logicalClock, run.chars);
+    }
+    for (const auto& range : other.pendingDeletes) {
+        changed |= applyDelete(range.first.siteId, range.first.logicalClock, range.second);
+    }
+    if (changed) {
+        retryPending();
+    }
+    return changed;
+}
+
+void TextSequence::appendRun(const Run& run) {
+    Piece* piece = newPiece(run.id.siteId, run.id.logicalClock,
+                            run.origin.siteId, run.origin.logicalClock);
+    piece->chars.assign(run.chars.begin(), run.chars.end());
+    piece->deleted = run.deleted;
+    observeClock(run.id.logicalClock + run.chars.size() - 1);
+    version++;
+    update(piece);
+    root = join(root, piece);
+    root->parent = nullptr;
+}
+
+std::u32string TextSequence::getChars(const CRDTId& first, size_t count) const {
+    std::u32string chars;
+    uint64_t clock = first.logicalClock;
+    while (chars.size() < count) {
+        size_t offset;
+        const Piece* piece = findChar(first.siteId, clock, offset);
+        if (!piece) {
+            return std::u32string();
+        }
+        size_t take = std::min(count - chars.size(), piece->chars.size() - offset);
+        chars.append(piece->chars.data() + offset, take);
+        clock += take;
+    }
+    return chars;
+}
+
+std::vector<std::pair<CRDTId, size_t>> TextSequence::getVisibleRanges(const CRDTId& first, size_t count) const {
+    std::vector<std::pair<CRDTId, size_t>> ranges;
+    uint64_t clock = first.logicalClock;
+    uint64_t end = first.logicalClock + count;
+    while (clock < end) {
+        size_t offset;
+        const Piece* piece = findChar(first.siteId, clock, offset);
+        if (!piece) {
+            break;
+        }
+        size_t take = static_cast<size_t>(std::min<uint64_t>(end - clock, piece->chars.size() - offset));
+        if (!piece->deleted) {
+            if (!ranges.empty() && ranges.back().first.logicalClock + ranges.back().second == clock) {
+                ranges.back().second += take;
+            } else {
+                ranges.emplace_back(CRDTId(first.siteId, clock), take);
+            }
+        }
+        clock += take;
+    }
+    return ranges;
+}
+
+std::vector<TextSequence::Run> TextSequence::getRuns() const {
+    std::vector<Run> runs;
+    runs.reserve(pieces.size());
+    for (const Piece* piece = leftmost(root); piece; piece = successor(piece)) {
+        Run run;
+        run.id = CRDTId(std::string(piece->siteId), piece->clock);
+        run.origin = CRDTId(std::string(piece->originSite), piece->originClock);
+        run.chars.assign(piece->chars.begin(), piece->chars.end());
+        run.deleted = piece->deleted;
+        runs.push_back(std::move(run));
+    }
+    return runs;
+}
+
+void TextSequence::getSiteClocks(std::unordered_map<std::string, uint64_t>& clocks) const {
+    for (const auto& site : siteIndex) {
+        if (site.second.empty()) {
+            continue;
+        }
+        const Piece* last = site.second.rbegin()->second;
+        uint64_t& clock = clocks[site.first];
+        clock = std::max(clock, last->clock + last->chars.size() - 1);
+    }
+}
+
+// Piece storage and treap maintenance
+TextSequence::Piece* TextSequence::newPiece(std::string_view site, uint64_t clock,
+                                            std::string_view originSite, uint64_t originClock) {
+    pieces.emplace_back(allocator);
+    Piece* piece = &pieces.back();
+    piece->siteId = site;
+    piece->clock = clock;
+    piece->originSite = originSite;
+    piece->originClock = originClock;
+    piece->priority = nextPriority();
+    siteIndex[std::string(site)][clock] = piece;
+    return piece;
+}
+
+uint32_t TextSequence::nextPriority() {
+    // xorshift32; the shape of the treap does not affect the text
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+void TextSequence::update(Piece* piece) {
+    piece->visible = (piece->deleted ? 0 : piece->chars.size()) +
+                     visibleOf(piece->left) + visibleOf(piece->right);
+    piece->count = 1 + countOf(piece->left) + countOf(piece->right);
+    if (piece->left) {
+        piece->left->parent = piece;
+    }
+    if (piece->right) {
+        piece->right->parent = piece;
+    }
+}
+
+void TextSequence::updatePath(Piece* piece) {
+    for (; piece; piece = piece->parent) {
+        update(piece);
+    }
+}
+
+TextSequence::Piece* TextSequence::leftmost(Piece* piece) {
+    while (piece && piece->left) {
+        piece = piece->left;
+    }
+    return piece;
+}
+
+const TextSequence::Piece* TextSequence::leftmost(const Piece* piece) {
+    return leftmost(const_cast<Piece*>(piece));
+}
+
+TextSequence::Piece* TextSequence::successor(const Piece* piece) {
+    if (piece->right) {
+        return leftmost(piece->right);
+    }
+    while (piece->parent && piece == piece->parent->right) {
+        piece = piece->parent;
+    }
+    return piece->parent;
+}
+
+size_t TextSequence::rankOf(const Piece* piece) {
+    size_t rank = countOf(piece->left);
+    for (; piece->parent; piece = piece->parent) {
+        if (piece == piece->parent->right) {
+            rank += countOf(piece->parent->left) + 1;
+        }
+    }
+    return rank;
+}
+
+void TextSequence::split(Piece* tree, size_t count, Piece*& left, Piece*& right) {
+    // left receives the first count pieces of tree, right the rest
+    if (!tree) {
+        left = right = nullptr;
+        return;
+    }
+    if (countOf(tree->left) < count) {
+        split(tree->right, count - countOf(tree->left) - 1, tree->right, right);
+        left = tree;
+    } else {
+        split(tree->left, count, left, tree->left);
+        right = tree;
+    }
+    update(tree);
+}
+
+TextSequence::Piece* TextSequence::join(Piece* left, Piece* right) {
+    if (!left) {
+        return right;
+    }
+    if (!right) {
+        return left;
+    }
+    if (left->priority > right->priority) {
+        left->right = join(left->right, right);
+        update(left);
+        return left;
+    }
+    right->left = join(left, right->left);
+    update(right);
+    return right;
+}
+
+void TextSequence::insertAfter(Piece* previous, Piece* piece) {
+    update(piece);
+    Piece* left;
+    Piece* right;
+    split(root, previous ? rankOf(previous) + 1 : 0, left, right);
+    root = join(join(left, piece), right);
+    root->parent = nullptr;
+}
+
+// Character lookup
+TextSequence::Piece* TextSequence::findByIndex(size_t index, size_t& offset) const {
+    Piece* piece = root;
+    while (piece) {
+        size_t leftVisible = visibleOf(piece->left);
+        if (index < leftVisible) {
+            piece = piece->left;
+            continue;
+        }
+        index -= leftVisible;
+        size_t own = piece->deleted ? 0 : piece->chars.size();
+        if (index < own) {
+            offset = index;
+            return piece;
+        }
+        index -= own;
+        piece = piece->right;
+    }
+    return nullptr;
+}
+
+TextSequence::Piece* TextSequence::findChar(const std::string& site, uint64_t clock,
+                                            size_t& offset) const {
+    auto entry = siteIndex.find(site);
+    if (entry == siteIndex.end()) {
+        return nullptr;
+    }
+    auto it = entry->second.upper_bound(clock);
+    if (it == entry->second.begin()) {
+        return nullptr;
+    }
+    Piece* piece = (--it)->second;
+    if (clock >= piece->clock + piece->chars.size()) {
+        return nullptr;
+    }
+    offset = static_cast<size_t>(clock - piece->clock);
+    return piece;
+}
+
+size_t TextSequence::missingSpan(const std::string& site, uint64_t clock, size_t count) const {
+    // Characters from clock on that are absent, up to the next piece of the site
+    auto entry = siteIndex.find(site);
+    if (entry != siteIndex.end()) {
+        auto next = entry->second.upper_bound(clock);
+        if (next != entry->second.end() && next->first < clock + count) {
+            return static_cast<size_t>(next->first - clock);
+        }
+    }
+    return count;
+}
+
+TextSequence::Piece* TextSequence::splitPiece(Piece* piece, size_t offset) {
+    // Characters after the first keep their predecessor as origin
+    uint64_t clock = piece->clock + offset;
+    Piece* rest = newPiece(piece->siteId, clock, piece->siteId, clock - 1);
+    rest->chars.assign(piece->chars, offset, std::u32string::npos);
+    rest->deleted = piece->deleted;
+    piece->chars.resize(offset);
+    updatePath(piece);
+    insertAfter(piece, rest);
+    return rest;
+}
+
+// Integration
+bool TextSequence::applyInsert(const std::string& site, uint64_t clock,
+                               const std::string& originSite, uint64_t originClock,
+                               const std::u32string& chars) {
+    bool changed = false;
+    size_t i = 0;
+    while (i < chars.size()) {
+        size_t offset;
+        Piece* present = findChar(site, clock + i, offset);
+        if (present) {
+            i += present->chars.size() - offset; // Already integrated
+            continue;
+        }
+        size_t end = i + missingSpan(site, clock + i, chars.size() - i);
+        std::string segmentOrigin = i == 0 ? originSite : site;
+        uint64_t segmentOriginClock = i == 0 ? originClock : clock + i - 1;
+        std::u32string segment = chars.substr(i, end - i);
+
+        Piece* previous = nullptr;
+        if (!segmentOrigin.empty()) {
+            previous = findChar(segmentOrigin, segmentOriginClock, offset);
+            if (!previous) {
+                pendingInserts.push_back(Run{CRDTId(site, clock + i),
+                                             CRDTId(segmentOrigin, segmentOriginClock),
+                                             segment, false});
+                i = end;
+                continue;
+            }
+            if (offset + 1 < previous->chars.size()) {
+                splitPiece(previous, offset + 1);
+            }
+        }
+
+        // Skip concurrent runs inserted after the same origin with greater IDs
+        // (and, with them, everything inserted after those runs)
+        Piece* next = previous ? successor(previous) : leftmost(root);
+        while (next && isGreater(next, site, clock + i)) {
+            previous = next;
+            next = successor(next);
+        }
+        placeRun(previous, site, clock + i, segmentOrigin, segmentOriginClock, segment);
+        changed = true;
+        i = end;
+    }
+    return changed;
+}
+
+void TextSequence::placeRun(Piece* previous, const std::string& site, uint64_t clock,
+                            const std::string& originSite, uint64_t originClock,
+                            const std::u32string& chars) {
+    observeClock(clock + chars.size() - 1);
+    version++;
+
+    // Typing at the end of one's own run extends it in place
+    if (previous && !previous->deleted && originSite == site && originClock + 1 == clock &&
+        previous->siteId == site.c_str() &&
+        previous->clock + previous->chars.size() == clock) {
+        previous->chars.append(chars);
+        updatePath(previous);
+        return;
+    }
+    Piece* piece = newPiece(site, clock, originSite, originClock);
+    piece->chars.assign(chars.begin(), chars.end());
+    insertAfter(previous, piece);
+}
+
+bool TextSequence::applyDelete(const std::string& site, uint64_t clock, size_t count) {
+    bool changed = false;
+    size_t i = 0;
+    while (i < count) {
+        size_t offset;
+        Piece* piece = findChar(site, clock + i, offset);
+        if (!piece) {
+            // Not inserted yet; delete it once it arrives
+            size_t span = missingSpan(site, clock + i, count - i);
+            pendingDeletes.emplace_back(CRDTId(site, clock + i), span);
+            i += span;
+            continue;
+        }
+        size_t removed = std::min(count - i, piece->chars.size() - offset);
+        if (!piece->deleted) {
+            if (offset > 0) {
+                piece = splitPiece(piece, offset);
+            }
+            if (removed < piece->chars.size()) {
+                splitPiece(piece, removed);
+            }
+            piece->deleted = true;
+            updatePath(piece);
+            version++;
+            changed = true;
+        }
+        i += removed;
+    }
+    return changed;
+}
+
+void TextSequence::retryPending() {
+    // Each pass may resolve origins that later pending runs depend on
+    bool progress = true;
+    while (progress && (!pendingInserts.empty() || !pendingDeletes.empty())) {
+        progress = false;
+        std::vector<Run> inserts;
+        inserts.swap(pendingInserts);
+        for (const auto& run : inserts) {
+            progress |= applyInsert(run.id.siteId, run.id.logicalClock,
+                                    run.origin.siteId, run.origin.logicalClock, run.chars);
+        }
+        std::vector<std::pair<CRDTId, size_t>> deletes;
+        deletes.swap(pendingDeletes);
+        for (const auto& range : deletes) {
+            applyDelete(range.first.siteId, range.first.logicalClock, range.second);
+        }
+    }
+}
+
+void TextSequence::observeClock(uint64_t clock) {
+    maxClock = std::max(maxClock, clock);
+}
+
+bool TextSequence::isGreater(const Piece* piece, const std::string& site, uint64_t clock) {
+    // Same order as LWW timestamps: clock first, then site
+    return piece->clock > clock || (piece->clock == clock && piece->siteId > site.c_str());
+}
+
+// UTF-8
+void TextSequence::appendUtf8(std::string& out, const char32_t* chars, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        char32_t c = chars[i];
+        if (c < 0x80) {
+            out += static_cast<char>(c);
+        } else if (c < 0x800) {
+            out += static_cast<char>(0xC0 | (c >> 6));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            out += static_cast<char>(0xE0 | (c >> 12));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (c >> 18));
+            out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+}
+
+std::string TextSequence::encodeUtf8(const std::u32string& chars) {
+    std::string out;
+    out.reserve(chars.size());
+    appendUtf8(out, chars.data(), chars.size());
+    return out;
+}
+
+std::u32string TextSequence::decodeUtf8(const std::string& text) {
+    static const char32_t kReplacement = 0xFFFD;
+    std::u32string out;
+    out.reserve(text.size());
+    size_t i = 0;
+    while (i < text.size()) {
+        unsigned char lead = static_cast<unsigned char>(text[i]);
+        size_t extra;
+        char32_t c;
+        if (lead < 0x80) {
+            out += lead;
+            i++;
+            continue;
+        } else if ((lead & 0xE0) == 0xC0) {
+            extra = 1;
+            c = lead & 0x1F;
+        } else if ((lead & 0xF0) == 0xE0) {
+            extra = 2;
+            c = lead & 0x0F;
+        } else if ((lead & 0xF8) == 0xF0) {
+            extra = 3;
+            c = lead & 0x07;
+        } else {
+            out += kReplacement;
+            i++;
+            continue;
+        }
+        if (i + extra >= text.size()) {
+            out += kReplacement;
+            break;
+        }
+        bool valid = true;
+        for (size_t k = 1; k <= extra; k++) {
+            unsigned char next = static_cast<unsigned char>(text[i + k]);
+            if ((next & 0xC0) != 0x80) {
+                valid = false;
+                break;
+            }
+            c = (c << 6) | (next & 0x3F);
+        }
+        if (!valid) {
+            out += kReplacement;
+            i++;
+            continue;
+        }
+        out += c;
+        i += extra + 1;
+    }
+    return out;
+}
+
+} // namespace Lienzo
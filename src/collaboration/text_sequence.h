@@ -0,0 +1,162 @@
+#pragma once
+
+#include "crdt.h"
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Lienzo {
+
+// Character-level sequence CRDT for text content (RGA)
+//
+// Every character has a unique ID and remembers the character it was typed
+// after (its origin). Concurrent inserts after the same origin are ordered
+// by descending ID, and deleted characters stay behind as tombstones, so
+// replicas that saw the same inserts and deletes agree on the text no
+// matter in which order they arrived.
+//
+// Characters are stored in runs: one insert of N characters gets N
+// consecutive clocks from one site, so it is kept as a single piece and
+// typing at the end of a run extends it in place. Pieces live in a treap
+// ordered by position that tracks visible lengths per subtree (a rope), so
+// finding, inserting and deleting by index is O(log n). A per-site index
+// maps character IDs back to their piece for remote operations.
+//
+// Indexes and lengths count Unicode code points.
+class TextSequence {
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    // One run of characters with consecutive clocks from a single site
+    struct Run {
+        CRDTId id;              // ID of the first character
+        CRDTId origin;          // Character the run was inserted after (empty: start)
+        std::u32string chars;
+        bool deleted;
+    };
+
+    explicit TextSequence(const allocator_type& alloc = allocator_type());
+    TextSequence(const TextSequence& other, const allocator_type& alloc = allocator_type());
+    TextSequence& operator=(const TextSequence&) = delete;
+
+    // Visible text
+    size_t length() const;
+    std::string toString() const;
+    // Bumped by every change; lets layout caches skip rebuilding the string
+    uint64_t getVersion() const { return version; }
+
+    // Local edits. The caller reserves chars.size() consecutive clocks
+    // starting at first, all greater than getMaxClock().
+    // Returns the origin the run was inserted after.
+    CRDTId insertAt(size_t index, const std::u32string& chars, const CRDTId& first);
+    // Deletes visible characters [index, index + count); returns the deleted
+    // ranges as (first ID, character count)
+    std::vector<std::pair<CRDTId, size_t>> eraseAt(size_t index, size_t count);
+
+    // Remote or replayed edits; both are idempotent and return true if the
+    // text changed. Operations whose origin has not arrived yet are held
+    // back and applied once it does.
+    bool integrateInsert(const CRDTId& first, const CRDTId& origin, const std::u32string& chars);
+    bool integrateDelete(const CRDTId& first, size_t count);
+
+    // Merge another replica's state of the same text
+    bool merge(const TextSequence& other);
+
+    // Append a stored run at the end as-is (decoding only)
+    void appendRun(const Run& run);
+    // Runs in document order, tombstones included
+    std::vector<Run> getRuns() const;
+    // Characters first .. first + count - 1 (deleted or not); empty if any
+    // of them is unknown
+    std::u32string getChars(const CRDTId& first, size_t count) const;
+    // The visible characters among first .. first + count - 1, as (first
+    // ID, character count) ranges
+    std::vector<std::pair<CRDTId, size_t>> getVisibleRanges(const CRDTId& first, size_t count) const;
+    size_t getRunCount() const { return pieces.size(); }
+
+    // Highest character clock per site, and overall
+    void getSiteClocks(std::unordered_map<std::string, uint64_t>& clocks) const;
+    uint64_t getMaxClock() const { return maxClock; }
+
+    // UTF-8 <-> code points; invalid bytes decode as U+FFFD
+    static std::u32string decodeUtf8(const std::string& text);
+    static std::string encodeUtf8(const std::u32string& chars);
+
+private:
+    struct Piece {
+        std::pmr::string siteId;
+        uint64_t clock;
+        std::pmr::string originSite;
+        uint64_t originClock;
+        std::pmr::u32string chars;
+        bool deleted;
+
+        // Treap links and subtree totals
+        uint32_t priority;
+        Piece* left;
+        Piece* right;
+        Piece* parent;
+        size_t visible;   // Visible characters in this subtree
+        size_t count;     // Pieces in this subtree
+
+        Piece(const allocator_type& alloc)
+            : siteId(alloc), clock(0), originSite(alloc), originClock(0), chars(alloc),
+              deleted(false), priority(0), left(nullptr), right(nullptr), parent(nullptr),
+              visible(0), count(1) {}
+    };
+
+    allocator_type allocator;
+    std::pmr::deque<Piece> pieces;     // Storage; pieces are never freed
+    Piece* root;
+    // site -> first clock of each piece -> piece
+    std::pmr::unordered_map<std::string, std::pmr::map<uint64_t, Piece*>> siteIndex;
+    // Remote operations waiting for their origin or target to arrive
+    std::vector<Run> pendingInserts;
+    std::vector<std::pair<CRDTId, size_t>> pendingDeletes;
+    uint64_t maxClock;
+    uint64_t version;
+    uint32_t seed;
+
+    Piece* newPiece(std::string_view site, uint64_t clock,
+                    std::string_view originSite, uint64_t originClock);
+    uint32_t nextPriority();
+
+    // Treap primitives
+    static size_t visibleOf(const Piece* piece) { return piece ? piece->visible : 0; }
+    static size_t countOf(const Piece* piece) { return piece ? piece->count : 0; }
+    static void update(Piece* piece);
+    static void updatePath(Piece* piece);
+    static Piece* leftmost(Piece* piece);
+    static const Piece* leftmost(const Piece* piece);
+    static Piece* successor(const Piece* piece);
+    static size_t rankOf(const Piece* piece);
+    void split(Piece* tree, size_t count, Piece*& left, Piece*& right);
+    Piece* join(Piece* left, Piece* right);
+    void insertAfter(Piece* previous, Piece* piece);
+
+    // Character lookup
+    Piece* findByIndex(size_t index, size_t& offset) const;
+    Piece* findChar(const std::string& site, uint64_t clock, size_t& offset) const;
+    size_t missingSpan(const std::string& site, uint64_t clock, size_t count) const;
+    // Split piece so that its first offset characters stay; returns the rest
+    Piece* splitPiece(Piece* piece, size_t offset);
+
+    bool applyInsert(const std::string& site, uint64_t clock, const std::string& originSite,
+                     uint64_t originClock, const std::u32string& chars);
+    void placeRun(Piece* previous, const std::string& site, uint64_t clock,
+                  const std::string& originSite, uint64_t originClock,
+                  const std::u32string& chars);
+    bool applyDelete(const std::string& site, uint64_t clock, size_t count);
+    void retryPending();
+    void observeClock(uint64_t clock);
+    static bool isGreater(const Piece* piece, const std::string& site, uint64_t clock);
+    static void appendUtf8(std::string& out, const char32_t* chars, size_t count);
+};
+
+} // namespace Lienzo
@@ -0,0 +1,380 @@
+#include "undo_manager.h"
+#include "text_sequence.h"
+#include <algorithm>
+#include <limits>
+
+namespace Lienzo {
+
+const size_t UndoManager::kDefaultMemoryLimit = 8 * 1024 * 1024;
+const double UndoManager::kDefaultCoalesceWindow = 0.5;
+
+void UndoManager::StepIndex::clear() {
+    properties.clear();
+    nodes.clear();
+    created.clear();
+}
+
+UndoManager::UndoManager(CRDTDocument& document, size_t memoryLimit)
+    : document(document), memoryLimit(memoryLimit), coalesceWindow(kDefaultCoalesceWindow),
+      nextSequence(0), pendingOverflow(false), coalesceBroken(false), mode(Mode::Recording),
+      memoryUsage(0), coalescedSteps(0), droppedSteps(0) {
+    listenerHandle = document.addOperationListener([this](const CRDTOperation& op, bool local) {
+        if (local) {
+            onOperation(op);
+        }
+    });
+    batchListenerHandle = document.addBatchListener([this]() { finishStep(); });
+}
+
+UndoManager::~UndoManager() {
+    document.removeOperationListener(listenerHandle);
+    document.removeBatchListener(batchListenerHandle);
+}
+
+bool UndoManager::undo() {
+    return replay(undoStack, Mode::Undoing);
+}
+
+bool UndoManager::redo() {
+    return replay(redoStack, Mode::Redoing);
+}
+
+void UndoManager::clear() {
+    undoStack.clear();
+    redoStack.clear();
+    topIndex.clear();
+    textAliases.clear();
+    aliasOrder.clear();
+    memoryUsage = 0;
+}
+
+void UndoManager::setMemoryLimit(size_t bytes) {
+    memoryLimit = bytes;
+    enforceLimit();
+}
+
+void UndoManager::onOperation(const CRDTOperation& op) {
+    // A clone's expansion is undone with the clone
+    if (!pendingOverflow && !document.isExpandingClone()) {
+        bool changed = document.didLocalOperationChange();
+        std::string node = op.nodeId.toString();
+        // Content of a node created in this step goes when the node does
+        bool created = pendingIndex.created.count(node) > 0;
+        switch (op.type) {
+            case CRDTOperationType::CreateNode:
+                pendingIndex.created.insert(node);
+                record(CRDTOperation::deleteNode(op.nodeId, CRDTId()));
+                break;
+            case CRDTOperationType::CloneSubtree:
+                pendingIndex.created.insert(op.timestamp.toString());
+                record(CRDTOperation::deleteNode(op.timestamp, CRDTId()));
+                break;
+            case CRDTOperationType::SetProperty: {
+                if (!changed || created) {
+                    break;
+                }
+                // Only the value before the step's first write matters
+                if (!pendingIndex.properties.emplace(node + "/" + op.key, pending.inverses.size()).second) {
+                    break;
+                }
+                pendingIndex.nodes.insert(node);
+                record(CRDTOperation::setProperty(op.nodeId, op.key, document.getReplacedValue(), CRDTId()));
+                break;
+            }
+            case CRDTOperationType::AddChild:
+                if (changed) {
+                    record(CRDTOperation::removeChild(op.nodeId, op.childId, CRDTId()));
+                }
+                break;
+            case CRDTOperationType::RemoveChild:
+                if (changed) {
+                    record(CRDTOperation::addChild(op.nodeId, op.childId, CRDTId()));
+                }
+                break;
+            case CRDTOperationType::DeleteNode:
+                if (changed) {
+                    record(CRDTOperation::restoreNode(op.nodeId, CRDTId()));
+                }
+                break;
+            case CRDTOperationType::RestoreNode:
+                if (changed) {
+                    record(CRDTOperation::deleteNode(op.nodeId, CRDTId()));
+                }
+                break;
+            case CRDTOperationType::InsertText:
+                if (!created) {
+                    record(CRDTOperation::deleteText(op.nodeId, op.timestamp,
+                                                     TextSequence::decodeUtf8(op.value).size()));
+                }
+                break;
+            case CRDTOperationType::DeleteText: {
+                auto target = created ? nullptr : document.getNode(op.nodeId);
+                if (!target || !target->getText()) {
+                    break;
+                }
+                // Deleted characters stay as tombstones: type them again
+                // right after the last one (the inverse keeps the first)
+                size_t count = static_cast<size_t>(op.childId.logicalClock - op.timestamp.logicalClock + 1);
+                std::u32string chars = target->getText()->getChars(op.timestamp, count);
+                if (!chars.empty()) {
+                    record(CRDTOperation::insertText(op.nodeId, op.timestamp, op.childId,
+                                                     TextSequence::encodeUtf8(chars)));
+                }
+                break;
+            }
+        }
+    }
+    if (!document.isInBatch()) {
+        finishStep();
+    }
+}
+
+void UndoManager::record(CRDTOperation inverse) {
+    pending.bytes += bytesOf(inverse);
+    pending.propertiesOnly = pending.propertiesOnly && inverse.type == CRDTOperationType::SetProperty;
+    pending.inverses.push_back(std::move(inverse));
+    if (pending.bytes > memoryLimit) {
+        // Too large to keep at all; stop recording until the step ends
+        pendingOverflow = true;
+        pending = Step();
+        pendingIndex.clear();
+    }
+}
+
+void UndoManager::finishStep() {
+    Step step = std::move(pending);
+    pending = Step();
+    StepIndex index = std::move(pendingIndex);
+    pendingIndex.clear();
+    bool overflow = pendingOverflow;
+    pendingOverflow = false;
+
+    if (overflow) {
+        droppedSteps++;
+    }
+    if (step.inverses.empty()) {
+        if (overflow && mode == Mode::Recording) {
+            // Redo steps assume the document as it was after the undo
+            for (const auto& dropped : redoStack) {
+                memoryUsage -= dropped.bytes;
+            }
+            redoStack.clear();
+            pruneAliases();
+        }
+        return;
+    }
+    step.last = std::chrono::steady_clock::now();
+
+    switch (mode) {
+        case Mode::Recording:
+            for (const auto& dropped : redoStack) {
+                memoryUsage -= dropped.bytes;
+            }
+            redoStack.clear();
+            if (coalesce(step, index)) {
+                coalescedSteps++;
+            } else {
+                pushStep(undoStack, std::move(step));
+                topIndex = std::move(index);
+            }
+            coalesceBroken = false;
+            break;
+        case Mode::Undoing:
+            pushStep(redoStack, std::move(step));
+            break;
+        case Mode::Redoing:
+            pushStep(undoStack, std::move(step));
+            topIndex.clear();
+            break;
+    }
+    enforceLimit();
+}
+
+bool UndoManager::coalesce(Step& step, StepIndex& index) {
+    if (!step.propertiesOnly || coalesceBroken || coalesceWindow <= 0.0 || undoStack.empty()) {
+        return false;
+    }
+    Step& top = undoStack.back();
+    if (!top.propertiesOnly || index.nodes != topIndex.nodes ||
+        std::chrono::duration<double>(step.last - top.last).count() > coalesceWindow) {
+        return false;
+    }
+    // The top step already holds the oldest value of what both touched
+    for (const auto& entry : index.properties) {
+        if (topIndex.properties.count(entry.first)) {
+            continue;
+        }
+        CRDTOperation& inverse = step.inverses[entry.second];
+        topIndex.properties.emplace(entry.first, top.inverses.size());
+        size_t bytes = bytesOf(inverse);
+        top.bytes += bytes;
+        memoryUsage += bytes;
+        top.inverses.push_back(std::move(inverse));
+    }
+    top.last = step.last;
+    return true;
+}
+
+void UndoManager::enforceLimit() {
+    pruneAliases();
+    while (memoryUsage > memoryLimit && (!undoStack.empty() || !redoStack.empty())) {
+        std::deque<Step>& stack = !undoStack.empty() ? undoStack : redoStack;
+        memoryUsage -= stack.front().bytes;
+        stack.pop_front();
+        droppedSteps++;
+        if (undoStack.empty()) {
+            topIndex.clear();
+        }
+        pruneAliases();
+    }
+}
+
+void UndoManager::pushStep(std::deque<Step>& stack, Step step) {
+    // Both stacks stay ordered by sequence, oldest first
+    step.sequence = nextSequence++;
+    memoryUsage += step.bytes;
+    stack.push_back(std::move(step));
+}
+
+void UndoManager::pruneAliases() {
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    if (!undoStack.empty()) {
+        oldest = undoStack.front().sequence;
+    }
+    if (!redoStack.empty()) {
+        oldest = std::min(oldest, redoStack.front().sequence);
+    }
+    while (!aliasOrder.empty() && aliasOrder.front().before <= oldest) {
+        const AliasKey& key = aliasOrder.front();
+        auto site = textAliases.find(key.site);
+        if (site != textAliases.end()) {
+            auto it = site->second.find(key.clock);
+            // Unless a later alias replaced it
+            if (it != site->second.end() && it->second.before == key.before) {
+                memoryUsage -= aliasBytes(key.site, it->second);
+                site->second.erase(it);
+                if (site->second.empty()) {
+                    textAliases.erase(site);
+                }
+            }
+        }
+        aliasOrder.pop_front();
+    }
+}
+
+bool UndoManager::replay(std::deque<Step>& stack, Mode replayMode) {
+    // Close whatever is being recorded (undo inside an open batch)
+    finishStep();
+    if (stack.empty()) {
+        return false;
+    }
+    Step step = std::move(stack.back());
+    stack.pop_back();
+    memoryUsage -= step.bytes;
+    if (&stack == &undoStack) {
+        topIndex.clear();
+    }
+
+    // The inverses' own inverses are recorded as the opposite step
+    mode = replayMode;
+    document.beginBatch();
+    for (auto it = step.inverses.rbegin(); it != step.inverses.rend(); ++it) {
+        apply(*it);
+    }
+    document.endBatch();
+    finishStep();
+    mode = Mode::Recording;
+    coalesceBroken = true;
+    pruneAliases();
+    return true;
+}
+
+void UndoManager::apply(const CRDTOperation& inverse) {
+    switch (inverse.type) {
+        case CRDTOperationType::SetProperty: {
+            auto node = document.getNode(inverse.nodeId);
+            if (!node) {
+                break;
+            }
+            // Another site wrote it after us: their value stands
+            auto it = node->getProperties().find(inverse.key);
+            if (it == node->getProperties().end() || it->second.timestamp.siteId != document.getSiteId()) {
+                break;
+            }
+            document.setNodeProperty(inverse.nodeId, inverse.key, inverse.value);
+            break;
+        }
+        case CRDTOperationType::AddChild:
+            document.addChild(inverse.nodeId, inverse.childId);
+            break;
+        case CRDTOperationType::RemoveChild:
+            document.removeChild(inverse.nodeId, inverse.childId);
+            break;
+        case CRDTOperationType::DeleteNode:
+            document.deleteNode(inverse.nodeId);
+            break;
+        case CRDTOperationType::RestoreNode:
+            document.restoreNode(inverse.nodeId);
+            break;
+        case CRDTOperationType::InsertText: {
+            CRDTId copy = document.insertTextAfter(inverse.nodeId, inverse.childId, inverse.value);
+            if (!copy.siteId.empty()) {
+                // Steps stacked from here on refer to the copy itself
+                const std::string& site = inverse.timestamp.siteId;
+                TextAlias alias{TextSequence::decodeUtf8(inverse.value).size(), copy, nextSequence};
+                auto inserted = textAliases[site].emplace(inverse.timestamp.logicalClock, alias);
+                if (!inserted.second) {
+                    memoryUsage -= aliasBytes(site, inserted.first->second);
+                    inserted.first->second = alias;
+                }
+                memoryUsage += aliasBytes(site, alias);
+                aliasOrder.push_back(AliasKey{alias.before, site, inverse.timestamp.logicalClock});
+            }
+            break;
+        }
+        case CRDTOperationType::DeleteText:
+            deleteText(inverse.nodeId, inverse.timestamp,
+                       static_cast<size_t>(inverse.childId.logicalClock - inverse.timestamp.logicalClock + 1));
+            break;
+        case CRDTOperationType::CreateNode:
+        case CRDTOperationType::CloneSubtree:
+            break;
+    }
+}
+
+void UndoManager::deleteText(const CRDTId& nodeId, const CRDTId& first, size_t count) {
+    document.deleteTextById(nodeId, first, count);
+    // New IDs of any of these characters that an undo typed again
+    auto site = textAliases.find(first.siteId);
+    if (site == textAliases.end()) {
+        return;
+    }
+    uint64_t begin = first.logicalClock;
+    uint64_t end = begin + count;
+    auto it = site->second.upper_bound(begin);
+    if (it != site->second.begin()) {
+        --it;
+    }
+    for (; it != site->second.end() && it->first < end; ++it) {
+        uint64_t from = std::max(begin, it->first);
+        uint64_t to = std::min(end, it->first + it->second.count);
+        if (from < to) {
+            const CRDTId& copy = it->second.first;
+            deleteText(nodeId, CRDTId(copy.siteId, copy.logicalClock + (from - it->first)),
+                       static_cast<size_t>(to - from));
+        }
+    }
+}
+
+size_t UndoManager::aliasBytes(const std::string& site, const TextAlias& alias) {
+    // Approximate: the map entry and its place in aliasOrder
+    return sizeof(TextAlias) + sizeof(AliasKey) + 2 * site.size() + alias.first.siteId.size();
+}
+
+size_t UndoManager::bytesOf(const CRDTOperation& op) {
+    // Approximate: the operation plus its strings
+    return sizeof(CRDTOperation) + op.key.size() + op.value.size() + op.nodeId.siteId.size() +
+           op.childId.siteId.size() + op.timestamp.siteId.size();
+}
+
+} // namespace Lienzo
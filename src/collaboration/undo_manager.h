@@ -0,0 +1,146 @@
+#pragma once
+
+#include "crdt.h"
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Lienzo {
+
+// Per-site undo and redo over a CRDTDocument
+//
+// Instead of copies of the document, every local change is recorded as
+// its inverse when it happens: the value a property had before, the
+// opposite child add or remove, a restore for a delete (and a delete for a
+// create), and text deletes and re-inserts by character ID. One outermost
+// batch (or one operation outside a batch) is one step. Undo applies the
+// step's inverses as new local operations in one batch, so they reach
+// peers and merge with concurrent remote edits like any other edit.
+// Remote operations are never recorded, and a property another site wrote
+// after us is left as it is. The operations an undo applies are recorded
+// in turn and become the redo step.
+//
+// Child order is not restored. Children are ordered by when they were last
+// added, and an undo's add is the latest there is: a child whose removal is
+// undone comes back as the last child, and re-adding a child that is
+// already there (moving it to the end) is not recorded as a step.
+//
+// Drags write the same nodes' properties every frame: a step that only
+// sets properties on the same nodes as the previous one, within the
+// coalescing window, merges into it and keeps the oldest values. The
+// stacks are capped in bytes, dropping the oldest steps first. Undo and
+// redo cost O(operations in the step), whatever the size of the document.
+class UndoManager {
+public:
+    static const size_t kDefaultMemoryLimit;
+    static const double kDefaultCoalesceWindow;    // Seconds
+
+    explicit UndoManager(CRDTDocument& document, size_t memoryLimit = kDefaultMemoryLimit);
+    ~UndoManager();
+    UndoManager(const UndoManager&) = delete;
+    UndoManager& operator=(const UndoManager&) = delete;
+
+    bool canUndo() const { return !undoStack.empty(); }
+    bool canRedo() const { return !redoStack.empty(); }
+    // Revert the last step, or re-apply the last undone one; false if there
+    // is none
+    bool undo();
+    bool redo();
+    void clear();
+
+    // The next change starts a new step even if it could coalesce (call
+    // when a drag ends)
+    void breakCoalescing() { coalesceBroken = true; }
+    // 0 turns coalescing off
+    void setCoalesceWindow(double seconds) { coalesceWindow = seconds; }
+    void setMemoryLimit(size_t bytes);
+
+    // Statistics
+    size_t getUndoDepth() const { return undoStack.size(); }
+    size_t getRedoDepth() const { return redoStack.size(); }
+    size_t getMemoryUsage() const { return memoryUsage; }
+    size_t getMemoryLimit() const { return memoryLimit; }
+    size_t getCoalescedSteps() const { return coalescedSteps; }
+    size_t getDroppedSteps() const { return droppedSteps; }
+
+private:
+    enum class Mode : uint8_t {
+        Recording,
+        Undoing,
+        Redoing
+    };
+
+    // Inverses are kept as operation templates: apply() issues each through
+    // the document's local API, which stamps it anew. Only text inverses
+    // carry IDs, those of the characters they refer to.
+    struct Step {
+        std::vector<CRDTOperation> inverses;    // In the order the changes were made
+        uint64_t sequence = 0;                  // Order the steps were stacked in
+        size_t bytes = 0;
+        bool propertiesOnly = true;
+        std::chrono::steady_clock::time_point last;
+    };
+    // Where a step's property inverses are, for coalescing; kept for the
+    // step being recorded and the top of the undo stack only
+    struct StepIndex {
+        std::unordered_map<std::string, size_t> properties;    // "node id/key" -> inverse
+        std::unordered_set<std::string> nodes;
+        std::unordered_set<std::string> created;     // Nodes created in the step
+        void clear();
+    };
+
+    // Characters an undo typed again, standing in for the deleted ones
+    // they copy when a later step deletes those. Only steps stacked before
+    // the alias was made refer to the deleted characters, so it is kept
+    // (and counted in memoryUsage) until the last of them is gone.
+    struct TextAlias {
+        size_t count;
+        CRDTId first;
+        uint64_t before;    // Steps with a lower sequence may need it
+    };
+    struct AliasKey {
+        uint64_t before;
+        std::string site;
+        uint64_t clock;
+    };
+
+    CRDTDocument& document;
+    size_t memoryLimit;
+    double coalesceWindow;
+    std::deque<Step> undoStack;     // Oldest first
+    std::deque<Step> redoStack;
+    Step pending;
+    StepIndex pendingIndex;
+    StepIndex topIndex;
+    std::unordered_map<std::string, std::map<uint64_t, TextAlias>> textAliases;    // Site -> clock
+    std::deque<AliasKey> aliasOrder;    // Oldest first
+    uint64_t nextSequence;
+    bool pendingOverflow;
+    bool coalesceBroken;
+    Mode mode;
+    size_t memoryUsage;
+    size_t coalescedSteps;
+    size_t droppedSteps;
+    size_t listenerHandle;
+    size_t batchListenerHandle;
+
+    void onOperation(const CRDTOperation& op);
+    void record(CRDTOperation inverse);
+    void finishStep();
+    bool coalesce(Step& step, StepIndex& index);
+    void enforceLimit();
+    void pushStep(std::deque<Step>& stack, Step step);
+    void pruneAliases();
+    static size_t aliasBytes(const std::string& site, const TextAlias& alias);
+    bool replay(std::deque<Step>& from, Mode replayMode);
+    void apply(const CRDTOperation& inverse);
+    void deleteText(const CRDTId& nodeId, const CRDTId& first, size_t count);
+    static size_t bytesOf(const CRDTOperation& op);
+};
+
+} // namespace Lienzo
@@ -0,0 +1,621 @@
+#include "boolean_ops.h"
+#include "hit_test.h"
+#include "numbers.h"
+#include "svg_export.h"
+#include "svg_import.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Lienzo {
+
+// Robust predicates
+namespace {
+
+// Bound on the rounding error of the filtered determinant (Shewchuk's
+// ccwerrboundA, with epsilon = 2^-53)
+const double kEpsilon = 1.1102230246251565e-16;
+const double kOrientErrorBound = (3.0 + 16.0 * kEpsilon) * kEpsilon;
+
+void twoSum(double a, double b, double& sum, double& error) {
+    sum = a + b;
+    double bVirtual = sum - a;
+    double aVirtual = sum - bVirtual;
+    error = (a - aVirtual) + (b - bVirtual);
+}
+
+void twoProduct(double a, double b, double& product, double& error) {
+    product = a * b;
+    error = std::fma(a, b, -product);
+}
+
+// Add b to the nonoverlapping expansion e[0..n), smallest component first,
+// dropping zero components; returns the new length
+int growExpansion(double* e, int n, double b) {
+    double q = b;
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        double sum, error;
+        twoSum(q, e[i], sum, error);
+        if (error != 0.0) {
+            e[m++] = error;
+        }
+        q = sum;
+    }
+    if (q != 0.0 || m == 0) {
+        e[m++] = q;
+    }
+    return m;
+}
+
+} // namespace
+
+int orient2d(const Point& a, const Point& b, const Point& c) {
+    double left = (a.x - c.x) * (b.y - c.y);
+    double right = (a.y - c.y) * (b.x - c.x);
+    double det = left - right;
+    double bound = kOrientErrorBound * (std::fabs(left) + std::fabs(right));
+    if (det > bound) {
+        return 1;
+    }
+    if (-det > bound) {
+        return -1;
+    }
+
+    // Exact: the determinant expanded into six products of the inputs,
+    // each split into two doubles and summed without rounding
+    const double terms[6][3] = {
+        {a.x, b.y, 1.0}, {a.x, c.y, -1.0}, {c.x, b.y, -1.0},
+        {a.y, b.x, -1.0}, {a.y, c.x, 1.0}, {c.y, b.x, 1.0}
+    };
+    double expansion[12];
+    int length = 0;
+    for (const auto& term : terms) {
+        double product, error;
+        twoProduct(term[0], term[1], product, error);
+        length = growExpansion(expansion, length, term[2] * error);
+        length = growExpansion(expansion, length, term[2] * product);
+    }
+    double top = expansion[length - 1];
+    return top > 0.0 ? 1 : (top < 0.0 ? -1 : 0);
+}
+
+// Boolean engine
+namespace {
+
+// Vertices live on a 2^-20 grid, fine enough for any design coordinate
+const double kSnapScale = 1048576.0;
+const size_t kMaxPasses = 4;
+
+double snap(double value) {
+    return std::round(value * kSnapScale) / kSnapScale;
+}
+
+bool samePoint(const Point& a, const Point& b) {
+    return a.x == b.x && a.y == b.y;
+}
+
+bool lessPoint(const Point& a, const Point& b) {
+    return a.x < b.x || (a.x == b.x && a.y < b.y);
+}
+
+struct Segment {
+    Point a, b;
+    uint8_t operand;
+};
+
+struct Split {
+    uint32_t segment;
+    Point point;
+};
+
+void addSegments(const std::vector<VectorPath>& paths, uint8_t operand, std::vector<Segment>& out) {
+    for (const auto& path : paths) {
+        size_t count = path.points.size();
+        if (count < 3) {
+            continue;   // No area
+        }
+        for (size_t k = 0; k < count; k++) {
+            const Point& from = path.points[k];
+            const Point& to = path.points[(k + 1) % count];
+            Point a(snap(from.x), snap(from.y)), b(snap(to.x), snap(to.y));
+            if (!samePoint(a, b)) {
+                out.push_back(Segment{a, b, operand});
+            }
+        }
+    }
+}
+
+// p lies on the segment's line; is it strictly between the endpoints?
+bool insideCollinear(const Segment& s, const Point& p) {
+    if (samePoint(p, s.a) || samePoint(p, s.b)) {
+        return false;
+    }
+    return p.x >= std::min(s.a.x, s.b.x) && p.x <= std::max(s.a.x, s.b.x) &&
+           p.y >= std::min(s.a.y, s.b.y) && p.y <= std::max(s.a.y, s.b.y);
+}
+
+void addSplit(std::vector<Split>& splits, uint32_t index, const Segment& s, const Point& p) {
+    if (!samePoint(p, s.a) && !samePoint(p, s.b)) {
+        splits.push_back(Split{index, p});
+    }
+}
+
+// Where segments s and t meet, record split points on each
+void intersect(const std::vector<Segment>& segments, uint32_t i, uint32_t j,
+               std::vector<Split>& splits, size_t& crossings) {
+    const Segment& s = segments[i];
+    const Segment& t = segments[j];
+    int o1 = orient2d(s.a, s.b, t.a);
+    int o2 = orient2d(s.a, s.b, t.b);
+    if (o1 == o2 && o1 != 0) {
+        return;
+    }
+    int o3 = orient2d(t.a, t.b, s.a);
+    int o4 = orient2d(t.a, t.b, s.b);
+    if (o3 == o4 && o3 != 0) {
+        return;
+    }
+    if (o1 == 0 && o2 == 0) {
+        // Collinear: split each at the other's endpoints where they overlap
+        if (insideCollinear(s, t.a)) splits.push_back(Split{i, t.a});
+        if (insideCollinear(s, t.b)) splits.push_back(Split{i, t.b});
+        if (insideCollinear(t, s.a)) splits.push_back(Split{j, s.a});
+        if (insideCollinear(t, s.b)) splits.push_back(Split{j, s.b});
+        return;
+    }
+    if (o1 == 0 || o2 == 0 || o3 == 0 || o4 == 0) {
+        // An endpoint touches the other segment
+        if (o1 == 0) addSplit(splits, i, s, t.a);
+        if (o2 == 0) addSplit(splits, i, s, t.b);
+        if (o3 == 0) addSplit(splits, j, t, s.a);
+        if (o4 == 0) addSplit(splits, j, t, s.b);
+        return;
+    }
+    // Proper crossing
+    double dx = s.b.x - s.a.x, dy = s.b.y - s.a.y;
+    double ex = t.b.x - t.a.x, ey = t.b.y - t.a.y;
+    double along = ((t.a.x - s.a.x) * ey - (t.a.y - s.a.y) * ex) / (dx * ey - dy * ex);
+    Point p(snap(s.a.x + along * dx), snap(s.a.y + along * dy));
+    addSplit(splits, i, s, p);
+    addSplit(splits, j, t, p);
+    crossings++;
+}
+
+// One sweep over x; returns false if no segment needed splitting
+bool splitPass(std::vector<Segment>& segments, size_t& crossings) {
+    std::vector<uint32_t> order(segments.size());
+    for (uint32_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    auto minX = [&](uint32_t i) { return std::min(segments[i].a.x, segments[i].b.x); };
+    auto maxX = [&](uint32_t i) { return std::max(segments[i].a.x, segments[i].b.x); };
+    std::sort(order.begin(), order.end(), [&](uint32_t l, uint32_t r) { return minX(l) < minX(r); });
+
+    std::vector<Split> splits;
+    std::vector<uint32_t> active;
+    for (uint32_t i : order) {
+        double left = minX(i);
+        double low = std::min(segments[i].a.y, segments[i].b.y);
+        double high = std::max(segments[i].a.y, segments[i].b.y);
+        for (size_t k = 0; k < active.size();) {
+            uint32_t j = active[k];
+            if (maxX(j) < left) {
+                active[k] = active.back();
+                active.pop_back();
+                continue;
+            }
+            if (std::max(segments[j].a.y, segments[j].b.y) >= low &&
+                std::min(segments[j].a.y, segments[j].b.y) <= high) {
+                intersect(segments, i, j, splits, crossings);
+            }
+            k++;
+        }
+        active.push_back(i);
+    }
+    if (splits.empty()) {
+        return false;
+    }
+
+    // Cut each segment at its split points, in order along it
+    std::sort(splits.begin(), splits.end(), [&](const Split& l, const Split& r) {
+        if (l.segment != r.segment) {
+            return l.segment < r.segment;
+        }
+        const Segment& s = segments[l.segment];
+        double dx = s.b.x - s.a.x, dy = s.b.y - s.a.y;
+        return (l.point.x - s.a.x) * dx + (l.point.y - s.a.y) * dy <
+               (r.point.x - s.a.x) * dx + (r.point.y - s.a.y) * dy;
+    });
+    std::vector<Segment> result;
+    result.reserve(segments.size() + splits.size());
+    size_t next = 0;
+    for (uint32_t i = 0; i < segments.size(); i++) {
+        const Segment& s = segments[i];
+        Point from = s.a;
+        for (; next < splits.size() && splits[next].segment == i; next++) {
+            const Point& p = splits[next].point;
+            if (!samePoint(p, from)) {
+                result.push_back(Segment{from, p, s.operand});
+                from = p;
+            }
+        }
+        if (!samePoint(from, s.b)) {
+            result.push_back(Segment{from, s.b, s.operand});
+        }
+    }
+    segments.swap(result);
+    return true;
+}
+
+// A unique segment with a < b (by x, then y) and the summed windings
+struct Edge {
+    Point a, b;
+    int winding[2];         // Per operand: +1 for each input edge running a->b
+    int below[2];           // Windings below (left of, if vertical)
+    bool vertical() const { return a.x == b.x; }
+};
+
+std::vector<Edge> mergeSegments(const std::vector<Segment>& segments) {
+    std::vector<Edge> edges;
+    edges.reserve(segments.size());
+    for (const auto& s : segments) {
+        bool forward = lessPoint(s.a, s.b);
+        Edge edge{forward ? s.a : s.b, forward ? s.b : s.a, {0, 0}, {0, 0}};
+        edge.winding[s.operand] = forward ? 1 : -1;
+        edges.push_back(edge);
+    }
+    auto less = [](const Edge& l, const Edge& r) {
+        if (!samePoint(l.a, r.a)) {
+            return lessPoint(l.a, r.a);
+        }
+        return lessPoint(l.b, r.b);
+    };
+    std::sort(edges.begin(), edges.end(), less);
+    size_t out = 0;
+    for (size_t i = 0; i < edges.size(); i++) {
+        if (out > 0 && samePoint(edges[out - 1].a, edges[i].a) && samePoint(edges[out - 1].b, edges[i].b)) {
+            edges[out - 1].winding[0] += edges[i].winding[0];
+            edges[out - 1].winding[1] += edges[i].winding[1];
+        } else {
+            edges[out++] = edges[i];
+        }
+    }
+    edges.resize(out);
+    // Edges whose contributions cancel out are not boundaries of anything
+    edges.erase(std::remove_if(edges.begin(), edges.end(), [](const Edge& e) {
+        return e.winding[0] == 0 && e.winding[1] == 0;
+    }), edges.end());
+    return edges;
+}
+
+// Winding numbers below every non-vertical edge and left of every vertical
+// one, from a sweep along x with the crossing edges ordered bottom to top
+void annotate(std::vector<Edge>& edges) {
+    std::vector<uint32_t> starts, ends, verticals;
+    for (uint32_t i = 0; i < edges.size(); i++) {
+        if (edges[i].vertical()) {
+            verticals.push_back(i);
+        } else {
+            starts.push_back(i);
+            ends.push_back(i);
+        }
+    }
+    // Edges starting at the same x go in bottom to top
+    std::sort(starts.begin(), starts.end(), [&](uint32_t l, uint32_t r) {
+        const Edge& s = edges[l];
+        const Edge& t = edges[r];
+        if (s.a.x != t.a.x) {
+            return s.a.x < t.a.x;
+        }
+        if (s.a.y != t.a.y) {
+            return s.a.y < t.a.y;
+        }
+        return orient2d(s.a, s.b, t.b) > 0;
+    });
+    std::sort(ends.begin(), ends.end(), [&](uint32_t l, uint32_t r) { return edges[l].b.x < edges[r].b.x; });
+    std::sort(verticals.begin(), verticals.end(), [&](uint32_t l, uint32_t r) { return edges[l].a.x < edges[r].a.x; });
+
+    auto above = [&](uint32_t i, int operand) {
+        return edges[i].below[operand] + edges[i].winding[operand];
+    };
+    std::vector<uint32_t> status;
+    size_t nextStart = 0, nextEnd = 0, nextVertical = 0;
+    while (nextStart < starts.size() || nextVertical < verticals.size()) {
+        double x = HUGE_VAL;
+        if (nextStart < starts.size()) x = std::min(x, edges[starts[nextStart]].a.x);
+        if (nextEnd < ends.size()) x = std::min(x, edges[ends[nextEnd]].b.x);
+        if (nextVertical < verticals.size()) x = std::min(x, edges[verticals[nextVertical]].a.x);
+
+        // Vertical edges see the edges crossing just left of x
+        for (; nextVertical < verticals.size() && edges[verticals[nextVertical]].a.x == x; nextVertical++) {
+            Edge& edge = edges[verticals[nextVertical]];
+            Point middle(x, edge.a.y + (edge.b.y - edge.a.y) / 2.0);
+            auto under = std::partition_point(status.begin(), status.end(), [&](uint32_t t) {
+                return orient2d(edges[t].a, edges[t].b, middle) > 0;
+            });
+            for (int operand = 0; operand < 2; operand++) {
+                edge.below[operand] = under == status.begin() ? 0 : above(*(under - 1), operand);
+            }
+        }
+        for (; nextEnd < ends.size() && edges[ends[nextEnd]].b.x == x; nextEnd++) {
+            status.erase(std::find(status.begin(), status.end(), ends[nextEnd]));
+        }
+        for (; nextStart < starts.size() && edges[starts[nextStart]].a.x == x; nextStart++) {
+            uint32_t i = starts[nextStart];
+            Edge& edge = edges[i];
+            auto position = std::partition_point(status.begin(), status.end(), [&](uint32_t t) {
+                int side = orient2d(edges[t].a, edges[t].b, edge.a);
+                if (side == 0) {
+                    side = orient2d(edges[t].a, edges[t].b, edge.b);   // Shared start
+                }
+                return side > 0;
+            });
+            for (int operand = 0; operand < 2; operand++) {
+                edge.below[operand] = position == status.begin() ? 0 : above(*(position - 1), operand);
+            }
+            status.insert(position, i);
+        }
+    }
+}
+
+bool filled(int winding, bool evenOdd) {
+    return evenOdd ? (winding & 1) != 0 : winding != 0;
+}
+
+bool combine(BooleanOp op, bool a, bool b) {
+    switch (op) {
+        case BooleanOp::Union: return a || b;
+        case BooleanOp::Subtract: return a && !b;
+        case BooleanOp::Intersect: return a && b;
+        case BooleanOp::Exclude: return a != b;
+    }
+    return false;
+}
+
+// Chain directed result edges into closed outlines
+std::vector<VectorPath> chain(std::vector<std::pair<Point, Point>>& edges) {
+    std::sort(edges.begin(), edges.end(), [](const std::pair<Point, Point>& l, const std::pair<Point, Point>& r) {
+        return lessPoint(l.first, r.first);
+    });
+    std::vector<bool> used(edges.size(), false);
+    std::vector<VectorPath> paths;
+    for (size_t start = 0; start < edges.size(); start++) {
+        if (used[start]) {
+            continue;
+        }
+        VectorPath path;
+        size_t current = start;
+        while (true) {
+            used[current] = true;
+            const Point& from = edges[current].first;
+            // Drop vertices that only split a straight run
+            size_t n = path.points.size();
+            if (n >= 2 && orient2d(path.points[n - 2], path.points[n - 1], from) == 0) {
+                path.points.back() = from;
+            } else {
+                path.addPoint(from);
+            }
+            const Point& to = edges[current].second;
+            if (samePoint(to, edges[start].first)) {
+                break;
+            }
+            auto range = std::equal_range(edges.begin(), edges.end(), std::make_pair(to, to),
+                                          [](const std::pair<Point, Point>& l, const std::pair<Point, Point>& r) {
+                                              return lessPoint(l.first, r.first);
+                                          });
+            size_t next = edges.size();
+            for (auto it = range.first; it != range.second; ++it) {
+                size_t k = static_cast<size_t>(it - edges.begin());
+                if (!used[k]) {
+                    next = k;
+                    break;
+                }
+            }
+            if (next == edges.size()) {
+                break;      // Unreachable for a consistent arrangement
+            }
+            current = next;
+        }
+        size_t n = path.points.size();
+        if (n >= 3 && orient2d(path.points[n - 2], path.points[n - 1], path.points[0]) == 0) {
+            path.points.pop_back();
+        }
+        if (path.points.size() >= 3) {
+            path.close();
+            paths.push_back(std::move(path));
+        }
+    }
+    return paths;
+}
+
+} // namespace
+
+BooleanResult computeBoolean(const std::vector<VectorPath>& a, const std::vector<VectorPath>& b,
+                             BooleanOp op, bool evenOddA, bool evenOddB) {
+    BooleanResult result;
+    std::vector<Segment> segments;
+    addSegments(a, 0, segments);
+    addSegments(b, 1, segments);
+    result.inputSegments = segments.size();
+
+    bool split = true;
+    while (split && result.passes < kMaxPasses) {
+        result.passes++;
+        split = splitPass(segments, result.intersections);
+    }
+    if (split) {
+        // Crossings may remain: classifying them would give a wrong outline
+        result.resolved = false;
+        result.splitSegments = segments.size();
+        return result;
+    }
+
+    std::vector<Edge> edges = mergeSegments(segments);
+    result.splitSegments = edges.size();
+    annotate(edges);
+
+    std::vector<std::pair<Point, Point>> boundary;
+    for (const auto& edge : edges) {
+        // Crossing an edge upwards adds its winding; crossing an upward
+        // (vertical) edge to the right subtracts it
+        int sign = edge.vertical() ? -1 : 1;
+        bool before = combine(op, filled(edge.below[0], evenOddA), filled(edge.below[1], evenOddB));
+        bool after = combine(op, filled(edge.below[0] + sign * edge.winding[0], evenOddA),
+                             filled(edge.below[1] + sign * edge.winding[1], evenOddB));
+        if (before == after) {
+            continue;
+        }
+        // Inside on the left: above a left-to-right edge, left of an upward one
+        bool forward = edge.vertical() ? before : after;
+        boundary.emplace_back(forward ? edge.a : edge.b, forward ? edge.b : edge.a);
+    }
+    result.paths = chain(boundary);
+    return result;
+}
+
+// BooleanEngine implementation
+const double BooleanEngine::kDefaultTolerance = 0.1;
+const size_t BooleanEngine::kMaxCacheEntries = 256;
+
+BooleanEngine::BooleanEngine(CRDTDocument& document)
+    : document(document), tolerance(kDefaultTolerance), hits(0), misses(0) {
+    listenerHandle = document.addOperationListener([this](const CRDTOperation& op, bool) {
+        if (op.type == CRDTOperationType::SetProperty || op.type == CRDTOperationType::DeleteNode ||
+            op.type == CRDTOperationType::RestoreNode) {
+            auto it = operands.find(op.nodeId.toString());
+            if (it != operands.end()) {
+                it->second.version++;
+            }
+        }
+    });
+}
+
+BooleanEngine::~BooleanEngine() {
+    document.removeOperationListener(listenerHandle);
+}
+
+void BooleanEngine::setTolerance(double value) {
+    if (value > 0.0 && value != tolerance) {
+        tolerance = value;
+        clear();
+    }
+}
+
+uint64_t BooleanEngine::versionOf(const std::string& id) const {
+    auto it = operands.find(id);
+    return it == operands.end() ? 0 : it->second.version;
+}
+
+bool BooleanEngine::outline(const CRDTId& id, std::vector<VectorPath>& paths, bool& evenOdd) const {
+    auto node = document.getNode(id);
+    if (!node || node->isDeleted()) {
+        return false;
+    }
+    evenOdd = node->getProperty("fill-rule") == "evenodd";
+    return flattenNodeOutline(*node, paths, tolerance);
+}
+
+std::shared_ptr<const BooleanResult> BooleanEngine::compute(BooleanOp op, const CRDTId& a, const CRDTId& b) {
+    std::string idA = a.toString(), idB = b.toString();
+    std::string key = std::to_string(static_cast<int>(op)) + "|" + idA + "|" + idB;
+    uint64_t versionA = versionOf(idA), versionB = versionOf(idB);
+    auto it = cache.find(key);
+    if (it != cache.end()) {
+        if (it->second->versionA == versionA && it->second->versionB == versionB) {
+            hits++;
+            entries.splice(entries.begin(), entries, it->second);
+            return it->second->result;
+        }
+        // An operand changed: this result can never be hit again
+        release(it->second);
+        cache.erase(it);
+    }
+    misses++;
+    std::vector<VectorPath> pathsA, pathsB;
+    bool evenOddA = false, evenOddB = false;
+    if (!outline(a, pathsA, evenOddA) || !outline(b, pathsB, evenOddB)) {
+        return nullptr;
+    }
+    auto result = std::make_shared<const BooleanResult>(computeBoolean(pathsA, pathsB, op, evenOddA, evenOddB));
+    // Operations on the operands are counted from here on
+    Operand& operandA = operands[idA];
+    Operand& operandB = operands[idB];
+    operandA.uses++;
+    operandB.uses++;
+    entries.push_front(CacheEntry{key, idA, idB, operandA.version, operandB.version, result});
+    cache[key] = entries.begin();
+    trimCache();
+    return result;
+}
+
+void BooleanEngine::trimCache() {
+    while (entries.size() > kMaxCacheEntries) {
+        auto last = std::prev(entries.end());
+        cache.erase(last->key);
+        release(last);
+    }
+}
+
+void BooleanEngine::release(std::list<CacheEntry>::iterator entry) {
+    // Stop counting operations on nodes no cached result depends on
+    for (const std::string* id : {&entry->a, &entry->b}) {
+        auto operand = operands.find(*id);
+        if (operand != operands.end() && --operand->second.uses == 0) {
+            operands.erase(operand);
+        }
+    }
+    entries.erase(entry);
+}
+
+CRDTId BooleanEngine::apply(BooleanOp op, const CRDTId& a, const CRDTId& b, const CRDTId& parent,
+                            bool removeOperands) {
+    auto result = compute(op, a, b);
+    if (!result || !result->resolved || result->paths.empty()) {
+        return CRDTId();
+    }
+    std::string d;
+    Bounds bounds;
+    for (const auto& path : result->paths) {
+        appendPathData(d, path, 4);
+        for (const auto& point : path.points) {
+            bounds.include(point.x, point.y);
+        }
+    }
+    auto format = [](double value) {
+        std::string out;
+        appendNumber(out, value, 4);
+        return out;
+    };
+
+    auto source = document.getNode(a);
+    document.beginBatch();
+    CRDTId id = document.createNode("shape");
+    document.setNodeProperty(id, "kind", "path");
+    document.setNodeProperty(id, "d", d);
+    document.setNodeProperty(id, "x", format(bounds.minX));
+    document.setNodeProperty(id, "y", format(bounds.minY));
+    document.setNodeProperty(id, "width", format(bounds.maxX - bounds.minX));
+    document.setNodeProperty(id, "height", format(bounds.maxY - bounds.minY));
+    for (const char* key : kSvgPresentationAttributes) {
+        // The result's own winding is what makes its holes
+        if (std::strcmp(key, "fill-rule") != 0 && source->hasProperty(key)) {
+            document.setNodeProperty(id, key, source->getProperty(key));
+        }
+    }
+    document.addChild(parent, id);
+    if (removeOperands) {
+        document.deleteNode(a);
+        document.deleteNode(b);
+    }
+    document.endBatch();
+    return id;
+}
+
+void BooleanEngine::clear() {
+    entries.clear();
+    cache.clear();
+    operands.clear();
+}
+
+} // namespace Lienzo
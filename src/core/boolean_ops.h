@@ -0,0 +1,120 @@
+#pragma once
+
+#include "../collaboration/crdt.h"
+#include "vector.h"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Lienzo {
+
+enum class BooleanOp : uint8_t {
+    Union,
+    Subtract,       // First operand minus the second
+    Intersect,
+    Exclude         // Either operand but not both
+};
+
+// Orientation of c relative to the directed line a->b: 1 if c is to the
+// left (counterclockwise), -1 if to the right, 0 if exactly collinear.
+// A floating-point filter decides almost every case; the rest are
+// evaluated exactly with expansion arithmetic, so the sign is never wrong.
+int orient2d(const Point& a, const Point& b, const Point& c);
+
+struct BooleanResult {
+    // Closed outlines; holes run opposite to their outer boundary, so the
+    // result is drawn with the nonzero fill rule
+    std::vector<VectorPath> paths;
+    size_t inputSegments = 0;
+    size_t splitSegments = 0;   // After splitting at intersections and merging overlaps
+    size_t intersections = 0;
+    size_t passes = 0;          // Intersection passes until no segment needed splitting
+    // False if segments still needed splitting after the last allowed pass;
+    // the arrangement is then unreliable and paths is left empty
+    bool resolved = true;
+};
+
+// Boolean combination of two filled outlines (subpaths implicitly closed)
+//
+// 1. Vertices are snapped to a fine grid and every segment is split where
+//    it meets another. A sweep along x finds the candidate pairs; exact
+//    orientation tests classify them, and the pass repeats until nothing
+//    needs splitting (snapped crossings can create new contacts). If that
+//    takes more than a few passes the result is marked unresolved.
+// 2. Identical segments are merged, summing their winding contributions.
+// 3. A second sweep keeps the segments ordered bottom to top and gives each
+//    one the winding numbers of both operands below and above it, from its
+//    neighbour underneath. A segment is part of the result if the operation
+//    is true on exactly one side.
+// 4. Result segments, oriented with the inside on their left, are chained
+//    into closed outlines.
+BooleanResult computeBoolean(const std::vector<VectorPath>& a, const std::vector<VectorPath>& b,
+                             BooleanOp op, bool evenOddA = false, bool evenOddB = false);
+
+// Boolean operations on document shapes
+// Operands are rectangles, ellipses or paths in the same coordinate space
+// (see flattenNodeOutline). Results are cached per operation and operand
+// pair until an operation touches either operand; past kMaxCacheEntries
+// the least recently used one is dropped.
+class BooleanEngine {
+public:
+    static const double kDefaultTolerance;
+    static const size_t kMaxCacheEntries;
+
+    explicit BooleanEngine(CRDTDocument& document);
+    ~BooleanEngine();
+    BooleanEngine(const BooleanEngine&) = delete;
+    BooleanEngine& operator=(const BooleanEngine&) = delete;
+
+    // Curve flattening tolerance, in document units
+    void setTolerance(double value);
+
+    // Combined outline, or nullptr if an operand has no geometry
+    std::shared_ptr<const BooleanResult> compute(BooleanOp op, const CRDTId& a, const CRDTId& b);
+
+    // Write the combination as a new path shape under parent, taking the
+    // first operand's paint, in one batch together with the removal of the
+    // operands if requested. Returns an empty ID if the result is empty or
+    // unresolved.
+    CRDTId apply(BooleanOp op, const CRDTId& a, const CRDTId& b, const CRDTId& parent,
+                 bool removeOperands = false);
+
+    void clear();
+
+    // Statistics
+    size_t getHits() const { return hits; }
+    size_t getMisses() const { return misses; }
+
+private:
+    struct CacheEntry {
+        std::string key;
+        std::string a;              // Operand IDs
+        std::string b;
+        uint64_t versionA;
+        uint64_t versionB;
+        std::shared_ptr<const BooleanResult> result;
+    };
+    struct Operand {
+        uint64_t version = 0;       // Operations seen since it was first cached
+        size_t uses = 0;            // Cached results it is an operand of
+    };
+
+    CRDTDocument& document;
+    size_t listenerHandle;
+    double tolerance;
+    std::unordered_map<std::string, Operand> operands;  // Only operands of cached results
+    std::list<CacheEntry> entries;                      // Most recently used first
+    std::unordered_map<std::string, std::list<CacheEntry>::iterator> cache;
+    size_t hits;
+    size_t misses;
+
+    uint64_t versionOf(const std::string& id) const;
+    bool outline(const CRDTId& id, std::vector<VectorPath>& paths, bool& evenOdd) const;
+    void trimCache();
+    void release(std::list<CacheEntry>::iterator entry);
+};
+
+} // namespace Lienzo
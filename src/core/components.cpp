@@ -0,0 +1,92 @@
+#include "components.h"
+#include "numbers.h"
+
+namespace Lienzo {
+
+static const char kOverridePrefix[] = "override/";
+
+// Short numbers keep instances small (to_string would pad to 6 decimals)
+static std::string formatted(double value) {
+    std::string text;
+    appendNumber(text, value);
+    return text;
+}
+
+CRDTId createComponent(CRDTDocument& doc, const CRDTId& parentId,
+                       double x, double y, double width, double height) {
+    doc.beginBatch();
+    CRDTId id = doc.createNode("component");
+    doc.setNodeProperty(id, "x", formatted(x));
+    doc.setNodeProperty(id, "y", formatted(y));
+    doc.setNodeProperty(id, "width", formatted(width));
+    doc.setNodeProperty(id, "height", formatted(height));
+    doc.addChild(parentId, id);
+    doc.endBatch();
+    return id;
+}
+
+CRDTId createInstance(CRDTDocument& doc, const CRDTId& componentId, const CRDTId& parentId,
+                      double x, double y, double scale) {
+    doc.beginBatch();
+    CRDTId id = doc.createNode("instance");
+    doc.setNodeProperty(id, "component", componentId.toString());
+    doc.setNodeProperty(id, "x", formatted(x));
+    doc.setNodeProperty(id, "y", formatted(y));
+    if (scale != 1.0) {
+        doc.setNodeProperty(id, "scale", formatted(scale));
+    }
+    doc.addChild(parentId, id);
+    doc.endBatch();
+    return id;
+}
+
+void setInstanceOverride(CRDTDocument& doc, const CRDTId& instanceId, const CRDTId& nodeId,
+                         const std::string& key, const std::string& value) {
+    doc.setNodeProperty(instanceId, instanceOverrideKey(nodeId, key), value);
+}
+
+std::string instanceOverrideKey(const CRDTId& nodeId, const std::string& key) {
+    return kOverridePrefix + nodeId.toString() + "/" + key;
+}
+
+bool parseInstanceOverrideKey(const std::string& key, CRDTId& nodeId, std::string& property) {
+    size_t prefix = sizeof(kOverridePrefix) - 1;
+    if (key.compare(0, prefix, kOverridePrefix) != 0) {
+        return false;
+    }
+    // Site IDs never contain '/', property keys might
+    size_t slash = key.find('/', prefix);
+    if (slash == std::string::npos) {
+        return false;
+    }
+    nodeId = CRDTId::fromString(std::string_view(key).substr(prefix, slash - prefix));
+    property = key.substr(slash + 1);
+    return !nodeId.siteId.empty() && !property.empty();
+}
+
+CRDTId instanceComponent(const CRDTNode& node) {
+    if (node.getType() != "instance") {
+        return CRDTId();
+    }
+    return CRDTId::fromString(node.getProperty("component"));
+}
+
+bool instanceOverrides(const CRDTNode& instance, const CRDTId& nodeId) {
+    std::string prefix = kOverridePrefix + nodeId.toString() + "/";
+    for (const auto& property : instance.getProperties()) {
+        if (!property.second.value.empty() && property.first.compare(0, prefix.size(), prefix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string resolveInstanceProperty(const CRDTNode& instance, const CRDTNode& node, const std::string& key) {
+    auto it = instance.getProperties().find(instanceOverrideKey(node.getId(), key));
+    if (it != instance.getProperties().end() && !it->second.value.empty()) {
+        return it->second.value;
+    }
+    return node.getProperty(key);
+}
+
+} // namespace Lienzo
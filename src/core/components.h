@@ -0,0 +1,45 @@
+#pragma once
+
+#include "../collaboration/crdt.h"
+#include <string>
+
+namespace Lienzo {
+
+// Reusable components (masters and instances)
+//
+// A component is an ordinary subtree rooted at a "component" node, placed
+// in the document like a frame (its content is in its coordinates), so its
+// geometry is stored once. An "instance" node refers to it by ID and holds
+// only a placement (x, y, scale) and sparse overrides: a property of one
+// node of the component replaced for this instance only, stored on the
+// instance as "override/<node id>/<key>". An instance without overrides is
+// one node with four properties, however large the component is.
+//
+// Instances are leaves in the document tree; consumers resolve them
+// through the component (see HitTester), sharing whatever they derive from
+// its geometry between all instances.
+
+// An empty component under parentId; add content to it with addChild
+CRDTId createComponent(CRDTDocument& doc, const CRDTId& parentId,
+                       double x, double y, double width, double height);
+// An instance of componentId under parentId at (x, y), scaled uniformly
+CRDTId createInstance(CRDTDocument& doc, const CRDTId& componentId, const CRDTId& parentId,
+                      double x, double y, double scale = 1.0);
+
+// Replace property key of the component's node nodeId for this instance
+// only; an empty value removes the override
+void setInstanceOverride(CRDTDocument& doc, const CRDTId& instanceId, const CRDTId& nodeId,
+                         const std::string& key, const std::string& value);
+
+// Property key an override is stored under, and back
+std::string instanceOverrideKey(const CRDTId& nodeId, const std::string& key);
+bool parseInstanceOverrideKey(const std::string& key, CRDTId& nodeId, std::string& property);
+
+// The component an instance refers to; empty for other nodes
+CRDTId instanceComponent(const CRDTNode& node);
+// Whether the instance overrides anything on nodeId
+bool instanceOverrides(const CRDTNode& instance, const CRDTId& nodeId);
+// Value of key on a component node as the instance shows it
+std::string resolveInstanceProperty(const CRDTNode& instance, const CRDTNode& node, const std::string& key);
+
+} // namespace Lienzo
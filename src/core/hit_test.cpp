@@ -0,0 +1,639 @@
+#include "hit_test.h"
+#include "components.h"
+#include "numbers.h"
+#include "svg_parser.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Lienzo {
+
+void Bounds::include(double x, double y) {
+    if (isEmpty()) {
+        minX = maxX = x;
+        minY = maxY = y;
+        return;
+    }
+    minX = std::min(minX, x);
+    maxX = std::max(maxX, x);
+    minY = std::min(minY, y);
+    maxY = std::max(maxY, y);
+}
+
+void Bounds::inflate(double amount) {
+    minX -= amount;
+    minY -= amount;
+    maxX += amount;
+    maxY += amount;
+}
+
+// PathGeometry implementation
+static const size_t kMaxBands = 1024;
+
+PathGeometry::PathGeometry(const std::vector<VectorPath>& paths) {
+    for (const auto& path : paths) {
+        const auto& points = path.points;
+        if (points.empty()) {
+            continue;
+        }
+        for (const auto& point : points) {
+            bounds.include(point.x, point.y);
+        }
+        for (size_t k = 1; k < points.size(); k++) {
+            addEdge(points[k - 1], points[k], true);
+        }
+        if (points.size() > 2) {
+            addEdge(points.back(), points.front(), path.closed);
+        }
+    }
+    buildBands();
+}
+
+void PathGeometry::addEdge(const Point& a, const Point& b, bool stroke) {
+    if (a.x == b.x && a.y == b.y) {
+        return;
+    }
+    edges.push_back(Edge{a.x, a.y, b.x, b.y});
+    stroked.push_back(stroke ? 1 : 0);
+}
+
+size_t PathGeometry::bandOf(double y) const {
+    double band = std::floor((y - bounds.minY) / bandHeight);
+    if (!(band > 0.0)) {
+        return 0;
+    }
+    size_t last = bandStarts.size() - 2;
+    return band >= static_cast<double>(last) ? last : static_cast<size_t>(band);
+}
+
+void PathGeometry::buildBands() {
+    // About two edges per band keeps each query to a handful of edges
+    size_t count = std::max<size_t>(1, std::min(kMaxBands, edges.size() / 2));
+    double height = bounds.maxY - bounds.minY;
+    if (!(height > 0.0)) {
+        count = 1;
+        height = 1.0;
+    }
+    bandHeight = height / static_cast<double>(count);
+    bandStarts.assign(count + 1, 0);
+
+    // Counting sort of edges into every band their y range touches
+    for (const auto& edge : edges) {
+        size_t first = bandOf(std::min(edge.y0, edge.y1));
+        size_t last = bandOf(std::max(edge.y0, edge.y1));
+        for (size_t b = first; b <= last; b++) {
+            bandStarts[b + 1]++;
+        }
+    }
+    for (size_t b = 0; b < count; b++) {
+        bandStarts[b + 1] += bandStarts[b];
+    }
+    bandEdges.resize(bandStarts[count]);
+    std::vector<uint32_t> fill(bandStarts.begin(), bandStarts.end() - 1);
+    for (size_t e = 0; e < edges.size(); e++) {
+        size_t first = bandOf(std::min(edges[e].y0, edges[e].y1));
+        size_t last = bandOf(std::max(edges[e].y0, edges[e].y1));
+        for (size_t b = first; b <= last; b++) {
+            bandEdges[fill[b]++] = static_cast<uint32_t>(e);
+        }
+    }
+}
+
+bool PathGeometry::fillContains(double x, double y, bool evenOdd) const {
+    if (edges.empty() || !bounds.contains(x, y)) {
+        return false;
+    }
+    // Winding number of a ray towards +x; edges are half-open in y so a
+    // vertex on the scanline is counted once
+    size_t band = bandOf(y);
+    int winding = 0;
+    for (uint32_t k = bandStarts[band]; k < bandStarts[band + 1]; k++) {
+        const Edge& edge = edges[bandEdges[k]];
+        if ((edge.y0 <= y) == (edge.y1 <= y)) {
+            continue;
+        }
+        double crossing = edge.x0 + (y - edge.y0) * (edge.x1 - edge.x0) / (edge.y1 - edge.y0);
+        if (crossing > x) {
+            winding += edge.y1 > edge.y0 ? 1 : -1;
+        }
+    }
+    return evenOdd ? (winding & 1) != 0 : winding != 0;
+}
+
+bool PathGeometry::strokeContains(double x, double y, double distance) const {
+    if (edges.empty() || distance <= 0.0) {
+        return false;
+    }
+    if (x < bounds.minX - distance || x > bounds.maxX + distance ||
+        y < bounds.minY - distance || y > bounds.maxY + distance) {
+        return false;
+    }
+    double limit = distance * distance;
+    size_t first = bandOf(y - distance);
+    size_t last = bandOf(y + distance);
+    for (uint32_t k = bandStarts[first]; k < bandStarts[last + 1]; k++) {
+        uint32_t e = bandEdges[k];
+        if (!stroked[e]) {
+            continue;
+        }
+        const Edge& edge = edges[e];
+        if (x < std::min(edge.x0, edge.x1) - distance || x > std::max(edge.x0, edge.x1) + distance) {
+            continue;
+        }
+        double dx = edge.x1 - edge.x0, dy = edge.y1 - edge.y0;
+        double t = ((x - edge.x0) * dx + (y - edge.y0) * dy) / (dx * dx + dy * dy);
+        t = std::max(0.0, std::min(1.0, t));
+        double px = edge.x0 + t * dx - x, py = edge.y0 + t * dy - y;
+        if (px * px + py * py <= limit) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t PathGeometry::getMemoryUsage() const {
+    return sizeof(PathGeometry) + edges.capacity() * sizeof(Edge) + stroked.capacity() +
+           (bandStarts.capacity() + bandEdges.capacity()) * sizeof(uint32_t);
+}
+
+// GeometryCache implementation
+GeometryCache::GeometryCache(double flatness)
+    : flatness(flatness), purgeAt(1024), builds(0) {
+}
+
+std::shared_ptr<const PathGeometry> GeometryCache::get(const std::string& outline) {
+    auto& slot = entries[outline];
+    if (auto geometry = slot.lock()) {
+        return geometry;
+    }
+    std::vector<VectorPath> paths;
+    flattenPath(outline, paths, flatness);
+    auto geometry = std::make_shared<const PathGeometry>(paths);
+    slot = geometry;
+    builds++;
+    // Drop outlines nobody uses any more once the table has doubled
+    if (entries.size() >= purgeAt) {
+        for (auto it = entries.begin(); it != entries.end();) {
+            it = it->second.expired() ? entries.erase(it) : std::next(it);
+        }
+        purgeAt = std::max<size_t>(1024, entries.size() * 2);
+    }
+    return geometry;
+}
+
+size_t GeometryCache::size() const {
+    size_t live = 0;
+    for (const auto& entry : entries) {
+        live += entry.second.expired() ? 0 : 1;
+    }
+    return live;
+}
+
+size_t GeometryCache::getMemoryUsage() const {
+    size_t bytes = 0;
+    for (const auto& entry : entries) {
+        if (auto geometry = entry.second.lock()) {
+            bytes += entry.first.capacity() + geometry->getMemoryUsage();
+        }
+    }
+    return bytes;
+}
+
+// HitTester implementation
+const double HitTester::kDefaultFlatness = 0.25;
+
+static double number(const CRDTNode& node, const char* key, double fallback = 0.0) {
+    if (!node.hasProperty(key)) {
+        return fallback;
+    }
+    std::string value = node.getProperty(key);
+    const char* p = value.data();
+    double result = fallback;
+    parseNumber(p, p + value.size(), result);
+    return result;
+}
+
+// Outline of a shape node as path data in its local coordinates
+static std::string outlineOf(const CRDTNode& node, const Bounds& bounds) {
+    if (node.getType() == "shape" && node.getProperty("kind") != "ellipse") {
+        return node.getProperty("d");
+    }
+    double width = bounds.maxX - bounds.minX, height = bounds.maxY - bounds.minY;
+    double rx, ry;
+    if (node.getType() == "rectangle") {
+        rx = std::min(number(node, "rx", number(node, "ry")), width / 2.0);
+        ry = std::min(number(node, "ry", number(node, "rx")), height / 2.0);
+    } else {
+        rx = width / 2.0;
+        ry = height / 2.0;
+    }
+    std::string d;
+    auto command = [&](char letter, double x, double y) {
+        d += letter;
+        appendNumber(d, x, 6);
+        d += ' ';
+        appendNumber(d, y, 6);
+    };
+    auto arcTo = [&](double x, double y) {
+        if (rx > 0.0 && ry > 0.0) {
+            d += 'A';
+            appendNumber(d, rx, 6);
+            d += ' ';
+            appendNumber(d, ry, 6);
+            d += " 0 0 1 ";
+            appendNumber(d, x, 6);
+            d += ' ';
+            appendNumber(d, y, 6);
+        } else {
+            command('L', x, y);
+        }
+    };
+    double left = bounds.minX, top = bounds.minY, right = bounds.maxX, bottom = bounds.maxY;
+    command('M', left + rx, top);
+    command('L', right - rx, top);
+    arcTo(right, top + ry);
+    command('L', right, bottom - ry);
+    arcTo(right - rx, bottom);
+    command('L', left + rx, bottom);
+    arcTo(left, bottom - ry);
+    command('L', left, top + ry);
+    arcTo(left + rx, top);
+    d += 'Z';
+    return d;
+}
+
+Bounds nodeBounds(const CRDTNode& node) {
+    Bounds bounds;
+    if (node.hasProperty("width") && node.hasProperty("height")) {
+        double x = number(node, "x"), y = number(node, "y");
+        bounds.include(x, y);
+        bounds.include(x + number(node, "width"), y + number(node, "height"));
+    } else if (node.hasProperty("d")) {
+        SvgBounds path;
+        if (computePathBounds(node.getProperty("d"), path)) {
+            bounds.include(path.minX, path.minY);
+            bounds.include(path.maxX, path.maxY);
+        }
+    }
+    return bounds;
+}
+
+bool flattenNodeOutline(const CRDTNode& node, std::vector<VectorPath>& out, double tolerance) {
+    std::string type = node.getType();
+    if (type != "rectangle" && type != "shape") {
+        return false;
+    }
+    Bounds bounds = nodeBounds(node);
+    if (bounds.isEmpty()) {
+        return false;
+    }
+    return flattenPath(outlineOf(node, bounds), out, tolerance);
+}
+
+HitTester::HitTester(DOMGraph& graph)
+    : graph(graph), flatness(kDefaultFlatness), geometries(kDefaultFlatness), generation(0),
+      structureVersion(0), contentVersion(0), fresh(false), candidatesTested(0) {
+}
+
+void HitTester::describe(const CRDTNode& node, Entry& entry) {
+    const std::string& type = node.getType();
+    entry.kind = Kind::None;
+    entry.frame = false;
+    entry.filled = true;
+    entry.evenOdd = false;
+    entry.strokeWidth = 0.0;
+    entry.bounds = Bounds();
+    entry.geometry.reset();
+    entry.component = nullptr;
+    entry.parts.reset();
+
+    if (type == "instance") {
+        describeInstance(node, entry);
+        return;
+    }
+    if (type == "frame" || type == "component" || type == "text") {
+        entry.frame = type != "text";
+        entry.kind = Kind::Box;
+    } else if (type == "rectangle") {
+        entry.kind = Kind::Outline;
+    } else if (type == "shape" && (node.getProperty("kind") == "ellipse" || node.hasProperty("d"))) {
+        entry.kind = Kind::Outline;
+    } else {
+        return;
+    }
+
+    entry.bounds = nodeBounds(node);
+    if (entry.bounds.isEmpty()) {
+        entry.kind = Kind::None;
+        return;
+    }
+    if (entry.kind == Kind::Outline) {
+        entry.filled = node.getProperty("fill") != "none";
+        entry.evenOdd = node.getProperty("fill-rule") == "evenodd";
+        std::string stroke = node.getProperty("stroke");
+        if (!stroke.empty() && stroke != "none") {
+            entry.strokeWidth = std::fabs(number(node, "stroke-width", 1.0));
+        }
+    }
+}
+
+void HitTester::describeInstance(const CRDTNode& node, Entry& entry) {
+    Component& component = componentFor(instanceComponent(node).toString());
+    entry.component = &component;
+    entry.componentStamp = component.stamp;
+    if (!component.parts) {
+        return;
+    }
+    entry.kind = Kind::Instance;
+    entry.origin = Point(number(node, "x"), number(node, "y"));
+    entry.scale = number(node, "scale", 1.0);
+    if (!(entry.scale > 0.0)) {
+        entry.scale = 1.0;
+    }
+
+    // Share the component's parts unless this instance overrides some
+    Bounds local = component.bounds;
+    entry.parts = component.parts;
+    for (const auto& part : *component.parts) {
+        if (!instanceOverrides(node, part.id)) {
+            continue;
+        }
+        auto own = std::make_shared<PartList>();
+        local = Bounds();
+        for (const auto& shared : *component.parts) {
+            Part copy = shared;
+            if (instanceOverrides(node, shared.id)) {
+                uint32_t source = graph.indexOf(shared.id);
+                if (source == DOMGraph::kNone || !makePart(*graph[source].node, &node, shared.offset, copy)) {
+                    continue;
+                }
+            }
+            Bounds bounds = copy.bounds;
+            bounds.inflate(copy.strokeWidth / 2.0);
+            local.include(bounds.minX, bounds.minY);
+            local.include(bounds.maxX, bounds.maxY);
+            own->push_back(std::move(copy));
+        }
+        entry.parts = std::move(own);
+        break;
+    }
+    if (!local.isEmpty()) {
+        entry.bounds.include(entry.origin.x + local.minX * entry.scale, entry.origin.y + local.minY * entry.scale);
+        entry.bounds.include(entry.origin.x + local.maxX * entry.scale, entry.origin.y + local.maxY * entry.scale);
+    }
+}
+
+HitTester::Component& HitTester::componentFor(const std::string& key) {
+    auto inserted = components.try_emplace(key);
+    Component& component = inserted.first->second;
+    if (inserted.second) {
+        component.id = CRDTId::fromString(key);
+    }
+    updateComponent(component);
+    return component;
+}
+
+void HitTester::updateComponent(Component& component) {
+    if (component.checked == generation) {
+        return;
+    }
+    component.checked = generation;
+    uint32_t index = graph.indexOf(component.id);
+    if (index == DOMGraph::kNone || graph[index].node->getType() != "component") {
+        component.parts.reset();
+        component.stamp = 0;
+        return;
+    }
+
+    // Only rebuild the parts when something in the component changed
+    uint32_t end = index + graph[index].subtreeSize;
+    uint64_t stamp = 0xcbf29ce484222325ULL;
+    for (uint32_t i = index + 1; i < end; i++) {
+        stamp = (stamp ^ graph[i].handle) * 0x100000001b3ULL;
+        stamp = (stamp ^ graph.getVersion(i)) * 0x100000001b3ULL;
+    }
+    if (component.parts && component.stamp == stamp) {
+        return;
+    }
+    component.stamp = stamp;
+    auto parts = std::make_shared<PartList>();
+    component.bounds = Bounds();
+    // Content is in the component's coordinates; nested frames offset theirs
+    std::vector<Point> offsets(end - index);
+    for (uint32_t i = index + 1; i < end; i++) {
+        uint32_t parent = graph[i].parent;
+        Point offset = offsets[parent - index];
+        const std::string& type = graph[parent].node->getType();
+        if (parent != index && (type == "frame" || type == "component")) {
+            Bounds frame = nodeBounds(*graph[parent].node);
+            offset.x += frame.minX;
+            offset.y += frame.minY;
+        }
+        offsets[i - index] = offset;
+        Part part;
+        // Instances inside components are not expanded
+        if (graph[i].node->getType() == "instance" || !makePart(*graph[i].node, nullptr, offset, part)) {
+            continue;
+        }
+        Bounds bounds = part.bounds;
+        bounds.inflate(part.strokeWidth / 2.0);
+        component.bounds.include(bounds.minX, bounds.minY);
+        component.bounds.include(bounds.maxX, bounds.maxY);
+        parts->push_back(std::move(part));
+    }
+    component.parts = std::move(parts);
+}
+
+bool HitTester::makePart(const CRDTNode& source, const CRDTNode* instance, const Point& offset, Part& part) {
+    const CRDTNode* node = &source;
+    std::unique_ptr<CRDTNode> overridden;
+    if (instance) {
+        // The node as this instance shows it
+        overridden = std::make_unique<CRDTNode>(source);
+        CRDTId stamp("override", std::numeric_limits<uint64_t>::max());
+        CRDTId target;
+        std::string key;
+        for (const auto& property : instance->getProperties()) {
+            if (!property.second.value.empty() && parseInstanceOverrideKey(property.first, target, key) &&
+                target == source.getId()) {
+                overridden->setProperty(key, property.second.value, stamp);
+            }
+        }
+        node = overridden.get();
+    }
+    Entry entry;
+    describe(*node, entry);
+    if (entry.kind != Kind::Box && entry.kind != Kind::Outline) {
+        return false;
+    }
+    part.id = source.getId();
+    part.offset = offset;
+    part.bounds = entry.bounds;
+    part.bounds.minX += offset.x;
+    part.bounds.maxX += offset.x;
+    part.bounds.minY += offset.y;
+    part.bounds.maxY += offset.y;
+    part.filled = entry.filled;
+    part.evenOdd = entry.evenOdd;
+    part.strokeWidth = entry.strokeWidth;
+    part.geometry = entry.kind == Kind::Outline ? geometries.get(outlineOf(*node, entry.bounds)) : nullptr;
+    return true;
+}
+
+HitTester::Entry& HitTester::entryFor(uint32_t index) {
+    uint32_t handle = graph[index].handle;
+    if (handle >= entries.size()) {
+        entries.resize(handle + 1);
+    }
+    Entry& entry = entries[handle];
+    uint64_t version = graph.getVersion(index);
+    // Instances also follow their component
+    if (!entry.valid || entry.version != version ||
+        (entry.component && (updateComponent(*entry.component), entry.component->stamp != entry.componentStamp))) {
+        describe(*graph[index].node, entry);
+        entry.version = version;
+        entry.valid = true;
+    }
+    return entry;
+}
+
+void HitTester::refresh() {
+    if (fresh && structureVersion == graph.getStructureVersion() &&
+        contentVersion == graph.getContentVersion()) {
+        return;
+    }
+    generation++;   // Components are checked again once per refresh
+    size_t count = graph.size();
+    worldBounds.resize(count);
+    offsets.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        const Entry& entry = entryFor(i);
+        uint32_t parent = graph[i].parent;
+        Point offset;
+        if (parent != DOMGraph::kNone) {
+            offset = offsets[parent];
+            const Entry& parentEntry = entries[graph[parent].handle];
+            // Frames are the coordinate space of their contents
+            if (parentEntry.frame) {
+                offset.x += parentEntry.bounds.minX;
+                offset.y += parentEntry.bounds.minY;
+            }
+        }
+        offsets[i] = offset;
+        Bounds bounds = entry.bounds;
+        if (!bounds.isEmpty()) {
+            bounds.minX += offset.x;
+            bounds.maxX += offset.x;
+            bounds.minY += offset.y;
+            bounds.maxY += offset.y;
+            bounds.inflate(entry.strokeWidth / 2.0);
+        }
+        worldBounds[i] = bounds;
+    }
+    structureVersion = graph.getStructureVersion();
+    contentVersion = graph.getContentVersion();
+    fresh = true;
+}
+
+Bounds HitTester::getBounds(uint32_t index) {
+    refresh();
+    return index < worldBounds.size() ? worldBounds[index] : Bounds();
+}
+
+// Stroke, then fill, then a near miss on the fill's edge
+static bool testOutline(const PathGeometry& geometry, double x, double y, double tolerance,
+                        bool filled, bool evenOdd, double strokeWidth, bool& onStroke) {
+    if (strokeWidth > 0.0 && geometry.strokeContains(x, y, strokeWidth / 2.0 + tolerance)) {
+        onStroke = true;
+        return true;
+    }
+    if (filled) {
+        if (geometry.fillContains(x, y, evenOdd)) {
+            return true;
+        }
+        // Near misses on thin filled shapes
+        return tolerance > 0.0 && geometry.strokeContains(x, y, tolerance);
+    }
+    return false;
+}
+
+bool HitTester::test(uint32_t index, double x, double y, double tolerance, Hit& hit) {
+    Entry& entry = entries[graph[index].handle];
+    hit.onStroke = false;
+    hit.part = CRDTId();
+    if (entry.kind == Kind::Box) {
+        return true;    // The bounds pass was exact
+    }
+    double localX = x - offsets[index].x, localY = y - offsets[index].y;
+    if (entry.kind == Kind::Outline) {
+        if (!entry.geometry) {
+            entry.geometry = geometries.get(outlineOf(*graph[index].node, entry.bounds));
+        }
+        return testOutline(*entry.geometry, localX, localY, tolerance,
+                           entry.filled, entry.evenOdd, entry.strokeWidth, hit.onStroke);
+    }
+
+    // Instances: test the component's parts in its coordinates, topmost first
+    localX = (localX - entry.origin.x) / entry.scale;
+    localY = (localY - entry.origin.y) / entry.scale;
+    double reach = tolerance / entry.scale;
+    for (auto part = entry.parts->rbegin(); part != entry.parts->rend(); ++part) {
+        double margin = part->strokeWidth / 2.0 + reach;
+        if (localX < part->bounds.minX - margin || localX > part->bounds.maxX + margin ||
+            localY < part->bounds.minY - margin || localY > part->bounds.maxY + margin) {
+            continue;
+        }
+        bool inside = !part->geometry ?
+            localX >= part->bounds.minX - part->strokeWidth / 2.0 &&
+            localX <= part->bounds.maxX + part->strokeWidth / 2.0 &&
+            localY >= part->bounds.minY - part->strokeWidth / 2.0 &&
+            localY <= part->bounds.maxY + part->strokeWidth / 2.0 :
+            testOutline(*part->geometry, localX - part->offset.x, localY - part->offset.y, reach,
+                        part->filled, part->evenOdd, part->strokeWidth, hit.onStroke);
+        if (inside) {
+            hit.part = part->id;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HitTester::hitTest(double x, double y, Hit& hit, double tolerance) {
+    refresh();
+    for (uint32_t i = static_cast<uint32_t>(worldBounds.size()); i-- > 1;) {
+        const Bounds& bounds = worldBounds[i];
+        if (bounds.isEmpty() || x < bounds.minX - tolerance || x > bounds.maxX + tolerance ||
+            y < bounds.minY - tolerance || y > bounds.maxY + tolerance) {
+            continue;
+        }
+        candidatesTested++;
+        if (test(i, x, y, tolerance, hit)) {
+            hit.id = graph.getId(i);
+            hit.index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<HitTester::Hit> HitTester::hitTestAll(double x, double y, double tolerance) {
+    refresh();
+    std::vector<Hit> hits;
+    for (uint32_t i = static_cast<uint32_t>(worldBounds.size()); i-- > 1;) {
+        const Bounds& bounds = worldBounds[i];
+        if (bounds.isEmpty() || x < bounds.minX - tolerance || x > bounds.maxX + tolerance ||
+            y < bounds.minY - tolerance || y > bounds.maxY + tolerance) {
+            continue;
+        }
+        candidatesTested++;
+        Hit hit;
+        if (test(i, x, y, tolerance, hit)) {
+            hit.id = graph.getId(i);
+            hit.index = i;
+            hits.push_back(hit);
+        }
+    }
+    return hits;
+}
+
+} // namespace Lienzo
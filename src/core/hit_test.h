@@ -0,0 +1,210 @@
+#pragma once
+
+#include "../collaboration/dom_graph.h"
+#include "vector.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Lienzo {
+
+struct Bounds {
+    double minX = 0.0, minY = 0.0, maxX = -1.0, maxY = -1.0;
+
+    bool isEmpty() const { return maxX < minX || maxY < minY; }
+    bool contains(double x, double y) const {
+        return x >= minX && x <= maxX && y >= minY && y <= maxY;
+    }
+    void include(double x, double y);
+    void inflate(double amount);
+};
+
+// Flattened outline prepared for point queries
+//
+// Edges are bucketed into horizontal bands over the outline's bounds, so
+// a query only looks at the edges near the point's y instead of all of
+// them: the winding number needs the edges crossing the point's scanline,
+// the stroke distance those within reach of it.
+class PathGeometry {
+public:
+    struct Edge {
+        double x0, y0, x1, y1;
+    };
+
+    PathGeometry() = default;
+    // Open subpaths are closed for filling, as in SVG
+    explicit PathGeometry(const std::vector<VectorPath>& paths);
+
+    const Bounds& getBounds() const { return bounds; }
+    const std::vector<Edge>& getEdges() const { return edges; }
+
+    // Nonzero or even-odd fill
+    bool fillContains(double x, double y, bool evenOdd = false) const;
+    // Whether an outline edge is within distance of the point (closing
+    // edges of open subpaths excluded)
+    bool strokeContains(double x, double y, double distance) const;
+
+    size_t getMemoryUsage() const;
+
+private:
+    std::vector<Edge> edges;
+    std::vector<uint8_t> stroked;           // Per edge: drawn by the stroke
+    Bounds bounds;
+    double bandHeight = 1.0;
+    std::vector<uint32_t> bandStarts;       // Band b owns bandEdges[bandStarts[b], bandStarts[b + 1])
+    std::vector<uint32_t> bandEdges;
+
+    void addEdge(const Point& a, const Point& b, bool stroke);
+    void buildBands();
+    size_t bandOf(double y) const;
+};
+
+// Flattened outlines shared by content
+// Every shape or component part with the same outline gets the same
+// PathGeometry, however many nodes or instances draw it. Geometries live as
+// long as something holds them.
+class GeometryCache {
+public:
+    explicit GeometryCache(double flatness);
+
+    // Geometry of an outline given as path data
+    std::shared_ptr<const PathGeometry> get(const std::string& outline);
+
+    // Geometries still in use, and their memory
+    size_t size() const;
+    size_t getMemoryUsage() const;
+    size_t getBuilds() const { return builds; }
+
+private:
+    double flatness;
+    std::unordered_map<std::string, std::weak_ptr<const PathGeometry>> entries;
+    size_t purgeAt;
+    size_t builds;
+};
+
+// Bounds of a node in its local coordinates, from x/y/width/height or its
+// path data; empty for nodes that have neither
+Bounds nodeBounds(const CRDTNode& node);
+
+// Outline of a rectangle, ellipse or path node in its local coordinates,
+// flattened to within tolerance; false for nodes that have none
+bool flattenNodeOutline(const CRDTNode& node, std::vector<VectorPath>& out, double tolerance);
+
+// Point picking against the actual outlines of a document's shapes
+//
+// A pick first compares the point with every visible node's bounds (in
+// paint order, topmost first), and only builds and tests the precise
+// geometry of the candidates. Rectangles, ellipses, path data and text
+// boxes are supported; a shape is hit inside its fill (unless fill is
+// "none") or within half its stroke width of the outline. Frames are hit
+// on their background when nothing inside them is, and offset their
+// descendants by their x/y. Geometry and bounds are cached per node and
+// rebuilt only when the node's version changes.
+//
+// Component instances (see components.h) are picked against their
+// component's parts, placed by the instance's x/y/scale. The parts are
+// built once per component and shared by every instance that overrides
+// nothing; instances with overrides rebuild only the overridden parts.
+// Components must be in the document tree to be resolved.
+class HitTester {
+public:
+    static const double kDefaultFlatness;
+
+    struct Hit {
+        CRDTId id;
+        uint32_t index = DOMGraph::kNone;   // In the DOMGraph
+        bool onStroke = false;
+        CRDTId part;                        // For instances: the component node hit
+    };
+
+    explicit HitTester(DOMGraph& graph);
+
+    // Topmost node under (x, y); tolerance widens strokes and thin shapes
+    // (e.g. a few screen pixels converted to document units)
+    bool hitTest(double x, double y, Hit& hit, double tolerance = 0.0);
+    // Every node under the point, topmost first
+    std::vector<Hit> hitTestAll(double x, double y, double tolerance = 0.0);
+
+    // Bounds of a visible node in document coordinates
+    Bounds getBounds(uint32_t index);
+
+    // Statistics
+    size_t getCandidatesTested() const { return candidatesTested; }
+    size_t getGeometryBuilds() const { return geometries.getBuilds(); }
+    const GeometryCache& getGeometryCache() const { return geometries; }
+
+private:
+    enum class Kind : uint8_t {
+        None,       // Not pickable itself (root, groups)
+        Box,        // Text, frames and components: the bounds are the shape
+        Outline,    // Rectangles, ellipses and paths
+        Instance    // Component instances: the component's parts
+    };
+
+    // One pickable node of a component, in the component's coordinates
+    struct Part {
+        CRDTId id;                  // Looked up in the graph again when overridden
+        std::shared_ptr<const PathGeometry> geometry;   // Null for boxes
+        Bounds bounds;              // Without the stroke
+        Point offset;               // Of the node's local coordinates
+        bool filled = true;
+        bool evenOdd = false;
+        double strokeWidth = 0.0;
+    };
+    using PartList = std::vector<Part>;
+
+    struct Component {
+        CRDTId id;
+        uint64_t stamp = 0;         // Handles and versions of its nodes
+        uint64_t checked = 0;       // Refresh generation the stamp is from
+        std::shared_ptr<const PartList> parts;      // Null if not resolvable
+        Bounds bounds;              // Of all parts, strokes included
+    };
+
+    // Per DOMGraph handle
+    struct Entry {
+        uint64_t version = 0;
+        bool valid = false;
+        Kind kind = Kind::None;
+        bool frame = false;
+        bool filled = true;
+        bool evenOdd = false;
+        double strokeWidth = 0.0;
+        Bounds bounds;              // Local coordinates, without the stroke
+        std::shared_ptr<const PathGeometry> geometry;   // Outlines, looked up on first test
+        // Instances
+        Component* component = nullptr;
+        uint64_t componentStamp = 0;
+        std::shared_ptr<const PartList> parts;     // The component's, unless overridden
+        Point origin;
+        double scale = 1.0;
+    };
+
+    DOMGraph& graph;
+    double flatness;
+    GeometryCache geometries;
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, Component> components;    // key: component id.toString()
+    uint64_t generation;
+    // Per DOMGraph index, refreshed when the graph changes
+    std::vector<Bounds> worldBounds;
+    std::vector<Point> offsets;
+    uint64_t structureVersion;
+    uint64_t contentVersion;
+    bool fresh;
+    size_t candidatesTested;
+
+    void refresh();
+    Entry& entryFor(uint32_t index);
+    void describe(const CRDTNode& node, Entry& entry);
+    void describeInstance(const CRDTNode& node, Entry& entry);
+    Component& componentFor(const std::string& key);
+    void updateComponent(Component& component);
+    // A part from a component node, with the instance's overrides if given
+    bool makePart(const CRDTNode& source, const CRDTNode* instance, const Point& offset, Part& part);
+    bool test(uint32_t index, double x, double y, double tolerance, Hit& hit);
+};
+
+} // namespace Lienzo
@@ -0,0 +1,210 @@
+#include "numbers.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace Lienzo {
+
+// Powers of ten that are exact doubles
+static const double kExactPowers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const int kMaxDigits = 19;     // Fit in a uint64_t
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define LIENZO_SWAR_DIGITS 1
+#endif
+
+#ifdef LIENZO_SWAR_DIGITS
+static uint64_t load8(const char* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// True if all eight bytes are '0'..'9'
+static bool isEightDigits(uint64_t value) {
+    return ((value & 0xF0F0F0F0F0F0F0F0ull) |
+            (((value + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+}
+
+// Eight ASCII digits to their value with three multiplies
+static uint32_t parseEightDigits(uint64_t value) {
+    const uint64_t mask = 0x000000FF000000FFull;
+    const uint64_t mul1 = 100 + (1000000ull << 32);
+    const uint64_t mul2 = 1 + (10000ull << 32);
+    value -= 0x3030303030303030ull;
+    value = (value * 10) + (value >> 8);
+    value = (((value & mask) * mul1) + (((value >> 16) & mask) * mul2)) >> 32;
+    return static_cast<uint32_t>(value);
+}
+#endif
+
+static int countDigits(uint64_t value) {
+    int digits = 0;
+    while (value > 0) {
+        value /= 10;
+        digits++;
+    }
+    return digits;
+}
+
+// Accumulate a run of digits; returns false if there was none
+static bool parseDigits(const char*& s, const char* end, uint64_t& mantissa, int& digits,
+                        int& exponent, bool fraction, bool& truncated) {
+    const char* start = s;
+#ifdef LIENZO_SWAR_DIGITS
+    while (end - s >= 8 && digits + 8 <= kMaxDigits) {
+        uint64_t chunk = load8(s);
+        if (!isEightDigits(chunk)) {
+            break;
+        }
+        mantissa = mantissa * 100000000ull + parseEightDigits(chunk);
+        digits = countDigits(mantissa);
+        if (fraction) {
+            exponent -= 8;
+        }
+        s += 8;
+    }
+#endif
+    while (s < end && *s >= '0' && *s <= '9') {
+        if (digits < kMaxDigits) {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*s - '0');
+            digits = mantissa ? digits + 1 : 0;
+            if (fraction) {
+                exponent--;
+            }
+        } else {
+            truncated = true;
+            if (!fraction) {
+                exponent++;
+            }
+        }
+        s++;
+    }
+    return s != start;
+}
+
+bool parseNumber(const char*& p, const char* end, double& value) {
+    const char* s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) {
+        negative = *s == '-';
+        s++;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool truncated = false;
+    bool any = parseDigits(s, end, mantissa, digits, exponent, false, truncated);
+    if (s < end && *s == '.') {
+        const char* dot = s++;
+        if (!parseDigits(s, end, mantissa, digits, exponent, true, truncated) && !any) {
+            s = dot;
+        } else {
+            any = true;
+        }
+    }
+    if (!any) {
+        return false;
+    }
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        const char* t = s + 1;
+        bool negativeExponent = false;
+        if (t < end && (*t == '-' || *t == '+')) {
+            negativeExponent = *t == '-';
+            t++;
+        }
+        if (t < end && *t >= '0' && *t <= '9') {
+            int explicitExponent = 0;
+            while (t < end && *t >= '0' && *t <= '9') {
+                if (explicitExponent < 100000) {
+                    explicitExponent = explicitExponent * 10 + (*t - '0');
+                }
+                t++;
+            }
+            exponent += negativeExponent ? -explicitExponent : explicitExponent;
+            s = t;
+        }
+    }
+
+    double result;
+    if (mantissa == 0) {
+        result = 0.0;
+    } else if (!truncated && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+        // Both operands exact, so the one rounding is the correct one
+        result = static_cast<double>(mantissa);
+        result = exponent < 0 ? result / kExactPowers[-exponent] : result * kExactPowers[exponent];
+    } else {
+        char buffer[64];
+        size_t length = static_cast<size_t>(s - p);
+        if (length < sizeof(buffer)) {
+            std::memcpy(buffer, p, length);
+            buffer[length] = '\0';
+            result = std::strtod(buffer, nullptr);
+        } else {
+            result = std::strtod(std::string(p, length).c_str(), nullptr);
+        }
+        negative = false;   // strtod saw the sign
+    }
+    value = negative ? -result : result;
+    p = s;
+    return true;
+}
+
+void appendNumber(std::string& out, double value, int decimals) {
+    if (!std::isfinite(value)) {
+        out += '0';
+        return;
+    }
+    decimals = decimals < 0 ? 0 : (decimals > 9 ? 9 : decimals);
+    double scale = kExactPowers[decimals];
+    if (std::fabs(value) * scale >= 9.0e15) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+        out += buffer;
+        return;
+    }
+    int64_t scaled = std::llround(value * scale);
+    if (scaled == 0) {
+        out += '0';
+        return;
+    }
+    if (scaled < 0) {
+        out += '-';
+        scaled = -scaled;
+    }
+    uint64_t unit = static_cast<uint64_t>(scale);
+    uint64_t integer = static_cast<uint64_t>(scaled) / unit;
+    uint64_t fraction = static_cast<uint64_t>(scaled) % unit;
+
+    char buffer[24];
+    int length = 0;
+    do {
+        buffer[length++] = static_cast<char>('0' + integer % 10);
+        integer /= 10;
+    } while (integer > 0);
+    while (length > 0) {
+        out += buffer[--length];
+    }
+    if (fraction == 0) {
+        return;
+    }
+    int width = decimals;
+    while (fraction % 10 == 0) {
+        fraction /= 10;
+        width--;
+    }
+    out += '.';
+    for (int k = width - 1; k >= 0; k--) {
+        buffer[k] = static_cast<char>('0' + fraction % 10);
+        fraction /= 10;
+    }
+    out.append(buffer, static_cast<size_t>(width));
+}
+
+} // namespace Lienzo
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+namespace Lienzo {
+
+// Number parsing and formatting for text formats (SVG, path data)
+
+// Parse a decimal floating-point number at p ("-1.5e3", ".5", "+7"),
+// advancing p past it; false (p unchanged) if there is none.
+// Runs of eight digits are converted at once (SWAR), and results are
+// exact whenever the digits fit in 53 bits and the exponent is small,
+// which covers practically all coordinates; other inputs go to strtod.
+bool parseNumber(const char*& p, const char* end, double& value);
+
+// Append value with at most decimals fractional digits, trailing zeros
+// dropped ("12.5", "-3", "0.125")
+void appendNumber(std::string& out, double value, int decimals = 3);
+
+} // namespace Lienzo
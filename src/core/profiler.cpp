@@ -0,0 +1,146 @@
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Lienzo {
+
+const size_t Profiler::kThreadCapacity = 1 << 15;
+std::atomic<bool> Profiler::enabled(true);
+
+namespace {
+
+// Written by the owning thread only; read concurrently by exports
+struct Slot {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> start{0};
+    std::atomic<uint64_t> end{0};
+};
+
+struct ThreadBuffer {
+    uint32_t threadId;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<uint64_t> head{0};      // Spans ever recorded
+    std::atomic<uint64_t> cleared{0};   // Spans before this index were cleared
+
+    explicit ThreadBuffer(uint32_t threadId)
+        : threadId(threadId), slots(new Slot[Profiler::kThreadCapacity]) {}
+};
+
+// Buffers outlive their threads so late exports still see their spans
+std::mutex registryMutex;
+std::vector<std::shared_ptr<ThreadBuffer>> registry;
+
+ThreadBuffer& localBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.push_back(std::make_shared<ThreadBuffer>(static_cast<uint32_t>(registry.size() + 1)));
+        return registry.back();
+    }();
+    return *buffer;
+}
+
+void appendEscaped(std::string& out, const char* text) {
+    for (const char* p = text; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            out += '\\';
+        }
+        out += static_cast<unsigned char>(*p) < 0x20 ? ' ' : *p;
+    }
+}
+
+} // namespace
+
+uint64_t Profiler::nowNanos() {
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - epoch).count());
+}
+
+void Profiler::record(const char* name, uint64_t startNanos, uint64_t endNanos) {
+    ThreadBuffer& buffer = localBuffer();
+    uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    Slot& slot = buffer.slots[head & (kThreadCapacity - 1)];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.start.store(startNanos, std::memory_order_relaxed);
+    slot.end.store(endNanos, std::memory_order_relaxed);
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+std::string Profiler::exportChromeTrace() {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffers = registry;
+    }
+
+    struct Span {
+        const char* name;
+        uint64_t start;
+        uint64_t end;
+    };
+    std::string out = "{\"traceEvents\": [\n";
+    bool first = true;
+    char number[160];
+    std::vector<Span> spans;
+    for (const auto& buffer : buffers) {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t begin = std::max(buffer->cleared.load(std::memory_order_relaxed),
+                                  head > kThreadCapacity ? head - kThreadCapacity : 0);
+        spans.clear();
+        for (uint64_t i = begin; i < head; i++) {
+            const Slot& slot = buffer->slots[i & (kThreadCapacity - 1)];
+            spans.push_back(Span{slot.name.load(std::memory_order_relaxed),
+                                 slot.start.load(std::memory_order_relaxed),
+                                 slot.end.load(std::memory_order_relaxed)});
+        }
+        // The owner may have lapped the ring while we copied: drop the slots
+        // it has written (or is writing) since
+        uint64_t after = buffer->head.load(std::memory_order_acquire);
+        size_t skip = 0;
+        if (after >= kThreadCapacity && after - kThreadCapacity + 1 > begin) {
+            skip = static_cast<size_t>(std::min<uint64_t>(after - kThreadCapacity + 1 - begin, spans.size()));
+        }
+
+        std::snprintf(number, sizeof(number), "%u", buffer->threadId);
+        out += first ? "" : ",\n";
+        first = false;
+        out += "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": ";
+        out += number;
+        out += ", \"args\": {\"name\": \"thread ";
+        out += number;
+        out += "\"}}";
+        for (size_t i = skip; i < spans.size(); i++) {
+            out += ",\n{\"name\": \"";
+            appendEscaped(out, spans[i].name ? spans[i].name : "?");
+            std::snprintf(number, sizeof(number), "\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+                          buffer->threadId, static_cast<double>(spans[i].start) / 1000.0,
+                          static_cast<double>(spans[i].end - spans[i].start) / 1000.0);
+            out += number;
+        }
+    }
+    out += "\n], \"displayTimeUnit\": \"ms\"}\n";
+    return out;
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) {
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    std::string trace = exportChromeTrace();
+    bool ok = std::fwrite(trace.data(), 1, trace.size(), file) == trace.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+void Profiler::clear() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto& buffer : registry) {
+        buffer->cleared.store(buffer->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+}
+
+} // namespace Lienzo
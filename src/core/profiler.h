@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace Lienzo {
+
+// Scoped timing spans for finding where frame time goes
+//
+// LIENZO_PROFILE_SCOPE("name") times the rest of the enclosing block. Spans
+// go to a fixed-size ring buffer owned by the recording thread (no locks;
+// the oldest spans are overwritten when it is full) and are exported in the
+// Chrome trace event format, which chrome://tracing and Perfetto open.
+// Without LIENZO_ENABLE_PROFILING the macro compiles to nothing.
+class Profiler {
+public:
+    static const size_t kThreadCapacity;    // Spans kept per thread
+
+    // Recording is on by default in profiling builds
+    static void setEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    // Nanoseconds since the profiler's first use
+    static uint64_t nowNanos();
+
+    // name must outlive the profiler (a string literal or __func__)
+    static void record(const char* name, uint64_t startNanos, uint64_t endNanos);
+
+    // Spans recorded since the last clear, as {"traceEvents": [...]}.
+    // Safe while other threads record; spans they overwrite during the
+    // export are left out.
+    static std::string exportChromeTrace();
+    static bool writeChromeTrace(const std::string& path);
+    static void clear();
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) : name(nullptr), start(0) {
+        if (Profiler::isEnabled()) {
+            this->name = name;
+            start = Profiler::nowNanos();
+        }
+    }
+    ~ProfileScope() {
+        if (name) {
+            Profiler::record(name, start, Profiler::nowNanos());
+        }
+    }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name;
+    uint64_t start;
+};
+
+} // namespace Lienzo
+
+#ifdef LIENZO_ENABLE_PROFILING
+#define LIENZO_PROFILE_CONCAT_(a, b) a##b
+#define LIENZO_PROFILE_CONCAT(a, b) LIENZO_PROFILE_CONCAT_(a, b)
+#define LIENZO_PROFILE_SCOPE(name) ::Lienzo::ProfileScope LIENZO_PROFILE_CONCAT(profileScope, __LINE__)(name)
+#else
+#define LIENZO_PROFILE_SCOPE(name) ((void)0)
+#endif
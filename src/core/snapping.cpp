@@ -0,0 +1,263 @@
+#include "snapping.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Lienzo {
+
+SnapEngine::SnapEngine(CRDTDocument& document)
+    : SnapEngine(document, document.getRootId()) {
+}
+
+SnapEngine::SnapEngine(CRDTDocument& document, const CRDTId& container)
+    : document(document), container(container), updates(0) {
+    listenerHandle = document.addOperationListener([this](const CRDTOperation& op, bool) {
+        onOperation(op);
+    });
+    rebuild();
+}
+
+SnapEngine::~SnapEngine() {
+    document.removeOperationListener(listenerHandle);
+}
+
+void SnapEngine::setContainer(const CRDTId& id) {
+    if (id != container) {
+        container = id;
+        rebuild();
+    }
+}
+
+void SnapEngine::rebuild() {
+    objects.clear();
+    freeSlots.clear();
+    ids.clear();
+    xLines.clear();
+    yLines.clear();
+    for (const auto& child : document.getChildren(container)) {
+        update(child);
+    }
+}
+
+void SnapEngine::onOperation(const CRDTOperation& op) {
+    switch (op.type) {
+        case CRDTOperationType::SetProperty:
+            if ((op.key == "x" || op.key == "y" || op.key == "width" || op.key == "height" || op.key == "d") &&
+                ids.count(op.nodeId.toString())) {
+                update(op.nodeId);
+            }
+            break;
+        case CRDTOperationType::AddChild:
+            if (op.nodeId == container) {
+                update(op.childId);
+            }
+            break;
+        case CRDTOperationType::RemoveChild:
+            if (op.nodeId == container) {
+                remove(op.childId);
+            }
+            break;
+        case CRDTOperationType::DeleteNode:
+            remove(op.nodeId);
+            break;
+        case CRDTOperationType::RestoreNode: {
+            // Back in the index if it is still one of the container's children
+            auto parent = document.getNode(container);
+            if (!parent) {
+                break;
+            }
+            for (const auto& child : parent->getChildEntries()) {
+                if (child.childId == op.nodeId && !child.deleted) {
+                    update(op.nodeId);
+                    break;
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void SnapEngine::update(const CRDTId& id) {
+    auto node = document.getNode(id);
+    if (!node || node->isDeleted()) {
+        remove(id);
+        return;
+    }
+    std::string key = id.toString();
+    auto it = ids.find(key);
+    uint32_t slot;
+    if (it != ids.end()) {
+        slot = it->second;
+        eraseLines(slot);
+    } else {
+        if (!freeSlots.empty()) {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            slot = static_cast<uint32_t>(objects.size());
+            objects.emplace_back();
+        }
+        ids.emplace(std::move(key), slot);
+        objects[slot].id = id;
+    }
+    objects[slot].bounds = nodeBounds(*node);
+    insertLines(slot);
+    updates++;
+}
+
+void SnapEngine::remove(const CRDTId& id) {
+    auto it = ids.find(id.toString());
+    if (it == ids.end()) {
+        return;
+    }
+    uint32_t slot = it->second;
+    eraseLines(slot);
+    objects[slot] = Object();
+    freeSlots.push_back(slot);
+    ids.erase(it);
+    updates++;
+}
+
+void SnapEngine::insertLines(uint32_t slot) {
+    Object& object = objects[slot];
+    const Bounds& b = object.bounds;
+    // Objects without geometry (groups, empty nodes) are tracked but not snapped to
+    if (b.isEmpty()) {
+        return;
+    }
+    xLines.insert({b.minX, slot, 0});
+    xLines.insert({(b.minX + b.maxX) / 2.0, slot, 1});
+    xLines.insert({b.maxX, slot, 2});
+    yLines.insert({b.minY, slot, 0});
+    yLines.insert({(b.minY + b.maxY) / 2.0, slot, 1});
+    yLines.insert({b.maxY, slot, 2});
+    object.indexed = true;
+}
+
+void SnapEngine::eraseLines(uint32_t slot) {
+    Object& object = objects[slot];
+    if (!object.indexed) {
+        return;
+    }
+    const Bounds& b = object.bounds;
+    xLines.erase({b.minX, slot, 0});
+    xLines.erase({(b.minX + b.maxX) / 2.0, slot, 1});
+    xLines.erase({b.maxX, slot, 2});
+    yLines.erase({b.minY, slot, 0});
+    yLines.erase({(b.minY + b.maxY) / 2.0, slot, 1});
+    yLines.erase({b.maxY, slot, 2});
+    object.indexed = false;
+}
+
+bool SnapEngine::nearest(const std::set<Line>& lines, double value, double tolerance,
+                         const std::vector<uint32_t>& excluded, double& found) const {
+    auto isExcluded = [&](const Line& line) {
+        return std::binary_search(excluded.begin(), excluded.end(), line.slot);
+    };
+    bool any = false;
+    double best = tolerance;
+    auto split = lines.lower_bound(Line{value, 0, 0});
+    for (auto it = split; it != lines.end() && it->value - value <= best; ++it) {
+        if (!isExcluded(*it)) {
+            best = it->value - value;
+            found = it->value;
+            any = true;
+            break;
+        }
+    }
+    for (auto it = split; it != lines.begin();) {
+        --it;
+        if (value - it->value > best) {
+            break;
+        }
+        if (!isExcluded(*it)) {
+            // Ties go to the line below, so results don't depend on set order
+            found = it->value;
+            any = true;
+            break;
+        }
+    }
+    return any;
+}
+
+void SnapEngine::addGuides(const std::set<Line>& lines, bool vertical, const double anchors[3],
+                           double start, double end, const std::vector<uint32_t>& excluded,
+                           std::vector<SnapGuide>& guides) const {
+    for (int k = 0; k < 3; k++) {
+        double position = anchors[k];
+        if (k > 0 && position == anchors[k - 1]) {
+            continue;
+        }
+        double epsilon = 1e-9 * std::max(1.0, std::fabs(position));
+        SnapGuide guide;
+        guide.vertical = vertical;
+        guide.position = position;
+        guide.start = start;
+        guide.end = end;
+        bool aligned = false;
+        for (auto it = lines.lower_bound(Line{position - epsilon, 0, 0});
+             it != lines.end() && it->value <= position + epsilon; ++it) {
+            if (std::binary_search(excluded.begin(), excluded.end(), it->slot)) {
+                continue;
+            }
+            const Bounds& b = objects[it->slot].bounds;
+            guide.start = std::min(guide.start, vertical ? b.minY : b.minX);
+            guide.end = std::max(guide.end, vertical ? b.maxY : b.maxX);
+            aligned = true;
+        }
+        if (aligned) {
+            guides.push_back(guide);
+        }
+    }
+}
+
+bool SnapEngine::snap(const Bounds& moving, double tolerance, SnapResult& result,
+                      const std::vector<CRDTId>& exclude) const {
+    result = SnapResult();
+    if (moving.isEmpty() || !(tolerance >= 0.0)) {
+        return false;
+    }
+    std::vector<uint32_t> excluded;
+    for (const auto& id : exclude) {
+        auto it = ids.find(id.toString());
+        if (it != ids.end()) {
+            excluded.push_back(it->second);
+        }
+    }
+    std::sort(excluded.begin(), excluded.end());
+
+    // Per axis, the anchor that is closest to any line decides the correction
+    auto closest = [&](const std::set<Line>& lines, double min, double max, double& delta) {
+        const double anchors[3] = {min, (min + max) / 2.0, max};
+        bool snapped = false;
+        for (double anchor : anchors) {
+            double found;
+            if (nearest(lines, anchor, tolerance, excluded, found) &&
+                (!snapped || std::fabs(found - anchor) < std::fabs(delta))) {
+                delta = found - anchor;
+                snapped = true;
+            }
+        }
+        return snapped;
+    };
+    result.snappedX = closest(xLines, moving.minX, moving.maxX, result.dx);
+    result.snappedY = closest(yLines, moving.minY, moving.maxY, result.dy);
+
+    Bounds moved = moving;
+    moved.minX += result.dx;
+    moved.maxX += result.dx;
+    moved.minY += result.dy;
+    moved.maxY += result.dy;
+    if (result.snappedX) {
+        const double anchors[3] = {moved.minX, (moved.minX + moved.maxX) / 2.0, moved.maxX};
+        addGuides(xLines, true, anchors, moved.minY, moved.maxY, excluded, result.guides);
+    }
+    if (result.snappedY) {
+        const double anchors[3] = {moved.minY, (moved.minY + moved.maxY) / 2.0, moved.maxY};
+        addGuides(yLines, false, anchors, moved.minX, moved.maxX, excluded, result.guides);
+    }
+    return result.snappedX || result.snappedY;
+}
+
+} // namespace Lienzo
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "../collaboration/crdt.h"
+#include "hit_test.h"
+#include <cstdint>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Lienzo {
+
+// An alignment line to draw while dragging
+struct SnapGuide {
+    bool vertical = true;       // x = position, else y = position
+    double position = 0.0;
+    double start = 0.0;         // Extent along the line, covering every object aligned on it
+    double end = 0.0;
+};
+
+struct SnapResult {
+    double dx = 0.0;            // Correction to apply to the proposed bounds
+    double dy = 0.0;
+    bool snappedX = false;
+    bool snappedY = false;
+    std::vector<SnapGuide> guides;
+};
+
+// Smart guides for dragging objects
+//
+// Indexes the left/center/right and top/middle/bottom lines of the
+// children of one container (the document root by default, i.e. the
+// top-level frames), which share a coordinate space. Each axis keeps its
+// lines in a sorted set, so a query only looks at the lines next to the
+// moving object's own, and moving an object replaces its six lines. The
+// index follows the document through an operation listener.
+class SnapEngine {
+public:
+    explicit SnapEngine(CRDTDocument& document);
+    SnapEngine(CRDTDocument& document, const CRDTId& container);
+    ~SnapEngine();
+    SnapEngine(const SnapEngine&) = delete;
+    SnapEngine& operator=(const SnapEngine&) = delete;
+
+    // Index the children of another container
+    void setContainer(const CRDTId& container);
+    const CRDTId& getContainer() const { return container; }
+    // Reindex everything, e.g. after merging another document state
+    void rebuild();
+
+    // Nearest alignment of moving (the dragged object's proposed bounds)
+    // with the other objects, per axis, within tolerance in document units
+    // (e.g. a few screen pixels divided by the zoom). Objects in exclude,
+    // normally the ones being dragged, are ignored.
+    bool snap(const Bounds& moving, double tolerance, SnapResult& result,
+              const std::vector<CRDTId>& exclude = {}) const;
+
+    // Statistics
+    size_t getObjectCount() const { return ids.size(); }
+    size_t getLineCount() const { return xLines.size() + yLines.size(); }
+    size_t getUpdates() const { return updates; }
+
+private:
+    struct Line {
+        double value;
+        uint32_t slot;
+        uint8_t anchor;     // 0 = min, 1 = center, 2 = max
+
+        bool operator<(const Line& other) const {
+            if (value != other.value) return value < other.value;
+            if (slot != other.slot) return slot < other.slot;
+            return anchor < other.anchor;
+        }
+    };
+
+    struct Object {
+        CRDTId id;
+        Bounds bounds;
+        bool indexed = false;
+    };
+
+    CRDTDocument& document;
+    CRDTId container;
+    size_t listenerHandle;
+    std::vector<Object> objects;
+    std::vector<uint32_t> freeSlots;
+    std::unordered_map<std::string, uint32_t> ids;     // Node ID -> slot
+    std::set<Line> xLines;
+    std::set<Line> yLines;
+    size_t updates;
+
+    void onOperation(const CRDTOperation& op);
+    void update(const CRDTId& id);
+    void remove(const CRDTId& id);
+    void insertLines(uint32_t slot);
+    void eraseLines(uint32_t slot);
+    bool nearest(const std::set<Line>& lines, double value, double tolerance,
+                 const std::vector<uint32_t>& excluded, double& found) const;
+    void addGuides(const std::set<Line>& lines, bool vertical, const double anchors[3],
+                   double start, double end, const std::vector<uint32_t>& excluded,
+                   std::vector<SnapGuide>& guides) const;
+};
+
+} // namespace Lienzo
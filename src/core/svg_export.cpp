@@ -0,0 +1,337 @@
+#include "svg_export.h"
+#include "numbers.h"
+#include "svg_import.h"
+#include <cstring>
+
+namespace Lienzo {
+
+void appendPathData(std::string& out, const VectorPath& path, int decimals) {
+    for (size_t i = 0; i < path.points.size(); i++) {
+        // One L, then implicit line-tos
+        if (i < 2) {
+            out += i == 0 ? 'M' : 'L';
+        } else {
+            out += ' ';
+        }
+        appendNumber(out, path.points[i].x, decimals);
+        out += ' ';
+        appendNumber(out, path.points[i].y, decimals);
+    }
+    if (path.closed && !path.points.empty()) {
+        out += 'Z';
+    }
+}
+
+const size_t SvgWriter::kDefaultChunkSize = 64 * 1024;
+const int SvgWriter::kDefaultDecimals = 3;
+
+SvgWriter::SvgWriter(ChunkCallback sink, size_t chunkSize)
+    : sink(std::move(sink)), chunkSize(chunkSize ? chunkSize : kDefaultChunkSize),
+      decimals(kDefaultDecimals), startTagOpen(false), bytesWritten(0), elementCount(0) {
+    buffer.reserve(this->chunkSize + 256);
+}
+
+void SvgWriter::beginDocument(double width, double height) {
+    openElement("svg");
+    attribute("xmlns", "http://www.w3.org/2000/svg");
+    attribute("width", width);
+    attribute("height", height);
+    buffer += " viewBox=\"0 0 ";
+    appendNumber(buffer, width, decimals);
+    buffer += ' ';
+    appendNumber(buffer, height, decimals);
+    buffer += '"';
+}
+
+void SvgWriter::endDocument() {
+    while (!openStarts.empty()) {
+        closeElement();
+    }
+    buffer += '\n';
+    flush();
+}
+
+void SvgWriter::openElement(std::string_view name) {
+    finishStartTag();
+    if (!openStarts.empty()) {
+        buffer += '\n';
+    }
+    buffer += '<';
+    buffer.append(name.data(), name.size());
+    openStarts.push_back(openNames.size());
+    openNames.append(name.data(), name.size());
+    startTagOpen = true;
+    elementCount++;
+}
+
+void SvgWriter::attribute(std::string_view name, std::string_view value) {
+    buffer += ' ';
+    buffer.append(name.data(), name.size());
+    buffer += "=\"";
+    appendEscaped(value, true);
+    buffer += '"';
+}
+
+void SvgWriter::attribute(std::string_view name, double value) {
+    buffer += ' ';
+    buffer.append(name.data(), name.size());
+    buffer += "=\"";
+    appendNumber(buffer, value, decimals);
+    buffer += '"';
+}
+
+void SvgWriter::text(std::string_view content) {
+    finishStartTag();
+    appendEscaped(content, false);
+    maybeFlush();
+}
+
+void SvgWriter::closeElement() {
+    if (openStarts.empty()) {
+        return;
+    }
+    size_t start = openStarts.back();
+    if (startTagOpen) {
+        buffer += "/>";
+        startTagOpen = false;
+    } else {
+        buffer += "</";
+        buffer.append(openNames, start, std::string::npos);
+        buffer += '>';
+    }
+    openNames.resize(start);
+    openStarts.pop_back();
+    maybeFlush();
+}
+
+void SvgWriter::attribute(std::string_view name, const VectorPath& path) {
+    buffer += ' ';
+    buffer.append(name.data(), name.size());
+    buffer += "=\"";
+    appendPathData(path);
+    buffer += '"';
+}
+
+void SvgWriter::writePath(const VectorPath& path, const SvgAttributes& attributes) {
+    openElement("path");
+    attribute("d", path);
+    for (const auto& attr : attributes) {
+        attribute(attr.first, attr.second);
+    }
+    closeElement();
+}
+
+void SvgWriter::writePaths(const std::vector<VectorPath>& paths, const SvgAttributes& attributes) {
+    openElement("path");
+    buffer += " d=\"";
+    for (const auto& path : paths) {
+        appendPathData(path);
+    }
+    buffer += '"';
+    for (const auto& attr : attributes) {
+        attribute(attr.first, attr.second);
+    }
+    closeElement();
+}
+
+void SvgWriter::flush() {
+    if (buffer.empty()) {
+        return;
+    }
+    if (sink) {
+        sink(buffer);
+    }
+    bytesWritten += buffer.size();
+    buffer.clear();
+}
+
+void SvgWriter::finishStartTag() {
+    if (startTagOpen) {
+        buffer += '>';
+        startTagOpen = false;
+    }
+}
+
+void SvgWriter::appendEscaped(std::string_view value, bool attribute) {
+    size_t run = 0;
+    for (size_t i = 0; i < value.size(); i++) {
+        const char* entity = nullptr;
+        switch (value[i]) {
+            case '&': entity = "&amp;"; break;
+            case '<': entity = "&lt;"; break;
+            case '>': entity = "&gt;"; break;
+            case '"': entity = attribute ? "&quot;" : nullptr; break;
+            default: break;
+        }
+        if (entity) {
+            buffer.append(value.data() + run, i - run);
+            buffer += entity;
+            run = i + 1;
+        }
+    }
+    buffer.append(value.data() + run, value.size() - run);
+}
+
+void SvgWriter::appendPathData(const VectorPath& path) {
+    Lienzo::appendPathData(buffer, path, decimals);
+    maybeFlush();
+}
+
+void SvgWriter::maybeFlush() {
+    if (buffer.size() >= chunkSize) {
+        flush();
+    }
+}
+
+// Frame export
+namespace {
+
+// Properties read while writing, in the order they are written
+enum PropertyKey {
+    kKind, kD, kName, kX, kY, kWidth, kHeight, kRx, kRy, kFirstPresentation
+};
+const char* const kGeometryKeys[kFirstPresentation] = {
+    "kind", "d", "name", "x", "y", "width", "height", "rx", "ry"
+};
+const size_t kPropertyCount = kFirstPresentation + kSvgPresentationAttributeCount;
+
+struct NodeProperties {
+    const std::string* values[kPropertyCount] = {};
+
+    explicit NodeProperties(const CRDTNode& node) {
+        for (const auto& property : node.getProperties()) {
+            // Unset or cleared
+            if (property.second.timestamp.siteId.empty() || property.second.value.empty()) {
+                continue;
+            }
+            const char* key = property.first.c_str();
+            for (size_t k = 0; k < kPropertyCount; k++) {
+                const char* name = k < kFirstPresentation ? kGeometryKeys[k]
+                                                          : kSvgPresentationAttributes[k - kFirstPresentation];
+                if (std::strcmp(key, name) == 0) {
+                    values[k] = &property.second.value;
+                    break;
+                }
+            }
+        }
+    }
+
+    bool is(size_t key, const char* value) const {
+        return values[key] && *values[key] == value;
+    }
+    double number(size_t key) const {
+        double result = 0.0;
+        if (values[key]) {
+            const char* p = values[key]->data();
+            parseNumber(p, p + values[key]->size(), result);
+        }
+        return result;
+    }
+    void write(SvgWriter& writer, size_t key, const char* name) const {
+        if (values[key]) {
+            writer.attribute(name, *values[key]);
+        }
+    }
+    void writeCommon(SvgWriter& writer) const {
+        write(writer, kName, "id");
+        for (size_t k = 0; k < kSvgPresentationAttributeCount; k++) {
+            write(writer, kFirstPresentation + k, kSvgPresentationAttributes[k]);
+        }
+    }
+};
+
+size_t writeChildren(const CRDTDocument& document, const CRDTId& parentId, SvgWriter& writer,
+                     const SvgPathProvider& pathFor);
+
+size_t writeNode(const CRDTDocument& document, const CRDTId& id, SvgWriter& writer,
+                 const SvgPathProvider& pathFor) {
+    auto node = document.getNode(id);
+    if (!node || node->isDeleted()) {
+        return 0;
+    }
+    NodeProperties properties(*node);
+    std::string type = node->getType();
+
+    if (type == "rectangle") {
+        writer.openElement("rect");
+        properties.write(writer, kX, "x");
+        properties.write(writer, kY, "y");
+        properties.write(writer, kWidth, "width");
+        properties.write(writer, kHeight, "height");
+        properties.write(writer, kRx, "rx");
+        properties.write(writer, kRy, "ry");
+    } else if (type == "shape" && properties.is(kKind, "ellipse")) {
+        double rx = properties.number(kWidth) / 2.0;
+        double ry = properties.number(kHeight) / 2.0;
+        writer.openElement("ellipse");
+        writer.attribute("cx", properties.number(kX) + rx);
+        writer.attribute("cy", properties.number(kY) + ry);
+        writer.attribute("rx", rx);
+        writer.attribute("ry", ry);
+    } else if (type == "shape") {
+        if (properties.values[kD]) {
+            writer.openElement("path");
+            writer.attribute("d", *properties.values[kD]);
+        } else {
+            VectorPath path;
+            if (!pathFor || !pathFor(id, path) || path.points.empty()) {
+                return 0;
+            }
+            writer.openElement("path");
+            writer.attribute("d", path);
+        }
+    } else if (type == "text") {
+        writer.openElement("text");
+        properties.write(writer, kX, "x");
+        properties.write(writer, kY, "y");
+        properties.writeCommon(writer);
+        writer.text(document.getText(id));
+        writer.closeElement();
+        return 1;
+    } else if (type == "group" || type == "frame") {
+        // Nested frames keep their viewport
+        writer.openElement(type == "frame" ? "svg" : "g");
+        if (type == "frame") {
+            properties.write(writer, kX, "x");
+            properties.write(writer, kY, "y");
+            properties.write(writer, kWidth, "width");
+            properties.write(writer, kHeight, "height");
+        }
+        properties.writeCommon(writer);
+        size_t count = 1 + writeChildren(document, id, writer, pathFor);
+        writer.closeElement();
+        return count;
+    } else {
+        return 0;
+    }
+    properties.writeCommon(writer);
+    writer.closeElement();
+    return 1;
+}
+
+size_t writeChildren(const CRDTDocument& document, const CRDTId& parentId, SvgWriter& writer,
+                     const SvgPathProvider& pathFor) {
+    size_t count = 0;
+    for (const auto& child : document.getChildren(parentId)) {
+        count += writeNode(document, child, writer, pathFor);
+    }
+    return count;
+}
+
+} // namespace
+
+size_t exportFrameSvg(const CRDTDocument& document, const CRDTId& frameId, SvgWriter& writer,
+                      const SvgPathProvider& pathFor) {
+    auto frame = document.getNode(frameId);
+    if (!frame || frame->isDeleted()) {
+        return 0;
+    }
+    NodeProperties properties(*frame);
+    writer.beginDocument(properties.values[kWidth] ? properties.number(kWidth) : 100.0,
+                         properties.values[kHeight] ? properties.number(kHeight) : 100.0);
+    size_t count = writeChildren(document, frameId, writer, pathFor);
+    writer.endDocument();
+    return count;
+}
+
+} // namespace Lienzo
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "../collaboration/crdt.h"
+#include "vector.h"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Lienzo {
+
+using SvgAttributes = std::vector<std::pair<std::string_view, std::string_view>>;
+
+// Append a polyline as path data ("M1 2L3 4 5 6Z")
+void appendPathData(std::string& out, const VectorPath& path, int decimals = 3);
+
+// Streaming SVG serializer
+// Markup is built in a buffer that is handed to the sink whenever it fills
+// up, so exporting a large document never holds the whole text at once.
+class SvgWriter {
+public:
+    using ChunkCallback = std::function<void(std::string_view chunk)>;
+
+    static const size_t kDefaultChunkSize;
+    static const int kDefaultDecimals;
+
+    explicit SvgWriter(ChunkCallback sink, size_t chunkSize = kDefaultChunkSize);
+
+    // Fractional digits kept in coordinates
+    void setDecimals(int value) { decimals = value; }
+
+    // <svg> root sized width x height; endDocument closes everything still
+    // open and flushes
+    void beginDocument(double width, double height);
+    void endDocument();
+
+    // Attributes go between openElement and the first child, text or close
+    void openElement(std::string_view name);
+    void attribute(std::string_view name, std::string_view value);
+    void attribute(std::string_view name, double value);
+    void attribute(std::string_view name, const VectorPath& path);   // As path data
+    void text(std::string_view content);
+    void closeElement();
+
+    // A polyline (or several, as one path) as <path d="...">
+    void writePath(const VectorPath& path, const SvgAttributes& attributes = {});
+    void writePaths(const std::vector<VectorPath>& paths, const SvgAttributes& attributes = {});
+
+    void flush();
+    size_t getBytesWritten() const { return bytesWritten + buffer.size(); }
+    size_t getElementCount() const { return elementCount; }
+
+private:
+    ChunkCallback sink;
+    size_t chunkSize;
+    int decimals;
+    std::string buffer;
+    std::string openNames;            // Names of open elements, back to back
+    std::vector<size_t> openStarts;   // Offset of each name in openNames
+    bool startTagOpen;
+    size_t bytesWritten;
+    size_t elementCount;
+
+    void finishStartTag();
+    void appendEscaped(std::string_view value, bool attribute);
+    void appendPathData(const VectorPath& path);
+    void maybeFlush();
+};
+
+// Write a frame and its subtree as a standalone SVG document
+// The inverse of SvgImporter: rectangles, paths, ellipses, groups and text
+// map back to their elements with presentation attributes and names (as
+// id). Shapes without path data are asked of pathFor, if given; nodes that
+// have no SVG form are skipped. Returns the number of elements written.
+using SvgPathProvider = std::function<bool(const CRDTId& id, VectorPath& path)>;
+size_t exportFrameSvg(const CRDTDocument& document, const CRDTId& frameId, SvgWriter& writer,
+                      const SvgPathProvider& pathFor = nullptr);
+
+} // namespace Lienzo
@@ -0,0 +1,316 @@
+#include "svg_import.h"
+#include "numbers.h"
+
+namespace Lienzo {
+
+const char* const kSvgPresentationAttributes[kSvgPresentationAttributeCount] = {
+    "fill", "fill-rule", "stroke", "stroke-width", "opacity", "fill-opacity",
+    "stroke-opacity", "transform", "style"
+};
+
+// Elements whose content never becomes nodes
+static bool isSkippedContainer(std::string_view name) {
+    return name == "defs" || name == "style" || name == "title" || name == "desc" ||
+           name == "metadata" || name == "clipPath" || name == "mask" || name == "symbol" ||
+           name == "linearGradient" || name == "radialGradient" || name == "pattern" ||
+           name == "marker" || name == "filter" || name == "script" || name == "foreignObject";
+}
+
+static double number(const SvgElement& element, const char* key) {
+    const std::string_view* value = element.get(key);
+    double result = 0.0;
+    if (value) {
+        const char* p = value->data();
+        const char* end = p + value->size();
+        while (p < end && *p == ' ') {
+            p++;
+        }
+        parseNumber(p, end, result);
+    }
+    return result;
+}
+
+static std::string formatNumber(double value) {
+    std::string out;
+    appendNumber(out, value, 4);
+    return out;
+}
+
+// ShapeBatch implementation
+std::vector<CRDTId> ShapeBatch::instantiate(CRDTDocument& document, const CRDTId& parent,
+                                            const std::function<void(const CRDTId&)>& onNode) const {
+    std::vector<CRDTId> ids;
+    std::vector<CRDTId> topLevel;
+    ids.reserve(entries.size());
+    for (const auto& entry : entries) {
+        CRDTId id = document.createNode(entry.type);
+        for (const auto& property : entry.properties) {
+            document.setNodeProperty(id, property.first, property.second);
+        }
+        if (!entry.text.empty()) {
+            document.insertText(id, 0, entry.text);
+        }
+        if (entry.parent < 0) {
+            document.addChild(parent, id);
+            topLevel.push_back(id);
+        } else {
+            document.addChild(ids[entry.parent], id);
+        }
+        ids.push_back(id);
+        if (onNode) {
+            onNode(id);
+        }
+    }
+    return topLevel;
+}
+
+size_t ShapeBatch::getMemoryUsage() const {
+    size_t bytes = sizeof(ShapeBatch) + entries.capacity() * sizeof(Entry);
+    for (const auto& entry : entries) {
+        bytes += entry.type.capacity() + entry.text.capacity() +
+                 entry.properties.capacity() * sizeof(entry.properties[0]);
+        for (const auto& property : entry.properties) {
+            bytes += property.first.capacity() + property.second.capacity();
+        }
+    }
+    return bytes;
+}
+
+SvgImporter::SvgImporter(CRDTDocument& document, const CRDTId& parent)
+    : document(document), root(parent), skipDepth(0), textDepth(0), skipped(0), recorder(nullptr) {
+}
+
+const CRDTId& SvgImporter::currentParent() const {
+    return stack.empty() ? root : stack.back().id;
+}
+
+void SvgImporter::handle(const SvgElement& element) {
+    switch (element.kind) {
+        case SvgElement::Kind::Open:
+            openElement(element, false);
+            break;
+        case SvgElement::Kind::Empty:
+            openElement(element, true);
+            break;
+        case SvgElement::Kind::Close:
+            closeElement(element.name);
+            break;
+        case SvgElement::Kind::Text:
+            if (skipDepth == 0 && textDepth > 0) {
+                textContent += element.text;
+            }
+            break;
+    }
+}
+
+void SvgImporter::openElement(const SvgElement& element, bool empty) {
+    std::string_view name = element.name;
+    if (skipDepth > 0) {
+        skipDepth += empty ? 0 : 1;
+        return;
+    }
+    if (textDepth > 0) {
+        // <tspan> and friends only contribute their text
+        textDepth += empty ? 0 : 1;
+        return;
+    }
+    if (isSkippedContainer(name)) {
+        skipDepth += empty ? 0 : 1;
+        skipped++;
+        return;
+    }
+    if (name == "svg") {
+        if (!empty) {
+            stack.push_back(Open{std::string(name), currentParent()});
+        }
+        return;
+    }
+    if (name == "g" || name == "a") {
+        CRDTId group = document.createNode("group");
+        copyAttributes(group, element);
+        attach(currentParent(), group);
+        if (!empty) {
+            stack.push_back(Open{std::string(name), group});
+        }
+        return;
+    }
+    if (name == "text") {
+        text = document.createNode("text");
+        textParent = currentParent();
+        textContent.clear();
+        document.setNodeProperty(text, "x", formatNumber(number(element, "x")));
+        document.setNodeProperty(text, "y", formatNumber(number(element, "y")));
+        for (const char* key : {"font-family", "font-size", "font-weight", "text-anchor"}) {
+            if (const std::string_view* value = element.get(key)) {
+                document.setNodeProperty(text, key, std::string(*value));
+            }
+        }
+        copyAttributes(text, element);
+        textDepth = 1;
+        if (empty) {
+            finishText();
+        }
+        return;
+    }
+
+    CRDTId shape = createShape(element);
+    if (shape == CRDTId()) {
+        skipped++;
+        skipDepth += empty ? 0 : 1;
+        return;
+    }
+    attach(currentParent(), shape);
+    if (!empty) {
+        // Content of a shape element (e.g. <animate>) is ignored
+        skipDepth = 1;
+    }
+}
+
+void SvgImporter::closeElement(std::string_view name) {
+    if (skipDepth > 0) {
+        skipDepth--;
+        return;
+    }
+    if (textDepth > 0) {
+        if (--textDepth == 0) {
+            finishText();
+        }
+        return;
+    }
+    // Model output is not always balanced: close the nearest match
+    for (size_t i = stack.size(); i-- > 0;) {
+        if (stack[i].name == name) {
+            stack.resize(i);
+            return;
+        }
+    }
+}
+
+CRDTId SvgImporter::createShape(const SvgElement& element) {
+    std::string_view name = element.name;
+    double x = 0.0, y = 0.0, width = 0.0, height = 0.0;
+    std::string type = "shape";
+    std::string kind = "path";
+    std::string d;
+
+    if (name == "rect") {
+        type = "rectangle";
+        x = number(element, "x");
+        y = number(element, "y");
+        width = number(element, "width");
+        height = number(element, "height");
+    } else if (name == "circle" || name == "ellipse") {
+        kind = "ellipse";
+        double rx = name == "circle" ? number(element, "r") : number(element, "rx");
+        double ry = name == "circle" ? rx : number(element, "ry");
+        x = number(element, "cx") - rx;
+        y = number(element, "cy") - ry;
+        width = 2.0 * rx;
+        height = 2.0 * ry;
+    } else {
+        if (name == "path") {
+            const std::string_view* value = element.get("d");
+            if (!value) {
+                return CRDTId();
+            }
+            d.assign(value->data(), value->size());
+        } else if (name == "line") {
+            d = "M" + formatNumber(number(element, "x1")) + "," + formatNumber(number(element, "y1")) +
+                "L" + formatNumber(number(element, "x2")) + "," + formatNumber(number(element, "y2"));
+        } else if (name == "polyline" || name == "polygon") {
+            const std::string_view* points = element.get("points");
+            if (!points) {
+                return CRDTId();
+            }
+            // Point lists are valid path data after an initial moveto
+            d = "M";
+            d.append(points->data(), points->size());
+            if (name == "polygon") {
+                d += 'Z';
+            }
+        } else {
+            return CRDTId();
+        }
+        SvgBounds bounds;
+        if (!computePathBounds(d, bounds)) {
+            return CRDTId();
+        }
+        x = bounds.minX;
+        y = bounds.minY;
+        width = bounds.maxX - bounds.minX;
+        height = bounds.maxY - bounds.minY;
+    }
+
+    CRDTId id = document.createNode(type);
+    if (type == "shape") {
+        document.setNodeProperty(id, "kind", kind);
+    }
+    if (!d.empty()) {
+        document.setNodeProperty(id, "d", d);
+    }
+    document.setNodeProperty(id, "x", formatNumber(x));
+    document.setNodeProperty(id, "y", formatNumber(y));
+    document.setNodeProperty(id, "width", formatNumber(width));
+    document.setNodeProperty(id, "height", formatNumber(height));
+    if (type == "rectangle") {
+        for (const char* key : {"rx", "ry"}) {
+            if (const std::string_view* value = element.get(key)) {
+                document.setNodeProperty(id, key, std::string(*value));
+            }
+        }
+    }
+    copyAttributes(id, element);
+    return id;
+}
+
+void SvgImporter::copyAttributes(const CRDTId& id, const SvgElement& element) {
+    for (const char* key : kSvgPresentationAttributes) {
+        if (const std::string_view* value = element.get(key)) {
+            document.setNodeProperty(id, key, std::string(*value));
+        }
+    }
+    if (const std::string_view* value = element.get("id")) {
+        document.setNodeProperty(id, "name", std::string(*value));
+    }
+}
+
+void SvgImporter::attach(const CRDTId& parent, const CRDTId& id) {
+    document.addChild(parent, id);
+    created.push_back(id);
+    if (recorder) {
+        auto node = document.getNode(id);
+        auto parentEntry = recorded.find(parent.toString());
+        ShapeBatch::Entry entry;
+        entry.type = node->getType();
+        entry.parent = parentEntry == recorded.end() ? -1 : parentEntry->second;
+        for (const auto& property : node->getProperties()) {
+            entry.properties.emplace_back(property.first, property.second.value);
+        }
+        entry.text = document.getText(id);
+        recorded[id.toString()] = static_cast<int32_t>(recorder->entries.size());
+        recorder->entries.push_back(std::move(entry));
+    }
+    if (onNode) {
+        onNode(id);
+    }
+}
+
+void SvgImporter::finishText() {
+    textDepth = 0;
+    if (!textContent.empty()) {
+        document.insertText(text, 0, textContent);
+    }
+    attach(textParent, text);
+    text = CRDTId();
+    textContent.clear();
+}
+
+void SvgImporter::finish() {
+    if (textDepth > 0) {
+        finishText();
+    }
+    stack.clear();
+    skipDepth = 0;
+}
+
+} // namespace Lienzo
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "../collaboration/crdt.h"
+#include "svg_parser.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Lienzo {
+
+// Attributes carried between SVG elements and node properties unchanged
+const size_t kSvgPresentationAttributeCount = 9;
+extern const char* const kSvgPresentationAttributes[kSvgPresentationAttributeCount];
+
+// Nodes produced by an import, detached from any document
+// Entries are in attach order, so a parent always precedes its children.
+struct ShapeBatch {
+    struct Entry {
+        std::string type;
+        int32_t parent;     // Index of the parent entry, -1 for the import root
+        std::vector<std::pair<std::string, std::string>> properties;
+        std::string text;
+    };
+
+    std::vector<Entry> entries;
+
+    // Recreate the nodes under parent; returns the new top-level IDs
+    // onNode is called for each node as it is attached
+    std::vector<CRDTId> instantiate(CRDTDocument& document, const CRDTId& parent,
+                                    const std::function<void(const CRDTId&)>& onNode = nullptr) const;
+    size_t getMemoryUsage() const;
+};
+
+// Turns SvgStreamParser events into document nodes under a parent
+//
+// Every element becomes one node as soon as it is complete:
+//   <rect>                      -> "rectangle" (x, y, width, height, rx, ry)
+//   <path>, <line>, <poly*>     -> "shape" with kind=path and d
+//   <circle>, <ellipse>         -> "shape" with kind=ellipse
+//   <g>, <a>                    -> "group", holding the nested nodes
+//   <text>                      -> "text" (x, y and the text content)
+// Shapes store their bounds in x/y/width/height. Paint and transform
+// attributes are copied as-is; definitions, styles and unknown elements
+// are skipped. Nodes are filled in before being attached, so observers
+// never see a half-built shape.
+class SvgImporter {
+public:
+    using NodeCallback = std::function<void(const CRDTId& id)>;
+
+    SvgImporter(CRDTDocument& document, const CRDTId& parent);
+
+    void setNodeCallback(NodeCallback callback) { onNode = std::move(callback); }
+    // Also append every node attached from now on to batch
+    void setRecorder(ShapeBatch* batch) { recorder = batch; }
+
+    void handle(const SvgElement& element);
+    // End of input: attaches an unterminated <text>
+    void finish();
+
+    const std::vector<CRDTId>& getCreatedNodes() const { return created; }
+    size_t getSkippedElements() const { return skipped; }
+
+private:
+    struct Open {
+        std::string name;
+        CRDTId id;          // Group node, or the parent for pass-through elements
+    };
+
+    CRDTDocument& document;
+    CRDTId root;
+    std::vector<Open> stack;
+    size_t skipDepth;       // Inside skipped elements
+    CRDTId text;            // <text> being collected, if any
+    CRDTId textParent;
+    std::string textContent;
+    size_t textDepth;
+    std::vector<CRDTId> created;
+    size_t skipped;
+    NodeCallback onNode;
+    ShapeBatch* recorder;
+    std::unordered_map<std::string, int32_t> recorded;   // Node ID -> entry
+
+    const CRDTId& currentParent() const;
+    void openElement(const SvgElement& element, bool empty);
+    void closeElement(std::string_view name);
+    CRDTId createShape(const SvgElement& element);
+    void copyAttributes(const CRDTId& id, const SvgElement& element);
+    void attach(const CRDTId& parent, const CRDTId& id);
+    void finishText();
+};
+
+} // namespace Lienzo
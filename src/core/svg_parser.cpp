@@ -0,0 +1,625 @@
+#include "svg_parser.h"
+#include "numbers.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace Lienzo {
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool startsMarkup(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           c == '/' || c == '!' || c == '?' || c == '_' || c == ':';
+}
+
+static bool startsWith(std::string_view text, std::string_view prefix) {
+    return text.size() >= prefix.size() && text.compare(0, prefix.size(), prefix) == 0;
+}
+
+const std::string_view* SvgElement::get(std::string_view key) const {
+    for (const auto& attribute : attributes) {
+        if (attribute.first == key) {
+            return &attribute.second;
+        }
+    }
+    return nullptr;
+}
+
+// SvgStreamParser implementation
+SvgStreamParser::SvgStreamParser(ElementCallback callback)
+    : onElement(std::move(callback)), scanned(0), quote(0), elementCount(0), bytesConsumed(0),
+      decodedCount(0) {
+}
+
+void SvgStreamParser::reset() {
+    pending.clear();
+    scanned = 0;
+    quote = 0;
+    elementCount = 0;
+    bytesConsumed = 0;
+}
+
+void SvgStreamParser::feed(std::string_view chunk) {
+    pending.append(chunk.data(), chunk.size());
+    size_t start = 0;
+    while (start < pending.size()) {
+        if (pending[start] != '<') {
+            size_t next = pending.find('<', start);
+            if (next == std::string::npos) {
+                break;  // The text may continue in the next chunk
+            }
+            emitText(std::string_view(pending).substr(start, next - start));
+            start = next;
+            continue;
+        }
+        if (pending.size() - start < 2) {
+            break;
+        }
+        if (!startsMarkup(pending[start + 1])) {
+            // A literal '<' in prose around the SVG
+            size_t next = pending.find('<', start + 1);
+            if (next == std::string::npos) {
+                break;
+            }
+            emitText(std::string_view(pending).substr(start, next - start));
+            start = next;
+            continue;
+        }
+        std::string_view rest = std::string_view(pending).substr(start);
+        size_t length = findMarkupEnd(rest);
+        if (length == 0) {
+            break;
+        }
+        emitTag(rest.substr(0, length));
+        start += length;
+        scanned = 0;
+        quote = 0;
+    }
+    pending.erase(0, start);
+    bytesConsumed += start;
+}
+
+void SvgStreamParser::finish() {
+    if (!pending.empty() && pending[0] != '<') {
+        emitText(pending);
+    }
+    bytesConsumed += pending.size();
+    pending.clear();
+    scanned = 0;
+    quote = 0;
+}
+
+size_t SvgStreamParser::findMarkupEnd(std::string_view markup) {
+    // Resume where the previous chunk stopped instead of rescanning
+    std::string_view terminator;
+    if (markup[1] == '!') {
+        if (markup.size() < 4 || (markup[2] == '[' && markup.size() < 9)) {
+            return 0;
+        }
+        if (startsWith(markup, "<!--")) {
+            terminator = "-->";
+        } else if (startsWith(markup, "<![CDATA[")) {
+            terminator = "]]>";
+        }
+    }
+    if (!terminator.empty()) {
+        size_t from = std::max<size_t>(scanned, terminator.size() + 1) - terminator.size() + 1;
+        size_t end = markup.find(terminator, from);
+        if (end == std::string_view::npos) {
+            scanned = markup.size();
+            return 0;
+        }
+        return end + terminator.size();
+    }
+    // Quotes only matter inside ordinary tags; '>' may appear in values
+    bool tag = markup[1] != '!' && markup[1] != '?';
+    for (size_t i = std::max<size_t>(scanned, 1); i < markup.size(); i++) {
+        char c = markup[i];
+        if (quote) {
+            if (c == quote) {
+                quote = 0;
+            }
+        } else if (tag && (c == '"' || c == '\'')) {
+            quote = c;
+        } else if (c == '>') {
+            return i + 1;
+        }
+    }
+    scanned = markup.size();
+    return 0;
+}
+
+void SvgStreamParser::emitText(std::string_view text) {
+    if (std::all_of(text.begin(), text.end(), isSpace)) {
+        return;
+    }
+    decodedCount = 0;
+    element.kind = SvgElement::Kind::Text;
+    element.name = std::string_view();
+    element.attributes.clear();
+    element.text = decode(text);
+    elementCount++;
+    if (onElement) {
+        onElement(element);
+    }
+}
+
+void SvgStreamParser::emitTag(std::string_view tag) {
+    if (tag[1] == '!' || tag[1] == '?') {
+        return;   // Comment, CDATA, doctype or processing instruction
+    }
+    // Strip '<' and '>'
+    std::string_view body = tag.substr(1, tag.size() - 2);
+    decodedCount = 0;
+    element.attributes.clear();
+    element.text = std::string_view();
+    if (body[0] == '/') {
+        element.kind = SvgElement::Kind::Close;
+        body.remove_prefix(1);
+    } else {
+        element.kind = SvgElement::Kind::Open;
+        size_t last = body.size();
+        while (last > 0 && isSpace(body[last - 1])) {
+            last--;
+        }
+        if (last > 0 && body[last - 1] == '/') {
+            element.kind = SvgElement::Kind::Empty;
+            body = body.substr(0, last - 1);
+        }
+    }
+
+    size_t i = 0;
+    while (i < body.size() && !isSpace(body[i]) && body[i] != '/') {
+        i++;
+    }
+    element.name = body.substr(0, i);
+
+    while (element.kind != SvgElement::Kind::Close) {
+        while (i < body.size() && isSpace(body[i])) {
+            i++;
+        }
+        if (i >= body.size()) {
+            break;
+        }
+        size_t nameStart = i;
+        while (i < body.size() && !isSpace(body[i]) && body[i] != '=') {
+            i++;
+        }
+        std::string_view name = body.substr(nameStart, i - nameStart);
+        while (i < body.size() && isSpace(body[i])) {
+            i++;
+        }
+        std::string_view value;
+        if (i < body.size() && body[i] == '=') {
+            i++;
+            while (i < body.size() && isSpace(body[i])) {
+                i++;
+            }
+            if (i < body.size() && (body[i] == '"' || body[i] == '\'')) {
+                char delimiter = body[i++];
+                size_t valueStart = i;
+                while (i < body.size() && body[i] != delimiter) {
+                    i++;
+                }
+                value = body.substr(valueStart, i - valueStart);
+                i++;
+            } else {
+                size_t valueStart = i;
+                while (i < body.size() && !isSpace(body[i])) {
+                    i++;
+                }
+                value = body.substr(valueStart, i - valueStart);
+            }
+        }
+        if (!name.empty()) {
+            element.attributes.emplace_back(name, decode(value));
+        }
+    }
+    elementCount++;
+    if (onElement) {
+        onElement(element);
+    }
+}
+
+std::string_view SvgStreamParser::decode(std::string_view text) {
+    if (text.find('&') == std::string_view::npos) {
+        return text;
+    }
+    if (decodedCount == decoded.size()) {
+        decoded.emplace_back();
+    }
+    std::string& out = decoded[decodedCount++];
+    decodeXmlEntities(text, out);
+    return out;
+}
+
+std::string decodeXmlEntities(std::string_view text) {
+    std::string out;
+    decodeXmlEntities(text, out);
+    return out;
+}
+
+void decodeXmlEntities(std::string_view text, std::string& out) {
+    size_t amp = text.find('&');
+    if (amp == std::string_view::npos) {
+        out.assign(text.data(), text.size());
+        return;
+    }
+    out.assign(text.data(), amp);
+    size_t i = amp;
+    while (i < text.size()) {
+        if (text[i] != '&') {
+            out += text[i++];
+            continue;
+        }
+        size_t semicolon = text.find(';', i);
+        if (semicolon == std::string_view::npos || semicolon - i > 10) {
+            out += text[i++];
+            continue;
+        }
+        std::string_view entity = text.substr(i + 1, semicolon - i - 1);
+        uint32_t code = 0;
+        if (entity == "lt") code = '<';
+        else if (entity == "gt") code = '>';
+        else if (entity == "amp") code = '&';
+        else if (entity == "quot") code = '"';
+        else if (entity == "apos") code = '\'';
+        else if (entity.size() > 1 && entity[0] == '#') {
+            bool hex = entity[1] == 'x' || entity[1] == 'X';
+            for (size_t k = hex ? 2 : 1; k < entity.size(); k++) {
+                char c = entity[k];
+                uint32_t digit;
+                if (c >= '0' && c <= '9') digit = c - '0';
+                else if (hex && c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+                else if (hex && c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+                else { code = 0; break; }
+                code = code * (hex ? 16 : 10) + digit;
+                if (code > 0x10FFFF) { code = 0; break; }
+            }
+        }
+        if (code == 0) {
+            out += text[i++];
+            continue;
+        }
+        // UTF-8
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        i = semicolon + 1;
+    }
+}
+
+// Path data
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+struct PathCursor {
+    const char* p;
+    const char* end;
+
+    void skipSeparators() {
+        while (p < end && (isSpace(*p) || *p == ',')) {
+            p++;
+        }
+    }
+
+    bool number(double& value) {
+        skipSeparators();
+        return parseNumber(p, end, value);
+    }
+
+    // Arc flags may be written without separators ("a5 5 0 011 10 10")
+    bool flag(double& value) {
+        skipSeparators();
+        if (p < end && (*p == '0' || *p == '1')) {
+            value = *p++ - '0';
+            return true;
+        }
+        return false;
+    }
+};
+
+// Walk path data as absolute segments
+// Sink gets moveTo, lineTo, quadTo, cubicTo, arcTo and close; relative,
+// shorthand (H/V) and smooth (S/T) commands are resolved here.
+template<typename Sink>
+bool walkPath(std::string_view d, Sink& sink) {
+    PathCursor cursor{d.data(), d.data() + d.size()};
+    double x = 0.0, y = 0.0, startX = 0.0, startY = 0.0;
+    double controlX = 0.0, controlY = 0.0;    // Last control point, for S/T
+    char previous = 0;
+    char command = 0;
+    bool any = false;
+    double args[7];
+    while (true) {
+        cursor.skipSeparators();
+        if (cursor.p >= cursor.end) {
+            break;
+        }
+        char c = *cursor.p;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+            command = c;
+            cursor.p++;
+            if (command == 'Z' || command == 'z') {
+                sink.close(startX, startY);
+                x = startX;
+                y = startY;
+                previous = 'Z';
+                continue;
+            }
+        } else if (command == 0 || command == 'Z' || command == 'z') {
+            break;
+        }
+
+        bool relative = command >= 'a';
+        char upper = relative ? static_cast<char>(command - 32) : command;
+        int count;
+        switch (upper) {
+            case 'M': case 'L': case 'T': count = 2; break;
+            case 'H': case 'V': count = 1; break;
+            case 'S': case 'Q': count = 4; break;
+            case 'C': count = 6; break;
+            case 'A': count = 7; break;
+            default: return any;
+        }
+        bool ok = true;
+        for (int k = 0; k < count && ok; k++) {
+            ok = (upper == 'A' && (k == 3 || k == 4)) ? cursor.flag(args[k]) : cursor.number(args[k]);
+        }
+        if (!ok) {
+            break;
+        }
+        any = true;
+
+        double baseX = relative ? x : 0.0;
+        double baseY = relative ? y : 0.0;
+        // Reflection of the previous control point, or the current point
+        bool smoothCubic = previous == 'C' || previous == 'S';
+        bool smoothQuad = previous == 'Q' || previous == 'T';
+        double reflectedX = 2.0 * x - controlX;
+        double reflectedY = 2.0 * y - controlY;
+        switch (upper) {
+            case 'M':
+                x = baseX + args[0];
+                y = baseY + args[1];
+                startX = x;
+                startY = y;
+                sink.moveTo(x, y);
+                // Further pairs are implicit line-tos
+                command = relative ? 'l' : 'L';
+                break;
+            case 'L':
+                x = baseX + args[0];
+                y = baseY + args[1];
+                sink.lineTo(x, y);
+                break;
+            case 'H':
+                x = baseX + args[0];
+                sink.lineTo(x, y);
+                break;
+            case 'V':
+                y = baseY + args[0];
+                sink.lineTo(x, y);
+                break;
+            case 'C':
+                controlX = baseX + args[2];
+                controlY = baseY + args[3];
+                sink.cubicTo(baseX + args[0], baseY + args[1], controlX, controlY,
+                             baseX + args[4], baseY + args[5]);
+                x = baseX + args[4];
+                y = baseY + args[5];
+                break;
+            case 'S':
+                controlX = baseX + args[0];
+                controlY = baseY + args[1];
+                sink.cubicTo(smoothCubic ? reflectedX : x, smoothCubic ? reflectedY : y,
+                             controlX, controlY, baseX + args[2], baseY + args[3]);
+                x = baseX + args[2];
+                y = baseY + args[3];
+                break;
+            case 'Q':
+                controlX = baseX + args[0];
+                controlY = baseY + args[1];
+                sink.quadTo(controlX, controlY, baseX + args[2], baseY + args[3]);
+                x = baseX + args[2];
+                y = baseY + args[3];
+                break;
+            case 'T':
+                controlX = smoothQuad ? reflectedX : x;
+                controlY = smoothQuad ? reflectedY : y;
+                sink.quadTo(controlX, controlY, baseX + args[0], baseY + args[1]);
+                x = baseX + args[0];
+                y = baseY + args[1];
+                break;
+            case 'A':
+                sink.arcTo(args[0], args[1], args[2], args[3] != 0.0, args[4] != 0.0,
+                           baseX + args[5], baseY + args[6]);
+                x = baseX + args[5];
+                y = baseY + args[6];
+                break;
+        }
+        previous = upper;
+    }
+    return any;
+}
+
+struct BoundsSink {
+    SvgBounds& bounds;
+    bool any = false;
+    double x = 0.0, y = 0.0;
+
+    void include(double px, double py) {
+        if (!any) {
+            bounds.minX = bounds.maxX = px;
+            bounds.minY = bounds.maxY = py;
+            any = true;
+            return;
+        }
+        bounds.minX = std::min(bounds.minX, px);
+        bounds.maxX = std::max(bounds.maxX, px);
+        bounds.minY = std::min(bounds.minY, py);
+        bounds.maxY = std::max(bounds.maxY, py);
+    }
+    void to(double px, double py) {
+        include(px, py);
+        x = px;
+        y = py;
+    }
+    void moveTo(double px, double py) { to(px, py); }
+    void lineTo(double px, double py) { to(px, py); }
+    void quadTo(double x1, double y1, double px, double py) {
+        include(x1, y1);
+        to(px, py);
+    }
+    void cubicTo(double x1, double y1, double x2, double y2, double px, double py) {
+        include(x1, y1);
+        include(x2, y2);
+        to(px, py);
+    }
+    void arcTo(double rx, double ry, double, bool, bool, double px, double py) {
+        // Conservative: the arc stays within its radii of either endpoint
+        rx = std::fabs(rx);
+        ry = std::fabs(ry);
+        include(x - rx, y - ry);
+        include(x + rx, y + ry);
+        include(px - rx, py - ry);
+        include(px + rx, py + ry);
+        to(px, py);
+    }
+    void close(double px, double py) { to(px, py); }
+};
+
+struct FlattenSink {
+    std::vector<VectorPath>& out;
+    double tolerance;
+    double x = 0.0, y = 0.0;
+    bool open = false;      // out.back() is the subpath being built
+
+    void begin(double px, double py) {
+        out.emplace_back();
+        out.back().addPoint(Point(px, py));
+        open = true;
+    }
+    void moveTo(double px, double py) {
+        begin(px, py);
+        x = px;
+        y = py;
+    }
+    void lineTo(double px, double py) {
+        if (!open) {
+            begin(x, y);    // Drawing on after Z starts at the subpath's start
+        }
+        out.back().addPoint(Point(px, py));
+        x = px;
+        y = py;
+    }
+    static int segments(double deviation, double tolerance, double factor) {
+        double n = std::ceil(std::sqrt(deviation * factor / tolerance));
+        return static_cast<int>(std::min(128.0, std::max(1.0, n)));
+    }
+    void quadTo(double x1, double y1, double px, double py) {
+        double x0 = x, y0 = y;
+        int n = segments(std::hypot(x0 - 2 * x1 + px, y0 - 2 * y1 + py), tolerance, 0.25);
+        for (int k = 1; k <= n; k++) {
+            double t = static_cast<double>(k) / n, u = 1.0 - t;
+            lineTo(u * u * x0 + 2 * u * t * x1 + t * t * px,
+                   u * u * y0 + 2 * u * t * y1 + t * t * py);
+        }
+    }
+    void cubicTo(double x1, double y1, double x2, double y2, double px, double py) {
+        double x0 = x, y0 = y;
+        double deviation = std::max(std::hypot(x0 - 2 * x1 + x2, y0 - 2 * y1 + y2),
+                                    std::hypot(x1 - 2 * x2 + px, y1 - 2 * y2 + py));
+        int n = segments(deviation, tolerance, 0.75);
+        for (int k = 1; k <= n; k++) {
+            double t = static_cast<double>(k) / n, u = 1.0 - t;
+            lineTo(u * u * u * x0 + 3 * u * u * t * x1 + 3 * u * t * t * x2 + t * t * t * px,
+                   u * u * u * y0 + 3 * u * u * t * y1 + 3 * u * t * t * y2 + t * t * t * py);
+        }
+    }
+    // Endpoint to center parameterization (SVG 1.1, appendix F.6.5)
+    void arcTo(double rx, double ry, double rotation, bool large, bool sweep, double px, double py) {
+        rx = std::fabs(rx);
+        ry = std::fabs(ry);
+        if (rx == 0.0 || ry == 0.0 || (px == x && py == y)) {
+            lineTo(px, py);
+            return;
+        }
+        double phi = rotation * kPi / 180.0;
+        double cosPhi = std::cos(phi), sinPhi = std::sin(phi);
+        double dx = (x - px) / 2.0, dy = (y - py) / 2.0;
+        double x1 = cosPhi * dx + sinPhi * dy;
+        double y1 = -sinPhi * dx + cosPhi * dy;
+        double lambda = (x1 * x1) / (rx * rx) + (y1 * y1) / (ry * ry);
+        if (lambda > 1.0) {
+            rx *= std::sqrt(lambda);
+            ry *= std::sqrt(lambda);
+        }
+        double numerator = rx * rx * ry * ry - rx * rx * y1 * y1 - ry * ry * x1 * x1;
+        double denominator = rx * rx * y1 * y1 + ry * ry * x1 * x1;
+        double coefficient = std::sqrt(std::max(0.0, numerator / denominator));
+        if (large == sweep) {
+            coefficient = -coefficient;
+        }
+        double cx1 = coefficient * rx * y1 / ry;
+        double cy1 = -coefficient * ry * x1 / rx;
+        double cx = cosPhi * cx1 - sinPhi * cy1 + (x + px) / 2.0;
+        double cy = sinPhi * cx1 + cosPhi * cy1 + (y + py) / 2.0;
+        double theta = std::atan2((y1 - cy1) / ry, (x1 - cx1) / rx);
+        double delta = std::atan2((-y1 - cy1) / ry, (-x1 - cx1) / rx) - theta;
+        if (sweep && delta < 0.0) {
+            delta += 2.0 * kPi;
+        } else if (!sweep && delta > 0.0) {
+            delta -= 2.0 * kPi;
+        }
+
+        double radius = std::max(rx, ry);
+        double step = tolerance < radius ? 2.0 * std::acos(1.0 - tolerance / radius) : kPi / 2.0;
+        int n = static_cast<int>(std::min(256.0, std::max(1.0, std::ceil(std::fabs(delta) / step))));
+        for (int k = 1; k < n; k++) {
+            double angle = theta + delta * k / n;
+            double ex = rx * std::cos(angle), ey = ry * std::sin(angle);
+            lineTo(cx + cosPhi * ex - sinPhi * ey, cy + sinPhi * ex + cosPhi * ey);
+        }
+        lineTo(px, py);
+    }
+    void close(double px, double py) {
+        if (open) {
+            out.back().close();
+            open = false;
+        }
+        x = px;
+        y = py;
+    }
+};
+
+} // namespace
+
+bool computePathBounds(std::string_view d, SvgBounds& bounds) {
+    BoundsSink sink{bounds};
+    walkPath(d, sink);
+    return sink.any;
+}
+
+bool flattenPath(std::string_view d, std::vector<VectorPath>& out, double tolerance) {
+    FlattenSink sink{out, tolerance > 0.0 ? tolerance : 0.25};
+    return walkPath(d, sink);
+}
+
+} // namespace Lienzo
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "vector.h"
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Lienzo {
+
+// One markup event from an SVG stream
+// Views point into the parser's buffers and are only valid during the
+// callback; nothing is allocated per element once the buffers are warm.
+struct SvgElement {
+    enum class Kind {
+        Open,       // <g ...>
+        Close,      // </g>
+        Empty,      // <rect ... />
+        Text        // Character data between tags (entities decoded)
+    };
+
+    Kind kind = Kind::Open;
+    std::string_view name;    // Tag name; empty for Text
+    std::vector<std::pair<std::string_view, std::string_view>> attributes;
+    std::string_view text;    // Kind::Text only
+
+    // Attribute value, or nullptr if absent
+    const std::string_view* get(std::string_view key) const;
+};
+
+// Incremental SVG tokenizer
+//
+// Input arrives in arbitrary chunks (e.g. model tokens); each element is
+// reported as soon as its closing '>' has been seen, so shapes can be
+// created while the rest of the document is still streaming. Comments,
+// processing instructions and doctypes are skipped. Text outside tags that
+// does not look like markup (prose around the SVG) is reported as Text and
+// can be ignored by the consumer.
+class SvgStreamParser {
+public:
+    using ElementCallback = std::function<void(const SvgElement& element)>;
+
+    explicit SvgStreamParser(ElementCallback callback = nullptr);
+
+    void setCallback(ElementCallback callback) { onElement = std::move(callback); }
+
+    void feed(std::string_view chunk);
+    // End of input: flushes trailing text; an unterminated tag is dropped
+    void finish();
+    void reset();
+
+    size_t getElementCount() const { return elementCount; }
+    size_t getBytesConsumed() const { return bytesConsumed; }
+
+private:
+    ElementCallback onElement;
+    std::string pending;      // Unconsumed input
+    size_t scanned;           // Bytes of the current tag already searched for its end
+    char quote;               // Attribute quote open at scanned, or 0
+    size_t elementCount;
+    size_t bytesConsumed;
+    SvgElement element;       // Reused between events
+    std::deque<std::string> decoded;    // Entity-decoded values (stable addresses)
+    size_t decodedCount;
+
+    // Length of the tag or comment at the start of markup, 0 if incomplete
+    size_t findMarkupEnd(std::string_view markup);
+    void emitText(std::string_view text);
+    void emitTag(std::string_view tag);
+    std::string_view decode(std::string_view text);
+};
+
+// Decode the five predefined XML entities and numeric references
+std::string decodeXmlEntities(std::string_view text);
+void decodeXmlEntities(std::string_view text, std::string& out);
+
+// Axis-aligned bounds of SVG path data, including control points
+// (a superset of the drawn area); false if the path has no coordinates
+struct SvgBounds {
+    double minX = 0.0, minY = 0.0, maxX = 0.0, maxY = 0.0;
+};
+bool computePathBounds(std::string_view d, SvgBounds& bounds);
+
+// Path data as polylines, one per subpath; curves and arcs are split
+// until they deviate from the true outline by at most tolerance
+bool flattenPath(std::string_view d, std::vector<VectorPath>& out, double tolerance = 0.25);
+
+} // namespace Lienzo
@@ -0,0 +1,331 @@
+#include "sync_simulator.h"
+#include "../collaboration/crdt_codec.h"
+#include "../collaboration/text_sequence.h"
+#include <algorithm>
+#include <chrono>
+#include <queue>
+#include <random>
+#include <unordered_map>
+
+namespace Lienzo {
+
+struct SyncSimulator::Replica {
+    VectorCRDTManager manager;
+    CRDTId frame;
+    std::vector<CRDTId> ownShapes;
+    std::mt19937 random;
+    // Local operations not yet flushed
+    ByteWriter outbox;
+    size_t outboxCount = 0;
+    bool flushPending = false;
+    // Remote operations waiting for the node they target, by node ID
+    std::unordered_map<std::string, std::vector<CRDTOperation>> waiting;
+    double cpuSeconds = 0.0;
+    // Arrival of the latest message on each link, for FIFO delivery
+    double uplinkLast = 0.0;
+    double downlinkLast = 0.0;
+
+    Replica(const std::string& siteId, uint32_t seed) : manager(siteId), random(seed) {}
+};
+
+struct SyncSimulator::Event {
+    enum class Kind : uint8_t {
+        Edit,
+        Flush,
+        AtRelay,        // A replica's message reached the relay
+        Deliver         // The relay's copy reached a replica
+    };
+
+    double time;
+    uint64_t sequence;      // Ties resolve in scheduling order
+    Kind kind;
+    size_t replica;
+    std::shared_ptr<const std::string> payload;
+
+    bool operator>(const Event& other) const {
+        return time != other.time ? time > other.time : sequence > other.sequence;
+    }
+};
+
+namespace {
+
+double elapsedSeconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+SyncSimulator::SyncSimulator(const SyncSimulationOptions& options) : options(options) {
+    for (size_t i = 0; i < options.replicas; i++) {
+        replicas.push_back(std::make_unique<Replica>("editor" + std::to_string(i),
+                                                     options.seed * 7919u + static_cast<uint32_t>(i)));
+    }
+}
+
+SyncSimulator::~SyncSimulator() = default;
+
+VectorCRDTManager& SyncSimulator::getReplica(size_t index) {
+    return replicas[index]->manager;
+}
+
+double SyncSimulator::linkFreeAt(size_t replica, double time) const {
+    bool moved = true;
+    while (moved) {
+        moved = false;
+        for (const auto& partition : options.partitions) {
+            if (time >= partition.startMs && time < partition.endMs &&
+                std::find(partition.isolated.begin(), partition.isolated.end(), replica) !=
+                    partition.isolated.end()) {
+                time = partition.endMs;
+                moved = true;
+            }
+        }
+    }
+    return time;
+}
+
+SyncSimulationStats SyncSimulator::run() {
+    SyncSimulationStats stats;
+    if (replicas.empty()) {
+        return stats;
+    }
+    std::mt19937 network(options.seed);
+    std::uniform_real_distribution<double> jitter(0.0, std::max(0.0, options.jitterMs));
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    // Shared starting document
+    CRDTDocument seed("seed");
+    std::vector<CRDTId> sharedShapes;
+    for (size_t f = 0; f < options.seedFrames; f++) {
+        CRDTId frame = seed.createNode("frame");
+        seed.setNodeProperty(frame, "x", std::to_string(f * 1200));
+        seed.setNodeProperty(frame, "y", "0");
+        seed.setNodeProperty(frame, "width", "1000");
+        seed.setNodeProperty(frame, "height", "1000");
+        seed.addChild(seed.getRootId(), frame);
+        for (size_t i = 0; i < options.seedShapesPerFrame; i++) {
+            CRDTId shape = seed.createNode("rectangle");
+            seed.setNodeProperty(shape, "x", std::to_string(i * 20));
+            seed.setNodeProperty(shape, "y", std::to_string(i * 10));
+            seed.setNodeProperty(shape, "width", "100");
+            seed.setNodeProperty(shape, "height", "60");
+            seed.addChild(frame, shape);
+            sharedShapes.push_back(shape);
+        }
+    }
+
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    uint64_t sequence = 0;
+    auto schedule = [&](double time, Event::Kind kind, size_t replica,
+                        std::shared_ptr<const std::string> payload = nullptr) {
+        events.push(Event{time, sequence++, kind, replica, std::move(payload)});
+    };
+    auto requestFlush = [&](size_t index, double now) {
+        Replica& replica = *replicas[index];
+        if (replica.outboxCount > 0 && !replica.flushPending) {
+            replica.flushPending = true;
+            schedule(now + options.flushIntervalMs, Event::Kind::Flush, index);
+        }
+    };
+
+    for (size_t i = 0; i < replicas.size(); i++) {
+        Replica& replica = *replicas[i];
+        CRDTDocument& doc = replica.manager.getDocument();
+        doc.merge(seed);
+        doc.addOperationListener([&replica, &stats, &doc](const CRDTOperation& op, bool local) {
+            if (local && !doc.isExpandingClone()) {
+                CRDTCodec::encodeOperation(replica.outbox, op);
+                replica.outboxCount++;
+                stats.operations++;
+            }
+        });
+        auto start = std::chrono::steady_clock::now();
+        replica.frame = replica.manager.createFrame(static_cast<double>(i) * 1200.0, 2000.0, 1000.0, 1000.0);
+        replica.cpuSeconds += elapsedSeconds(start);
+        requestFlush(i, 0.0);
+        schedule(unit(replica.random) * options.editIntervalMs, Event::Kind::Edit, i);
+    }
+
+    // Apply a remote operation, or park it until its node exists
+    std::function<void(Replica&, const CRDTOperation&)> apply = [&](Replica& replica, const CRDTOperation& op) {
+        CRDTDocument& doc = replica.manager.getDocument();
+        if (op.type != CRDTOperationType::CreateNode && !doc.getNode(op.nodeId)) {
+            replica.waiting[op.nodeId.toString()].push_back(op);
+            stats.deferred++;
+            return;
+        }
+        doc.applyOperation(op);
+        if (op.type == CRDTOperationType::CreateNode && !replica.waiting.empty()) {
+            auto it = replica.waiting.find(op.nodeId.toString());
+            if (it != replica.waiting.end()) {
+                std::vector<CRDTOperation> ready = std::move(it->second);
+                replica.waiting.erase(it);
+                for (const auto& waiting : ready) {
+                    apply(replica, waiting);
+                }
+            }
+        }
+    };
+
+    auto edit = [&](Replica& replica) {
+        CRDTDocument& doc = replica.manager.getDocument();
+        std::mt19937& random = replica.random;
+        double choice = std::uniform_real_distribution<double>(0.0, 1.0)(random);
+        auto coordinate = [&] { return std::to_string(random() % 1000); };
+        if (choice < 0.45 && !sharedShapes.empty()) {
+            // Drag a shared shape: concurrent drags of the same shape resolve by LWW
+            const CRDTId& shape = sharedShapes[random() % sharedShapes.size()];
+            doc.setNodeProperty(shape, "x", coordinate());
+            doc.setNodeProperty(shape, "y", coordinate());
+        } else if (choice < 0.60) {
+            auto frame = replica.manager.getFrame(replica.frame);
+            if (frame) {
+                frame->setPosition(frame->getX() + 1.0, frame->getY(), doc);
+            }
+        } else if (choice < 0.75 || replica.ownShapes.empty()) {
+            CRDTId shape = doc.createNode("rectangle");
+            doc.setNodeProperty(shape, "x", coordinate());
+            doc.setNodeProperty(shape, "y", coordinate());
+            doc.setNodeProperty(shape, "width", "50");
+            doc.setNodeProperty(shape, "height", "50");
+            doc.addChild(replica.frame, shape);
+            replica.ownShapes.push_back(shape);
+        } else if (choice < 0.90) {
+            const CRDTId& shape = replica.ownShapes[random() % replica.ownShapes.size()];
+            doc.setNodeProperty(shape, "width", std::to_string(20 + random() % 200));
+            doc.setNodeProperty(shape, "fill", random() % 2 ? "#EF476F" : "#06D6A0");
+        } else {
+            size_t index = random() % replica.ownShapes.size();
+            doc.removeChild(replica.frame, replica.ownShapes[index]);
+            doc.deleteNode(replica.ownShapes[index]);
+            replica.ownShapes.erase(replica.ownShapes.begin() + static_cast<std::ptrdiff_t>(index));
+        }
+    };
+
+    auto arrival = [&](double departure, double& last) {
+        double time = departure + options.latencyMs + jitter(network);
+        if (!options.reorder) {
+            time = std::max(time, last);
+        }
+        last = std::max(last, time);
+        return time;
+    };
+
+    double lastDelivery = 0.0;
+    while (!events.empty()) {
+        Event event = events.top();
+        events.pop();
+        Replica& replica = *replicas[event.replica];
+        switch (event.kind) {
+            case Event::Kind::Edit: {
+                auto start = std::chrono::steady_clock::now();
+                edit(replica);
+                replica.cpuSeconds += elapsedSeconds(start);
+                stats.lastEditMs = std::max(stats.lastEditMs, event.time);
+                requestFlush(event.replica, event.time);
+                double next = event.time + options.editIntervalMs * (0.5 + unit(replica.random));
+                if (next < options.durationMs) {
+                    schedule(next, Event::Kind::Edit, event.replica);
+                }
+                break;
+            }
+            case Event::Kind::Flush: {
+                replica.flushPending = false;
+                ByteWriter message;
+                message.putVarint(replica.outboxCount);
+                message.putBytes(replica.outbox.data().data(), replica.outbox.size());
+                replica.outbox.clear();
+                replica.outboxCount = 0;
+                stats.messages++;
+                stats.bytesSent += message.size();
+                double departure = linkFreeAt(event.replica, event.time);
+                schedule(arrival(departure, replica.uplinkLast), Event::Kind::AtRelay, event.replica,
+                         std::make_shared<const std::string>(std::move(message.data())));
+                break;
+            }
+            case Event::Kind::AtRelay:
+                for (size_t i = 0; i < replicas.size(); i++) {
+                    if (i == event.replica) {
+                        continue;
+                    }
+                    stats.bytesReceived += event.payload->size();
+                    double departure = linkFreeAt(i, event.time);
+                    schedule(arrival(departure, replicas[i]->downlinkLast), Event::Kind::Deliver, i, event.payload);
+                }
+                break;
+            case Event::Kind::Deliver: {
+                auto start = std::chrono::steady_clock::now();
+                ByteReader reader(event.payload->data(), event.payload->size());
+                uint64_t count = 0;
+                reader.getVarint(count);
+                CRDTOperation op;
+                for (uint64_t k = 0; k < count && CRDTCodec::decodeOperation(reader, op); k++) {
+                    apply(replica, op);
+                }
+                replica.cpuSeconds += elapsedSeconds(start);
+                lastDelivery = std::max(lastDelivery, event.time);
+                break;
+            }
+        }
+    }
+    stats.convergenceMs = std::max(0.0, lastDelivery - stats.lastEditMs);
+
+    double cpuTotal = 0.0;
+    for (const auto& replica : replicas) {
+        cpuTotal += replica->cpuSeconds * 1e3;
+        stats.cpuMaxMs = std::max(stats.cpuMaxMs, replica->cpuSeconds * 1e3);
+    }
+    stats.cpuMeanMs = cpuTotal / static_cast<double>(replicas.size());
+
+    const CRDTDocument& reference = replicas.front()->manager.getDocument();
+    std::string expected = canonicalState(reference);
+    stats.converged = true;
+    for (size_t i = 1; i < replicas.size(); i++) {
+        const CRDTDocument& doc = replicas[i]->manager.getDocument();
+        if (!replicas[i]->waiting.empty() || canonicalState(doc) != expected) {
+            stats.converged = false;
+        }
+        for (const auto& id : reference.getAllNodeIds()) {
+            if (reference.getChildren(id) != doc.getChildren(id)) {
+                stats.childOrderMismatches++;
+            }
+        }
+    }
+    return stats;
+}
+
+std::string SyncSimulator::canonicalState(const CRDTDocument& document) {
+    std::vector<CRDTId> ids = document.getAllNodeIds();
+    std::sort(ids.begin(), ids.end());
+    std::string out;
+    for (const auto& id : ids) {
+        auto node = document.getNode(id);
+        if (!node) {
+            continue;
+        }
+        out += id.toString();
+        out += ' ';
+        out += node->getType();
+        out += node->isDeleted() ? " deleted\n" : "\n";
+        std::vector<std::pair<std::string, const CRDTProperty<std::string>*>> properties;
+        for (const auto& entry : node->getProperties()) {
+            properties.emplace_back(std::string(entry.first), &entry.second);
+        }
+        std::sort(properties.begin(), properties.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (const auto& property : properties) {
+            out += "  " + property.first + "=" + property.second->value + "@" +
+                   property.second->timestamp.toString() + "\n";
+        }
+        // In stored order: replicas that agree keep the same order too
+        for (const auto& child : node->getChildEntries()) {
+            out += "  > " + child.childId.toString() + (child.deleted ? " removed" : "") + "\n";
+        }
+        if (node->getText()) {
+            out += "  text " + node->getText()->toString() + "\n";
+        }
+    }
+    return out;
+}
+
+} // namespace Lienzo
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "vector_crdt.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Lienzo {
+
+// A window during which some replicas cannot reach the relay
+// Messages they send, and messages for them, wait until it ends (the
+// reconnect resends them).
+struct SyncPartition {
+    double startMs = 0.0;
+    double endMs = 0.0;
+    std::vector<size_t> isolated;
+};
+
+struct SyncSimulationOptions {
+    size_t replicas = 2;
+    uint32_t seed = 1;
+    // Editing phase; each replica edits every editIntervalMs on average
+    double durationMs = 5000.0;
+    double editIntervalMs = 100.0;
+    // Local operations are batched into one message per flush interval
+    double flushIntervalMs = 50.0;
+    // One-way delay between a replica and the relay, plus uniform jitter
+    double latencyMs = 40.0;
+    double jitterMs = 20.0;
+    // Let jitter reorder messages on a link; otherwise links are FIFO
+    bool reorder = true;
+    std::vector<SyncPartition> partitions;
+    // Shared starting document: frames of rectangles every replica has
+    size_t seedFrames = 20;
+    size_t seedShapesPerFrame = 10;
+};
+
+struct SyncSimulationStats {
+    size_t operations = 0;          // Local operations generated by all replicas
+    size_t messages = 0;            // Sent to the relay
+    uint64_t bytesSent = 0;         // Replicas to relay
+    uint64_t bytesReceived = 0;     // Relay to replicas
+    size_t deferred = 0;            // Remote operations that arrived before their target node
+    double lastEditMs = 0.0;
+    double convergenceMs = 0.0;     // From the last edit until every replica has every operation
+    double cpuMeanMs = 0.0;         // Per replica: time spent on local edits and remote operations
+    double cpuMaxMs = 0.0;
+    bool converged = false;         // Every replica ended in the same state
+    size_t childOrderMismatches = 0;    // Nodes whose live children differ (also fails converged)
+};
+
+// Simulated collaboration session
+//
+// K VectorCRDTManager replicas start from the same document and edit
+// concurrently (drags, resizes, new and deleted rectangles, some on shared
+// shapes). Their operations go through a relay in batched messages, over
+// links with latency, jitter (optionally reordering) and scheduled
+// partitions, all in virtual time, so a run is reproducible from its seed.
+// Operations that arrive before the node they target are held until it
+// exists. At the end every replica's state is compared.
+class SyncSimulator {
+public:
+    explicit SyncSimulator(const SyncSimulationOptions& options);
+    ~SyncSimulator();
+    SyncSimulator(const SyncSimulator&) = delete;
+    SyncSimulator& operator=(const SyncSimulator&) = delete;
+
+    SyncSimulationStats run();
+
+    VectorCRDTManager& getReplica(size_t index);
+
+    // Description of a document's state that does not depend on how it was
+    // built: nodes sorted by ID, with type, tombstone, properties (value and
+    // timestamp) and child entries in their stored order
+    static std::string canonicalState(const CRDTDocument& document);
+
+private:
+    struct Replica;
+    struct Event;
+
+    SyncSimulationOptions options;
+    std::vector<std::unique_ptr<Replica>> replicas;
+
+    double linkFreeAt(size_t replica, double time) const;
+};
+
+} // namespace Lienzo
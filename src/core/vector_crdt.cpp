@@ -1,4 +1,10 @@
 #include "vector_crdt.h"
+#include "profiler.h"
+#include "svg_export.h"
+#include "svg_import.h"
+#include "svg_parser.h"
+#include "../collaboration/op_trace.h"
+#include "../collaboration/undo_manager.h"
 #include <sstream>
 #include <stdexcept>
 #include <algorithm>
@@ -182,13 +188,68 @@ VectorCRDTManager::VectorCRDTManager(const std::string& siteId)
     rebuildFromDocument();
 }
 
+VectorCRDTManager::~VectorCRDTManager() {
+    stopTrace();
+}
+
+bool VectorCRDTManager::startTrace(const std::string& path) {
+    stopTrace();
+    trace = path.empty() ? std::make_unique<OpTraceRecorder>(document)
+                         : std::make_unique<OpTraceRecorder>(document, path);
+    if (!trace->isOk()) {
+        trace.reset();
+        return false;
+    }
+    return true;
+}
+
+std::string VectorCRDTManager::stopTrace() {
+    if (!trace) {
+        return std::string();
+    }
+    trace->stop();
+    std::string data = trace->getData();
+    trace.reset();
+    return data;
+}
+
+uint64_t VectorCRDTManager::getTraceBytes() const {
+    return trace ? trace->getBytes() : 0;
+}
+
+UndoManager& VectorCRDTManager::getUndoManager() {
+    if (!undoManager) {
+        undoManager = std::make_unique<UndoManager>(document);
+    }
+    return *undoManager;
+}
+
+bool VectorCRDTManager::undo() {
+    if (!getUndoManager().undo()) {
+        return false;
+    }
+    syncFrames();
+    return true;
+}
+
+bool VectorCRDTManager::redo() {
+    if (!getUndoManager().redo()) {
+        return false;
+    }
+    syncFrames();
+    return true;
+}
+
 CRDTId VectorCRDTManager::createFrame(double x, double y, double width, double height) {
+    // One batch, so undo removes the frame in one step
+    document.beginBatch();
     CRDTId frameId = createCRDTNodeForFrame(x, y, width, height);
     auto frame = std::make_shared<CRDTFrame>(frameId, x, y, width, height);
     frames[frameId.toString()] = frame;
     
     // Add to root
     document.addChild(document.getRootId(), frameId);
+    document.endBatch();
     
     return frameId;
 }
@@ -206,8 +267,25 @@ void VectorCRDTManager::deleteFrame(const CRDTId& frameId) {
     frames.erase(frameId.toString());
 }
 
+CRDTId VectorCRDTManager::duplicateFrame(const CRDTId& frameId, double dx, double dy) {
+    auto frame = getFrame(frameId);
+    if (!frame) {
+        return CRDTId();
+    }
+    document.beginBatch();
+    CRDTId copyId = document.cloneSubtree(frameId, document.getRootId());
+    if (!copyId.siteId.empty()) {
+        document.setNodeProperty(copyId, "x", std::to_string(frame->getX() + dx));
+        document.setNodeProperty(copyId, "y", std::to_string(frame->getY() + dy));
+        syncFrame(copyId);
+    }
+    document.endBatch();
+    return copyId;
+}
+
 CRDTId VectorCRDTManager::createShape(const CRDTId& frameId, 
                                       std::shared_ptr<VectorShape> shape) {
+    document.beginBatch();
     CRDTId shapeId = createCRDTNodeForShape(frameId, shape);
     auto crdtShape = std::make_shared<CRDTVectorShape>(shapeId, shape);
     shapes[shapeId.toString()] = crdtShape;
@@ -217,6 +295,7 @@ CRDTId VectorCRDTManager::createShape(const CRDTId& frameId,
     if (frame) {
         frame->addShape(shapeId, document);
     }
+    document.endBatch();
     
     return shapeId;
 }
@@ -247,6 +326,64 @@ void VectorCRDTManager::merge(const VectorCRDTManager& other) {
     rebuildFromDocument();
 }
 
+void VectorCRDTManager::syncFrame(const CRDTId& frameId) {
+    auto node = document.getNode(frameId);
+    if (!node || node->isDeleted()) {
+        frames.erase(frameId.toString());
+        return;
+    }
+    double x = 0, y = 0, width = 100, height = 100;
+    if (node->hasProperty("x")) x = std::stod(node->getProperty("x"));
+    if (node->hasProperty("y")) y = std::stod(node->getProperty("y"));
+    if (node->hasProperty("width")) width = std::stod(node->getProperty("width"));
+    if (node->hasProperty("height")) height = std::stod(node->getProperty("height"));
+    
+    auto frame = std::make_shared<CRDTFrame>(frameId, x, y, width, height);
+    frame->syncFromCRDTNode(*node);
+    frames[frameId.toString()] = frame;
+}
+
+void VectorCRDTManager::syncFrames() {
+    // Frames an undo deleted, restored, moved or resized
+    std::vector<CRDTId> known;
+    for (const auto& entry : frames) {
+        known.push_back(entry.second->getId());
+    }
+    for (const auto& frameId : known) {
+        syncFrame(frameId);
+    }
+    for (const auto& frameId : getAllFrames()) {
+        syncFrame(frameId);
+    }
+}
+
+std::vector<CRDTId> VectorCRDTManager::importSvg(const CRDTId& frameId, std::string_view svg) {
+    document.beginBatch();
+    SvgImporter importer(document, frameId);
+    SvgStreamParser parser([&](const SvgElement& element) { importer.handle(element); });
+    parser.feed(svg);
+    parser.finish();
+    importer.finish();
+    document.endBatch();
+    syncFrame(frameId);
+    return importer.getCreatedNodes();
+}
+
+size_t VectorCRDTManager::exportSvg(const CRDTId& frameId,
+                                    const std::function<void(std::string_view chunk)>& sink) const {
+    SvgWriter writer(sink);
+    // Shapes created from VectorShape objects have no path data in the document
+    exportFrameSvg(document, frameId, writer, [this](const CRDTId& id, VectorPath& path) {
+        auto it = shapes.find(id.toString());
+        if (it == shapes.end()) {
+            return false;
+        }
+        path = it->second->getShape()->getPath();
+        return true;
+    });
+    return writer.getBytesWritten();
+}
+
 std::vector<CRDTId> VectorCRDTManager::getAllFrames() const {
     return document.getChildren(document.getRootId());
 }
@@ -256,6 +393,7 @@ std::vector<CRDTId> VectorCRDTManager::getShapesInFrame(const CRDTId& frameId) c
 }
 
 void VectorCRDTManager::rebuildFromDocument() {
+    LIENZO_PROFILE_SCOPE("VectorCRDTManager::rebuildFromDocument");
     // Rebuild frames and shapes from CRDT document
     // This is called after merge to sync local state
     frames.clear();
@@ -264,18 +402,7 @@ void VectorCRDTManager::rebuildFromDocument() {
     // Rebuild frames
     auto frameIds = document.getChildren(document.getRootId());
     for (const auto& frameId : frameIds) {
-        auto node = document.getNode(frameId);
-        if (node && !node->isDeleted()) {
-            double x = 0, y = 0, width = 100, height = 100;
-            if (node->hasProperty("x")) x = std::stod(node->getProperty("x"));
-            if (node->hasProperty("y")) y = std::stod(node->getProperty("y"));
-            if (node->hasProperty("width")) width = std::stod(node->getProperty("width"));
-            if (node->hasProperty("height")) height = std::stod(node->getProperty("height"));
-            
-            auto frame = std::make_shared<CRDTFrame>(frameId, x, y, width, height);
-            frame->syncFromCRDTNode(*node);
-            frames[frameId.toString()] = frame;
-        }
+        syncFrame(frameId);
     }
     
     // TODO: Rebuild shapes (would need shape type information)
@@ -2,13 +2,18 @@
 
 #include "../collaboration/crdt.h"
 #include "vector.h"
+#include <functional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 #include <memory>
 
 namespace Lienzo {
 
+class OpTraceRecorder;
+class UndoManager;
+
 // CRDT-aware vector shape
 // Wraps VectorShape with CRDT properties for collaboration
 class CRDTVectorShape {
@@ -84,6 +89,7 @@ private:
 class VectorCRDTManager {
 public:
     VectorCRDTManager(const std::string& siteId);
+    ~VectorCRDTManager();
     
     // Document access
     CRDTDocument& getDocument() { return document; }
@@ -93,6 +99,9 @@ public:
     CRDTId createFrame(double x, double y, double width, double height);
     std::shared_ptr<CRDTFrame> getFrame(const CRDTId& frameId);
     void deleteFrame(const CRDTId& frameId);
+    // Copy a frame and everything in it, offset by (dx, dy), as one batch
+    // and one CloneSubtree operation; returns the copy (empty if unknown)
+    CRDTId duplicateFrame(const CRDTId& frameId, double dx, double dy);
     
     // Shape operations
     CRDTId createShape(const CRDTId& frameId, std::shared_ptr<VectorShape> shape);
@@ -106,6 +115,36 @@ public:
     // Merge with another document state
     void merge(const VectorCRDTManager& other);
     
+    // Refresh one frame from the document, e.g. when a streamed load reports it ready
+    void syncFrame(const CRDTId& frameId);
+    
+    // SVG interchange
+    // The whole import is one document batch, so peers and undo see it as a
+    // single change; returns every node created
+    std::vector<CRDTId> importSvg(const CRDTId& frameId, std::string_view svg);
+    // Stream the frame as SVG, chunk by chunk; returns the bytes written
+    size_t exportSvg(const CRDTId& frameId,
+                     const std::function<void(std::string_view chunk)>& sink) const;
+    
+    // Operation tracing (see OpTraceRecorder)
+    // Records every local and remote operation with its time, into the file
+    // at path, or into memory if path is empty. Returns false if the file
+    // cannot be created.
+    bool startTrace(const std::string& path = "");
+    // Stop recording; returns the trace for in-memory recordings
+    std::string stopTrace();
+    bool isTracing() const { return trace != nullptr; }
+    // Bytes recorded so far (0 when not tracing)
+    uint64_t getTraceBytes() const;
+    
+    // Undo and redo of this site's changes (see UndoManager); recording
+    // starts with the first call to any of these
+    UndoManager& getUndoManager();
+    // Revert or re-apply one step and refresh the frames; false if there
+    // is nothing to undo or redo
+    bool undo();
+    bool redo();
+    
     // Get all frames
     std::vector<CRDTId> getAllFrames() const;
     
@@ -116,8 +155,11 @@ private:
     CRDTDocument document;
     std::unordered_map<std::string, std::shared_ptr<CRDTFrame>> frames;
     std::unordered_map<std::string, std::shared_ptr<CRDTVectorShape>> shapes;
+    std::unique_ptr<OpTraceRecorder> trace;
+    std::unique_ptr<UndoManager> undoManager;
     
     void rebuildFromDocument();
+    void syncFrames();
     CRDTId createCRDTNodeForFrame(double x, double y, double width, double height);
     CRDTId createCRDTNodeForShape(const CRDTId& frameId, std::shared_ptr<VectorShape> shape);
 };
@@ -1,8 +1,24 @@
 #include "plugin.h"
+#include "plugin_sandbox.h"
+#include "../collaboration/dom_graph.h"
+#include <algorithm>
+#include <chrono>
 
 namespace Lienzo {
 
-PluginManager::PluginManager() {
+const uint64_t PluginManager::kMaxThrottle;
+
+static double elapsedMs(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+PluginManager::PluginManager()
+    : document(nullptr), operationListener(0), batchListener(0), batchCount(0),
+      dispatchCount(0), nextSubscription(0), dispatching(false) {
+}
+
+PluginManager::~PluginManager() {
+    detachDocument();
 }
 
 void PluginManager::registerPlugin(std::shared_ptr<IPlugin> plugin) {
@@ -12,7 +28,11 @@ void PluginManager::registerPlugin(std::shared_ptr<IPlugin> plugin) {
 }
 
 void PluginManager::unregisterPlugin(const std::string& name) {
+    unsubscribe(name);
     plugins.erase(name);
+    if (sandboxes.erase(name)) {
+        bindSandboxes();
+    }
 }
 
 std::shared_ptr<IPlugin> PluginManager::getPlugin(const std::string& name) {
@@ -23,8 +43,29 @@ std::shared_ptr<IPlugin> PluginManager::getPlugin(const std::string& name) {
     return nullptr;
 }
 
-void PluginManager::loadPlugin(const std::string& path) {
-    // TODO: Implement plugin loading
+void PluginManager::setRuntime(std::shared_ptr<PluginRuntime> target) {
+    runtime = std::move(target);
+}
+
+bool PluginManager::loadPlugin(const std::string& path, uint32_t kinds, double budgetMs) {
+    if (!runtime) {
+        runtime = std::make_shared<NativePluginRuntime>();
+    }
+    auto module = runtime->instantiate(path);
+    if (!module) {
+        return false;
+    }
+    auto plugin = std::make_shared<SandboxedPlugin>(std::move(module));
+    std::string name = plugin->getName();
+    if (getPlugin(name)) {
+        return false;
+    }
+    registerPlugin(plugin);
+    sandboxes[name] = plugin;
+    bindSandboxes();
+    plugin->activate();
+    subscribe(name, kinds, budgetMs);
+    return true;
 }
 
 void PluginManager::unloadPlugin(const std::string& name) {
@@ -35,5 +76,200 @@ void PluginManager::unloadPlugin(const std::string& name) {
     }
 }
 
-} // namespace Lienzo
+void PluginManager::attachDocument(CRDTDocument& target) {
+    detachDocument();
+    document = &target;
+    operationListener = document->addOperationListener([this](const CRDTOperation& op, bool local) {
+        current.add(op, local);
+    });
+    batchListener = document->addBatchListener([this] {
+        closeBatch();
+    });
+    bindSandboxes();
+}
+
+void PluginManager::detachDocument() {
+    if (!document) {
+        return;
+    }
+    document->removeOperationListener(operationListener);
+    document->removeBatchListener(batchListener);
+    document = nullptr;
+    bindSandboxes();
+    current = DocumentChangeSet();
+    for (auto& subscription : subscriptions) {
+        subscription->pending.clear();
+        subscription->stats.pendingBatches = 0;
+    }
+}
+
+void PluginManager::subscribe(const std::string& name, uint32_t kinds, double budgetMs) {
+    auto plugin = getPlugin(name);
+    if (!plugin) {
+        return;
+    }
+    // Overruns are measured in budgets, so a budget has to be positive
+    if (!(budgetMs > 0.0)) {
+        budgetMs = kDefaultBudgetMs;
+    }
+    for (auto& subscription : subscriptions) {
+        if (subscription->name == name) {
+            subscription->kinds = kinds;
+            subscription->budgetMs = budgetMs;
+            return;
+        }
+    }
+    auto subscription = std::make_shared<Subscription>();
+    subscription->name = name;
+    subscription->plugin = plugin;
+    subscription->kinds = kinds;
+    subscription->budgetMs = budgetMs;
+    subscription->throttledUntil = 0;
+    subscriptions.push_back(subscription);
+}
+
+void PluginManager::unsubscribe(const std::string& name) {
+    subscriptions.erase(
+        std::remove_if(subscriptions.begin(), subscriptions.end(),
+                       [&name](const std::shared_ptr<Subscription>& subscription) {
+                           return subscription->name == name;
+                       }),
+        subscriptions.end()
+    );
+}
 
+const PluginStats* PluginManager::getStats(const std::string& name) const {
+    for (const auto& subscription : subscriptions) {
+        if (subscription->name == name) {
+            return &subscription->stats;
+        }
+    }
+    return nullptr;
+}
+
+void PluginManager::closeBatch() {
+    if (current.empty()) {
+        return;
+    }
+    current.firstBatch = current.lastBatch = ++batchCount;
+    current.coalesce();
+    auto changes = std::make_shared<const DocumentChangeSet>(std::move(current));
+    current = DocumentChangeSet();
+    
+    uint32_t kinds = changes->getKinds();
+    for (auto& subscription : subscriptions) {
+        if ((kinds & subscription->kinds) && subscription->name != commandOrigin) {
+            subscription->pending.push_back(changes);
+            subscription->stats.pendingBatches = subscription->pending.size();
+        }
+    }
+}
+
+size_t PluginManager::dispatchEvents(double frameBudgetMs) {
+    if (!document || dispatching) {
+        return 0;
+    }
+    // Operations outside any batch count as one batch per frame
+    if (!document->isInBatch()) {
+        closeBatch();
+    }
+    dispatching = true;
+    dispatchCount++;
+    auto start = std::chrono::steady_clock::now();
+    
+    // Plugins may unsubscribe (or subscribe others) while being called
+    auto order = subscriptions;
+    size_t count = order.size();
+    size_t called = 0;
+    size_t firstDeferred = count;
+    for (size_t k = 0; k < count; k++) {
+        size_t index = (nextSubscription + k) % count;
+        Subscription& subscription = *order[index];
+        if (subscription.pending.empty()) {
+            continue;
+        }
+        if (dispatchCount < subscription.throttledUntil) {
+            subscription.stats.throttled++;
+            continue;
+        }
+        // Someone always gets called, so a tight budget cannot starve everyone
+        if (called > 0 && elapsedMs(start) >= frameBudgetMs) {
+            subscription.stats.deferred++;
+            firstDeferred = std::min(firstDeferred, k);
+            continue;
+        }
+        deliver(subscription);
+        called++;
+    }
+    if (firstDeferred < count) {
+        nextSubscription = (nextSubscription + firstDeferred) % count;
+    }
+    dispatching = false;
+    return called;
+}
+
+void PluginManager::deliver(Subscription& subscription) {
+    std::vector<std::shared_ptr<const DocumentChangeSet>> pending;
+    pending.swap(subscription.pending);
+    subscription.stats.pendingBatches = 0;
+    
+    // A plugin that fell behind gets one merged set instead of the backlog
+    DocumentChangeSet merged;
+    const DocumentChangeSet* changes = pending.front().get();
+    if (pending.size() > 1) {
+        for (const auto& batch : pending) {
+            merged.merge(*batch);
+        }
+        merged.coalesce();
+        changes = &merged;
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    subscription.plugin->onDocumentChanged(*document, *changes);
+    double ms = elapsedMs(start);
+    
+    PluginStats& stats = subscription.stats;
+    stats.deliveries++;
+    stats.batches += pending.size();
+    stats.totalMs += ms;
+    stats.lastMs = ms;
+    stats.maxMs = std::max(stats.maxMs, ms);
+    if (ms > subscription.budgetMs) {
+        // Sit out about as many frames as the budget was exceeded by
+        stats.overBudget++;
+        double overrun = std::min(static_cast<double>(kMaxThrottle), ms / subscription.budgetMs);
+        uint64_t skip = static_cast<uint64_t>(overrun);
+        subscription.throttledUntil = dispatchCount + 1 + skip;
+    }
+    
+    auto sandbox = sandboxes.find(subscription.name);
+    if (sandbox != sandboxes.end() && sandbox->second->hasCommands()) {
+        commandOrigin = subscription.name;
+        document->beginBatch();
+        PluginCommandResult result = sandbox->second->applyCommands(*document);
+        document->endBatch();
+        commandOrigin.clear();
+        stats.commands += result.applied;
+        stats.rejectedCommands += result.rejected;
+    }
+}
+
+void PluginManager::bindSandboxes() {
+    if (!document || sandboxes.empty()) {
+        for (auto& sandbox : sandboxes) {
+            sandbox.second->bind(nullptr, nullptr);
+        }
+        view.reset();
+        graph.reset();
+        return;
+    }
+    if (!graph) {
+        graph = std::make_unique<DOMGraph>(*document);
+        view = std::make_unique<PluginDocumentView>(*graph);
+    }
+    for (auto& sandbox : sandboxes) {
+        sandbox.second->bind(graph.get(), view.get());
+    }
+}
+
+} // namespace Lienzo
@@ -1,12 +1,19 @@
 #pragma once
 
+#include "plugin_events.h"
 #include <string>
 #include <functional>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 namespace Lienzo {
 
+class DOMGraph;
+class PluginDocumentView;
+class PluginRuntime;
+class SandboxedPlugin;
+
 // Plugin interface similar to VS Code
 class IPlugin {
 public:
@@ -16,21 +23,103 @@ public:
     virtual std::string getVersion() const = 0;
     virtual void activate() = 0;
     virtual void deactivate() = 0;
+    
+    // Document changes since the last delivery (see PluginManager::subscribe)
+    virtual void onDocumentChanged(const CRDTDocument& /*document*/, const DocumentChangeSet& /*changes*/) {}
+};
+
+// CPU time and delivery counters for one subscribed plugin
+struct PluginStats {
+    uint64_t deliveries = 0;      // onDocumentChanged calls
+    uint64_t batches = 0;         // Document batches those calls covered
+    double totalMs = 0.0;
+    double lastMs = 0.0;
+    double maxMs = 0.0;
+    uint64_t overBudget = 0;      // Calls that ran past the plugin's budget
+    uint64_t throttled = 0;       // Dispatches skipped to pay back an overrun
+    uint64_t deferred = 0;        // Dispatches skipped because the frame budget ran out
+    size_t pendingBatches = 0;
+    uint64_t commands = 0;        // Sandboxed plugins: commands applied
+    uint64_t rejectedCommands = 0;
 };
 
 class PluginManager {
 public:
+    static constexpr double kDefaultBudgetMs = 2.0;
+    static constexpr double kDefaultFrameBudgetMs = 4.0;
+    
     PluginManager();
+    ~PluginManager();
     
     void registerPlugin(std::shared_ptr<IPlugin> plugin);
     void unregisterPlugin(const std::string& name);
     std::shared_ptr<IPlugin> getPlugin(const std::string& name);
     
-    void loadPlugin(const std::string& path);
+    // Sandboxed plugins
+    // loadPlugin() instantiates a module through the runtime (a
+    // NativePluginRuntime unless set), registers and subscribes it. Modules
+    // read the attached document through a shared PluginDocumentView and
+    // their commands are applied in one document batch after each delivery;
+    // that batch is not reported back to the plugin that caused it.
+    void setRuntime(std::shared_ptr<PluginRuntime> runtime);
+    bool loadPlugin(const std::string& path, uint32_t kinds = kAllChanges,
+                    double budgetMs = kDefaultBudgetMs);
     void unloadPlugin(const std::string& name);
     
+    // Document event bus
+    // Operations are coalesced per document batch (operations outside a
+    // batch are grouped until the next dispatch). dispatchEvents(), called
+    // by the host once per frame, hands each subscribed plugin everything
+    // pending for it in one call. A plugin that runs past its budget is
+    // skipped for a number of dispatches proportional to the overrun, and
+    // plugins left when the frame budget is spent wait for the next frame.
+    // A budget that is not positive falls back to kDefaultBudgetMs.
+    void attachDocument(CRDTDocument& document);
+    void detachDocument();
+    void subscribe(const std::string& name, uint32_t kinds = kAllChanges,
+                   double budgetMs = kDefaultBudgetMs);
+    void unsubscribe(const std::string& name);
+    // Returns the number of plugins called
+    size_t dispatchEvents(double frameBudgetMs = kDefaultFrameBudgetMs);
+    
+    // Stats of a subscribed plugin; nullptr if it is not subscribed
+    const PluginStats* getStats(const std::string& name) const;
+    
 private:
+    struct Subscription {
+        std::string name;
+        std::shared_ptr<IPlugin> plugin;
+        uint32_t kinds;
+        double budgetMs;
+        std::vector<std::shared_ptr<const DocumentChangeSet>> pending;
+        uint64_t throttledUntil;  // Dispatch number
+        PluginStats stats;
+    };
+    
+    static const uint64_t kMaxThrottle = 60;   // Dispatches
+    
     std::unordered_map<std::string, std::shared_ptr<IPlugin>> plugins;
+    
+    CRDTDocument* document;
+    size_t operationListener;
+    size_t batchListener;
+    DocumentChangeSet current;
+    uint64_t batchCount;
+    std::vector<std::shared_ptr<Subscription>> subscriptions;
+    uint64_t dispatchCount;
+    size_t nextSubscription;  // Round-robin start, so deferred plugins go first
+    bool dispatching;
+    
+    std::shared_ptr<PluginRuntime> runtime;
+    std::unordered_map<std::string, std::shared_ptr<SandboxedPlugin>> sandboxes;
+    // Created on demand while sandboxed plugins and a document are present
+    std::unique_ptr<DOMGraph> graph;
+    std::unique_ptr<PluginDocumentView> view;
+    std::string commandOrigin;    // Plugin whose commands are being applied
+    
+    void closeBatch();
+    void deliver(Subscription& subscription);
+    void bindSandboxes();
 };
 
 } // namespace Lienzo
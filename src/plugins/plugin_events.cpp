@@ -0,0 +1,88 @@
+#include "plugin_events.h"
+#include <algorithm>
+
+namespace Lienzo {
+
+template<typename T>
+static void sortUnique(std::vector<T>& values) {
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+}
+
+template<typename T>
+static void append(std::vector<T>& to, const std::vector<T>& from) {
+    to.insert(to.end(), from.begin(), from.end());
+}
+
+void DocumentChangeSet::add(const CRDTOperation& op, bool local) {
+    switch (op.type) {
+        case CRDTOperationType::CreateNode:
+            createdNodes.push_back(op.nodeId);
+            break;
+        case CRDTOperationType::DeleteNode:
+            deletedNodes.push_back(op.nodeId);
+            break;
+        case CRDTOperationType::RestoreNode:
+            // Back as it was: to plugins, a new node
+            createdNodes.push_back(op.nodeId);
+            break;
+        case CRDTOperationType::AddChild:
+        case CRDTOperationType::RemoveChild:
+            reparentedNodes.push_back(op.nodeId);
+            break;
+        case CRDTOperationType::SetProperty:
+            changedProperties.emplace_back(op.nodeId, op.key);
+            break;
+        case CRDTOperationType::InsertText:
+        case CRDTOperationType::DeleteText:
+            changedText.push_back(op.nodeId);
+            break;
+        case CRDTOperationType::CloneSubtree:
+            return;     // Its expansion follows
+    }
+    operationCount++;
+    hasLocal = hasLocal || local;
+    hasRemote = hasRemote || !local;
+}
+
+void DocumentChangeSet::merge(const DocumentChangeSet& later) {
+    if (later.empty()) {
+        return;
+    }
+    if (empty()) {
+        firstBatch = later.firstBatch;
+    }
+    lastBatch = later.lastBatch;
+    operationCount += later.operationCount;
+    hasLocal = hasLocal || later.hasLocal;
+    hasRemote = hasRemote || later.hasRemote;
+    append(createdNodes, later.createdNodes);
+    append(deletedNodes, later.deletedNodes);
+    append(reparentedNodes, later.reparentedNodes);
+    append(changedProperties, later.changedProperties);
+    append(changedText, later.changedText);
+}
+
+void DocumentChangeSet::coalesce() {
+    sortUnique(createdNodes);
+    sortUnique(deletedNodes);
+    sortUnique(reparentedNodes);
+    sortUnique(changedProperties);
+    sortUnique(changedText);
+}
+
+uint32_t DocumentChangeSet::getKinds() const {
+    uint32_t kinds = 0;
+    if (!createdNodes.empty() || !deletedNodes.empty() || !reparentedNodes.empty()) {
+        kinds |= kStructureChanges;
+    }
+    if (!changedProperties.empty()) {
+        kinds |= kPropertyChanges;
+    }
+    if (!changedText.empty()) {
+        kinds |= kTextChanges;
+    }
+    return kinds;
+}
+
+} // namespace Lienzo
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "../collaboration/crdt.h"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Lienzo {
+
+// Kinds of document change a plugin can subscribe to
+enum DocumentChangeKind : uint32_t {
+    kStructureChanges = 1 << 0,   // Nodes created/deleted, children added/removed
+    kPropertyChanges = 1 << 1,
+    kTextChanges = 1 << 2,
+    kAllChanges = kStructureChanges | kPropertyChanges | kTextChanges
+};
+
+// Coalesced summary of the operations in one document batch
+//
+// Each node (or node/property pair) appears once however many operations
+// touched it; plugins read current values from the document.
+struct DocumentChangeSet {
+    uint64_t firstBatch = 0;      // Sequence numbers of the batches covered
+    uint64_t lastBatch = 0;
+    size_t operationCount = 0;
+    bool hasLocal = false;
+    bool hasRemote = false;
+    
+    std::vector<CRDTId> createdNodes;
+    std::vector<CRDTId> deletedNodes;
+    std::vector<CRDTId> reparentedNodes;    // Parents whose child list changed
+    std::vector<std::pair<CRDTId, std::string>> changedProperties;
+    std::vector<CRDTId> changedText;
+    
+    void add(const CRDTOperation& op, bool local);
+    // Fold a later change set into this one
+    void merge(const DocumentChangeSet& later);
+    // Sort and drop duplicates; call once after the last add/merge
+    void coalesce();
+    
+    bool empty() const { return operationCount == 0; }
+    uint32_t getKinds() const;
+};
+
+} // namespace Lienzo
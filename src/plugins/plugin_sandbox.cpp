@@ -0,0 +1,166 @@
+#include "plugin_sandbox.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace Lienzo {
+
+const size_t SandboxedPlugin::kMaxCommands;
+
+// NativePluginRuntime implementation
+static std::unordered_map<std::string, NativePluginRuntime::Factory>& nativeModules() {
+    static std::unordered_map<std::string, NativePluginRuntime::Factory> modules;
+    return modules;
+}
+
+void NativePluginRuntime::registerModule(const std::string& name, Factory factory) {
+    nativeModules()[name] = std::move(factory);
+}
+
+void NativePluginRuntime::unregisterModule(const std::string& name) {
+    nativeModules().erase(name);
+}
+
+std::unique_ptr<PluginModule> NativePluginRuntime::instantiate(const std::string& path) {
+    std::string name = path.substr(path.find_last_of("/\\") + 1);
+    const std::string extension = ".wasm";
+    if (name.size() > extension.size() &&
+        name.compare(name.size() - extension.size(), extension.size(), extension) == 0) {
+        name.resize(name.size() - extension.size());
+    }
+    auto it = nativeModules().find(name);
+    if (it == nativeModules().end()) {
+        return nullptr;
+    }
+    return it->second();
+}
+
+// SandboxedPlugin implementation
+SandboxedPlugin::SandboxedPlugin(std::unique_ptr<PluginModule> module)
+    : module(std::move(module)), graph(nullptr), view(nullptr) {
+}
+
+void SandboxedPlugin::bind(const DOMGraph* target, PluginDocumentView* targetView) {
+    graph = target;
+    view = targetView;
+    commands.clear();
+}
+
+void SandboxedPlugin::onDocumentChanged(const CRDTDocument& /*document*/, const DocumentChangeSet& changes) {
+    if (!graph || !view) {
+        return;
+    }
+    view->update();
+
+    // Only nodes the plugin can see are reported
+    changed.clear();
+    auto report = [this](const CRDTId& id) {
+        uint32_t index = graph->indexOf(id);
+        if (index != DOMGraph::kNone) {
+            changed.push_back(index);
+        }
+    };
+    for (const auto& id : changes.createdNodes) report(id);
+    for (const auto& id : changes.reparentedNodes) report(id);
+    for (const auto& property : changes.changedProperties) report(property.first);
+    for (const auto& id : changes.changedText) report(id);
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+    commands.clear();
+    viewIds = view->getIds();
+    PluginViewReader reader(view->data(), view->size());
+    module->onChanges(reader, changed, changes.getKinds(), commands);
+}
+
+PluginCommandResult SandboxedPlugin::applyCommands(CRDTDocument& document) {
+    PluginCommandResult result;
+    std::vector<CRDTId> created;
+    auto resolve = [&](uint64_t ref, CRDTId& id) {
+        if (ref & PluginCommandBuffer::kNewNodeFlag) {
+            uint64_t index = ref & ~static_cast<uint64_t>(PluginCommandBuffer::kNewNodeFlag);
+            if (index >= created.size() || created[index].siteId.empty()) {
+                return false;
+            }
+            id = created[index];
+            return true;
+        }
+        if (ref >= viewIds.size()) {
+            return false;
+        }
+        id = viewIds[ref];
+        return true;
+    };
+
+    const std::string& bytes = commands.getBytes();
+    ByteReader reader(bytes.data(), bytes.size());
+    size_t total = commands.getCommandCount();
+    std::string key, value;
+    while (reader.remaining() > 0) {
+        if (result.applied + result.rejected >= kMaxCommands) {
+            break;
+        }
+        uint8_t type;
+        uint64_t first = 0, second = 0;
+        CRDTId node, other;
+        bool ok = false;
+        reader.getByte(type);
+        switch (static_cast<PluginCommandType>(type)) {
+            case PluginCommandType::CreateNode:
+                if (reader.getString(key) && reader.getVarint(first)) {
+                    // Check the parent before creating anything; a failed lookup
+                    // still reserves the handle (as an empty ID) so later ones line up
+                    ok = first == PluginCommandBuffer::kNoParent || resolve(first, node);
+                    created.push_back(ok ? document.createNode(key) : CRDTId());
+                    if (ok && first != PluginCommandBuffer::kNoParent) {
+                        document.addChild(node, created.back());
+                    }
+                } else {
+                    reader.skip(reader.remaining());
+                }
+                break;
+            case PluginCommandType::DeleteNode:
+                if (reader.getVarint(first) && resolve(first, node) &&
+                    node != document.getRootId()) {
+                    document.deleteNode(node);
+                    ok = true;
+                }
+                break;
+            case PluginCommandType::SetProperty:
+                if (reader.getVarint(first) && reader.getString(key) && reader.getString(value) &&
+                    resolve(first, node)) {
+                    document.setNodeProperty(node, key, value);
+                    ok = true;
+                }
+                break;
+            case PluginCommandType::AddChild:
+            case PluginCommandType::RemoveChild:
+                if (reader.getVarint(first) && reader.getVarint(second) &&
+                    resolve(first, node) && resolve(second, other) && node != other) {
+                    if (static_cast<PluginCommandType>(type) == PluginCommandType::AddChild) {
+                        document.addChild(node, other);
+                    } else {
+                        document.removeChild(node, other);
+                    }
+                    ok = true;
+                }
+                break;
+            default:
+                // Unknown command: the rest of the buffer cannot be framed
+                reader.skip(reader.remaining());
+                break;
+        }
+        if (ok) {
+            result.applied++;
+        } else {
+            result.rejected++;
+        }
+    }
+    // Whatever was not looked at counts as rejected too
+    if (total > result.applied + result.rejected) {
+        result.rejected = total - result.applied;
+    }
+    commands.clear();
+    return result;
+}
+
+} // namespace Lienzo
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "plugin.h"
+#include "plugin_view.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Lienzo {
+
+// A sandboxed plugin module (one WebAssembly instance)
+// It only sees the document through a PluginViewReader over the host's
+// view buffer, and only changes it through the command buffer it fills.
+class PluginModule {
+public:
+    virtual ~PluginModule() = default;
+
+    virtual std::string getName() const = 0;
+    virtual std::string getVersion() const = 0;
+    virtual void start() {}
+    virtual void stop() {}
+
+    // changedNodes are view indices (sorted); kinds are DocumentChangeKind flags
+    virtual void onChanges(const PluginViewReader& view, const std::vector<uint32_t>& changedNodes,
+                           uint32_t kinds, PluginCommandBuffer& commands) = 0;
+};
+
+// Loads plugin modules; nullptr if the path cannot be instantiated
+class PluginRuntime {
+public:
+    virtual ~PluginRuntime() = default;
+    virtual std::unique_ptr<PluginModule> instantiate(const std::string& path) = 0;
+};
+
+// Stand-in runtime for native builds and benchmarks
+// Resolves "dir/name.wasm" to a module factory registered as "name".
+class NativePluginRuntime : public PluginRuntime {
+public:
+    using Factory = std::function<std::unique_ptr<PluginModule>()>;
+
+    static void registerModule(const std::string& name, Factory factory);
+    static void unregisterModule(const std::string& name);
+
+    std::unique_ptr<PluginModule> instantiate(const std::string& path) override;
+};
+
+// Outcome of applying one command buffer
+struct PluginCommandResult {
+    size_t applied = 0;
+    size_t rejected = 0;      // Malformed, unresolved or over the limit
+};
+
+// Adapts a PluginModule to the IPlugin event bus
+class SandboxedPlugin : public IPlugin {
+public:
+    // Commands past this many per delivery are rejected
+    static const size_t kMaxCommands = 10000;
+
+    explicit SandboxedPlugin(std::unique_ptr<PluginModule> module);
+
+    std::string getName() const override { return module->getName(); }
+    std::string getVersion() const override { return module->getVersion(); }
+    void activate() override { module->start(); }
+    void deactivate() override { module->stop(); }
+
+    // Bind the host's view (owned by PluginManager); unbound plugins ignore changes
+    void bind(const DOMGraph* graph, PluginDocumentView* view);
+
+    void onDocumentChanged(const CRDTDocument& document, const DocumentChangeSet& changes) override;
+
+    // Apply what the last onDocumentChanged() asked for, then clear it
+    // Node references resolve against the view as the plugin saw it.
+    PluginCommandResult applyCommands(CRDTDocument& document);
+    bool hasCommands() const { return commands.getCommandCount() > 0; }
+
+private:
+    std::unique_ptr<PluginModule> module;
+    const DOMGraph* graph;
+    PluginDocumentView* view;
+    std::vector<CRDTId> viewIds;     // getIds() at the time of the call
+    std::vector<uint32_t> changed;
+    PluginCommandBuffer commands;
+};
+
+} // namespace Lienzo
@@ -0,0 +1,184 @@
+#include "plugin_view.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace Lienzo {
+
+static PluginNodeType nodeTypeCode(const std::string& type) {
+    if (type == "frame") return PluginNodeType::Frame;
+    if (type == "group") return PluginNodeType::Group;
+    if (type == "rectangle") return PluginNodeType::Rectangle;
+    if (type == "shape") return PluginNodeType::Shape;
+    if (type == "text") return PluginNodeType::Text;
+    if (type == "root") return PluginNodeType::Root;
+    return PluginNodeType::Other;
+}
+
+static float numberProperty(const CRDTNode& node, const char* key) {
+    auto it = node.getProperties().find(key);
+    if (it == node.getProperties().end()) {
+        return 0.0f;
+    }
+    return std::strtof(it->second.value.c_str(), nullptr);
+}
+
+// PluginDocumentView implementation
+PluginDocumentView::PluginDocumentView(const DOMGraph& graph)
+    : graph(graph), structureVersion(0), contentVersion(0), generation(0) {
+    rebuild();
+}
+
+PluginNodeRecord* PluginDocumentView::records() {
+    return reinterpret_cast<PluginNodeRecord*>(buffer.data() + sizeof(PluginViewHeader));
+}
+
+bool PluginDocumentView::update() {
+    if (graph.getStructureVersion() != structureVersion) {
+        rebuild();
+        return true;
+    }
+    if (graph.getContentVersion() == contentVersion) {
+        return false;
+    }
+    contentVersion = graph.getContentVersion();
+    bool changed = false;
+    PluginNodeRecord* nodes = records();
+    for (uint32_t i = 0; i < graph.size(); i++) {
+        uint64_t version = graph.getVersion(i);
+        if (version != versions[i]) {
+            versions[i] = version;
+            fillGeometry(nodes[i], *graph[i].node);
+            changed = true;
+        }
+    }
+    if (changed) {
+        reinterpret_cast<PluginViewHeader*>(buffer.data())->generation = ++generation;
+    }
+    return changed;
+}
+
+void PluginDocumentView::rebuild() {
+    structureVersion = graph.getStructureVersion();
+    contentVersion = graph.getContentVersion();
+    uint32_t count = static_cast<uint32_t>(graph.size());
+    ids.clear();
+    versions.clear();
+    std::string strings;
+    for (uint32_t i = 0; i < count; i++) {
+        ids.push_back(graph.getId(i));
+        versions.push_back(graph.getVersion(i));
+        strings += ids.back().toString();
+    }
+
+    size_t recordBytes = sizeof(PluginNodeRecord) * count;
+    buffer.assign(sizeof(PluginViewHeader) + recordBytes + strings.size(), 0);
+    PluginViewHeader* header = reinterpret_cast<PluginViewHeader*>(buffer.data());
+    header->magic = kPluginViewMagic;
+    header->version = kPluginViewVersion;
+    header->nodeCount = count;
+    header->stringBytes = static_cast<uint32_t>(strings.size());
+    header->generation = ++generation;
+
+    PluginNodeRecord* nodes = records();
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const DOMGraph::Node& node = graph[i];
+        PluginNodeRecord& record = nodes[i];
+        record.parent = node.parent;
+        record.firstChild = node.firstChild;
+        record.nextSibling = node.nextSibling;
+        record.subtreeSize = node.subtreeSize;
+        record.type = nodeTypeCode(node.node->getType());
+        record.idOffset = offset;
+        record.idLength = static_cast<uint32_t>(ids[i].toString().size());
+        offset += record.idLength;
+        fillGeometry(record, *node.node);
+    }
+    std::memcpy(buffer.data() + sizeof(PluginViewHeader) + recordBytes, strings.data(), strings.size());
+}
+
+void PluginDocumentView::fillGeometry(PluginNodeRecord& record, const CRDTNode& node) {
+    record.x = numberProperty(node, "x");
+    record.y = numberProperty(node, "y");
+    record.width = numberProperty(node, "width");
+    record.height = numberProperty(node, "height");
+    record.rotation = numberProperty(node, "rotation");
+}
+
+// PluginViewReader implementation
+PluginViewReader::PluginViewReader(const uint8_t* data, size_t size)
+    : header(nullptr), nodes(nullptr), strings(nullptr), valid(false) {
+    if (!data || size < sizeof(PluginViewHeader)) {
+        return;
+    }
+    header = reinterpret_cast<const PluginViewHeader*>(data);
+    if (header->magic != kPluginViewMagic || header->version != kPluginViewVersion) {
+        return;
+    }
+    size_t recordBytes = sizeof(PluginNodeRecord) * static_cast<size_t>(header->nodeCount);
+    if (size - sizeof(PluginViewHeader) < recordBytes ||
+        size - sizeof(PluginViewHeader) - recordBytes < header->stringBytes) {
+        return;
+    }
+    nodes = reinterpret_cast<const PluginNodeRecord*>(data + sizeof(PluginViewHeader));
+    strings = reinterpret_cast<const char*>(data + sizeof(PluginViewHeader) + recordBytes);
+    valid = true;
+}
+
+std::string_view PluginViewReader::getId(uint32_t index) const {
+    const PluginNodeRecord& record = nodes[index];
+    if (static_cast<uint64_t>(record.idOffset) + record.idLength > header->stringBytes) {
+        return std::string_view();
+    }
+    return std::string_view(strings + record.idOffset, record.idLength);
+}
+
+// PluginCommandBuffer implementation
+void PluginCommandBuffer::putString(std::string_view value) {
+    writer.putVarint(value.size());
+    writer.putBytes(value.data(), value.size());
+}
+
+uint32_t PluginCommandBuffer::createNode(std::string_view type, uint32_t parent) {
+    writer.putByte(static_cast<uint8_t>(PluginCommandType::CreateNode));
+    putString(type);
+    writer.putVarint(parent);
+    commandCount++;
+    return kNewNodeFlag | createdCount++;
+}
+
+void PluginCommandBuffer::deleteNode(uint32_t node) {
+    writer.putByte(static_cast<uint8_t>(PluginCommandType::DeleteNode));
+    writer.putVarint(node);
+    commandCount++;
+}
+
+void PluginCommandBuffer::setProperty(uint32_t node, std::string_view key, std::string_view value) {
+    writer.putByte(static_cast<uint8_t>(PluginCommandType::SetProperty));
+    writer.putVarint(node);
+    putString(key);
+    putString(value);
+    commandCount++;
+}
+
+void PluginCommandBuffer::addChild(uint32_t parent, uint32_t child) {
+    writer.putByte(static_cast<uint8_t>(PluginCommandType::AddChild));
+    writer.putVarint(parent);
+    writer.putVarint(child);
+    commandCount++;
+}
+
+void PluginCommandBuffer::removeChild(uint32_t parent, uint32_t child) {
+    writer.putByte(static_cast<uint8_t>(PluginCommandType::RemoveChild));
+    writer.putVarint(parent);
+    writer.putVarint(child);
+    commandCount++;
+}
+
+void PluginCommandBuffer::clear() {
+    writer.clear();
+    commandCount = 0;
+    createdCount = 0;
+}
+
+} // namespace Lienzo
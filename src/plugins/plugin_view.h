@@ -0,0 +1,141 @@
+#pragma once
+
+#include "../collaboration/crdt.h"
+#include "../collaboration/crdt_codec.h"
+#include "../collaboration/dom_graph.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Lienzo {
+
+// Plugin ABI
+//
+// Sandboxed plugins never call into the document. They read a flat,
+// read-only snapshot of the tree (header, node records, string table, all
+// little-endian in one buffer) and describe their edits in a command
+// buffer that the host applies afterwards in a single document batch.
+
+enum class PluginNodeType : uint32_t {
+    Other = 0,
+    Root = 1,
+    Frame = 2,
+    Group = 3,
+    Rectangle = 4,
+    Shape = 5,
+    Text = 6
+};
+
+struct PluginViewHeader {
+    uint32_t magic;           // kPluginViewMagic
+    uint32_t version;
+    uint32_t nodeCount;
+    uint32_t stringBytes;     // String table size, after the records
+    uint64_t generation;      // Changes whenever the buffer is rewritten
+};
+
+// One visible node, in pre-order (see DOMGraph); indices refer to records
+struct PluginNodeRecord {
+    uint32_t parent;          // 0xFFFFFFFF when absent
+    uint32_t firstChild;
+    uint32_t nextSibling;
+    uint32_t subtreeSize;
+    PluginNodeType type;
+    uint32_t idOffset;        // Node ID ("site:clock") in the string table
+    uint32_t idLength;
+    uint32_t flags;           // Reserved
+    float x, y, width, height, rotation;
+    uint32_t padding;
+};
+
+static const uint32_t kPluginViewMagic = 0x5650564C;   // "LVPV"
+static const uint32_t kPluginViewVersion = 1;
+
+// Host side: keeps the snapshot buffer in sync with a DOMGraph
+// Structural changes rewrite the records; property edits only refresh the
+// records of nodes whose version moved.
+class PluginDocumentView {
+public:
+    explicit PluginDocumentView(const DOMGraph& graph);
+
+    // Bring the buffer up to date; false if nothing changed
+    bool update();
+
+    // Valid until the next update()
+    const uint8_t* data() const { return buffer.data(); }
+    size_t size() const { return buffer.size(); }
+    uint64_t getGeneration() const { return generation; }
+
+    // Node IDs of the records, for resolving plugin commands
+    const std::vector<CRDTId>& getIds() const { return ids; }
+
+private:
+    const DOMGraph& graph;
+    std::vector<uint8_t> buffer;
+    std::vector<CRDTId> ids;
+    std::vector<uint64_t> versions;
+    uint64_t structureVersion;
+    uint64_t contentVersion;
+    uint64_t generation;
+
+    void rebuild();
+    void fillGeometry(PluginNodeRecord& record, const CRDTNode& node);
+    PluginNodeRecord* records();
+};
+
+// Plugin side: bounds-checked access to a snapshot buffer
+class PluginViewReader {
+public:
+    PluginViewReader(const uint8_t* data, size_t size);
+
+    bool isValid() const { return valid; }
+    uint32_t getNodeCount() const { return valid ? header->nodeCount : 0; }
+    uint64_t getGeneration() const { return valid ? header->generation : 0; }
+    const PluginNodeRecord& getNode(uint32_t index) const { return nodes[index]; }
+    std::string_view getId(uint32_t index) const;
+
+private:
+    const PluginViewHeader* header;
+    const PluginNodeRecord* nodes;
+    const char* strings;
+    bool valid;
+};
+
+// Mutations requested by a plugin
+// Nodes are view record indices, or handles returned by createNode (which
+// have kNewNodeFlag set) for nodes created earlier in the same buffer.
+enum class PluginCommandType : uint8_t {
+    CreateNode = 1,
+    DeleteNode = 2,
+    SetProperty = 3,
+    AddChild = 4,
+    RemoveChild = 5
+};
+
+class PluginCommandBuffer {
+public:
+    static const uint32_t kNewNodeFlag = 0x80000000;
+    static const uint32_t kNoParent = 0xFFFFFFFF;
+
+    PluginCommandBuffer() : commandCount(0), createdCount(0) {}
+
+    uint32_t createNode(std::string_view type, uint32_t parent = kNoParent);
+    void deleteNode(uint32_t node);
+    void setProperty(uint32_t node, std::string_view key, std::string_view value);
+    void addChild(uint32_t parent, uint32_t child);
+    void removeChild(uint32_t parent, uint32_t child);
+
+    const std::string& getBytes() const { return writer.data(); }
+    size_t getCommandCount() const { return commandCount; }
+    void clear();
+
+private:
+    ByteWriter writer;
+    size_t commandCount;
+    uint32_t createdCount;
+
+    void putString(std::string_view value);
+};
+
+} // namespace Lienzo
@@ -1,8 +1,17 @@
 #include "crdt_bindings.h"
-#include <emscripten.h>
+#include "../collaboration/snapshot_stream.h"
+#include "../collaboration/text_sequence.h"
+#include "../collaboration/undo_manager.h"
+#include "../ai/chat.h"
+#include "../core/hit_test.h"
+#include "../core/profiler.h"
+#include "../core/snapping.h"
+#include <algorithm>
+#include <chrono>
 #include <vector>
 #include <string>
 #include <cstring>
+#include <cstdio>
 #include <cstdlib>
 
 using namespace Lienzo;
@@ -10,24 +19,72 @@ using namespace Lienzo;
 // Global manager instance
 static VectorCRDTManager* g_manager = nullptr;
 
+// Streamed document load in progress, if any
+static SnapshotStreamDecoder* g_stream = nullptr;
+
+// AI response being ingested, if any
+static ChatInterface* g_aiStream = nullptr;
+static CRDTId g_aiFrame;
+
+// Picking over the manager's document, created on first use
+static DOMGraph* g_graph = nullptr;
+static HitTester* g_hitTester = nullptr;
+// Alignment guides between top-level frames, created on first use
+static SnapEngine* g_snapEngine = nullptr;
+
+static void releasePicking() {
+    delete g_snapEngine;
+    delete g_hitTester;
+    delete g_graph;
+    g_snapEngine = nullptr;
+    g_hitTester = nullptr;
+    g_graph = nullptr;
+}
+
+// The decoder and the AI stream's importer write into the manager's
+// document: drop them with the manager
+static void releaseStream() {
+    delete g_stream;
+    g_stream = nullptr;
+}
+
+static void releaseAiStream() {
+    if (g_aiStream) {
+        // Closes the document batch the stream opened
+        g_aiStream->endVectorStream();
+    }
+    delete g_aiStream;
+    g_aiStream = nullptr;
+    g_aiFrame = CRDTId();
+}
+
 extern "C" {
 
 // Initialize the CRDT manager
 EMSCRIPTEN_KEEPALIVE
 void* crdt_manager_create(const char* siteId) {
+    LIENZO_PROFILE_SCOPE(__func__);
+    releasePicking();
+    releaseStream();
+    releaseAiStream();
     if (g_manager) {
         delete g_manager;
     }
     g_manager = new VectorCRDTManager(std::string(siteId));
+    // Record local changes for crdt_undo from the start
+    g_manager->getUndoManager();
     return g_manager;
 }
 
 // Get the global manager
 EMSCRIPTEN_KEEPALIVE
 void* crdt_manager_get() {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) {
-        // Create default manager if none exists
+        // Create default manager if none exists, recording for crdt_undo
+        // like crdt_manager_create
         g_manager = new VectorCRDTManager("default");
+        g_manager->getUndoManager();
     }
     return g_manager;
 }
@@ -35,6 +92,7 @@ void* crdt_manager_get() {
 // Frame operations
 EMSCRIPTEN_KEEPALIVE
 const char* crdt_create_frame(double x, double y, double width, double height) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return nullptr;
     
     CRDTId frameId = g_manager->createFrame(x, y, width, height);
@@ -48,6 +106,7 @@ const char* crdt_create_frame(double x, double y, double width, double height) {
 
 EMSCRIPTEN_KEEPALIVE
 double crdt_frame_get_x(const char* frameIdStr) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return 0.0;
     CRDTId frameId = stringToCRDTId(frameIdStr);
     auto frame = g_manager->getFrame(frameId);
@@ -59,6 +118,7 @@ double crdt_frame_get_x(const char* frameIdStr) {
 
 EMSCRIPTEN_KEEPALIVE
 double crdt_frame_get_y(const char* frameIdStr) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return 0.0;
     CRDTId frameId = stringToCRDTId(frameIdStr);
     auto frame = g_manager->getFrame(frameId);
@@ -70,6 +130,7 @@ double crdt_frame_get_y(const char* frameIdStr) {
 
 EMSCRIPTEN_KEEPALIVE
 double crdt_frame_get_width(const char* frameIdStr) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return 0.0;
     CRDTId frameId = stringToCRDTId(frameIdStr);
     auto frame = g_manager->getFrame(frameId);
@@ -81,6 +142,7 @@ double crdt_frame_get_width(const char* frameIdStr) {
 
 EMSCRIPTEN_KEEPALIVE
 double crdt_frame_get_height(const char* frameIdStr) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return 0.0;
     CRDTId frameId = stringToCRDTId(frameIdStr);
     auto frame = g_manager->getFrame(frameId);
@@ -92,6 +154,7 @@ double crdt_frame_get_height(const char* frameIdStr) {
 
 EMSCRIPTEN_KEEPALIVE
 void crdt_frame_set_position(const char* frameIdStr, double x, double y) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return;
     CRDTId frameId = stringToCRDTId(frameIdStr);
     auto frame = g_manager->getFrame(frameId);
@@ -102,6 +165,7 @@ void crdt_frame_set_position(const char* frameIdStr, double x, double y) {
 
 EMSCRIPTEN_KEEPALIVE
 void crdt_frame_set_size(const char* frameIdStr, double width, double height) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return;
     CRDTId frameId = stringToCRDTId(frameIdStr);
     auto frame = g_manager->getFrame(frameId);
@@ -112,14 +176,45 @@ void crdt_frame_set_size(const char* frameIdStr, double width, double height) {
 
 EMSCRIPTEN_KEEPALIVE
 void crdt_frame_delete(const char* frameIdStr) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return;
     CRDTId frameId = stringToCRDTId(frameIdStr);
     g_manager->deleteFrame(frameId);
 }
 
+// Copy a frame with all its content; returns the copy's ID (free with crdt_free_string)
+EMSCRIPTEN_KEEPALIVE
+const char* crdt_frame_duplicate(const char* frameIdStr, double dx, double dy) {
+    LIENZO_PROFILE_SCOPE(__func__);
+    if (!g_manager) return nullptr;
+    CRDTId copyId = g_manager->duplicateFrame(stringToCRDTId(frameIdStr), dx, dy);
+    if (copyId.siteId.empty()) return nullptr;
+    std::string idStr = crdtIdToString(copyId);
+    char* result = (char*)malloc(idStr.length() + 1);
+    strcpy(result, idStr.c_str());
+    return result;
+}
+
+// Undo or redo this site's last change; 1 if a step was applied. Frames
+// are refreshed, other views re-read the document.
+EMSCRIPTEN_KEEPALIVE
+int crdt_undo() {
+    LIENZO_PROFILE_SCOPE(__func__);
+    if (!g_manager) return 0;
+    return g_manager->undo() ? 1 : 0;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int crdt_redo() {
+    LIENZO_PROFILE_SCOPE(__func__);
+    if (!g_manager) return 0;
+    return g_manager->redo() ? 1 : 0;
+}
+
 // Get all frame IDs
 EMSCRIPTEN_KEEPALIVE
 void crdt_get_all_frames(char* buffer, int bufferSize) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) {
         buffer[0] = '\0';
         return;
@@ -139,6 +234,7 @@ void crdt_get_all_frames(char* buffer, int bufferSize) {
 // Rectangle operations (using shapes)
 EMSCRIPTEN_KEEPALIVE
 const char* crdt_create_rectangle(const char* frameIdStr, double x, double y, double width, double height) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return nullptr;
     
     // Create rectangle as a CRDT node
@@ -161,6 +257,7 @@ const char* crdt_create_rectangle(const char* frameIdStr, double x, double y, do
 
 EMSCRIPTEN_KEEPALIVE
 double crdt_rectangle_get_x(const char* rectIdStr) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return 0.0;
     CRDTId rectId = stringToCRDTId(rectIdStr);
     auto node = g_manager->getDocument().getNode(rectId);
@@ -172,6 +269,7 @@ double crdt_rectangle_get_x(const char* rectIdStr) {
 
 EMSCRIPTEN_KEEPALIVE
 double crdt_rectangle_get_y(const char* rectIdStr) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return 0.0;
     CRDTId rectId = stringToCRDTId(rectIdStr);
     auto node = g_manager->getDocument().getNode(rectId);
@@ -183,6 +281,7 @@ double crdt_rectangle_get_y(const char* rectIdStr) {
 
 EMSCRIPTEN_KEEPALIVE
 double crdt_rectangle_get_width(const char* rectIdStr) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return 0.0;
     CRDTId rectId = stringToCRDTId(rectIdStr);
     auto node = g_manager->getDocument().getNode(rectId);
@@ -194,6 +293,7 @@ double crdt_rectangle_get_width(const char* rectIdStr) {
 
 EMSCRIPTEN_KEEPALIVE
 double crdt_rectangle_get_height(const char* rectIdStr) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return 0.0;
     CRDTId rectId = stringToCRDTId(rectIdStr);
     auto node = g_manager->getDocument().getNode(rectId);
@@ -205,6 +305,7 @@ double crdt_rectangle_get_height(const char* rectIdStr) {
 
 EMSCRIPTEN_KEEPALIVE
 void crdt_rectangle_set_position(const char* rectIdStr, double x, double y) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return;
     CRDTId rectId = stringToCRDTId(rectIdStr);
     g_manager->getDocument().setNodeProperty(rectId, "x", std::to_string(x));
@@ -213,6 +314,7 @@ void crdt_rectangle_set_position(const char* rectIdStr, double x, double y) {
 
 EMSCRIPTEN_KEEPALIVE
 void crdt_rectangle_set_size(const char* rectIdStr, double width, double height) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return;
     CRDTId rectId = stringToCRDTId(rectIdStr);
     g_manager->getDocument().setNodeProperty(rectId, "width", std::to_string(width));
@@ -221,6 +323,7 @@ void crdt_rectangle_set_size(const char* rectIdStr, double width, double height)
 
 EMSCRIPTEN_KEEPALIVE
 void crdt_rectangle_delete(const char* rectIdStr) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return;
     CRDTId rectId = stringToCRDTId(rectIdStr);
     g_manager->getDocument().deleteNode(rectId);
@@ -229,6 +332,7 @@ void crdt_rectangle_delete(const char* rectIdStr) {
 // Text box operations
 EMSCRIPTEN_KEEPALIVE
 const char* crdt_create_textbox(double x, double y, double width, double height, const char* text) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return nullptr;
     
     CRDTId textId = g_manager->getDocument().createNode("text");
@@ -236,7 +340,9 @@ const char* crdt_create_textbox(double x, double y, double width, double height,
     g_manager->getDocument().setNodeProperty(textId, "y", std::to_string(y));
     g_manager->getDocument().setNodeProperty(textId, "width", std::to_string(width));
     g_manager->getDocument().setNodeProperty(textId, "height", std::to_string(height));
-    g_manager->getDocument().setNodeProperty(textId, "text", text ? std::string(text) : "");
+    if (text) {
+        g_manager->getDocument().insertText(textId, 0, text);
+    }
     
     // Add to root frame
     CRDTId rootId = g_manager->getDocument().getRootId();
@@ -250,18 +356,40 @@ const char* crdt_create_textbox(double x, double y, double width, double height,
 
 EMSCRIPTEN_KEEPALIVE
 void crdt_textbox_set_text(const char* textIdStr, const char* text) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return;
     CRDTId textId = stringToCRDTId(textIdStr);
-    g_manager->getDocument().setNodeProperty(textId, "text", text ? std::string(text) : "");
+    // Only the changed span becomes an operation, not the whole text
+    g_manager->getDocument().setText(textId, text ? std::string(text) : "");
+}
+
+// Per-keystroke edits; index and length count Unicode code points
+EMSCRIPTEN_KEEPALIVE
+int crdt_textbox_insert_text(const char* textIdStr, int index, const char* text) {
+    LIENZO_PROFILE_SCOPE(__func__);
+    if (!g_manager || !text || index < 0) return 0;
+    CRDTId textId = stringToCRDTId(textIdStr);
+    return g_manager->getDocument().insertText(textId, (size_t)index, text) ? 1 : 0;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int crdt_textbox_delete_text(const char* textIdStr, int index, int length) {
+    LIENZO_PROFILE_SCOPE(__func__);
+    if (!g_manager || index < 0 || length <= 0) return 0;
+    CRDTId textId = stringToCRDTId(textIdStr);
+    return g_manager->getDocument().deleteText(textId, (size_t)index, (size_t)length) ? 1 : 0;
 }
 
 EMSCRIPTEN_KEEPALIVE
 const char* crdt_textbox_get_text(const char* textIdStr) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) return nullptr;
     CRDTId textId = stringToCRDTId(textIdStr);
     auto node = g_manager->getDocument().getNode(textId);
-    if (node && node->hasProperty("text")) {
-        std::string text = node->getProperty("text");
+    if (node && (node->getText() || node->hasProperty("text"))) {
+        // Documents from before text editing stored a plain property
+        std::string text = node->getText() ? node->getText()->toString()
+                                           : node->getProperty("text");
         char* result = (char*)malloc(text.length() + 1);
         strcpy(result, text.c_str());
         return result;
@@ -272,6 +400,7 @@ const char* crdt_textbox_get_text(const char* textIdStr) {
 // Get all rectangles
 EMSCRIPTEN_KEEPALIVE
 void crdt_get_all_rectangles(char* buffer, int bufferSize) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) {
         buffer[0] = '\0';
         return;
@@ -299,6 +428,7 @@ void crdt_get_all_rectangles(char* buffer, int bufferSize) {
 // Get all text boxes
 EMSCRIPTEN_KEEPALIVE
 void crdt_get_all_textboxes(char* buffer, int bufferSize) {
+    LIENZO_PROFILE_SCOPE(__func__);
     if (!g_manager) {
         buffer[0] = '\0';
         return;
@@ -323,6 +453,288 @@ void crdt_get_all_textboxes(char* buffer, int bufferSize) {
     buffer[bufferSize - 1] = '\0';
 }
 
+// Snapshot of the whole document (caller must free)
+EMSCRIPTEN_KEEPALIVE
+uint8_t* crdt_serialize(int* size) {
+    LIENZO_PROFILE_SCOPE(__func__);
+    if (!g_manager) return nullptr;
+    std::string data = g_manager->getDocument().serialize();
+    uint8_t* result = (uint8_t*)malloc(data.size());
+    memcpy(result, data.data(), data.size());
+    *size = (int)data.size();
+    return result;
+}
+
+// Streamed loading: push snapshot chunks as they arrive (e.g. from a fetch
+// reader), then poll for frames whose subtree is complete and paint them
+EMSCRIPTEN_KEEPALIVE
+int crdt_stream_begin() {
+    LIENZO_PROFILE_SCOPE(__func__);
+    if (!g_manager) return 0;
+    delete g_stream;
+    g_stream = new SnapshotStreamDecoder(g_manager->getDocument());
+    return 1;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int crdt_stream_push(const uint8_t* data, int size) {
+    LIENZO_PROFILE_SCOPE(__func__);
+    if (!g_stream) return 0;
+    return g_stream->push(data, (size_t)size) ? 1 : 0;
+}
+
+// Writes the next ready frame ID into buffer and syncs it into the manager;
+// returns 0 when no frame is ready yet
+EMSCRIPTEN_KEEPALIVE
+int crdt_stream_next_ready_frame(char* buffer, int bufferSize) {
+    LIENZO_PROFILE_SCOPE(__func__);
+    CRDTId frameId;
+    if (!g_stream || !g_stream->popReadyFrame(frameId)) {
+        return 0;
+    }
+    g_manager->syncFrame(frameId);
+    std::string idStr = crdtIdToString(frameId);
+    strncpy(buffer, idStr.c_str(), bufferSize - 1);
+    buffer[bufferSize - 1] = '\0';
+    return 1;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int crdt_stream_is_root_ready() {
+    LIENZO_PROFILE_SCOPE(__func__);
+    return g_stream && g_stream->isRootReady() ? 1 : 0;
+}
+
+// Call at end of stream; remaining frames are still returned by
+// crdt_stream_next_ready_frame until crdt_stream_end
+EMSCRIPTEN_KEEPALIVE
+int crdt_stream_finish() {
+    LIENZO_PROFILE_SCOPE(__func__);
+    if (!g_stream) return 0;
+    return g_stream->finish() ? 1 : 0;
+}
+
+EMSCRIPTEN_KEEPALIVE
+void crdt_stream_end() {
+    LIENZO_PROFILE_SCOPE(__func__);
+    delete g_stream;
+    g_stream = nullptr;
+}
+
+// Streamed AI output: push model tokens as they arrive; complete SVG
+// elements become shapes in the frame immediately, and the whole response
+// is one undoable batch. Returns the number of nodes created on end.
+EMSCRIPTEN_KEEPALIVE
+int crdt_ai_stream_begin(const char* frameIdStr) {
+    LIENZO_PROFILE_SCOPE(__func__);
+    if (!g_manager) return 0;
+    releaseAiStream();
+    g_aiFrame = stringToCRDTId(frameIdStr);
+    g_aiStream = new ChatInterface();
+    g_aiStream->setTargetFrame(g_manager->getDocument(), g_aiFrame);
+    g_aiStream->beginVectorStream();
+    return 1;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int crdt_ai_stream_push(const char* tokens) {
+    LIENZO_PROFILE_SCOPE(__func__);
+    if (!g_aiStream) return 0;
+    g_aiStream->receiveVectorTokens(tokens);
+    return 1;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int crdt_ai_stream_end() {
+    LIENZO_PROFILE_SCOPE(__func__);
+    if (!g_aiStream) return 0;
+    int count = (int)g_aiStream->endVectorStream();
+    delete g_aiStream;
+    g_aiStream = nullptr;
+    g_manager->syncFrame(g_aiFrame);
+    return count;
+}
+
+// Topmost shape under a document point, tested against its outline;
+// tolerance is in document units. Writes the ID into buffer and returns 1,
+// or 2 if the point is on the shape's stroke; 0 if nothing was hit.
+EMSCRIPTEN_KEEPALIVE
+int crdt_hit_test(double x, double y, double tolerance, char* buffer, int bufferSize) {
+    LIENZO_PROFILE_SCOPE(__func__);
+    if (!g_manager) return 0;
+    if (!g_hitTester) {
+        g_graph = new DOMGraph(g_manager->getDocument());
+        g_hitTester = new HitTester(*g_graph);
+    }
+    HitTester::Hit hit;
+    if (!g_hitTester->hitTest(x, y, hit, tolerance)) {
+        return 0;
+    }
+    std::string idStr = crdtIdToString(hit.id);
+    strncpy(buffer, idStr.c_str(), bufferSize - 1);
+    buffer[bufferSize - 1] = '\0';
+    return hit.onStroke ? 2 : 1;
+}
+
+// Snap a frame being dragged to (x, y) against the other top-level frames,
+// within tolerance document units. Writes the snapped x and y to result,
+// followed by (vertical, position, start, end) for each guide that fits in
+// resultSize doubles; returns the number of guides written, or -1 if the
+// frame does not exist. Call crdt_frame_set_position with the snapped x/y.
+EMSCRIPTEN_KEEPALIVE
+int crdt_frame_snap(const char* frameIdStr, double x, double y, double tolerance,
+                    double* result, int resultSize) {
+    LIENZO_PROFILE_SCOPE(__func__);
+    if (!g_manager || resultSize < 2) return -1;
+    CRDTId frameId = stringToCRDTId(frameIdStr);
+    auto frame = g_manager->getFrame(frameId);
+    if (!frame) return -1;
+    if (!g_snapEngine) {
+        g_snapEngine = new SnapEngine(g_manager->getDocument());
+    }
+    Bounds moving;
+    moving.include(x, y);
+    moving.include(x + frame->getWidth(), y + frame->getHeight());
+    SnapResult snap;
+    g_snapEngine->snap(moving, tolerance, snap, {frameId});
+    result[0] = x + snap.dx;
+    result[1] = y + snap.dy;
+    int written = 0;
+    for (const auto& guide : snap.guides) {
+        if (2 + 4 * (written + 1) > resultSize) break;
+        double* out = result + 2 + 4 * written;
+        out[0] = guide.vertical ? 1.0 : 0.0;
+        out[1] = guide.position;
+        out[2] = guide.start;
+        out[3] = guide.end;
+        written++;
+    }
+    return written;
+}
+
+// Record every operation on the document into memory (see OpTraceRecorder)
+EMSCRIPTEN_KEEPALIVE
+int crdt_trace_start() {
+    LIENZO_PROFILE_SCOPE(__func__);
+    if (!g_manager) return 0;
+    return g_manager->startTrace() ? 1 : 0;
+}
+
+// Stop recording and return the trace (caller must free)
+EMSCRIPTEN_KEEPALIVE
+uint8_t* crdt_trace_stop(int* size) {
+    LIENZO_PROFILE_SCOPE(__func__);
+    *size = 0;
+    if (!g_manager || !g_manager->isTracing()) return nullptr;
+    std::string data = g_manager->stopTrace();
+    uint8_t* result = (uint8_t*)malloc(data.size());
+    memcpy(result, data.data(), data.size());
+    *size = (int)data.size();
+    return result;
+}
+
+// Fill a CRDTMetrics (see crdt_bindings.h); returns the bytes written, or
+// 0 if size is too small. Cost grows with the node count, not with activity.
+EMSCRIPTEN_KEEPALIVE
+int crdt_get_metrics(void* out, int size) {
+    LIENZO_PROFILE_SCOPE(__func__);
+    static const auto start = std::chrono::steady_clock::now();
+    if (!g_manager || size < (int)sizeof(CRDTMetrics)) return 0;
+    const CRDTDocument& doc = g_manager->getDocument();
+    DocumentMetrics metrics = doc.getMetrics();
+    CRDTMetrics result;
+    result.version = CRDTMetrics::kVersion;
+    result.timeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    result.residentNodes = (double)metrics.residentNodes;
+    result.liveNodes = (double)metrics.liveNodes;
+    result.deletedNodes = (double)metrics.deletedNodes;
+    result.liveFrames = (double)metrics.getLiveNodes("frame");
+    result.liveRectangles = (double)metrics.getLiveNodes("rectangle");
+    result.liveTexts = (double)metrics.getLiveNodes("text");
+    result.liveGroups = (double)metrics.getLiveNodes("group");
+    result.liveShapes = (double)metrics.getLiveNodes("shape");
+    result.liveOtherNodes = result.liveNodes - result.liveFrames - result.liveRectangles -
+                            result.liveTexts - result.liveGroups - result.liveShapes;
+    result.properties = (double)metrics.properties;
+    result.liveChildEntries = (double)metrics.liveChildEntries;
+    result.removedChildEntries = (double)metrics.removedChildEntries;
+    result.textCharacters = (double)metrics.textCharacters;
+    result.textRuns = (double)metrics.textRuns;
+    result.localOperations = (double)metrics.counters.localOperations;
+    result.remoteOperations = (double)metrics.counters.remoteOperations;
+    result.rejectedOperations = (double)metrics.counters.rejectedOperations;
+    result.merges = (double)metrics.counters.merges;
+    result.mergeMicros = (double)metrics.counters.mergeMicros;
+    for (size_t i = 0; i < DocumentCounters::kLatencyBuckets; i++) {
+        result.mergeLatency[i] = (double)metrics.counters.mergeLatency[i];
+    }
+    result.logicalClock = (double)metrics.logicalClock;
+    result.siteCount = (double)metrics.siteClocks.size();
+    result.maxRemoteClock = 0.0;
+    for (const auto& site : metrics.siteClocks) {
+        if (site.first != doc.getSiteId()) {
+            result.maxRemoteClock = std::max(result.maxRemoteClock, (double)site.second);
+        }
+    }
+    result.documentBytesInUse = (double)metrics.memory.bytesInUse;
+    result.documentPeakBytesInUse = (double)metrics.memory.peakBytesInUse;
+    result.documentBytesReserved = (double)metrics.memory.bytesReserved;
+    result.documentAllocations = (double)metrics.memory.allocationCount;
+    result.domGraphBytes = g_graph ? (double)(g_graph->getNodes().capacity() * sizeof(DOMGraph::Node)) : 0.0;
+    result.traceBytes = (double)g_manager->getTraceBytes();
+    result.undoBytes = (double)g_manager->getUndoManager().getMemoryUsage();
+    memcpy(out, &result, sizeof(result));
+    return (int)sizeof(result);
+}
+
+// Clock per site, this one included, as JSON sorted by site:
+// [{"site":"alice","clock":12},...] (caller must free with crdt_free_string).
+// Same cost as crdt_get_metrics, which only carries the maximum.
+EMSCRIPTEN_KEEPALIVE
+char* crdt_get_site_clocks() {
+    LIENZO_PROFILE_SCOPE(__func__);
+    std::string json = "[";
+    if (g_manager) {
+        DocumentMetrics metrics = g_manager->getDocument().getMetrics();
+        for (const auto& site : metrics.siteClocks) {
+            if (json.size() > 1) json += ',';
+            json += "{\"site\":\"";
+            for (char c : site.first) {
+                if (c == '"' || c == '\\') {
+                    json += '\\';
+                    json += c;
+                } else if ((unsigned char)c < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)c);
+                    json += escaped;
+                } else {
+                    json += c;
+                }
+            }
+            json += "\",\"clock\":" + std::to_string(site.second) + "}";
+        }
+    }
+    json += ']';
+    char* result = (char*)malloc(json.length() + 1);
+    strcpy(result, json.c_str());
+    return result;
+}
+
+// Spans recorded since the last clear, as Chrome trace JSON (caller must
+// free with crdt_free_string); empty unless built with LIENZO_ENABLE_PROFILING
+EMSCRIPTEN_KEEPALIVE
+char* crdt_profile_export() {
+    std::string trace = Profiler::exportChromeTrace();
+    char* result = (char*)malloc(trace.length() + 1);
+    strcpy(result, trace.c_str());
+    return result;
+}
+
+EMSCRIPTEN_KEEPALIVE
+void crdt_profile_clear() {
+    Profiler::clear();
+}
+
 // Free allocated string
 EMSCRIPTEN_KEEPALIVE
 void crdt_free_string(char* str) {
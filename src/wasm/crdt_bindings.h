@@ -1,7 +1,13 @@
 #pragma once
 
+#ifdef __EMSCRIPTEN__
 #include <emscripten.h>
+#else
+// Native builds (lienzo_test, lienzo_bench) compile the bindings as plain functions
+#define EMSCRIPTEN_KEEPALIVE
+#endif
 #include <string>
+#include <string_view>
 #include "../core/vector_crdt.h"
 #include "../collaboration/crdt.h"
 
@@ -12,15 +18,53 @@ inline std::string crdtIdToString(const CRDTId& id) {
     return id.toString();
 }
 
-inline CRDTId stringToCRDTId(const std::string& str) {
-    size_t colonPos = str.find(':');
-    if (colonPos != std::string::npos) {
-        std::string siteId = str.substr(0, colonPos);
-        uint64_t clock = std::stoull(str.substr(colonPos + 1));
-        return CRDTId(siteId, clock);
-    }
-    return CRDTId();
+inline CRDTId stringToCRDTId(std::string_view str) {
+    return CRDTId::fromString(str);
 }
 
-} // namespace Lienzo
+// Filled by crdt_get_metrics. Every field is a double, without padding, so
+// JavaScript reads it as a Float64Array; new fields are only ever appended
+// (check version and the size crdt_get_metrics returns).
+struct CRDTMetrics {
+    static const int kVersion = 1;
+
+    double version;
+    double timeMs;                  // Since module start; rates are counter deltas over this
+    // Nodes (resident in memory)
+    double residentNodes;
+    double liveNodes;
+    double deletedNodes;
+    double liveFrames;
+    double liveRectangles;
+    double liveTexts;
+    double liveGroups;
+    double liveShapes;
+    double liveOtherNodes;
+    double properties;
+    double liveChildEntries;
+    double removedChildEntries;
+    double textCharacters;
+    double textRuns;
+    // Operations and merges (DocumentCounters)
+    double localOperations;
+    double remoteOperations;
+    double rejectedOperations;
+    double merges;
+    double mergeMicros;
+    double mergeLatency[DocumentCounters::kLatencyBuckets];
+    // Clocks
+    double logicalClock;
+    double siteCount;               // Sites seen in the document, this one included
+    double maxRemoteClock;          // Highest clock of any other site (per site: crdt_get_site_clocks)
+    // Memory by subsystem, in bytes
+    double documentBytesInUse;
+    double documentPeakBytesInUse;
+    double documentBytesReserved;
+    double documentAllocations;
+    double domGraphBytes;
+    double traceBytes;
+    double undoBytes;       // Undo and redo stacks
+};
+static_assert(sizeof(CRDTMetrics) % sizeof(double) == 0, "CRDTMetrics must be packed doubles");
 
+} // namespace Lienzo
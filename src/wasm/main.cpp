@@ -1,4 +1,3 @@
-#include <emscripten.h>
 #include "../core/frame.h"
 #include "../canvas/canvas.h"
 #include "crdt_bindings.h"
@@ -0,0 +1,78 @@
+#include "op_trace.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/resource.h>
+
+using namespace Lienzo;
+
+namespace {
+
+size_t peakResidentBytes() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+int usage() {
+    std::fprintf(stderr,
+                 "Usage: lienzo_replay TRACE [--replicas=N] [--realtime] [--speed=F]\n"
+                 "Replays a trace recorded with VectorCRDTManager::startTrace into N\n"
+                 "fresh replicas, as fast as possible or at the recorded pace\n"
+                 "(--realtime, optionally sped up by --speed).\n");
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    OpTraceReplayOptions options;
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], "--replicas=", 11) == 0) {
+            options.replicas = static_cast<size_t>(std::atol(argv[i] + 11));
+        } else if (std::strcmp(argv[i], "--realtime") == 0) {
+            options.realTime = true;
+        } else if (std::strncmp(argv[i], "--speed=", 8) == 0) {
+            options.speed = std::atof(argv[i] + 8);
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            return usage();
+        }
+    }
+    if (!path || options.replicas == 0) {
+        return usage();
+    }
+
+    std::string trace;
+    if (!readOpTraceFile(path, trace)) {
+        std::fprintf(stderr, "lienzo_replay: cannot read %s\n", path);
+        return 1;
+    }
+    OpTraceReplayStats stats;
+    bool complete = replayOpTrace(trace, options, stats);
+    if (stats.records == 0 && !complete) {
+        std::fprintf(stderr, "lienzo_replay: %s is not an operation trace\n", path);
+        return 1;
+    }
+
+    std::printf("records=%zu replicas=%zu applied=%zu skipped=%zu seconds=%.3f ops_per_sec=%.0f "
+                "p50_us=%.2f p90_us=%.2f p99_us=%.2f max_us=%.2f nodes=%zu "
+                "peak_arena_bytes=%zu peak_rss_bytes=%zu trace_bytes=%zu\n",
+                stats.records, options.replicas, stats.applied, stats.skipped, stats.seconds,
+                stats.opsPerSecond, stats.latencyP50Micros, stats.latencyP90Micros,
+                stats.latencyP99Micros, stats.latencyMaxMicros, stats.nodes, stats.peakBytesInUse,
+                peakResidentBytes(), trace.size());
+    if (!complete) {
+        std::fprintf(stderr, "lienzo_replay: trace is damaged after record %zu\n", stats.records);
+        return 1;
+    }
+    return 0;
+}